@@ -0,0 +1,123 @@
+// Runtime of the assembly printed by `monkey --emit-asm`, which calls it
+// on the slow paths it does not inline: operands that are not integers,
+// errors, and closure, array, hash and string creation. Built with the program:
+//
+//   monkey --emit-asm prog.mk > prog.s
+//   cc prog.s runtime/asmRuntime.c -Iruntime -o prog
+//
+// Arguments and results follow the System V ABI, so a Value travels in two
+// registers, its type first.
+
+#include <stddef.h>
+
+#include "monkeyRuntime.h"
+
+// Byte offsets the assembly relies on
+_Static_assert(sizeof(Value) == 16, "a Value is 16 bytes");
+_Static_assert(offsetof(Closure, code) == 0, "code of a closure");
+_Static_assert(offsetof(Closure, numParams) == 8, "arity of a closure");
+_Static_assert(offsetof(Closure, captures) == 32, "captures of a closure");
+
+Value monkeyProgram(void);
+Value monkeyInfix(const char* opt, Value left, Value right);
+Value monkeyPrefix(const char* opt, Value right);
+Value monkeyUnbound(const char* name);
+void monkeyCheckCall(Value callee, int argc);
+Value monkeyClosure(Code code, int numParams, int numCaptures,
+                    const char* source);
+Value monkeyString(const char* chars, size_t len);
+Value monkeyArray(size_t capacity);
+void monkeyPush(Array* array, Value value);
+Value monkeyHash(size_t capacity);
+void monkeyCheckKey(Value key);
+void monkeyHashPut(Hash* hash, Value key, Value value);
+Value monkeyIndex(Value left, Value index);
+
+Value monkeyInfix(const char* opt, Value left, Value right)
+{
+    switch (opt[0])
+    {
+    case '+':
+        return infixAdd(left, right);
+    case '-':
+        return infixSub(left, right);
+    case '*':
+        return infixMul(left, right);
+    case '/':
+        return infixDiv(left, right);
+    case '<':
+        return infixLess(left, right);
+    case '>':
+        return infixGreater(left, right);
+    case '=':
+        return infixEqual(left, right);
+    case '!':
+        return infixNotEqual(left, right);
+    default:
+        return unknownInfix(opt, left, right);
+    }
+}
+
+Value monkeyPrefix(const char* opt, Value right)
+{
+    if (opt[0] == '-')
+        return prefixNegate(right);
+    return unknownPrefix(opt, right);
+}
+
+Value monkeyUnbound(const char* name)
+{
+    return unbound(name);
+}
+
+void monkeyCheckCall(Value callee, int argc)
+{
+    checkCall(callee, argc);
+}
+
+Value monkeyClosure(Code code, int numParams, int numCaptures,
+                    const char* source)
+{
+    return mkClosure(code, numParams, numCaptures, source);
+}
+
+Value monkeyString(const char* chars, size_t len)
+{
+    return mkString(chars, len);
+}
+
+Value monkeyArray(size_t capacity)
+{
+    return mkArray(capacity);
+}
+
+void monkeyPush(Array* array, Value value)
+{
+    arrayPush(ARRAY_VALUE(array), value);
+}
+
+Value monkeyHash(size_t capacity)
+{
+    return mkHash(capacity);
+}
+
+void monkeyCheckKey(Value key)
+{
+    checkHashKey(key);
+}
+
+void monkeyHashPut(Hash* hash, Value key, Value value)
+{
+    hashPut(HASH_VALUE(hash), key, value);
+}
+
+Value monkeyIndex(Value left, Value index)
+{
+    return indexValue(left, index);
+}
+
+int main(void)
+{
+    printValue(monkeyProgram());
+    return 0;
+}
@@ -0,0 +1,567 @@
+#ifndef _MONKEY_LANG_RUNTIME_MONKEYRUNTIME_H_
+#define _MONKEY_LANG_RUNTIME_MONKEYRUNTIME_H_
+
+// Runtime of the C programs printed by `monkey --emit-c`. Values, closures,
+// arrays, hashes, strings and error messages are those of the interpreter; see
+// src/object.h, src/collection.h and src/rope.h.
+//
+//   monkey --emit-c prog.mk > prog.c
+//   cc -O2 -Iruntime prog.c -o prog
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum
+{
+    VALUE_UNDEFINED = 0, // no value: a `let`, or a global not yet bound
+    VALUE_NULL,
+    VALUE_INT,
+    VALUE_BOOL,
+    VALUE_CLOSURE,
+    VALUE_ARRAY,
+    VALUE_HASH,
+    VALUE_STRING,
+} ValueType;
+
+typedef struct Closure Closure;
+typedef struct Array Array;
+typedef struct Hash Hash;
+typedef struct Rope Rope;
+
+typedef struct
+{
+    ValueType type;
+    union
+    {
+        int64_t integer;
+        int boolean;
+        Closure* closure;
+        Array* array;
+        Hash* hash;
+        Rope* string;
+    } as;
+} Value;
+
+// Body of a function literal. It is called with its closure and one Value
+// per parameter, through a pointer cast to the CodeN type of the program
+// that takes N of them.
+typedef void (*Code)(void);
+
+// Emitted programs never free their closures
+struct Closure
+{
+    Code code;
+    int numParams;
+    const char* source; // printed as the value of the closure
+    int numCaptures;
+    Value captures[];
+};
+
+#define UNDEFINED_VALUE ((Value){VALUE_UNDEFINED, {0}})
+#define NULL_VALUE      ((Value){VALUE_NULL, {0}})
+#define INT_VALUE(v)    ((Value){VALUE_INT, {.integer = (v)}})
+#define BOOL_VALUE(v)   ((Value){VALUE_BOOL, {.boolean = (v)}})
+#define CLOSURE_VALUE(c) ((Value){VALUE_CLOSURE, {.closure = (c)}})
+#define ARRAY_VALUE(a)   ((Value){VALUE_ARRAY, {.array = (a)}})
+#define HASH_VALUE(h)    ((Value){VALUE_HASH, {.hash = (h)}})
+#define STRING_VALUE(s)  ((Value){VALUE_STRING, {.string = (s)}})
+
+// Arrays and hashes live until the program exits, as closures do
+struct Array
+{
+    size_t len;
+    size_t capacity;
+    Value* elements;
+};
+
+typedef struct
+{
+    Value key;
+    Value value;
+} HashEntry;
+
+// Pairs in the order their keys were first inserted, found through an
+// open-addressing table of their positions plus one, 0 being empty
+struct Hash
+{
+    HashEntry* entries;
+    size_t len;
+    size_t capacity;
+    size_t* slots;
+    size_t slotMask;
+};
+
+// Strings are ropes, as in the interpreter, so that appending to a long
+// string takes constant time. A concatenation is flattened the first time
+// its characters are needed. Strings live until the program exits too.
+struct Rope
+{
+    size_t len;
+    const char* chars; // NULL until a concatenation is flattened
+    Rope* left;
+    Rope* right;
+    uint64_t hash; // 0 until the string is first hashed
+};
+
+static inline const char* valueTypeName(ValueType type)
+{
+    switch (type)
+    {
+    case VALUE_NULL:
+        return "NULL";
+    case VALUE_INT:
+        return "INTEGER";
+    case VALUE_BOOL:
+        return "BOOLEAN";
+    case VALUE_CLOSURE:
+        return "FUNCTION";
+    case VALUE_ARRAY:
+        return "ARRAY";
+    case VALUE_HASH:
+        return "HASH";
+    case VALUE_STRING:
+        return "STRING";
+    default:
+        return "UNDEFINED";
+    }
+}
+
+// A runtime error ends the program, as it ends a run of the interpreter
+static inline Value runtimeError(const char* fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    fprintf(stderr, "[ERROR]: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+
+    exit(1);
+}
+
+static inline void* allocOrFail(size_t size)
+{
+    void* output = malloc(size);
+    if (!output)
+        runtimeError("out of memory");
+    return output;
+}
+
+// Literals keep the characters the program was compiled with
+static inline Value mkString(const char* chars, size_t len)
+{
+    Rope* rope  = allocOrFail(sizeof(Rope));
+    rope->len   = len;
+    rope->chars = chars;
+    rope->left  = NULL;
+    rope->right = NULL;
+    rope->hash  = 0;
+    return STRING_VALUE(rope);
+}
+
+static inline Value concatStrings(Rope* left, Rope* right)
+{
+    if (!left->len)
+        return STRING_VALUE(right);
+    if (!right->len)
+        return STRING_VALUE(left);
+
+    Value output            = mkString(NULL, left->len + right->len);
+    output.as.string->left  = left;
+    output.as.string->right = right;
+    return output;
+}
+
+// Filled from the end, right halves first, without recursion however deep
+// the concatenation is
+static inline const char* flattenRope(Rope* rope)
+{
+    if (rope->chars)
+        return rope->chars;
+
+    char* chars    = allocOrFail(rope->len + 1);
+    size_t end     = rope->len;
+    size_t len     = 0;
+    size_t cap     = 16;
+    Rope** pending = allocOrFail(sizeof(Rope*) * cap);
+
+    chars[end]     = '\0';
+    pending[len++] = rope;
+    while (len > 0)
+    {
+        Rope* part = pending[--len];
+        if (part->chars)
+        {
+            end -= part->len;
+            memcpy(chars + end, part->chars, part->len);
+            continue;
+        }
+
+        if (len + 2 > cap)
+        {
+            cap <<= 1;
+            pending = realloc(pending, sizeof(Rope*) * cap);
+            if (!pending)
+                runtimeError("out of memory");
+        }
+        pending[len++] = part->left;
+        pending[len++] = part->right;
+    }
+    free(pending);
+
+    rope->chars = chars;
+    rope->left  = NULL;
+    rope->right = NULL;
+    return chars;
+}
+
+static inline uint64_t ropeHash(Rope* rope)
+{
+    if (!rope->hash)
+    {
+        const char* chars = flattenRope(rope);
+        uint64_t x        = 14695981039346656037ULL;
+        for (size_t i = 0; i < rope->len; ++i)
+            x = (x ^ (unsigned char)chars[i]) * 1099511628211ULL;
+        rope->hash = x ? x : 1;
+    }
+    return rope->hash;
+}
+
+static inline int ropesEqual(Rope* lhs, Rope* rhs)
+{
+    if (lhs == rhs)
+        return 1;
+    if (lhs->len != rhs->len)
+        return 0;
+    if (lhs->hash && rhs->hash && lhs->hash != rhs->hash)
+        return 0;
+    return memcmp(flattenRope(lhs), flattenRope(rhs), lhs->len) == 0;
+}
+
+// Only false and null are falsy
+static inline int isTruthy(Value value)
+{
+    switch (value.type)
+    {
+    case VALUE_NULL:
+    case VALUE_UNDEFINED:
+        return 0;
+    case VALUE_BOOL:
+        return value.as.boolean;
+    default:
+        return 1;
+    }
+}
+
+// Integers, booleans and strings compare by value, closures, arrays and
+// hashes by identity
+static inline int valuesEqual(Value lhs, Value rhs)
+{
+    if (lhs.type != rhs.type)
+        return 0;
+
+    switch (lhs.type)
+    {
+    case VALUE_INT:
+        return lhs.as.integer == rhs.as.integer;
+    case VALUE_BOOL:
+        return lhs.as.boolean == rhs.as.boolean;
+    case VALUE_CLOSURE:
+        return lhs.as.closure == rhs.as.closure;
+    case VALUE_ARRAY:
+        return lhs.as.array == rhs.as.array;
+    case VALUE_HASH:
+        return lhs.as.hash == rhs.as.hash;
+    case VALUE_STRING:
+        return ropesEqual(lhs.as.string, rhs.as.string);
+    default:
+        return 1;
+    }
+}
+
+// The result of an if or a call, which is null rather than undefined
+static inline Value orNull(Value value)
+{
+    return value.type == VALUE_UNDEFINED ? NULL_VALUE : value;
+}
+
+static inline Value loadGlobal(Value value, const char* name)
+{
+    if (value.type == VALUE_UNDEFINED)
+        return runtimeError("identifier not found: %s", name);
+    return value;
+}
+
+static inline Value unbound(const char* name)
+{
+    return runtimeError("identifier not found: %s", name);
+}
+
+static inline Value prefixNot(Value right)
+{
+    return BOOL_VALUE(!isTruthy(right));
+}
+
+static inline Value prefixNegate(Value right)
+{
+    if (right.type == VALUE_INT)
+        return INT_VALUE((int64_t)(0 - (uint64_t)right.as.integer));
+    return runtimeError("unknown operator: -%s", valueTypeName(right.type));
+}
+
+static inline Value unknownPrefix(const char* opt, Value right)
+{
+    return runtimeError("unknown operator: %s%s", opt,
+                        valueTypeName(right.type));
+}
+
+// Operands of an infix operator that are not both integers
+static inline Value infixFallback(const char* opt, Value left, Value right)
+{
+    if ((opt[0] == '=' || opt[0] == '!') && opt[1] == '=')
+    {
+        int equal = valuesEqual(left, right);
+        return BOOL_VALUE(opt[0] == '=' ? equal : !equal);
+    }
+
+    if (opt[0] == '+' && left.type == VALUE_STRING
+        && right.type == VALUE_STRING)
+        return concatStrings(left.as.string, right.as.string);
+
+    if (left.type != right.type)
+        return runtimeError("type mismatch: %s %s %s",
+                            valueTypeName(left.type), opt,
+                            valueTypeName(right.type));
+
+    return runtimeError("unknown operator: %s %s %s",
+                        valueTypeName(left.type), opt,
+                        valueTypeName(right.type));
+}
+
+static inline Value unknownInfix(const char* opt, Value left, Value right)
+{
+    if (left.type == VALUE_INT && right.type == VALUE_INT)
+        return runtimeError("unknown operator: INTEGER %s INTEGER", opt);
+    return infixFallback(opt, left, right);
+}
+
+// Integers take the path in result, written in terms of a and b.
+// Arithmetic wraps around on overflow.
+#define INFIX_OPERATOR(name, opt, result)                                    \
+    static inline Value name(Value left, Value right)                        \
+    {                                                                        \
+        if (left.type == VALUE_INT && right.type == VALUE_INT)               \
+        {                                                                    \
+            int64_t a = left.as.integer;                                     \
+            int64_t b = right.as.integer;                                    \
+            return result;                                                   \
+        }                                                                    \
+        return infixFallback(opt, left, right);                              \
+    }
+
+static inline Value divideInts(int64_t a, int64_t b)
+{
+    if (b == 0)
+        return runtimeError("division by zero");
+    if (a == INT64_MIN && b == -1)
+        return INT_VALUE(INT64_MIN);
+    return INT_VALUE(a / b);
+}
+
+INFIX_OPERATOR(infixAdd, "+", INT_VALUE((int64_t)((uint64_t)a + (uint64_t)b)))
+INFIX_OPERATOR(infixSub, "-", INT_VALUE((int64_t)((uint64_t)a - (uint64_t)b)))
+INFIX_OPERATOR(infixMul, "*", INT_VALUE((int64_t)((uint64_t)a * (uint64_t)b)))
+INFIX_OPERATOR(infixDiv, "/", divideInts(a, b))
+INFIX_OPERATOR(infixLess, "<", BOOL_VALUE(a < b))
+INFIX_OPERATOR(infixGreater, ">", BOOL_VALUE(a > b))
+INFIX_OPERATOR(infixEqual, "==", BOOL_VALUE(a == b))
+INFIX_OPERATOR(infixNotEqual, "!=", BOOL_VALUE(a != b))
+
+static inline Value mkClosure(Code code, int numParams, int numCaptures,
+                              const char* source)
+{
+    Closure* closure = malloc(sizeof(Closure)
+                              + sizeof(Value) * (size_t)numCaptures);
+    if (!closure)
+        return runtimeError("out of memory");
+
+    closure->code        = code;
+    closure->numParams   = numParams;
+    closure->source      = source;
+    closure->numCaptures = numCaptures;
+
+    return CLOSURE_VALUE(closure);
+}
+
+// Checked before the arguments are run, as the interpreter does
+static inline void checkCall(Value callee, int argc)
+{
+    if (callee.type != VALUE_CLOSURE)
+        runtimeError("not a function: %s", valueTypeName(callee.type));
+    if (callee.as.closure->numParams != argc)
+        runtimeError("wrong number of arguments: want=%d, got=%d",
+                     callee.as.closure->numParams, argc);
+}
+
+static inline Value mkArray(size_t capacity)
+{
+    Array* array    = allocOrFail(sizeof(Array));
+    array->len      = 0;
+    array->capacity = capacity;
+    array->elements = allocOrFail(sizeof(Value) * (capacity ? capacity : 1));
+    return ARRAY_VALUE(array);
+}
+
+// Literals make their arrays for all of their elements
+static inline void arrayPush(Value array, Value value)
+{
+    Array* a             = array.as.array;
+    a->elements[a->len++] = value;
+}
+
+static inline Value mkHash(size_t capacity)
+{
+    size_t slots = 16;
+    while (slots / 2 < capacity)
+        slots <<= 1;
+
+    Hash* hash     = allocOrFail(sizeof(Hash));
+    hash->len      = 0;
+    hash->capacity = capacity;
+    hash->entries  = allocOrFail(sizeof(HashEntry) * (capacity ? capacity : 1));
+    hash->slots    = calloc(slots, sizeof(size_t));
+    hash->slotMask = slots - 1;
+    if (!hash->slots)
+        runtimeError("out of memory");
+    return HASH_VALUE(hash);
+}
+
+// Keys are integers, booleans and strings, checked as soon as they are run
+static inline void checkHashKey(Value key)
+{
+    if (key.type != VALUE_INT && key.type != VALUE_BOOL
+        && key.type != VALUE_STRING)
+        runtimeError("unusable as hash key: %s", valueTypeName(key.type));
+}
+
+// The slot holding key, or the empty slot where it belongs
+static inline size_t* findSlot(const Hash* hash, Value key)
+{
+    uint64_t x = key.type == VALUE_INT    ? (uint64_t)key.as.integer
+               : key.type == VALUE_STRING ? ropeHash(key.as.string)
+                                          : (uint64_t)(key.as.boolean != 0);
+    x += 0x9e3779b97f4a7c15ULL * (uint64_t)key.type;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 31;
+
+    for (size_t i = (size_t)x & hash->slotMask;; i = (i + 1) & hash->slotMask)
+    {
+        size_t* slot = &hash->slots[i];
+        if (!*slot || valuesEqual(hash->entries[*slot - 1].key, key))
+            return slot;
+    }
+}
+
+// A key repeated in a literal keeps its first place and its last value
+static inline void hashPut(Value hash, Value key, Value value)
+{
+    Hash* h      = hash.as.hash;
+    size_t* slot = findSlot(h, key);
+    if (*slot)
+    {
+        h->entries[*slot - 1].value = value;
+        return;
+    }
+
+    h->entries[h->len++] = (HashEntry){key, value};
+    *slot                = h->len;
+}
+
+static inline Value indexValue(Value left, Value index)
+{
+    if (left.type == VALUE_ARRAY && index.type == VALUE_INT)
+    {
+        Array* array = left.as.array;
+        if (index.as.integer < 0 || (uint64_t)index.as.integer >= array->len)
+            return NULL_VALUE;
+        return array->elements[index.as.integer];
+    }
+    if (left.type == VALUE_STRING && index.type == VALUE_INT)
+    {
+        Rope* string = left.as.string;
+        if (index.as.integer < 0 || (uint64_t)index.as.integer >= string->len)
+            return NULL_VALUE;
+        return mkString(flattenRope(string) + index.as.integer, 1);
+    }
+
+    if (left.type != VALUE_HASH)
+        return runtimeError("index operator not supported: %s",
+                            valueTypeName(left.type));
+    checkHashKey(index);
+
+    size_t* slot = findSlot(left.as.hash, index);
+    return *slot ? left.as.hash->entries[*slot - 1].value : NULL_VALUE;
+}
+
+static inline void writeValue(Value value)
+{
+    switch (value.type)
+    {
+    case VALUE_NULL:
+        printf("null");
+        break;
+    case VALUE_INT:
+        printf("%" PRId64, value.as.integer);
+        break;
+    case VALUE_BOOL:
+        printf("%s", value.as.boolean ? "true" : "false");
+        break;
+    case VALUE_CLOSURE:
+        printf("%s", value.as.closure->source);
+        break;
+    case VALUE_ARRAY:
+        printf("[");
+        for (size_t i = 0; i < value.as.array->len; ++i)
+        {
+            if (i > 0)
+                printf(", ");
+            writeValue(value.as.array->elements[i]);
+        }
+        printf("]");
+        break;
+    case VALUE_HASH:
+        printf("{");
+        for (size_t i = 0; i < value.as.hash->len; ++i)
+        {
+            if (i > 0)
+                printf(", ");
+            writeValue(value.as.hash->entries[i].key);
+            printf(": ");
+            writeValue(value.as.hash->entries[i].value);
+        }
+        printf("}");
+        break;
+    case VALUE_STRING:
+        fwrite(flattenRope(value.as.string), 1, value.as.string->len, stdout);
+        break;
+    default:
+        break;
+    }
+}
+
+// Print the value of the program, as `monkey prog.mk` does
+static inline void printValue(Value value)
+{
+    if (value.type == VALUE_UNDEFINED)
+        return;
+    writeValue(value);
+    printf("\n");
+}
+
+#endif //_MONKEY_LANG_RUNTIME_MONKEYRUNTIME_H_
@@ -0,0 +1,1337 @@
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asmEmitter.h"
+#include "ast.h"
+#include "dynString.h"
+#include "object.h"
+#include "stringBuilder.h"
+
+// Callee-saved registers handed out to temporaries
+#define POOL_SIZE 5
+
+#define TYPE_DYNAMIC -1
+
+// Frame below %rbp: the pool registers saved by the prologue, the closure
+// being run, then a 16-byte slot per local of the resolver followed by the
+// spilled temporaries
+#define SELF_OFFSET  -48
+#define SLOTS_OFFSET -64
+
+// Byte offsets in a Closure of runtime/monkeyRuntime.h
+#define CLOSURE_PARAMS   8
+#define CLOSURE_CAPTURES 32
+
+static const char* const pool64[POOL_SIZE] = {"%rbx", "%r12", "%r13",
+                                              "%r14", "%r15"};
+static const char* const pool32[POOL_SIZE] = {"%ebx", "%r12d", "%r13d",
+                                              "%r14d", "%r15d"};
+
+typedef enum
+{
+    OPERAND_CONSTANT = 0,
+    OPERAND_REGISTER,
+    OPERAND_MEMORY, // a frame slot: a local read in place, or a spill
+} OperandKind;
+
+// A temporary on the operand stack of the function being written
+struct Operand
+{
+    OperandKind kind;
+    int type; // ValueType when known statically, or TYPE_DYNAMIC
+    int64_t constant;
+    int reg;     // of the pool, holding the payload
+    int typeReg; // of the pool, holding a dynamic type
+    int offset;  // from %rbp, of the frame slot
+    int isLocal; // reads a local, so a `let` may change it
+};
+
+// Text of an operand in an instruction
+typedef struct
+{
+    char s[64];
+} Text;
+
+struct AsmEmitter
+{
+    StringBuilder* text;   // functions finished so far
+    StringBuilder* rodata; // string literals
+    size_t numFunctions;
+    size_t numLabels;
+    size_t numStrings;
+    int numGlobals;
+};
+
+// Function being written: the program, or a function literal
+struct AsmFunction
+{
+    StringBuilder* body;
+    StringBuilder* stubs; // slow paths, placed after the epilogue
+    struct Operand* ops;
+    size_t numOps;
+    size_t opCapacity;
+    int used[POOL_SIZE];
+    int saved[POOL_SIZE]; // used at all, so saved by the prologue
+    int numLocals;
+    int* paramIndex; // of each frame slot that holds a parameter, or -1
+    int numSpills;
+    int numParams;   // of a function literal, or -1 for the program
+    size_t entry;    // label, where a call of the function to itself jumps
+    size_t epilogue; // label
+    size_t tailExit; // label, leaving for the callee of a tail call
+    int tailCalls;   // whether a call leaves through tailExit
+};
+
+/* Private Function Signatures */
+static void emit(StringBuilder*, const char*, ...);
+static void emitLabel(StringBuilder*, size_t);
+static size_t newLabel(struct AsmEmitter*);
+static size_t addString(struct AsmEmitter*, const char*);
+static void initFunction(struct AsmFunction*, struct AsmEmitter*, int);
+static void finishFunction(struct AsmEmitter*, struct AsmFunction*,
+                           const char*);
+static int slotOffset(struct AsmFunction*, int);
+static Text payloadText(const struct Operand*);
+static Text payload32Text(const struct Operand*);
+static Text typeText(const struct Operand*);
+static Text type64Text(const struct Operand*);
+static int fitsImmediate(const struct Operand*);
+static struct Operand* top(struct AsmFunction*, size_t);
+static struct Operand* pushOperand(struct AsmFunction*);
+static void popOperand(struct AsmFunction*);
+static void pushConstant(struct AsmFunction*, int, int64_t);
+static struct Operand* newTemp(struct AsmFunction*, int);
+static int allocRegister(struct AsmFunction*);
+static void placeTemp(struct AsmFunction*, struct Operand*, int);
+static void materializeLocals(struct AsmFunction*);
+static void loadPayload(struct AsmFunction*, const struct Operand*,
+                        const char*);
+static void loadValue(struct AsmFunction*, StringBuilder*,
+                      const struct Operand*, const char*, const char*);
+static void storeValue(struct AsmFunction*, const struct Operand*, Text,
+                       Text);
+static void guardInt(struct AsmFunction*, const struct Operand*, size_t);
+static void emitTruth(struct AsmEmitter*, struct AsmFunction*,
+                      const struct Operand*);
+static void emitReturn(struct AsmEmitter*, struct AsmFunction*, int);
+static void emitBlock(struct AsmEmitter*, struct AsmFunction*, BlockStmt*);
+static void emitStmt(struct AsmEmitter*, struct AsmFunction*, Stmt*);
+static void emitExpr(struct AsmEmitter*, struct AsmFunction*, Expr*);
+static void emitIdent(struct AsmEmitter*, struct AsmFunction*, IdentExpr*);
+static void emitPrefix(struct AsmEmitter*, struct AsmFunction*,
+                       PrefixExpr*);
+static void emitInfix(struct AsmEmitter*, struct AsmFunction*, InfixExpr*);
+static void emitSlowInfix(struct AsmEmitter*, struct AsmFunction*,
+                          const char*, size_t);
+static void emitCondition(struct AsmEmitter*, struct AsmFunction*, Expr*,
+                          size_t);
+static void emitIf(struct AsmEmitter*, struct AsmFunction*, IfExpr*);
+static void emitFunction(struct AsmEmitter*, struct AsmFunction*, Expr*);
+static void emitCall(struct AsmEmitter*, struct AsmFunction*, CallExpr*);
+static void emitString(struct AsmEmitter*, struct AsmFunction*, StringExpr*);
+static void emitArray(struct AsmEmitter*, struct AsmFunction*, ArrayExpr*);
+static void emitHash(struct AsmEmitter*, struct AsmFunction*, HashExpr*);
+static void emitIndex(struct AsmEmitter*, struct AsmFunction*, IndexExpr*);
+static void useGlobal(struct AsmEmitter*, int);
+
+String* emitAsm(Program* pProg)
+{
+    struct AsmEmitter e = {mkStringBuilder(), mkStringBuilder(), 0, 0, 0, 0};
+    struct AsmFunction program;
+
+    initFunction(&program, &e, 0);
+    emitBlock(&e, &program, pProg);
+    emitReturn(&e, &program, 0);
+    popOperand(&program);
+    finishFunction(&e, &program, "monkeyProgram");
+
+    StringBuilder* sb = mkStringBuilder();
+    char buffer[64];
+
+    builderAppendStr(sb, "# Generated by `monkey --emit-asm`\n"
+                         "\t.text\n\t.globl\tmonkeyProgram\n");
+    builderAppendFreeString(sb, buildString(e.text));
+    builderAppendStr(sb, "\t.section\t.rodata\n");
+    builderAppendFreeString(sb, buildString(e.rodata));
+    snprintf(buffer, sizeof(buffer), "\t.zero\t%d\n",
+             16 * (e.numGlobals > 0 ? e.numGlobals : 1));
+    builderAppendStr(sb, "\t.bss\n\t.p2align\t4\nmonkeyGlobals:\n");
+    builderAppendStr(sb, buffer);
+    builderAppendStr(sb, "\t.section\t.note.GNU-stack,\"\",@progbits\n");
+
+    String* output = buildString(sb);
+    freeStringBuilder(sb);
+    freeStringBuilder(e.text);
+    freeStringBuilder(e.rodata);
+    return output;
+}
+
+static void emit(StringBuilder* sb, const char* fmt, ...)
+{
+    char line[256];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    builderAppendChar(sb, '\t');
+    builderAppendStr(sb, line);
+    builderAppendChar(sb, '\n');
+}
+
+static void emitLabel(StringBuilder* sb, size_t label)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), ".L%zu:\n", label);
+    builderAppendStr(sb, buffer);
+}
+
+static size_t newLabel(struct AsmEmitter* e)
+{
+    return e->numLabels++;
+}
+
+// Label .LsN of a string literal holding str
+static size_t addString(struct AsmEmitter* e, const char* str)
+{
+    size_t label = e->numStrings++;
+    char buffer[32];
+
+    snprintf(buffer, sizeof(buffer), ".Ls%zu:\n\t.string\t\"", label);
+    builderAppendStr(e->rodata, buffer);
+    for (const char* c = str; *c; ++c)
+    {
+        unsigned char ch = (unsigned char)*c;
+        if (ch == '"' || ch == '\\')
+        {
+            builderAppendChar(e->rodata, '\\');
+            builderAppendChar(e->rodata, (char)ch);
+        }
+        else if (ch < 0x20 || ch >= 0x7f)
+        {
+            snprintf(buffer, sizeof(buffer), "\\%03o", ch);
+            builderAppendStr(e->rodata, buffer);
+        }
+        else
+        {
+            builderAppendChar(e->rodata, (char)ch);
+        }
+    }
+    builderAppendStr(e->rodata, "\"\n");
+
+    return label;
+}
+
+static void initFunction(struct AsmFunction* f, struct AsmEmitter* e,
+                         int numLocals)
+{
+    f->body       = mkStringBuilder();
+    f->stubs      = mkStringBuilder();
+    f->ops        = NULL;
+    f->numOps     = 0;
+    f->opCapacity = 0;
+    f->numLocals  = numLocals;
+    f->paramIndex = malloc(sizeof(int) * (size_t)(numLocals + 1));
+    f->numSpills  = 0;
+    f->numParams  = -1;
+    f->entry      = newLabel(e);
+    f->epilogue   = newLabel(e);
+    f->tailExit   = newLabel(e);
+    f->tailCalls  = 0;
+
+    for (int i = 0; i < POOL_SIZE; ++i)
+    {
+        f->used[i]  = 0;
+        f->saved[i] = 0;
+    }
+    for (int i = 0; i < numLocals; ++i)
+        f->paramIndex[i] = -1;
+}
+
+// Wrap the body in the prologue and epilogue, now that the registers and
+// frame slots it uses are known
+static void finishFunction(struct AsmEmitter* e, struct AsmFunction* f,
+                           const char* name)
+{
+    int frameSize = -SLOTS_OFFSET + 16 * (f->numLocals + f->numSpills);
+
+    builderAppendStr(e->text, "\t.p2align\t4\n");
+    builderAppendStr(e->text, name);
+    builderAppendStr(e->text, ":\n");
+    emit(e->text, "pushq\t%%rbp");
+    emit(e->text, "movq\t%%rsp, %%rbp");
+    emit(e->text, "subq\t$%d, %%rsp", frameSize);
+    for (int i = 0; i < POOL_SIZE; ++i)
+    {
+        if (f->saved[i])
+            emit(e->text, "movq\t%s, %d(%%rbp)", pool64[i], -8 * (i + 1));
+    }
+    builderAppendFreeString(e->text, buildString(f->body));
+
+    emitLabel(e->text, f->epilogue);
+    for (int i = 0; i < POOL_SIZE; ++i)
+    {
+        if (f->saved[i])
+            emit(e->text, "movq\t%d(%%rbp), %s", -8 * (i + 1), pool64[i]);
+    }
+    emit(e->text, "leave");
+    emit(e->text, "ret");
+
+    // The callee in %rdi returns to the caller of the function
+    if (f->tailCalls)
+    {
+        emitLabel(e->text, f->tailExit);
+        for (int i = 0; i < POOL_SIZE; ++i)
+        {
+            if (f->saved[i])
+                emit(e->text, "movq\t%d(%%rbp), %s", -8 * (i + 1),
+                     pool64[i]);
+        }
+        emit(e->text, "leave");
+        emit(e->text, "jmp\t*(%%rdi)");
+    }
+    builderAppendFreeString(e->text, buildString(f->stubs));
+
+    freeStringBuilder(f->body);
+    freeStringBuilder(f->stubs);
+    free(f->ops);
+    free(f->paramIndex);
+}
+
+// Parameters stay where the caller pushed them, above the return address
+static int slotOffset(struct AsmFunction* f, int slot)
+{
+    if (f->paramIndex[slot] >= 0)
+        return 16 + 16 * f->paramIndex[slot];
+    return SLOTS_OFFSET - 16 * (slot + 1);
+}
+
+static Text payloadText(const struct Operand* op)
+{
+    Text t;
+    switch (op->kind)
+    {
+    case OPERAND_CONSTANT:
+        snprintf(t.s, sizeof(t.s), "$%" PRId64, op->constant);
+        break;
+    case OPERAND_REGISTER:
+        snprintf(t.s, sizeof(t.s), "%s", pool64[op->reg]);
+        break;
+    default:
+        snprintf(t.s, sizeof(t.s), "%d(%%rbp)", op->offset + 8);
+        break;
+    }
+    return t;
+}
+
+// Booleans are an int in the payload
+static Text payload32Text(const struct Operand* op)
+{
+    Text t;
+    switch (op->kind)
+    {
+    case OPERAND_CONSTANT:
+        snprintf(t.s, sizeof(t.s), "$%d", (int)op->constant);
+        break;
+    case OPERAND_REGISTER:
+        snprintf(t.s, sizeof(t.s), "%s", pool32[op->reg]);
+        break;
+    default:
+        snprintf(t.s, sizeof(t.s), "%d(%%rbp)", op->offset + 8);
+        break;
+    }
+    return t;
+}
+
+static Text typeText(const struct Operand* op)
+{
+    Text t;
+    if (op->type != TYPE_DYNAMIC)
+        snprintf(t.s, sizeof(t.s), "$%d", op->type);
+    else if (op->kind == OPERAND_REGISTER)
+        snprintf(t.s, sizeof(t.s), "%s", pool32[op->typeReg]);
+    else
+        snprintf(t.s, sizeof(t.s), "%d(%%rbp)", op->offset);
+    return t;
+}
+
+// The type as a quadword, to push it with the padding after it
+static Text type64Text(const struct Operand* op)
+{
+    Text t = typeText(op);
+    if (op->type == TYPE_DYNAMIC && op->kind == OPERAND_REGISTER)
+        snprintf(t.s, sizeof(t.s), "%s", pool64[op->typeReg]);
+    return t;
+}
+
+// Whether the payload can be an operand of an instruction as it is, which
+// a constant can only as a sign-extended 32-bit immediate
+static int fitsImmediate(const struct Operand* op)
+{
+    return op->kind != OPERAND_CONSTANT
+           || (op->constant >= INT32_MIN && op->constant <= INT32_MAX);
+}
+
+// The operand depth places below the top of the stack
+static struct Operand* top(struct AsmFunction* f, size_t depth)
+{
+    return &f->ops[f->numOps - 1 - depth];
+}
+
+static struct Operand* pushOperand(struct AsmFunction* f)
+{
+    if (f->numOps == f->opCapacity)
+    {
+        f->opCapacity = f->opCapacity ? f->opCapacity * 2 : 16;
+        f->ops = realloc(f->ops, sizeof(struct Operand) * f->opCapacity);
+    }
+
+    struct Operand* op = &f->ops[f->numOps++];
+    memset(op, 0, sizeof(*op));
+    op->typeReg = -1;
+    return op;
+}
+
+static void popOperand(struct AsmFunction* f)
+{
+    struct Operand* op = top(f, 0);
+    if (op->kind == OPERAND_REGISTER)
+    {
+        f->used[op->reg] = 0;
+        if (op->typeReg >= 0)
+            f->used[op->typeReg] = 0;
+    }
+    --f->numOps;
+}
+
+static void pushConstant(struct AsmFunction* f, int type, int64_t value)
+{
+    struct Operand* op = pushOperand(f);
+    op->kind           = OPERAND_CONSTANT;
+    op->type           = type;
+    op->constant       = value;
+}
+
+// A temporary on top of the stack for a value of the given type, not yet
+// written
+static struct Operand* newTemp(struct AsmFunction* f, int type)
+{
+    struct Operand* op = pushOperand(f);
+    op->type           = type;
+    placeTemp(f, op, type == TYPE_DYNAMIC);
+    return op;
+}
+
+static int allocRegister(struct AsmFunction* f)
+{
+    for (int i = 0; i < POOL_SIZE; ++i)
+    {
+        if (!f->used[i])
+        {
+            f->used[i]  = 1;
+            f->saved[i] = 1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Give op registers, or the frame slot of its place on the stack once the
+// pool runs out
+static void placeTemp(struct AsmFunction* f, struct Operand* op,
+                      int needsType)
+{
+    int free = 0;
+    for (int i = 0; i < POOL_SIZE; ++i)
+        free += !f->used[i];
+
+    op->isLocal = 0;
+    if (free >= 1 + needsType)
+    {
+        op->kind    = OPERAND_REGISTER;
+        op->reg     = allocRegister(f);
+        op->typeReg = needsType ? allocRegister(f) : -1;
+        return;
+    }
+
+    int spill = (int)(op - f->ops);
+    if (spill + 1 > f->numSpills)
+        f->numSpills = spill + 1;
+    op->kind   = OPERAND_MEMORY;
+    op->offset = SLOTS_OFFSET - 16 * (f->numLocals + spill + 1);
+}
+
+// Copy the locals read in place on the stack into temporaries, before a
+// branch whose `let` could change them
+static void materializeLocals(struct AsmFunction* f)
+{
+    for (size_t i = 0; i < f->numOps; ++i)
+    {
+        struct Operand* op = &f->ops[i];
+        if (!op->isLocal)
+            continue;
+
+        struct Operand local = *op;
+        placeTemp(f, op, 1);
+        storeValue(f, &local, typeText(op), payloadText(op));
+    }
+}
+
+static void loadPayload(struct AsmFunction* f, const struct Operand* op,
+                        const char* reg)
+{
+    if (fitsImmediate(op))
+        emit(f->body, "movq\t%s, %s", payloadText(op).s, reg);
+    else
+        emit(f->body, "movabsq\t$%" PRId64 ", %s", op->constant, reg);
+}
+
+// Load op as a Value argument of the System V ABI, in sb
+static void loadValue(struct AsmFunction* f, StringBuilder* sb,
+                      const struct Operand* op, const char* type32,
+                      const char* payload)
+{
+    (void)f;
+    emit(sb, "movl\t%s, %s", typeText(op).s, type32);
+    if (fitsImmediate(op))
+        emit(sb, "movq\t%s, %s", payloadText(op).s, payload);
+    else
+        emit(sb, "movabsq\t$%" PRId64 ", %s", op->constant, payload);
+}
+
+// Write op to a type and a payload destination, through %rcx
+static void storeValue(struct AsmFunction* f, const struct Operand* op,
+                       Text type, Text payload)
+{
+    if (op->type != TYPE_DYNAMIC || op->kind == OPERAND_REGISTER)
+    {
+        emit(f->body, "movl\t%s, %s", typeText(op).s, type.s);
+    }
+    else
+    {
+        emit(f->body, "movl\t%s, %%ecx", typeText(op).s);
+        emit(f->body, "movl\t%%ecx, %s", type.s);
+    }
+
+    if (op->kind == OPERAND_REGISTER
+        || (op->kind == OPERAND_CONSTANT && fitsImmediate(op)))
+    {
+        emit(f->body, "movq\t%s, %s", payloadText(op).s, payload.s);
+    }
+    else
+    {
+        loadPayload(f, op, "%rcx");
+        emit(f->body, "movq\t%%rcx, %s", payload.s);
+    }
+}
+
+// Jump to label unless op holds an integer
+static void guardInt(struct AsmFunction* f, const struct Operand* op,
+                     size_t label)
+{
+    if (op->type == VALUE_INT)
+        return;
+    if (op->type != TYPE_DYNAMIC)
+        emit(f->body, "jmp\t.L%zu", label);
+    else
+        emit(f->body, "cmpl\t$%d, %s", VALUE_INT, typeText(op).s);
+    if (op->type == TYPE_DYNAMIC)
+        emit(f->body, "jne\t.L%zu", label);
+}
+
+// Leave 1 in %eax if op is truthy, 0 otherwise: only false and null are
+// falsy
+static void emitTruth(struct AsmEmitter* e, struct AsmFunction* f,
+                      const struct Operand* op)
+{
+    switch (op->type)
+    {
+    case VALUE_NULL:
+    case VALUE_UNDEFINED:
+        emit(f->body, "xorl\t%%eax, %%eax");
+        return;
+    case VALUE_INT:
+    case VALUE_CLOSURE:
+    case VALUE_ARRAY:
+    case VALUE_HASH:
+    case VALUE_STRING:
+        emit(f->body, "movl\t$1, %%eax");
+        return;
+    case VALUE_BOOL:
+        emit(f->body, "movl\t%s, %%eax", payload32Text(op).s);
+        emit(f->body, "testl\t%%eax, %%eax");
+        emit(f->body, "setne\t%%al");
+        emit(f->body, "movzbl\t%%al, %%eax");
+        return;
+    default:
+        break;
+    }
+
+    size_t notBool = newLabel(e);
+    size_t done    = newLabel(e);
+
+    emit(f->body, "movl\t%s, %%ecx", typeText(op).s);
+    emit(f->body, "movl\t$1, %%eax");
+    emit(f->body, "cmpl\t$%d, %%ecx", VALUE_BOOL);
+    emit(f->body, "jne\t.L%zu", notBool);
+    emit(f->body, "movl\t%s, %%eax", payload32Text(op).s);
+    emit(f->body, "testl\t%%eax, %%eax");
+    emit(f->body, "setne\t%%al");
+    emit(f->body, "movzbl\t%%al, %%eax");
+    emit(f->body, "jmp\t.L%zu", done);
+    emitLabel(f->body, notBool);
+    emit(f->body, "cmpl\t$%d, %%ecx", VALUE_NULL);
+    emit(f->body, "ja\t.L%zu", done);
+    emit(f->body, "xorl\t%%eax, %%eax");
+    emitLabel(f->body, done);
+}
+
+// Return the value on top of the stack, which a call gives as null when
+// it is undefined
+static void emitReturn(struct AsmEmitter* e, struct AsmFunction* f,
+                       int orNull)
+{
+    struct Operand* op = top(f, 0);
+
+    emit(f->body, "movl\t%s, %%eax", typeText(op).s);
+    loadPayload(f, op, "%rdx");
+    if (orNull && op->type == TYPE_DYNAMIC)
+    {
+        size_t defined = newLabel(e);
+        emit(f->body, "testl\t%%eax, %%eax");
+        emit(f->body, "jne\t.L%zu", defined);
+        emit(f->body, "movl\t$%d, %%eax", VALUE_NULL);
+        emitLabel(f->body, defined);
+    }
+    else if (orNull && op->type == VALUE_UNDEFINED)
+    {
+        emit(f->body, "movl\t$%d, %%eax", VALUE_NULL);
+    }
+    emit(f->body, "jmp\t.L%zu", f->epilogue);
+}
+
+// Push the value of the last statement, which is undefined for an empty
+// block
+static void emitBlock(struct AsmEmitter* e, struct AsmFunction* f,
+                      BlockStmt* pBlockStmt)
+{
+    if (pBlockStmt->len == 0)
+    {
+        pushConstant(f, VALUE_UNDEFINED, 0);
+        return;
+    }
+
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head)
+    {
+        emitStmt(e, f, tmp->value);
+        if (tmp->before != pBlockStmt->head)
+            popOperand(f);
+        tmp = tmp->before;
+    }
+}
+
+static void emitStmt(struct AsmEmitter* e, struct AsmFunction* f,
+                     Stmt* pStmt)
+{
+    if (!pStmt->inner.checkIsNull)
+    {
+        pushConstant(f, VALUE_UNDEFINED, 0);
+        return;
+    }
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+    {
+        LetStmt* letStmt = pStmt->inner.letStmt;
+        int slot         = letStmt->name->slot;
+        Text type;
+        Text payload;
+
+        emitExpr(e, f, letStmt->value);
+        if (letStmt->name->kind == RESOLVE_GLOBAL)
+        {
+            useGlobal(e, slot);
+            snprintf(type.s, sizeof(type.s), "monkeyGlobals+%d(%%rip)",
+                     16 * slot);
+            snprintf(payload.s, sizeof(payload.s),
+                     "monkeyGlobals+%d(%%rip)", 16 * slot + 8);
+        }
+        else
+        {
+            snprintf(type.s, sizeof(type.s), "%d(%%rbp)",
+                     slotOffset(f, slot));
+            snprintf(payload.s, sizeof(payload.s), "%d(%%rbp)",
+                     slotOffset(f, slot) + 8);
+        }
+        storeValue(f, top(f, 0), type, payload);
+        popOperand(f);
+        pushConstant(f, VALUE_UNDEFINED, 0);
+        return;
+    }
+
+    case STMT_RETURN:
+        emitExpr(e, f, pStmt->inner.returnStmt->returnValue);
+        emitReturn(e, f, 1);
+        return;
+
+    case STMT_EXPRESSION:
+        emitExpr(e, f, pStmt->inner.exprStmt->expression);
+        return;
+
+    case STMT_BLOCK:
+        emitBlock(e, f, pStmt->inner.blockStmt);
+        return;
+
+    default:
+        pushConstant(f, VALUE_UNDEFINED, 0);
+        return;
+    }
+}
+
+static void emitExpr(struct AsmEmitter* e, struct AsmFunction* f,
+                     Expr* pExpr)
+{
+    if (!pExpr || !pExpr->inner.checkIsNull)
+    {
+        pushConstant(f, VALUE_NULL, 0);
+        return;
+    }
+
+    switch (pExpr->type)
+    {
+    case EXPR_IDENT:
+        emitIdent(e, f, pExpr->inner.identExpr);
+        return;
+
+    case EXPR_INTEGER:
+        pushConstant(f, VALUE_INT, pExpr->inner.intExpr->value);
+        return;
+
+    case EXPR_BOOL:
+        pushConstant(f, VALUE_BOOL, pExpr->inner.boolExpr->value);
+        return;
+
+    case EXPR_STRING:
+        emitString(e, f, pExpr->inner.stringExpr);
+        return;
+
+    case EXPR_PREFIX:
+        emitPrefix(e, f, pExpr->inner.prefixExpr);
+        return;
+
+    case EXPR_INFIX:
+        emitInfix(e, f, pExpr->inner.infixExpr);
+        return;
+
+    case EXPR_IF:
+        emitIf(e, f, pExpr->inner.ifExpr);
+        return;
+
+    case EXPR_FUNCTION:
+        emitFunction(e, f, pExpr);
+        return;
+
+    case EXPR_CALL:
+        emitCall(e, f, pExpr->inner.callExpr);
+        return;
+
+    case EXPR_ARRAY:
+        emitArray(e, f, pExpr->inner.arrayExpr);
+        return;
+
+    case EXPR_HASH:
+        emitHash(e, f, pExpr->inner.hashExpr);
+        return;
+
+    case EXPR_INDEX:
+        emitIndex(e, f, pExpr->inner.indexExpr);
+        return;
+
+    default:
+        pushConstant(f, VALUE_NULL, 0);
+        return;
+    }
+}
+
+static void emitIdent(struct AsmEmitter* e, struct AsmFunction* f,
+                      IdentExpr* pIdentExpr)
+{
+    int slot = pIdentExpr->slot;
+
+    switch (pIdentExpr->kind)
+    {
+    case RESOLVE_LOCAL:
+    {
+        struct Operand* op = pushOperand(f);
+        op->kind           = OPERAND_MEMORY;
+        op->type           = TYPE_DYNAMIC;
+        op->offset         = slotOffset(f, slot);
+        op->isLocal        = 1;
+        return;
+    }
+
+    case RESOLVE_CAPTURE:
+    {
+        struct Operand* op = newTemp(f, TYPE_DYNAMIC);
+        int offset         = CLOSURE_CAPTURES + 16 * slot;
+
+        emit(f->body, "movq\t%d(%%rbp), %%rax", SELF_OFFSET);
+        emit(f->body, "movl\t%d(%%rax), %%ecx", offset);
+        emit(f->body, "movl\t%%ecx, %s", typeText(op).s);
+        emit(f->body, "movq\t%d(%%rax), %%rcx", offset + 8);
+        emit(f->body, "movq\t%%rcx, %s", payloadText(op).s);
+        return;
+    }
+
+    case RESOLVE_GLOBAL:
+    {
+        struct Operand* op = newTemp(f, TYPE_DYNAMIC);
+        size_t unbound     = newLabel(e);
+
+        useGlobal(e, slot);
+        emit(f->body, "movl\tmonkeyGlobals+%d(%%rip), %%ecx", 16 * slot);
+        emit(f->body, "testl\t%%ecx, %%ecx");
+        emit(f->body, "je\t.L%zu", unbound);
+        emit(f->body, "movl\t%%ecx, %s", typeText(op).s);
+        emit(f->body, "movq\tmonkeyGlobals+%d(%%rip), %%rcx", 16 * slot + 8);
+        emit(f->body, "movq\t%%rcx, %s", payloadText(op).s);
+
+        emitLabel(f->stubs, unbound);
+        emit(f->stubs, "leaq\t.Ls%zu(%%rip), %%rdi",
+             addString(e, getStr(pIdentExpr->value)));
+        emit(f->stubs, "call\tmonkeyUnbound");
+        return;
+    }
+
+    default:
+    {
+        emit(f->body, "leaq\t.Ls%zu(%%rip), %%rdi",
+             addString(e, getStr(pIdentExpr->value)));
+        emit(f->body, "call\tmonkeyUnbound");
+        pushConstant(f, VALUE_NULL, 0);
+        return;
+    }
+    }
+}
+
+static void emitPrefix(struct AsmEmitter* e, struct AsmFunction* f,
+                       PrefixExpr* pPrefixExpr)
+{
+    const char* opt = getStr(pPrefixExpr->opt);
+    emitExpr(e, f, pPrefixExpr->right);
+    struct Operand* right = top(f, 0);
+
+    if (opt[0] == '!')
+    {
+        emitTruth(e, f, right);
+        emit(f->body, "xorl\t$1, %%eax");
+        popOperand(f);
+        emit(f->body, "movq\t%%rax, %s", payloadText(newTemp(f, VALUE_BOOL)).s);
+        return;
+    }
+
+    size_t slow = newLabel(e);
+    emitLabel(f->stubs, slow);
+    emit(f->stubs, "leaq\t.Ls%zu(%%rip), %%rdi", addString(e, opt));
+    loadValue(f, f->stubs, right, "%esi", "%rdx");
+    emit(f->stubs, "call\tmonkeyPrefix");
+
+    if (opt[0] == '-')
+    {
+        guardInt(f, right, slow);
+        loadPayload(f, right, "%rax");
+        emit(f->body, "negq\t%%rax");
+    }
+    else
+    {
+        emit(f->body, "jmp\t.L%zu", slow);
+    }
+
+    popOperand(f);
+    emit(f->body, "movq\t%%rax, %s", payloadText(newTemp(f, VALUE_INT)).s);
+}
+
+// Arithmetic and comparisons of integers are inlined, and wrap around on
+// overflow. Other operands take the slow path through monkeyInfix, which
+// compares values of any type and raises the errors.
+static void emitInfix(struct AsmEmitter* e, struct AsmFunction* f,
+                      InfixExpr* pInfixExpr)
+{
+    const char* opt = getStr(pInfixExpr->opt);
+    emitExpr(e, f, pInfixExpr->left);
+    emitExpr(e, f, pInfixExpr->right);
+
+    struct Operand* left  = top(f, 1);
+    struct Operand* right = top(f, 0);
+    size_t slow           = newLabel(e);
+    size_t done           = newLabel(e);
+    int resultType        = VALUE_INT;
+    Text operand          = payloadText(right);
+    // Unless an operand is known to be an integer, + can concatenate two
+    // strings, and its result has a type known only at run time
+    int dynamicAdd = opt[0] == '+' && left->type != VALUE_INT
+                  && right->type != VALUE_INT;
+
+    if (!strchr("+-*/<>=!", opt[0]))
+    {
+        emitSlowInfix(e, f, opt, slow);
+        emit(f->body, "jmp\t.L%zu", slow);
+        emitLabel(f->body, done);
+        popOperand(f);
+        popOperand(f);
+
+        struct Operand* result = newTemp(f, TYPE_DYNAMIC);
+        emit(f->body, "movl\t%%eax, %s", typeText(result).s);
+        emit(f->body, "movq\t%%rdx, %s", payloadText(result).s);
+        return;
+    }
+
+    guardInt(f, left, slow);
+    guardInt(f, right, slow);
+    loadPayload(f, left, "%rax");
+    if (!fitsImmediate(right) || opt[0] == '/')
+    {
+        loadPayload(f, right, "%rcx");
+        snprintf(operand.s, sizeof(operand.s), "%%rcx");
+    }
+
+    switch (opt[0])
+    {
+    case '+':
+        emit(f->body, "addq\t%s, %%rax", operand.s);
+        break;
+    case '-':
+        emit(f->body, "subq\t%s, %%rax", operand.s);
+        break;
+    case '*':
+        if (operand.s[0] == '$')
+            emit(f->body, "imulq\t%s, %%rax, %%rax", operand.s);
+        else
+            emit(f->body, "imulq\t%s, %%rax", operand.s);
+        break;
+    case '/':
+        // Division by zero raises an error and INT64_MIN / -1 wraps
+        // around, both on the slow path
+        if (right->kind == OPERAND_CONSTANT
+            && (right->constant == 0 || right->constant == -1))
+        {
+            emit(f->body, "jmp\t.L%zu", slow);
+        }
+        else if (right->kind != OPERAND_CONSTANT)
+        {
+            emit(f->body, "testq\t%%rcx, %%rcx");
+            emit(f->body, "je\t.L%zu", slow);
+            emit(f->body, "cmpq\t$-1, %%rcx");
+            emit(f->body, "je\t.L%zu", slow);
+        }
+        emit(f->body, "cqto");
+        emit(f->body, "idivq\t%%rcx");
+        break;
+    default:
+    {
+        const char* set = opt[0] == '<'   ? "setl"
+                          : opt[0] == '>' ? "setg"
+                          : opt[0] == '=' ? "sete"
+                                          : "setne";
+        emit(f->body, "cmpq\t%s, %%rax", operand.s);
+        emit(f->body, "%s\t%%al", set);
+        emit(f->body, "movzbl\t%%al, %%eax");
+        resultType = VALUE_BOOL;
+        break;
+    }
+    }
+    if (dynamicAdd)
+    {
+        emit(f->body, "movq\t%%rax, %%rdx");
+        emit(f->body, "movl\t$%d, %%eax", VALUE_INT);
+    }
+    emitLabel(f->body, done);
+
+    // Comparisons of other types give a boolean; anything else that
+    // returns is a division taken off the fast path, or a concatenation
+    emitSlowInfix(e, f, opt, slow);
+    if (!dynamicAdd)
+        emit(f->stubs, "movq\t%%rdx, %%rax");
+    emit(f->stubs, "jmp\t.L%zu", done);
+
+    popOperand(f);
+    popOperand(f);
+    if (dynamicAdd)
+    {
+        struct Operand* result = newTemp(f, TYPE_DYNAMIC);
+        emit(f->body, "movl\t%%eax, %s", typeText(result).s);
+        emit(f->body, "movq\t%%rdx, %s", payloadText(result).s);
+        return;
+    }
+    emit(f->body, "movq\t%%rax, %s", payloadText(newTemp(f, resultType)).s);
+}
+
+// Call monkeyInfix on the two operands on top of the stack, at label
+static void emitSlowInfix(struct AsmEmitter* e, struct AsmFunction* f,
+                          const char* opt, size_t label)
+{
+    emitLabel(f->stubs, label);
+    emit(f->stubs, "leaq\t.Ls%zu(%%rip), %%rdi", addString(e, opt));
+    loadValue(f, f->stubs, top(f, 1), "%esi", "%rdx");
+    loadValue(f, f->stubs, top(f, 0), "%ecx", "%r8");
+    emit(f->stubs, "call\tmonkeyInfix");
+}
+
+// Jump to falseLabel unless the condition is truthy. A comparison jumps on
+// the flags of its cmpq instead of making a boolean first.
+static void emitCondition(struct AsmEmitter* e, struct AsmFunction* f,
+                          Expr* condition, size_t falseLabel)
+{
+    InfixExpr* infix = condition && condition->inner.checkIsNull
+                               && condition->type == EXPR_INFIX
+                           ? condition->inner.infixExpr
+                           : NULL;
+    const char* opt  = infix ? getStr(infix->opt) : "";
+
+    if (!infix || !strchr("<>=!", opt[0]) || opt[0] == '\0')
+    {
+        emitExpr(e, f, condition);
+        emitTruth(e, f, top(f, 0));
+        emit(f->body, "testl\t%%eax, %%eax");
+        emit(f->body, "je\t.L%zu", falseLabel);
+        popOperand(f);
+        return;
+    }
+
+    emitExpr(e, f, infix->left);
+    emitExpr(e, f, infix->right);
+
+    struct Operand* left  = top(f, 1);
+    struct Operand* right = top(f, 0);
+    size_t slow           = newLabel(e);
+    size_t taken          = newLabel(e);
+    Text operand          = payloadText(right);
+
+    guardInt(f, left, slow);
+    guardInt(f, right, slow);
+    loadPayload(f, left, "%rax");
+    if (!fitsImmediate(right))
+    {
+        loadPayload(f, right, "%rcx");
+        snprintf(operand.s, sizeof(operand.s), "%%rcx");
+    }
+    emit(f->body, "cmpq\t%s, %%rax", operand.s);
+    emit(f->body, "%s\t.L%zu",
+         opt[0] == '<'   ? "jge"
+         : opt[0] == '>' ? "jle"
+         : opt[0] == '=' ? "jne"
+                         : "je",
+         falseLabel);
+    emitLabel(f->body, taken);
+
+    emitSlowInfix(e, f, opt, slow);
+    emit(f->stubs, "testl\t%%edx, %%edx");
+    emit(f->stubs, "je\t.L%zu", falseLabel);
+    emit(f->stubs, "jmp\t.L%zu", taken);
+
+    popOperand(f);
+    popOperand(f);
+}
+
+// Both branches leave their value in the same temporary
+static void emitIf(struct AsmEmitter* e, struct AsmFunction* f,
+                   IfExpr* pIfExpr)
+{
+    size_t alternative = newLabel(e);
+    size_t done        = newLabel(e);
+
+    materializeLocals(f);
+    emitCondition(e, f, pIfExpr->condition, alternative);
+
+    size_t result = f->numOps;
+    newTemp(f, TYPE_DYNAMIC);
+
+    if (pIfExpr->consequence)
+        emitBlock(e, f, pIfExpr->consequence);
+    else
+        pushConstant(f, VALUE_NULL, 0);
+    storeValue(f, top(f, 0), typeText(&f->ops[result]),
+               payloadText(&f->ops[result]));
+    popOperand(f);
+    emit(f->body, "jmp\t.L%zu", done);
+
+    emitLabel(f->body, alternative);
+    if (pIfExpr->alternative)
+        emitBlock(e, f, pIfExpr->alternative);
+    else
+        pushConstant(f, VALUE_NULL, 0);
+    storeValue(f, top(f, 0), typeText(&f->ops[result]),
+               payloadText(&f->ops[result]));
+    popOperand(f);
+    emitLabel(f->body, done);
+
+    // An undefined branch, ending with a `let`, gives null
+    size_t defined = newLabel(e);
+    Text type      = typeText(&f->ops[result]);
+    emit(f->body, "cmpl\t$%d, %s", VALUE_UNDEFINED, type.s);
+    emit(f->body, "jne\t.L%zu", defined);
+    emit(f->body, "movl\t$%d, %s", VALUE_NULL, type.s);
+    emitLabel(f->body, defined);
+}
+
+// Write the function of the literal, then create its closure in f
+static void emitFunction(struct AsmEmitter* e, struct AsmFunction* f,
+                         Expr* pExpr)
+{
+    FntExpr* fntExpr = pExpr->inner.fntExpr;
+    size_t index     = e->numFunctions++;
+    char name[32];
+    struct AsmFunction fn;
+
+    snprintf(name, sizeof(name), "monkeyFn%zu", index);
+    initFunction(&fn, e, fntExpr->numLocals);
+    fn.numParams = (int)fntExpr->parameters->len;
+
+    int i                   = 0;
+    struct ParamNode* param = fntExpr->parameters->tail->before;
+    while (param != fntExpr->parameters->head)
+    {
+        fn.paramIndex[param->value->slot] = i++;
+        param                             = param->before;
+    }
+
+    emitLabel(fn.body, fn.entry);
+    emit(fn.body, "movq\t%%rdi, %d(%%rbp)", SELF_OFFSET);
+    for (int slot = 0; slot < fntExpr->numLocals; ++slot)
+    {
+        if (slot == fntExpr->selfSlot)
+        {
+            emit(fn.body, "movl\t$%d, %d(%%rbp)", VALUE_CLOSURE,
+                 slotOffset(&fn, slot));
+            emit(fn.body, "movq\t%%rdi, %d(%%rbp)", slotOffset(&fn, slot) + 8);
+        }
+        else if (fn.paramIndex[slot] < 0)
+        {
+            emit(fn.body, "movl\t$%d, %d(%%rbp)", VALUE_UNDEFINED,
+                 slotOffset(&fn, slot));
+        }
+    }
+
+    emitBlock(e, &fn, fntExpr->body);
+    emitReturn(e, &fn, 1);
+    popOperand(&fn);
+    finishFunction(e, &fn, name);
+
+    // The source is printed as the value of the closure
+    String* source = stringifyFntExpr(fntExpr);
+    emit(f->body, "leaq\t%s(%%rip), %%rdi", name);
+    emit(f->body, "movl\t$%zu, %%esi", fntExpr->parameters->len);
+    emit(f->body, "movl\t$%d, %%edx", fntExpr->numCaptures);
+    emit(f->body, "leaq\t.Ls%zu(%%rip), %%rcx",
+         addString(e, getStr(source)));
+    emit(f->body, "call\tmonkeyClosure");
+    freeString(source);
+
+    Capture* capture = fntExpr->captures;
+    for (int j = 0; j < fntExpr->numCaptures; ++j)
+    {
+        int to = CLOSURE_CAPTURES + 16 * j;
+        if (capture[j].source == CAPTURE_LOCAL)
+        {
+            int from = slotOffset(f, capture[j].index);
+            emit(f->body, "movq\t%d(%%rbp), %%rcx", from);
+            emit(f->body, "movq\t%%rcx, %d(%%rdx)", to);
+            emit(f->body, "movq\t%d(%%rbp), %%rcx", from + 8);
+            emit(f->body, "movq\t%%rcx, %d(%%rdx)", to + 8);
+        }
+        else
+        {
+            int from = CLOSURE_CAPTURES + 16 * capture[j].index;
+            emit(f->body, "movq\t%d(%%rbp), %%rax", SELF_OFFSET);
+            emit(f->body, "movq\t%d(%%rax), %%rcx", from);
+            emit(f->body, "movq\t%%rcx, %d(%%rdx)", to);
+            emit(f->body, "movq\t%d(%%rax), %%rcx", from + 8);
+            emit(f->body, "movq\t%%rcx, %d(%%rdx)", to + 8);
+        }
+    }
+
+    emit(f->body, "movq\t%%rdx, %s",
+         payloadText(newTemp(f, VALUE_CLOSURE)).s);
+}
+
+// The callee and its arity are checked before the arguments are run. The
+// arguments are then pushed, the first at the lowest address, and the
+// closure is passed in %rdi. A call in tail position moves them over the
+// arguments of the function instead, which its caller pops, when they are
+// no more: a call of the function to itself then jumps back to its entry,
+// any other leaves its frame and jumps to the callee.
+static void emitCall(struct AsmEmitter* e, struct AsmFunction* f,
+                     CallExpr* pCallExpr)
+{
+    size_t argc = pCallExpr->arguments->len;
+    size_t bad  = newLabel(e);
+
+    emitExpr(e, f, pCallExpr->function);
+    size_t callee     = f->numOps - 1;
+    struct Operand* c = top(f, 0);
+
+    emitLabel(f->stubs, bad);
+    loadValue(f, f->stubs, c, "%edi", "%rsi");
+    emit(f->stubs, "movl\t$%zu, %%edx", argc);
+    emit(f->stubs, "call\tmonkeyCheckCall");
+
+    if (c->type == TYPE_DYNAMIC)
+    {
+        emit(f->body, "cmpl\t$%d, %s", VALUE_CLOSURE, typeText(c).s);
+        emit(f->body, "jne\t.L%zu", bad);
+    }
+    if (c->type == TYPE_DYNAMIC || c->type == VALUE_CLOSURE)
+    {
+        loadPayload(f, c, "%rax");
+        emit(f->body, "cmpl\t$%zu, %d(%%rax)", argc, CLOSURE_PARAMS);
+        emit(f->body, "jne\t.L%zu", bad);
+    }
+    else
+    {
+        emit(f->body, "jmp\t.L%zu", bad);
+    }
+
+    struct ArgNode* arg = pCallExpr->arguments->tail->before;
+    while (arg != pCallExpr->arguments->head)
+    {
+        emitExpr(e, f, arg->value);
+        arg = arg->before;
+    }
+
+    for (size_t i = 0; i < argc; ++i)
+    {
+        struct Operand* op = top(f, i);
+        if (fitsImmediate(op))
+        {
+            emit(f->body, "pushq\t%s", payloadText(op).s);
+        }
+        else
+        {
+            loadPayload(f, op, "%rax");
+            emit(f->body, "pushq\t%%rax");
+        }
+        emit(f->body, "pushq\t%s", type64Text(op).s);
+    }
+
+    loadPayload(f, &f->ops[callee], "%rdi");
+    if (pCallExpr->tail && (int)argc <= f->numParams)
+    {
+        for (size_t i = 0; i < 2 * argc; ++i)
+        {
+            emit(f->body, "movq\t%zu(%%rsp), %%rax", 8 * i);
+            emit(f->body, "movq\t%%rax, %zu(%%rbp)", 16 + 8 * i);
+        }
+        if (argc > 0)
+            emit(f->body, "addq\t$%zu, %%rsp", 16 * argc);
+        emit(f->body, "cmpq\t%d(%%rbp), %%rdi", SELF_OFFSET);
+        emit(f->body, "je\t.L%zu", f->entry);
+        emit(f->body, "jmp\t.L%zu", f->tailExit);
+        f->tailCalls = 1;
+
+        for (size_t i = 0; i <= argc; ++i)
+            popOperand(f);
+        pushConstant(f, VALUE_NULL, 0);
+        return;
+    }
+    emit(f->body, "call\t*(%%rdi)");
+    if (argc > 0)
+        emit(f->body, "addq\t$%zu, %%rsp", 16 * argc);
+
+    for (size_t i = 0; i <= argc; ++i)
+        popOperand(f);
+
+    struct Operand* result = newTemp(f, TYPE_DYNAMIC);
+    emit(f->body, "movl\t%%eax, %s", typeText(result).s);
+    emit(f->body, "movq\t%%rdx, %s", payloadText(result).s);
+}
+
+// Arrays and hashes are made by the runtime for the length of their
+// literal, then filled in place as their elements are run
+// The characters stay in .rodata, where the string points
+static void emitString(struct AsmEmitter* e, struct AsmFunction* f,
+                       StringExpr* pStringExpr)
+{
+    emit(f->body, "leaq\t.Ls%zu(%%rip), %%rdi",
+         addString(e, getStr(pStringExpr->value)));
+    emit(f->body, "movl\t$%zu, %%esi", getLen(pStringExpr->value));
+    emit(f->body, "call\tmonkeyString");
+    emit(f->body, "movq\t%%rdx, %s",
+         payloadText(newTemp(f, VALUE_STRING)).s);
+}
+
+static void emitArray(struct AsmEmitter* e, struct AsmFunction* f,
+                      ArrayExpr* pArrayExpr)
+{
+    emit(f->body, "movl\t$%zu, %%edi", pArrayExpr->elements->len);
+    emit(f->body, "call\tmonkeyArray");
+    size_t array = f->numOps;
+    emit(f->body, "movq\t%%rdx, %s", payloadText(newTemp(f, VALUE_ARRAY)).s);
+
+    struct ArgNode* tmp = pArrayExpr->elements->tail->before;
+    while (tmp != pArrayExpr->elements->head)
+    {
+        emitExpr(e, f, tmp->value);
+        loadValue(f, f->body, top(f, 0), "%esi", "%rdx");
+        loadPayload(f, &f->ops[array], "%rdi");
+        emit(f->body, "call\tmonkeyPush");
+        popOperand(f);
+        tmp = tmp->before;
+    }
+}
+
+// Each key is checked before its value is run, as eval does
+static void emitHash(struct AsmEmitter* e, struct AsmFunction* f,
+                     HashExpr* pHashExpr)
+{
+    emit(f->body, "movl\t$%zu, %%edi", pHashExpr->pairs->len / 2);
+    emit(f->body, "call\tmonkeyHash");
+    size_t hash = f->numOps;
+    emit(f->body, "movq\t%%rdx, %s", payloadText(newTemp(f, VALUE_HASH)).s);
+
+    struct ArgNode* tmp = pHashExpr->pairs->tail->before;
+    while (tmp != pHashExpr->pairs->head)
+    {
+        emitExpr(e, f, tmp->value);
+        loadValue(f, f->body, top(f, 0), "%edi", "%rsi");
+        emit(f->body, "call\tmonkeyCheckKey");
+        tmp = tmp->before;
+
+        emitExpr(e, f, tmp->value);
+        loadValue(f, f->body, top(f, 1), "%esi", "%rdx");
+        loadValue(f, f->body, top(f, 0), "%ecx", "%r8");
+        loadPayload(f, &f->ops[hash], "%rdi");
+        emit(f->body, "call\tmonkeyHashPut");
+        popOperand(f);
+        popOperand(f);
+        tmp = tmp->before;
+    }
+}
+
+static void emitIndex(struct AsmEmitter* e, struct AsmFunction* f,
+                      IndexExpr* pIndexExpr)
+{
+    emitExpr(e, f, pIndexExpr->left);
+    emitExpr(e, f, pIndexExpr->index);
+    loadValue(f, f->body, top(f, 1), "%edi", "%rsi");
+    loadValue(f, f->body, top(f, 0), "%edx", "%rcx");
+    emit(f->body, "call\tmonkeyIndex");
+    popOperand(f);
+    popOperand(f);
+
+    struct Operand* result = newTemp(f, TYPE_DYNAMIC);
+    emit(f->body, "movl\t%%eax, %s", typeText(result).s);
+    emit(f->body, "movq\t%%rdx, %s", payloadText(result).s);
+}
+
+static void useGlobal(struct AsmEmitter* e, int slot)
+{
+    if (slot >= e->numGlobals)
+        e->numGlobals = slot + 1;
+}
@@ -0,0 +1,25 @@
+#ifndef _MONKEY_LANG_SRC_ASMEMITTER_H_
+#define _MONKEY_LANG_SRC_ASMEMITTER_H_
+
+#include "ast.h"
+#include "dynString.h"
+
+// Translate a program that went through resolveProgram and analyzeCaptures
+// into x86-64 assembly for GNU as, in AT&T syntax, linked with the runtime
+// in runtime/asmRuntime.c:
+//
+//   monkey --emit-asm prog.mk > prog.s
+//   cc prog.s runtime/asmRuntime.c -Iruntime -o prog
+//
+// Values keep the layout of runtime/monkeyRuntime.h. Each function literal
+// is a function whose caller pushes the arguments, 16 bytes each, and
+// passes the closure in %rdi; it returns the type in %rax and the payload
+// in %rdx. Frame slots live below %rbp. Temporaries are given the
+// callee-saved registers %rbx and %r12 to %r15 while they last, and frame
+// slots after that; only temporaries whose type is not known statically
+// need a register for it. Integer operations are inlined, and the runtime
+// is only called on slow paths. The program prints what `monkey prog.mk`
+// prints, and ends with the same message on an error.
+String* emitAsm(Program*);
+
+#endif //_MONKEY_LANG_SRC_ASMEMITTER_H_
@@ -1,8 +1,11 @@
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "ast.h"
 #include "dynString.h"
+#include "stringBuilder.h"
+#include "walker.h"
 
 #define UNDEFINED_OBJECT_FOUND(type)                           \
     fprintf(stderr, "Undefined" type "found. Exit Program\n"); \
@@ -44,6 +47,7 @@ Expr* mkExpr(void)
     Expr* output = malloc(sizeof(Expr));
 
     output->type              = EMPTY_EXPR;
+    output->refCount          = 1;
     output->inner.checkIsNull = 0;
 
     return output;
@@ -84,6 +88,9 @@ IdentExpr* mkIdentExpr(void)
     IdentExpr* output = malloc(sizeof(IdentExpr));
 
     output->value = NULL;
+    output->kind  = RESOLVE_UNRESOLVED;
+    output->depth = 0;
+    output->slot  = 0;
 
     return output;
 }
@@ -161,7 +168,34 @@ FntExpr* mkFntExpr(void)
 #undef tail
 #undef head
 
-    output->body = mkBlockStmt();
+    output->body      = mkBlockStmt();
+    output->numLocals = 0;
+    output->selfSlot  = -1;
+
+    output->captures    = NULL;
+    output->numCaptures = 0;
+    output->pure        = 0;
+
+    output->nurseryEpoch = 0;
+
+    return output;
+}
+
+static Arguments* mkArguments(void)
+{
+    Arguments* output = malloc(sizeof(Arguments));
+
+    output->head = malloc(sizeof(struct ArgNode));
+    output->tail = malloc(sizeof(struct ArgNode));
+    output->len  = 0;
+
+    output->head->before = NULL;
+    output->head->value  = NULL;
+    output->head->next   = output->tail;
+
+    output->tail->before = output->head;
+    output->tail->value  = NULL;
+    output->tail->next   = NULL;
 
     return output;
 }
@@ -170,137 +204,256 @@ CallExpr* mkCallExpr(void)
 {
     CallExpr* output = malloc(sizeof(CallExpr));
 
-    output->function = mkExpr();
+    output->function  = NULL;
+    output->arguments = mkArguments();
+    output->tail      = 0;
 
-    output->arguments       = malloc(sizeof(Arguments));
-    output->arguments->head = malloc(sizeof(struct ArgNode));
-    output->arguments->tail = malloc(sizeof(struct ArgNode));
-    output->arguments->len  = 0;
+    return output;
+}
 
-#define head output->arguments->head
-#define tail output->arguments->tail
+ArrayExpr* mkArrayExpr(void)
+{
+    ArrayExpr* output = malloc(sizeof(ArrayExpr));
 
-    head->before = NULL;
-    head->value  = NULL;
-    head->next   = tail;
+    output->elements = mkArguments();
 
-    tail->before = head;
-    tail->value  = NULL;
-    tail->next   = NULL;
+    return output;
+}
 
-#undef tail
-#undef head
+HashExpr* mkHashExpr(void)
+{
+    HashExpr* output = malloc(sizeof(HashExpr));
+
+    output->pairs = mkArguments();
 
     return output;
 }
 
-/* Implementing Destructors */
-void freeProgram(Program* pProg)
+IndexExpr* mkIndexExpr(void)
 {
-    if (!pProg)
-        return;
+    IndexExpr* output = malloc(sizeof(IndexExpr));
 
-    Stmt* tmp = NULL;
-    while (pProg->len > 0)
-    {
-        tmp = popStmt(pProg);
-        freeStmt(tmp);
-    }
+    output->left  = NULL;
+    output->index = mkExpr();
 
-    free(pProg->head);
-    free(pProg->tail);
-    free(pProg);
+    return output;
 }
 
-void freeStmt(Stmt* pStmt)
+StringExpr* mkStringExpr(void)
 {
-    if (!pStmt)
-        return;
+    StringExpr* output = malloc(sizeof(StringExpr));
 
-    switch (pStmt->type)
-    {
-    case STMT_LET:
-        freeLetStmt(pStmt->inner.letStmt);
-        break;
+    output->value = NULL;
 
-    case STMT_RETURN:
-        freeReturnStmt(pStmt->inner.returnStmt);
-        break;
+    return output;
+}
 
-    case STMT_EXPRESSION:
-        freeExprStmt(pStmt->inner.exprStmt);
-        break;
+/* Implementing Destructors */
 
-    case STMT_BLOCK:
-        freeBlockStmt(pStmt->inner.blockStmt);
-        break;
+// Destructors go through the walker: children are freed before their parent
+// without recursion, and freeNode only releases the node it is handed. The
+// context, if any, is an Expr whose own allocation must be kept.
+static WalkResult releaseShared(AstNode node, void* ctx)
+{
+    (void)ctx;
 
-    case EMPTY_STMT:
-        break;
+    // A shared node is only released by its last parent
+    if (node.kind == NODE_EXPR && node.as.expr->refCount > 1)
+    {
+        --node.as.expr->refCount;
+        return WALK_SKIP;
+    }
 
-    default:
-        UNDEFINED_OBJECT_FOUND("Stmt");
-        break;
+    return WALK_CONTINUE;
+}
+
+static void freeBlockNodes(BlockStmt* pBlockStmt)
+{
+    struct ProgNode* tmp  = pBlockStmt->head->next;
+    struct ProgNode* next = NULL;
+    while (tmp != pBlockStmt->tail)
+    {
+        next = tmp->next;
+        free(tmp);
+        tmp = next;
     }
 
-    free(pStmt);
+    free(pBlockStmt->head);
+    free(pBlockStmt->tail);
+    free(pBlockStmt);
 }
 
-void freeExprWithoutSelf(Expr* pExpr)
+static void freeArgNodes(Arguments* pArgs)
 {
-    if (!pExpr)
+    if (!pArgs)
         return;
 
-    switch (pExpr->type)
+    struct ArgNode* tmp  = pArgs->head->next;
+    struct ArgNode* next = NULL;
+    while (tmp != pArgs->tail)
     {
-    case EXPR_IDENT:
-        freeIdentExpr(pExpr->inner.identExpr);
-        break;
-
-    case EXPR_INTEGER:
-        freeIntExpr(pExpr->inner.intExpr);
-        break;
+        next = tmp->next;
+        free(tmp);
+        tmp = next;
+    }
 
-    case EXPR_BOOL:
-        freeBoolExpr(pExpr->inner.boolExpr);
-        break;
+    free(pArgs->head);
+    free(pArgs->tail);
+    free(pArgs);
+}
 
-    case EXPR_PREFIX:
-        freePrefixExpr(pExpr->inner.prefixExpr);
-        break;
+static void freeCaptures(FntExpr* pFntExpr)
+{
+    for (int i = 0; i < pFntExpr->numCaptures; ++i)
+        freeString(pFntExpr->captures[i].name);
+    free(pFntExpr->captures);
+}
 
-    case EXPR_INFIX:
-        freeInfixExpr(pExpr->inner.infixExpr);
-        break;
+static void freeLetStmtShell(LetStmt* pLetStmt)
+{
+    if (!pLetStmt)
+        return;
 
-    case EXPR_IF:
-        freeIfExpr(pExpr->inner.ifExpr);
-        break;
+    freeIdentExpr(pLetStmt->name);
+    free(pLetStmt);
+}
 
-    case EXPR_FUNCTION:
-        freeFntExpr(pExpr->inner.fntExpr);
+static WalkResult freeNode(AstNode node, void* ctx)
+{
+    switch (node.kind)
+    {
+    case NODE_BLOCK:
+        freeBlockNodes(node.as.block);
         break;
 
-    case EXPR_CALL:
-        freeCallExpr(pExpr->inner.callExpr);
+    case NODE_STMT:
+        switch (node.as.stmt->type)
+        {
+        case STMT_LET:
+            freeLetStmtShell(node.as.stmt->inner.letStmt);
+            break;
+
+        case STMT_RETURN:
+            free(node.as.stmt->inner.returnStmt);
+            break;
+
+        case STMT_EXPRESSION:
+            free(node.as.stmt->inner.exprStmt);
+            break;
+
+        case STMT_BLOCK:
+        case EMPTY_STMT:
+            break;
+
+        default:
+            UNDEFINED_OBJECT_FOUND("Stmt");
+            break;
+        }
+        free(node.as.stmt);
         break;
 
-    case EMPTY_EXPR:
+    case NODE_EXPR:
+        switch (node.as.expr->type)
+        {
+        case EXPR_IDENT:
+            freeIdentExpr(node.as.expr->inner.identExpr);
+            break;
+
+        case EXPR_INTEGER:
+            freeIntExpr(node.as.expr->inner.intExpr);
+            break;
+
+        case EXPR_BOOL:
+            freeBoolExpr(node.as.expr->inner.boolExpr);
+            break;
+
+        case EXPR_PREFIX:
+            if (node.as.expr->inner.prefixExpr)
+                freeString(node.as.expr->inner.prefixExpr->opt);
+            free(node.as.expr->inner.prefixExpr);
+            break;
+
+        case EXPR_INFIX:
+            if (node.as.expr->inner.infixExpr)
+                freeString(node.as.expr->inner.infixExpr->opt);
+            free(node.as.expr->inner.infixExpr);
+            break;
+
+        case EXPR_IF:
+            free(node.as.expr->inner.ifExpr);
+            break;
+
+        case EXPR_FUNCTION:
+            if (node.as.expr->inner.fntExpr)
+            {
+                freeParameters(node.as.expr->inner.fntExpr->parameters);
+                freeCaptures(node.as.expr->inner.fntExpr);
+            }
+            free(node.as.expr->inner.fntExpr);
+            break;
+
+        case EXPR_CALL:
+            if (node.as.expr->inner.callExpr)
+                freeArgNodes(node.as.expr->inner.callExpr->arguments);
+            free(node.as.expr->inner.callExpr);
+            break;
+
+        case EXPR_ARRAY:
+            if (node.as.expr->inner.arrayExpr)
+                freeArgNodes(node.as.expr->inner.arrayExpr->elements);
+            free(node.as.expr->inner.arrayExpr);
+            break;
+
+        case EXPR_HASH:
+            if (node.as.expr->inner.hashExpr)
+                freeArgNodes(node.as.expr->inner.hashExpr->pairs);
+            free(node.as.expr->inner.hashExpr);
+            break;
+
+        case EXPR_INDEX:
+            free(node.as.expr->inner.indexExpr);
+            break;
+
+        case EXPR_STRING:
+            freeStringExpr(node.as.expr->inner.stringExpr);
+            break;
+
+        case EMPTY_EXPR:
+            break;
+
+        default:
+            UNDEFINED_OBJECT_FOUND("Expr");
+            break;
+        }
+        if (node.as.expr != ctx)
+            free(node.as.expr);
         break;
 
     default:
-        UNDEFINED_OBJECT_FOUND("Expr");
         break;
     }
+
+    return WALK_CONTINUE;
 }
 
-void freeExpr(Expr* pExpr)
+static const Visitor freeVisitor = {releaseShared, NULL, freeNode};
+
+void freeProgram(Program* pProg) { walkProgram(pProg, &freeVisitor, NULL); }
+
+void freeStmt(Stmt* pStmt) { walkStmt(pStmt, &freeVisitor, NULL); }
+
+void freeExprWithoutSelf(Expr* pExpr)
 {
-    if (!pExpr)
-        return;
+    walkExpr(pExpr, &freeVisitor, pExpr);
+}
+
+void freeExpr(Expr* pExpr) { walkExpr(pExpr, &freeVisitor, NULL); }
 
-    freeExprWithoutSelf(pExpr);
-    free(pExpr);
+Expr* retainExpr(Expr* pExpr)
+{
+    if (pExpr)
+        ++pExpr->refCount;
+    return pExpr;
 }
 
 void freeLetStmt(LetStmt* pLetStmt)
@@ -401,18 +554,23 @@ void freeFntExpr(FntExpr* pFntExpr)
 
     freeParameters(pFntExpr->parameters);
     freeBlockStmt(pFntExpr->body);
+    freeCaptures(pFntExpr);
     free(pFntExpr);
 }
 
 void freeParameters(Parameters* pParam)
 {
+    if (!pParam)
+        return;
+
     struct ParamNode* tmp = pParam->tail->before;
+    struct ParamNode* before = NULL;
     while (tmp != pParam->head)
     {
+        before = tmp->before;
         freeIdentExpr(tmp->value);
-        if (tmp)
-            free(tmp);
-        tmp = tmp->before;
+        free(tmp);
+        tmp = before;
     }
     free(pParam->tail);
     free(pParam->head);
@@ -429,144 +587,352 @@ void freeCallExpr(CallExpr* pCallExpr)
     free(pCallExpr);
 }
 
+void freeArrayExpr(ArrayExpr* pArrayExpr)
+{
+    if (!pArrayExpr)
+        return;
+
+    freeArguments(pArrayExpr->elements);
+    free(pArrayExpr);
+}
+
+void freeHashExpr(HashExpr* pHashExpr)
+{
+    if (!pHashExpr)
+        return;
+
+    freeArguments(pHashExpr->pairs);
+    free(pHashExpr);
+}
+
+void freeIndexExpr(IndexExpr* pIndexExpr)
+{
+    if (!pIndexExpr)
+        return;
+
+    freeExpr(pIndexExpr->left);
+    freeExpr(pIndexExpr->index);
+    free(pIndexExpr);
+}
+
+void freeStringExpr(StringExpr* pStringExpr)
+{
+    if (!pStringExpr)
+        return;
+
+    freeString(pStringExpr->value);
+
+    free(pStringExpr);
+}
+
 void freeArguments(Arguments* pArgs)
 {
+    if (!pArgs)
+        return;
+
     struct ArgNode* tmp = pArgs->tail->before;
     while (tmp != pArgs->head)
     {
         freeExpr(tmp->value);
-        if (tmp)
-            free(tmp);
         tmp = tmp->before;
     }
-    free(pArgs->tail);
-    free(pArgs->head);
-    free(pArgs);
+    freeArgNodes(pArgs);
 }
 
 /* Implementing Stringify */
-String* stringifyProgram(Program* pProg)
-{
-    if (!pProg)
-        return NULL;
-
-    String* output       = mkString("");
-    struct ProgNode* tmp = pProg->tail->before;
-    while (tmp != pProg->head)
-    {
-        concatFreeString(output, stringifyStmt(tmp->value));
-        tmp = tmp->before;
-    }
 
-    return output;
-}
-
-String* stringifyStmt(Stmt* pStmt)
+// Stringify also goes through the walker and writes every node straight
+// into one StringBuilder: pre emits the text before the first child,
+// between the separators and post the text after the last child.
+struct StringifyCtx
 {
-    if (!pStmt)
-        return NULL;
+    StringBuilder* builder;
+    BlockStmt* program; // printed without the braces of a block
+};
 
-    String* output = NULL;
+static WalkResult stringifyPre(AstNode node, void* ctx)
+{
+    struct StringifyCtx* sctx = ctx;
+    StringBuilder* builder    = sctx->builder;
 
-    switch (pStmt->type)
+    switch (node.kind)
     {
-    case STMT_LET:
-        output = stringifyLetStmt(pStmt->inner.letStmt);
-        break;
-
-    case STMT_RETURN:
-        output = stringifyReturnStmt(pStmt->inner.returnStmt);
+    case NODE_BLOCK:
+        if (node.as.block != sctx->program)
+            builderAppendStr(builder, "{ ");
         break;
 
-    case STMT_EXPRESSION:
-        output = stringifyExprStmt(pStmt->inner.exprStmt);
+    case NODE_STMT:
+        if (!node.as.stmt->inner.checkIsNull)
+            break;
+
+        if (node.as.stmt->type == STMT_LET)
+        {
+            builderAppendStr(builder, "let ");
+            builderAppendString(builder,
+                                node.as.stmt->inner.letStmt->name->value);
+            builderAppendStr(builder, " = ");
+        }
+        else if (node.as.stmt->type == STMT_RETURN)
+        {
+            builderAppendStr(builder, "return ");
+        }
         break;
 
-    case STMT_BLOCK:
-        output = stringifyBlockStmt(pStmt->inner.blockStmt);
+    case NODE_EXPR:
+    {
+        Expr* expr = node.as.expr;
+        if (!expr->inner.checkIsNull)
+            break;
+
+        switch (expr->type)
+        {
+        case EXPR_IDENT:
+            builderAppendString(builder, expr->inner.identExpr->value);
+            break;
+
+        case EXPR_INTEGER:
+        {
+            char buffer[22];
+            sprintf(buffer, "%" PRId64, expr->inner.intExpr->value);
+            builderAppendStr(builder, buffer);
+            break;
+        }
+
+        case EXPR_BOOL:
+            builderAppendStr(builder,
+                             expr->inner.boolExpr->value ? "true" : "false");
+            break;
+
+        case EXPR_STRING:
+            builderAppendChar(builder, '"');
+            builderAppendString(builder, expr->inner.stringExpr->value);
+            builderAppendChar(builder, '"');
+            break;
+
+        case EXPR_PREFIX:
+            builderAppendChar(builder, '(');
+            builderAppendString(builder, expr->inner.prefixExpr->opt);
+            break;
+
+        case EXPR_INFIX:
+            builderAppendChar(builder, '(');
+            break;
+
+        case EXPR_IF:
+            builderAppendStr(builder, "if ");
+            break;
+
+        case EXPR_FUNCTION:
+        {
+            Parameters* params = expr->inner.fntExpr->parameters;
+
+            builderAppendStr(builder, "fn(");
+            if (params)
+            {
+                struct ParamNode* tmp = params->tail->before;
+                while (tmp != params->head)
+                {
+                    builderAppendString(builder, tmp->value->value);
+                    if (tmp->before != params->head)
+                        builderAppendStr(builder, ", ");
+                    tmp = tmp->before;
+                }
+            }
+            builderAppendStr(builder, ") ");
+            break;
+        }
+
+        case EXPR_ARRAY:
+            builderAppendChar(builder, '[');
+            break;
+
+        case EXPR_HASH:
+            builderAppendChar(builder, '{');
+            break;
+
+        case EXPR_INDEX:
+            builderAppendChar(builder, '(');
+            break;
+
+        default:
+            break;
+        }
         break;
+    }
 
     default:
         break;
     }
 
-    return output;
+    return WALK_CONTINUE;
 }
 
-String* stringifyExpr(Expr* pExpr)
+static WalkResult stringifyBetween(AstNode node, size_t child, void* ctx)
 {
-    if (!pExpr)
-        return NULL;
+    StringBuilder* builder = ((struct StringifyCtx*)ctx)->builder;
 
-    String* output = NULL;
+    if (node.kind != NODE_EXPR)
+        return WALK_CONTINUE;
 
-    switch (pExpr->type)
+    switch (node.as.expr->type)
     {
-    case EXPR_IDENT:
-        output = stringifyIdentExpr(pExpr->inner.identExpr);
+    case EXPR_INFIX:
+        builderAppendChar(builder, ' ');
+        builderAppendString(builder, node.as.expr->inner.infixExpr->opt);
+        builderAppendChar(builder, ' ');
         break;
 
-    case EXPR_INTEGER:
-        output = stringifyIntExpr(pExpr->inner.intExpr);
+    case EXPR_IF:
+        builderAppendStr(builder, child == 1 ? " " : "else ");
         break;
 
-    case EXPR_BOOL:
-        output = stringifyBoolExpr(pExpr->inner.boolExpr);
+    case EXPR_CALL:
+        builderAppendStr(builder, child == 1 ? "(" : ", ");
         break;
 
-    case EXPR_PREFIX:
-        output = stringifyPrefixExpr(pExpr->inner.prefixExpr);
+    case EXPR_ARRAY:
+        builderAppendStr(builder, ", ");
         break;
 
-    case EXPR_INFIX:
-        output = stringifyInfixExpr(pExpr->inner.infixExpr);
+    case EXPR_HASH:
+        // Every odd child is the value of the key before it
+        builderAppendStr(builder, child % 2 ? ": " : ", ");
         break;
 
-    case EXPR_IF:
-        output = stringifyIfExpr(pExpr->inner.ifExpr);
+    case EXPR_INDEX:
+        builderAppendChar(builder, '[');
         break;
 
-    case EXPR_FUNCTION:
-        output = stringifyFntExpr(pExpr->inner.fntExpr);
+    default:
         break;
+    }
 
-    case EXPR_CALL:
-        output = stringifyCallExpr(pExpr->inner.callExpr);
+    return WALK_CONTINUE;
+}
+
+static WalkResult stringifyPost(AstNode node, void* ctx)
+{
+    struct StringifyCtx* sctx = ctx;
+    StringBuilder* builder    = sctx->builder;
+
+    switch (node.kind)
+    {
+    case NODE_BLOCK:
+        if (node.as.block != sctx->program)
+            builderAppendStr(builder, " }");
+        break;
+
+    case NODE_STMT:
+        if (!node.as.stmt->inner.checkIsNull)
+            break;
+
+        if (node.as.stmt->type == STMT_LET
+            || node.as.stmt->type == STMT_RETURN)
+            builderAppendChar(builder, ';');
+        break;
+
+    case NODE_EXPR:
+        if (!node.as.expr->inner.checkIsNull)
+            break;
+
+        switch (node.as.expr->type)
+        {
+        case EXPR_PREFIX:
+        case EXPR_INFIX:
+            builderAppendChar(builder, ')');
+            break;
+
+        case EXPR_CALL:
+        {
+            // Without arguments the opening parenthesis was never written
+            Arguments* args = node.as.expr->inner.callExpr->arguments;
+            builderAppendStr(builder, !args || args->len == 0 ? "()" : ")");
+            break;
+        }
+
+        case EXPR_ARRAY:
+            builderAppendChar(builder, ']');
+            break;
+
+        case EXPR_HASH:
+            builderAppendChar(builder, '}');
+            break;
+
+        case EXPR_INDEX:
+            builderAppendStr(builder, "])");
+            break;
+
+        default:
+            break;
+        }
         break;
 
     default:
         break;
     }
 
+    return WALK_CONTINUE;
+}
+
+static String* stringifyNode(AstNode node, BlockStmt* program)
+{
+    static const Visitor visitor = {stringifyPre, stringifyBetween,
+                                    stringifyPost};
+    struct StringifyCtx ctx      = {mkStringBuilder(), program};
+
+    walkNode(node, &visitor, &ctx);
+
+    String* output = buildString(ctx.builder);
+    freeStringBuilder(ctx.builder);
+
     return output;
 }
 
-String* stringifyLetStmt(LetStmt* pLetStmt)
+String* stringifyProgram(Program* pProg)
 {
-    if (!pLetStmt)
+    if (!pProg)
         return NULL;
 
-    String* output = mkString("let ");
-    concatFreeString(output, stringifyIdentExpr(pLetStmt->name));
-    appendStr(output, " = ");
-    if (pLetStmt->value)
-        concatFreeString(output, stringifyExpr(pLetStmt->value));
-    appendStr(output, ";");
+    return stringifyNode((AstNode){NODE_BLOCK, {.block = pProg}}, pProg);
+}
 
-    return output;
+String* stringifyStmt(Stmt* pStmt)
+{
+    if (!pStmt)
+        return NULL;
+
+    return stringifyNode((AstNode){NODE_STMT, {.stmt = pStmt}}, NULL);
 }
 
-String* stringifyReturnStmt(ReturnStmt* pReturnStmt)
+String* stringifyExpr(Expr* pExpr)
 {
-    if (!pReturnStmt)
+    if (!pExpr)
         return NULL;
 
-    String* output = mkString("return ");
-    if (pReturnStmt->returnValue)
-        concatFreeString(output, stringifyExpr(pReturnStmt->returnValue));
-    appendStr(output, ";");
+    return stringifyNode((AstNode){NODE_EXPR, {.expr = pExpr}}, NULL);
+}
 
-    return output;
+// The stringifiers of inner nodes wrap them in a temporary Stmt or Expr
+#define STRINGIFY_STMT(stmtType, field, value)                       \
+    if (!(value))                                                    \
+        return NULL;                                                 \
+    Stmt tmp = {stmtType, {.field = (value)}};                       \
+    return stringifyStmt(&tmp)
+#define STRINGIFY_EXPR(exprType, field, value)                       \
+    if (!(value))                                                    \
+        return NULL;                                                 \
+    Expr tmp = {exprType, 1, {.field = (value)}};                    \
+    return stringifyExpr(&tmp)
+
+String* stringifyLetStmt(LetStmt* pLetStmt)
+{
+    STRINGIFY_STMT(STMT_LET, letStmt, pLetStmt);
+}
+
+String* stringifyReturnStmt(ReturnStmt* pReturnStmt)
+{
+    STRINGIFY_STMT(STMT_RETURN, returnStmt, pReturnStmt);
 }
 
 String* stringifyExprStmt(ExprStmt* pExprStmt)
@@ -579,131 +945,75 @@ String* stringifyExprStmt(ExprStmt* pExprStmt)
 
 String* stringifyBlockStmt(BlockStmt* pBlockStmt)
 {
-    String* output = mkString("{ ");
-    concatFreeString(output, stringifyProgram((Program*)pBlockStmt));
-    appendStr(output, " }");
-    return output;
+    if (!pBlockStmt)
+        return mkString("{  }");
+
+    return stringifyNode((AstNode){NODE_BLOCK, {.block = pBlockStmt}}, NULL);
 }
 
 String* stringifyIdentExpr(IdentExpr* pIdentExpr)
 {
-    if (!pIdentExpr)
-        return NULL;
-
-    return mkString(getStr(pIdentExpr->value));
+    STRINGIFY_EXPR(EXPR_IDENT, identExpr, pIdentExpr);
 }
 
 String* stringifyIntExpr(IntExpr* pIntExpr)
 {
-    if (!pIntExpr)
-        return NULL;
-
-    char buffer[22];
-    sprintf(buffer, "%lld", pIntExpr->value);
-
-    return mkString(buffer);
+    STRINGIFY_EXPR(EXPR_INTEGER, intExpr, pIntExpr);
 }
 
 String* stringifyBoolExpr(BoolExpr* pBoolExpr)
 {
-    if (!pBoolExpr)
-        return NULL;
-
-    return mkString(pBoolExpr->value != 0 ? "true" : "false");
+    STRINGIFY_EXPR(EXPR_BOOL, boolExpr, pBoolExpr);
 }
 
 String* stringifyPrefixExpr(PrefixExpr* pPrefixExpr)
 {
-    if (!pPrefixExpr)
-        return NULL;
-
-    String* output = mkString("(");
-    concatString(output, pPrefixExpr->opt);
-    concatFreeString(output, stringifyExpr(pPrefixExpr->right));
-    appendChar(output, ')');
-
-    return output;
+    STRINGIFY_EXPR(EXPR_PREFIX, prefixExpr, pPrefixExpr);
 }
 
 String* stringifyInfixExpr(InfixExpr* pInfixExpr)
 {
-    if (!pInfixExpr)
-        return NULL;
-
-    String* output = mkString("(");
-    concatFreeString(output, stringifyExpr(pInfixExpr->left));
-    appendChar(output, ' ');
-    concatString(output, pInfixExpr->opt);
-    appendChar(output, ' ');
-    concatFreeString(output, stringifyExpr(pInfixExpr->right));
-    appendChar(output, ')');
-
-    return output;
+    STRINGIFY_EXPR(EXPR_INFIX, infixExpr, pInfixExpr);
 }
 
 String* stringifyIfExpr(IfExpr* pIfExpr)
 {
-    if (!pIfExpr)
-        return NULL;
-
-    String* output = mkString("if ");
-    concatFreeString(output, stringifyExpr(pIfExpr->condition));
-    appendChar(output, ' ');
-    concatFreeString(output, stringifyBlockStmt(pIfExpr->consequence));
-
-    if (pIfExpr->alternative)
-    {
-        appendStr(output, "else ");
-        concatFreeString(output, stringifyBlockStmt(pIfExpr->alternative));
-    }
-
-    return output;
+    STRINGIFY_EXPR(EXPR_IF, ifExpr, pIfExpr);
 }
 
 String* stringifyFntExpr(FntExpr* pFntExpr)
 {
-    if (!pFntExpr)
-        return NULL;
-
-    String* output = mkString("fn(");
-
-    struct ParamNode* tmp = pFntExpr->parameters->tail->before;
-    while (tmp != pFntExpr->parameters->head)
-    {
-        concatFreeString(output, stringifyIdentExpr(tmp->value));
-        if (tmp->before != pFntExpr->parameters->head)
-            appendStr(output, ", ");
-        tmp = tmp->before;
-    }
-
-    appendStr(output, ") ");
-    concatFreeString(output, stringifyBlockStmt(pFntExpr->body));
-
-    return output;
+    STRINGIFY_EXPR(EXPR_FUNCTION, fntExpr, pFntExpr);
 }
 
 String* stringifyCallExpr(CallExpr* pCallExpr)
 {
-    if (!pCallExpr)
-        return NULL;
+    STRINGIFY_EXPR(EXPR_CALL, callExpr, pCallExpr);
+}
 
-    String* output = mkString("");
-    concatFreeString(output, stringifyExpr(pCallExpr->function));
-    appendChar(output, '(');
+String* stringifyArrayExpr(ArrayExpr* pArrayExpr)
+{
+    STRINGIFY_EXPR(EXPR_ARRAY, arrayExpr, pArrayExpr);
+}
 
-    struct ArgNode* tmp = pCallExpr->arguments->tail->before;
-    while (tmp != pCallExpr->arguments->head)
-    {
-        concatFreeString(output, stringifyExpr(tmp->value));
-        if (tmp->before != pCallExpr->arguments->head)
-            appendStr(output, ", ");
-        tmp = tmp->before;
-    }
-    appendStr(output, ")");
+String* stringifyHashExpr(HashExpr* pHashExpr)
+{
+    STRINGIFY_EXPR(EXPR_HASH, hashExpr, pHashExpr);
+}
 
-    return output;
+String* stringifyIndexExpr(IndexExpr* pIndexExpr)
+{
+    STRINGIFY_EXPR(EXPR_INDEX, indexExpr, pIndexExpr);
 }
 
+String* stringifyStringExpr(StringExpr* pStringExpr)
+{
+    STRINGIFY_EXPR(EXPR_STRING, stringExpr, pStringExpr);
+}
+
+#undef STRINGIFY_EXPR
+#undef STRINGIFY_STMT
+
 /* Implementing push and pop */
 void pushStmt(Program* pProg, Stmt** pStmt)
 {
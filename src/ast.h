@@ -15,6 +15,21 @@ typedef enum
     STMT_BLOCK,
 } StmtType;
 
+typedef enum
+{
+    RESOLVE_UNRESOLVED = 0,
+    RESOLVE_GLOBAL,  // slot in the global table
+    RESOLVE_LOCAL,   // slot in the frame of the enclosing function
+    RESOLVE_FREE,    // slot in the frame of a function `depth` levels out
+    RESOLVE_CAPTURE, // index into the captures of the enclosing closure
+} ResolveKind;
+
+typedef enum
+{
+    CAPTURE_LOCAL = 0, // slot in the frame of the enclosing function
+    CAPTURE_OUTER,     // capture of the enclosing closure
+} CaptureSource;
+
 typedef enum
 {
     EMPTY_EXPR = 0,
@@ -26,6 +41,10 @@ typedef enum
     EXPR_IF,
     EXPR_FUNCTION,
     EXPR_CALL,
+    EXPR_ARRAY,
+    EXPR_HASH,
+    EXPR_INDEX,
+    EXPR_STRING,
 } ExprType;
 
 typedef struct Program Program;
@@ -45,8 +64,13 @@ typedef struct InfixExpr InfixExpr;
 typedef struct IfExpr IfExpr;
 typedef struct Parameters Parameters;
 typedef struct Arguments Arguments;
+typedef struct Capture Capture;
 typedef struct FntExpr FntExpr;
 typedef struct CallExpr CallExpr;
+typedef struct ArrayExpr ArrayExpr;
+typedef struct HashExpr HashExpr;
+typedef struct IndexExpr IndexExpr;
+typedef struct StringExpr StringExpr;
 
 Program* mkProgram(void);
 Stmt* mkStmt(void);
@@ -63,10 +87,15 @@ InfixExpr* mkInfixExpr(void);
 IfExpr* mkIfExpr(void);
 FntExpr* mkFntExpr(void);
 CallExpr* mkCallExpr(void);
+ArrayExpr* mkArrayExpr(void);
+HashExpr* mkHashExpr(void);
+IndexExpr* mkIndexExpr(void);
+StringExpr* mkStringExpr(void);
 
 void freeProgram(Program*);
 void freeStmt(Stmt*);
 void freeExpr(Expr*);
+Expr* retainExpr(Expr*);
 void freeExprWithoutSelf(Expr*);
 void freeLetStmt(LetStmt*);
 void freeReturnStmt(ReturnStmt*);
@@ -80,6 +109,10 @@ void freeInfixExpr(InfixExpr*);
 void freeIfExpr(IfExpr*);
 void freeFntExpr(FntExpr*);
 void freeCallExpr(CallExpr*);
+void freeArrayExpr(ArrayExpr*);
+void freeHashExpr(HashExpr*);
+void freeIndexExpr(IndexExpr*);
+void freeStringExpr(StringExpr*);
 void freeParameters(Parameters*);
 void freeArguments(Arguments*);
 
@@ -98,6 +131,10 @@ String* stringifyInfixExpr(InfixExpr*);
 String* stringifyIfExpr(IfExpr*);
 String* stringifyFntExpr(FntExpr*);
 String* stringifyCallExpr(CallExpr*);
+String* stringifyArrayExpr(ArrayExpr*);
+String* stringifyHashExpr(HashExpr*);
+String* stringifyIndexExpr(IndexExpr*);
+String* stringifyStringExpr(StringExpr*);
 
 void pushStmt(Program*, Stmt**);
 Stmt* popStmt(Program*);
@@ -139,6 +176,9 @@ struct Stmt
 struct Expr
 {
     ExprType type;
+    // Number of parents pointing at this node. It is 1 unless hash-consing
+    // made structurally equal subtrees share the node.
+    uint32_t refCount;
     union
     {
         uintptr_t checkIsNull; // To make it zero initizlize
@@ -150,6 +190,10 @@ struct Expr
         IfExpr* ifExpr;
         FntExpr* fntExpr;
         CallExpr* callExpr;
+        ArrayExpr* arrayExpr;
+        HashExpr* hashExpr;
+        IndexExpr* indexExpr;
+        StringExpr* stringExpr;
     } inner;
 };
 
@@ -174,6 +218,12 @@ struct ExprStmt
 struct IdentExpr
 {
     String* value;
+    // Filled in by resolveProgram, both for uses and for the names bound by
+    // `let` and parameters. depth counts the function literals between the
+    // use and its binding, so it is 0 unless kind is RESOLVE_FREE.
+    ResolveKind kind;
+    int depth;
+    int slot;
 };
 
 struct IntExpr
@@ -224,6 +274,28 @@ struct FntExpr
 {
     Parameters* parameters;
     BlockStmt* body;
+    // Filled in by resolveProgram: the number of slots a call needs for its
+    // parameters and bindings, and the slot that holds the function itself
+    // when it is bound by `let` (-1 otherwise) so that it can recurse.
+    int numLocals;
+    int selfSlot;
+    // Filled in by analyzeCaptures: the variables of enclosing functions
+    // that the body uses, copied into the closure when it is created.
+    Capture* captures;
+    int numCaptures;
+    // Filled in by analyzePurity: whether a call depends on its arguments
+    // only, for the engines to memoize it
+    int pure;
+    // Set by the collector: the filling of a nursery that holds a reference
+    // to the function for its young closures, see gc.c
+    size_t nurseryEpoch;
+};
+
+struct Capture
+{
+    String* name;
+    CaptureSource source;
+    int index; // frame slot or capture index, depending on source
 };
 
 struct ArgNode
@@ -244,6 +316,32 @@ struct CallExpr
 {
     Expr* function;
     Arguments* arguments;
+    // Filled in by resolveProgram: whether the call is the last thing its
+    // function does, so that the callee can take over the caller's frame
+    int tail;
+};
+
+struct ArrayExpr
+{
+    Arguments* elements;
+};
+
+struct HashExpr
+{
+    // Keys and values alternate, each key before its value
+    Arguments* pairs;
+};
+
+struct IndexExpr
+{
+    Expr* left;
+    Expr* index;
+};
+
+// What the quotes of a string literal enclose
+struct StringExpr
+{
+    String* value;
 };
 
 #endif //_MONKEY_LANG_SRC_AST_H_
@@ -0,0 +1,383 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "capture.h"
+#include "closureCompiler.h"
+#include "code.h"
+#include "collection.h"
+#include "compiler.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "jit.h"
+#include "parser.h"
+#include "registerCompiler.h"
+#include "registerVM.h"
+#include "repl.h"
+#include "resolver.h"
+#include "vm.h"
+
+#define REPEAT 3
+
+typedef struct
+{
+    const char* name;
+    const char* source;
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    {"calls",
+     "let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) };"
+     "fib(30)"},
+    {"arithmetic",
+     "let step = fn(n, acc) { if (n == 0) { acc } else { step(n - 1, "
+     "(acc * 31 + n * 7 - n / 3 + n * n / 5) - acc / 2 "
+     "+ (n - acc) * 3 / 7) } };"
+     "let loop = fn(k, acc) { if (k == 0) { acc } "
+     "else { loop(k - 1, acc + step(2000, k)) } };"
+     "loop(2000, 0)"},
+    // A tree of 111111 arrays of 10 elements each, with 1M leaves, then 1M
+    // lookups of pseudo-random leaves through its 6 levels. No array is
+    // large, nor ever grows; see the collection benchmarks for that.
+    {"arrays",
+     "let node = fn(lo, step) { if (step == 0) { lo } else { "
+     "let s = step / 10;"
+     "[node(lo, s), node(lo + step, s), node(lo + 2 * step, s), "
+     "node(lo + 3 * step, s), node(lo + 4 * step, s), "
+     "node(lo + 5 * step, s), node(lo + 6 * step, s), "
+     "node(lo + 7 * step, s), node(lo + 8 * step, s), "
+     "node(lo + 9 * step, s)] } };"
+     "let table = node(0, 100000);"
+     "let get = fn(t, k, step) { if (step == 0) { t } "
+     "else { get(t[k / step], k - k / step * step, step / 10) } };"
+     "let next = fn(x) { let y = x * 1103515245 + 12345; "
+     "y - y / 2147483648 * 2147483648 };"
+     "let look = fn(n, x, acc) { if (n == 0) { acc } else { "
+     "let y = next(x);"
+     "look(n - 1, y, acc + get(table, y - y / 1000000 * 1000000, "
+     "100000)) } };"
+     "look(1000000, 1, 0)"},
+    // The same tree of 10-entry hashes, keyed by the first leaf below
+    // each entry, which probe a single group of their small tables
+    {"hashes",
+     "let node = fn(lo, step) { if (step == 0) { lo } else { "
+     "let s = step / 10;"
+     "{lo: node(lo, s), lo + step: node(lo + step, s), "
+     "lo + 2 * step: node(lo + 2 * step, s), "
+     "lo + 3 * step: node(lo + 3 * step, s), "
+     "lo + 4 * step: node(lo + 4 * step, s), "
+     "lo + 5 * step: node(lo + 5 * step, s), "
+     "lo + 6 * step: node(lo + 6 * step, s), "
+     "lo + 7 * step: node(lo + 7 * step, s), "
+     "lo + 8 * step: node(lo + 8 * step, s), "
+     "lo + 9 * step: node(lo + 9 * step, s)} } };"
+     "let table = node(0, 100000);"
+     "let get = fn(t, k, step) { if (step == 0) { t } "
+     "else { get(t[k / step * step], k, step / 10) } };"
+     "let next = fn(x) { let y = x * 1103515245 + 12345; "
+     "y - y / 2147483648 * 2147483648 };"
+     "let look = fn(n, x, acc) { if (n == 0) { acc } else { "
+     "let y = next(x);"
+     "look(n - 1, y, acc + get(table, y - y / 1000000 * 1000000, "
+     "100000)) } };"
+     "look(1000000, 1, 0)"},
+    // A 10 MB string from 1M appends, then one index that flattens it
+    {"strings",
+     "let add = fn(n, s) { if (n == 0) { s } "
+     "else { add(n - 1, s + \"0123456789\") } };"
+     "let loop = fn(k, s) { if (k == 0) { s } "
+     "else { loop(k - 1, add(1000, s)) } };"
+     "loop(1000, \"\")[9999999]"},
+};
+
+typedef struct
+{
+    const char* name;
+    Engine engine;
+    int superinstructions;
+    int jit;
+} BenchEngine;
+
+static const BenchEngine engines[] = {
+    {"eval", ENGINE_EVAL, 0, 0},
+    {"vm", ENGINE_VM, 0, 0},
+    {"vm+super", ENGINE_VM, 1, 0},
+    {"vm+jit", ENGINE_VM, 0, 1},
+    {"registers", ENGINE_REGISTERS, 0, 0},
+    {"closures", ENGINE_CLOSURES, 0, 0},
+};
+
+// Run the source once in a fresh environment, leaving its inspected value
+// or error in output. Returns the seconds spent running, without parsing
+// and compiling. The dispatches of the VM go to profile, if not NULL.
+static double runOnce(const char* source, const BenchEngine* bench,
+                      DispatchProfile* profile, String** output)
+{
+    Engine engine    = bench->engine;
+    Environment* env = mkEnvironment();
+    Lexer* l         = mkLexer(source);
+    Parser* p        = mkParser(l);
+    Program* program = parseProgram(p);
+    double seconds   = 0;
+
+    if (getErrLen(p) != 0 || resolveProgram(getResolver(env), program) != 0)
+    {
+        *output = mkString("PARSE ERROR");
+        freeProgram(program);
+        freeParser(p);
+        freeEnvironment(env);
+        return 0;
+    }
+    analyzeCaptures(program);
+
+    Value result               = UNDEFINED_VALUE;
+    CompiledFunction* compiled = NULL;
+    NodeTree* tree             = NULL;
+    if (engine == ENGINE_VM)
+    {
+        compiled = compileProgram(program, env);
+        if (compiled && bench->superinstructions)
+            fuseInstructions(compiled);
+    }
+    else if (engine == ENGINE_REGISTERS)
+    {
+        compiled = compileRegisters(program, env);
+    }
+    else if (engine == ENGINE_CLOSURES)
+    {
+        tree = compileClosures(program, env);
+    }
+
+    setDispatchProfile(env, profile);
+    setJitThreshold(env, bench->jit ? DEFAULT_JIT_THRESHOLD : 0);
+    clock_t start = clock();
+    if (engine == ENGINE_EVAL)
+        result = eval(program, env);
+    else if (engine == ENGINE_VM && compiled)
+        result = runBytecode(compiled, env);
+    else if (engine == ENGINE_REGISTERS && compiled)
+        result = runRegisters(compiled, env);
+    else if (engine == ENGINE_CLOSURES && tree)
+        result = runClosures(tree, env);
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    String* error = getEvalError(env);
+    if (error)
+    {
+        *output = mkString("ERROR: ");
+        concatFreeString(*output, error);
+    }
+    else
+    {
+        *output = inspectValue(result);
+    }
+
+    freeObject(compiled ? &compiled->object : NULL);
+    freeObject(tree ? &tree->object : NULL);
+    freeProgram(program);
+    freeParser(p);
+    freeEnvironment(env);
+    return seconds;
+}
+
+// The collection benchmarks fill a single array or hash of this many
+// elements or pairs, made empty so that it grows all the way, then look up
+// as many pseudo-random ones in it. No program can push onto an array or
+// grow a hash, which are made for the length of their literal, so these
+// run on the collections themselves.
+#define COLLECTION_LEN 1000000
+
+typedef struct
+{
+    const char* name;
+    int64_t (*run)(void);
+} CollectionBenchmark;
+
+// The pseudo-random sequence of the program benchmarks
+static int64_t nextRandom(int64_t x)
+{
+    return (x * 1103515245 + 12345) % 2147483648;
+}
+
+static int64_t pushArray(void)
+{
+    Array* array = mkArray(0);
+    for (int64_t i = 0; i < COLLECTION_LEN; ++i)
+        arrayPush(array, INT_VALUE(i));
+
+    int64_t x   = 1;
+    int64_t sum = 0;
+    for (int i = 0; i < COLLECTION_LEN; ++i)
+    {
+        x = nextRandom(x);
+        sum += arrayGet(array, x % COLLECTION_LEN).as.integer;
+    }
+
+    freeObject(&array->object);
+    return sum;
+}
+
+static int64_t putHash(void)
+{
+    Hash* hash = mkHash(0);
+    for (int64_t i = 0; i < COLLECTION_LEN; ++i)
+        hashPut(hash, INT_VALUE(i), INT_VALUE(i));
+
+    int64_t x   = 1;
+    int64_t sum = 0;
+    for (int i = 0; i < COLLECTION_LEN; ++i)
+    {
+        x = nextRandom(x);
+        sum += hashGet(hash, INT_VALUE(x % COLLECTION_LEN)).as.integer;
+    }
+
+    freeObject(&hash->object);
+    return sum;
+}
+
+static const CollectionBenchmark collectionBenchmarks[] = {
+    {"array-push", pushArray},
+    {"hash-put", putHash},
+};
+
+static int isSelected(const char* name, int argc, char** argv)
+{
+    if (argc < 2)
+        return 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Print the instruction sequences the VM ran on the benchmarks, as the
+// training profile tools/superGen.c reads. Counts are per million
+// dispatches of their benchmark, so that each weighs the same.
+static void printSequences(void)
+{
+    static double pairs[BASE_OPCODE_COUNT][BASE_OPCODE_COUNT];
+    static double triples[BASE_OPCODE_COUNT][BASE_OPCODE_COUNT]
+                         [BASE_OPCODE_COUNT];
+    const BenchEngine* vm = &engines[1];
+
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+    {
+        DispatchProfile* profile = mkDispatchProfile();
+        String* output           = NULL;
+        runOnce(benchmarks[i].source, vm, profile, &output);
+
+        double scale = profile->dispatches
+                         ? 1e6 / (double)profile->dispatches
+                         : 0;
+        for (int a = 0; a < BASE_OPCODE_COUNT; ++a)
+        {
+            for (int b = 0; b < BASE_OPCODE_COUNT; ++b)
+            {
+                pairs[a][b] += (double)profile->pairs[a][b] * scale;
+                for (int c = 0; c < BASE_OPCODE_COUNT; ++c)
+                    triples[a][b][c] +=
+                        (double)profile->triples[a][b][c] * scale;
+            }
+        }
+
+        freeString(output);
+        freeDispatchProfile(profile);
+    }
+
+    printf("# sequences per million dispatches of each benchmark\n");
+    for (int a = 0; a < BASE_OPCODE_COUNT; ++a)
+    {
+        for (int b = 0; b < BASE_OPCODE_COUNT; ++b)
+        {
+            if (pairs[a][b] >= 1)
+                printf("%.0f %s %s\n", pairs[a][b], opcodeName((Opcode)a),
+                       opcodeName((Opcode)b));
+
+            for (int c = 0; c < BASE_OPCODE_COUNT; ++c)
+            {
+                if (triples[a][b][c] >= 1)
+                    printf("%.0f %s %s %s\n", triples[a][b][c],
+                           opcodeName((Opcode)a), opcodeName((Opcode)b),
+                           opcodeName((Opcode)c));
+            }
+        }
+    }
+}
+
+// Usage: monkey_bench [--profile] [benchmark...]. Prints the best of
+// REPEAT runs of each benchmark on each engine, with the dispatches of the
+// VM when built with MONKEY_PROFILE_DISPATCH, then of the collection
+// benchmarks. --profile prints the training profile instead.
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--profile") == 0)
+    {
+        printSequences();
+        return 0;
+    }
+
+    printf("dispatch: %s\n", getDispatchMode());
+
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+    {
+        if (!isSelected(benchmarks[i].name, argc, argv))
+            continue;
+
+        for (size_t j = 0; j < sizeof(engines) / sizeof(engines[0]); ++j)
+        {
+            double best    = 0;
+            String* output = NULL;
+
+            DispatchProfile* profile = NULL;
+            if (isDispatchProfiled() && engines[j].engine == ENGINE_VM)
+                profile = mkDispatchProfile();
+
+            for (int k = 0; k < REPEAT; ++k)
+            {
+                freeString(output);
+                double seconds = runOnce(benchmarks[i].source, &engines[j],
+                                         profile, &output);
+                if (k == 0 || seconds < best)
+                    best = seconds;
+            }
+
+            printf("%-12s %-10s %8.3fs  %s", benchmarks[i].name,
+                   engines[j].name, best, getStr(output));
+            if (profile)
+                printf("  (%" PRIu64 " dispatches)",
+                       profile->dispatches / REPEAT);
+            printf("\n");
+
+            freeString(output);
+            freeDispatchProfile(profile);
+        }
+    }
+
+    for (size_t i = 0;
+         i < sizeof(collectionBenchmarks) / sizeof(collectionBenchmarks[0]);
+         ++i)
+    {
+        if (!isSelected(collectionBenchmarks[i].name, argc, argv))
+            continue;
+
+        double best    = 0;
+        int64_t result = 0;
+        for (int k = 0; k < REPEAT; ++k)
+        {
+            clock_t start  = clock();
+            result         = collectionBenchmarks[i].run();
+            double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+            if (k == 0 || seconds < best)
+                best = seconds;
+        }
+
+        printf("%-12s %-10s %8.3fs  %" PRId64 "\n",
+               collectionBenchmarks[i].name, "runtime", best, result);
+    }
+
+    return 0;
+}
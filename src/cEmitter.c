@@ -0,0 +1,667 @@
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "cEmitter.h"
+#include "dynString.h"
+#include "stringBuilder.h"
+
+struct CEmitter
+{
+    StringBuilder* prototypes;
+    StringBuilder* functions; // C functions of the literals finished so far
+    size_t numFunctions;
+    size_t maxArity; // of every call, for the CodeN types
+    int numGlobals;
+};
+
+// C function being written: the program, or a function literal
+struct CFunction
+{
+    StringBuilder* sb;
+    int indent;
+    size_t numTemps;
+    size_t index; // N of fnN, for a function literal
+    int selfSlot; // of a function literal bound by `let`, or -1
+    int returned; // whether the code written last always returns
+    Parameters* parameters; // of a function literal, or NULL
+    int loops; // whether a call to itself jumps back to its entry
+};
+
+// Value of a statement that is undefined, made a temporary only if used
+#define UNDEFINED_TEMP SIZE_MAX
+
+/* Private Function Signatures */
+static void emitLine(struct CFunction*, const char*, ...);
+static size_t newTemp(struct CFunction*, const char*, ...);
+static char* formatLine(const char*, va_list);
+static size_t emitBlock(struct CEmitter*, struct CFunction*, BlockStmt*);
+static size_t emitStmt(struct CEmitter*, struct CFunction*, Stmt*);
+static size_t emitExpr(struct CEmitter*, struct CFunction*, Expr*);
+static size_t emitIdent(struct CEmitter*, struct CFunction*, IdentExpr*);
+static size_t emitInfix(struct CEmitter*, struct CFunction*, InfixExpr*);
+static size_t emitIf(struct CEmitter*, struct CFunction*, IfExpr*);
+static int emitBranch(struct CEmitter*, struct CFunction*, BlockStmt*,
+                      size_t);
+static size_t emitFunction(struct CEmitter*, struct CFunction*, Expr*);
+static size_t emitCall(struct CEmitter*, struct CFunction*, CallExpr*);
+static void emitTailCall(struct CFunction*, size_t, size_t, const size_t*,
+                         const String*);
+static size_t emitArray(struct CEmitter*, struct CFunction*, ArrayExpr*);
+static size_t emitHash(struct CEmitter*, struct CFunction*, HashExpr*);
+static size_t valueTemp(struct CFunction*, size_t);
+static void useGlobal(struct CEmitter*, int);
+static void appendCodeTypes(StringBuilder*, size_t);
+static void appendCString(StringBuilder*, const String*);
+
+// Runtime function of an infix operator, picked by its first character as
+// eval does
+static const struct
+{
+    char opt;
+    const char* function;
+} infixFunctions[] = {
+    {'+', "infixAdd"},     {'-', "infixSub"},     {'*', "infixMul"},
+    {'/', "infixDiv"},     {'<', "infixLess"},    {'>', "infixGreater"},
+    {'=', "infixEqual"},   {'!', "infixNotEqual"},
+};
+
+String* emitC(Program* pProg)
+{
+    struct CEmitter e = {mkStringBuilder(), mkStringBuilder(), 0, 0, 0};
+    struct CFunction program = {mkStringBuilder(), 1, 0, 0, -1, 0, NULL, 0};
+
+    size_t result = emitBlock(&e, &program, pProg);
+    if (!program.returned)
+        emitLine(&program, "return t%zu;", valueTemp(&program, result));
+
+    StringBuilder* sb = mkStringBuilder();
+    builderAppendStr(sb, "// Generated by `monkey --emit-c`\n"
+                         "#include \"monkeyRuntime.h\"\n\n");
+    appendCodeTypes(sb, e.maxArity);
+    if (e.numFunctions > 0)
+    {
+        builderAppendFreeString(sb, buildString(e.prototypes));
+        builderAppendChar(sb, '\n');
+    }
+    if (e.numGlobals > 0)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "static Value g[%d];\n\n",
+                 e.numGlobals);
+        builderAppendStr(sb, buffer);
+    }
+    builderAppendFreeString(sb, buildString(e.functions));
+    builderAppendStr(sb, "static Value runProgram(void)\n{\n");
+    builderAppendFreeString(sb, buildString(program.sb));
+    builderAppendStr(sb, "}\n\n"
+                         "int main(void)\n{\n"
+                         "    printValue(runProgram());\n"
+                         "    return 0;\n}\n");
+
+    String* output = buildString(sb);
+    freeStringBuilder(sb);
+    freeStringBuilder(program.sb);
+    freeStringBuilder(e.prototypes);
+    freeStringBuilder(e.functions);
+    return output;
+}
+
+static void emitLine(struct CFunction* f, const char* fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    char* line = formatLine(fmt, args);
+    va_end(args);
+
+    for (int i = 0; i < f->indent; ++i)
+        builderAppendStr(f->sb, "    ");
+    builderAppendStr(f->sb, line);
+    builderAppendChar(f->sb, '\n');
+    free(line);
+}
+
+// Declare the next temporary, initialized with the C expression in fmt
+static size_t newTemp(struct CFunction* f, const char* fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    char* value = formatLine(fmt, args);
+    va_end(args);
+
+    size_t temp = f->numTemps++;
+    emitLine(f, "Value t%zu = %s;", temp, value);
+    free(value);
+    return temp;
+}
+
+static char* formatLine(const char* fmt, va_list args)
+{
+    va_list copy;
+
+    va_copy(copy, args);
+    int len = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+
+    char* output = malloc((size_t)len + 1);
+    vsnprintf(output, (size_t)len + 1, fmt, args);
+    return output;
+}
+
+// The temporary holding the value of the last statement, which is
+// undefined for an empty block. Statements after one that always returns
+// are not written.
+static size_t emitBlock(struct CEmitter* e, struct CFunction* f,
+                        BlockStmt* pBlockStmt)
+{
+    if (pBlockStmt->len == 0)
+        return UNDEFINED_TEMP;
+
+    size_t result        = 0;
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head && !f->returned)
+    {
+        result = emitStmt(e, f, tmp->value);
+        tmp    = tmp->before;
+    }
+
+    return result;
+}
+
+static size_t emitStmt(struct CEmitter* e, struct CFunction* f, Stmt* pStmt)
+{
+    if (!pStmt->inner.checkIsNull)
+        return UNDEFINED_TEMP;
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+    {
+        LetStmt* letStmt = pStmt->inner.letStmt;
+        size_t value     = emitExpr(e, f, letStmt->value);
+
+        if (letStmt->name->kind == RESOLVE_GLOBAL)
+        {
+            useGlobal(e, letStmt->name->slot);
+            emitLine(f, "g[%d] = t%zu;", letStmt->name->slot, value);
+        }
+        else
+        {
+            emitLine(f, "l[%d] = t%zu;", letStmt->name->slot, value);
+        }
+
+        return UNDEFINED_TEMP;
+    }
+
+    case STMT_RETURN:
+    {
+        size_t value = emitExpr(e, f, pStmt->inner.returnStmt->returnValue);
+        if (!f->returned)
+            emitLine(f, "return orNull(t%zu);", value);
+        f->returned = 1;
+        return value;
+    }
+
+    case STMT_EXPRESSION:
+        return emitExpr(e, f, pStmt->inner.exprStmt->expression);
+
+    case STMT_BLOCK:
+        return emitBlock(e, f, pStmt->inner.blockStmt);
+
+    default:
+        return UNDEFINED_TEMP;
+    }
+}
+
+static size_t emitExpr(struct CEmitter* e, struct CFunction* f, Expr* pExpr)
+{
+    if (!pExpr || !pExpr->inner.checkIsNull)
+        return newTemp(f, "NULL_VALUE");
+
+    switch (pExpr->type)
+    {
+    case EXPR_IDENT:
+        return emitIdent(e, f, pExpr->inner.identExpr);
+
+    case EXPR_INTEGER:
+    {
+        // The literal of INT64_MIN would be a negated unsigned constant
+        int64_t value = pExpr->inner.intExpr->value;
+        if (value == INT64_MIN)
+            return newTemp(f, "INT_VALUE(INT64_MIN)");
+        return newTemp(f, "INT_VALUE(INT64_C(%" PRId64 "))", value);
+    }
+
+    case EXPR_BOOL:
+        return newTemp(f, "BOOL_VALUE(%d)", pExpr->inner.boolExpr->value);
+
+    case EXPR_STRING:
+    {
+        String* value     = pExpr->inner.stringExpr->value;
+        StringBuilder* sb = mkStringBuilder();
+        appendCString(sb, value);
+        String* literal = buildString(sb);
+        freeStringBuilder(sb);
+
+        size_t output = newTemp(f, "mkString(%s, %zu)", getStr(literal),
+                                getLen(value));
+        freeString(literal);
+        return output;
+    }
+
+    case EXPR_PREFIX:
+    {
+        PrefixExpr* prefixExpr = pExpr->inner.prefixExpr;
+        const char* opt        = getStr(prefixExpr->opt);
+        size_t right           = emitExpr(e, f, prefixExpr->right);
+
+        if (opt[0] == '!')
+            return newTemp(f, "prefixNot(t%zu)", right);
+        if (opt[0] == '-')
+            return newTemp(f, "prefixNegate(t%zu)", right);
+        return newTemp(f, "unknownPrefix(\"%s\", t%zu)", opt, right);
+    }
+
+    case EXPR_INFIX:
+        return emitInfix(e, f, pExpr->inner.infixExpr);
+
+    case EXPR_IF:
+        return emitIf(e, f, pExpr->inner.ifExpr);
+
+    case EXPR_FUNCTION:
+        return emitFunction(e, f, pExpr);
+
+    case EXPR_CALL:
+        return emitCall(e, f, pExpr->inner.callExpr);
+
+    case EXPR_ARRAY:
+        return emitArray(e, f, pExpr->inner.arrayExpr);
+
+    case EXPR_HASH:
+        return emitHash(e, f, pExpr->inner.hashExpr);
+
+    case EXPR_INDEX:
+    {
+        size_t left  = emitExpr(e, f, pExpr->inner.indexExpr->left);
+        size_t index = emitExpr(e, f, pExpr->inner.indexExpr->index);
+        return newTemp(f, "indexValue(t%zu, t%zu)", left, index);
+    }
+
+    default:
+        return newTemp(f, "NULL_VALUE");
+    }
+}
+
+static size_t emitIdent(struct CEmitter* e, struct CFunction* f,
+                        IdentExpr* pIdentExpr)
+{
+    const char* name = getStr(pIdentExpr->value);
+    int slot         = pIdentExpr->slot;
+
+    switch (pIdentExpr->kind)
+    {
+    case RESOLVE_GLOBAL:
+        useGlobal(e, slot);
+        return newTemp(f, "loadGlobal(g[%d], \"%s\")", slot, name);
+
+    case RESOLVE_LOCAL:
+        return newTemp(f, "l[%d]", slot);
+
+    case RESOLVE_CAPTURE:
+        return newTemp(f, "self->captures[%d]", slot);
+
+    default:
+        return newTemp(f, "unbound(\"%s\")", name);
+    }
+}
+
+static size_t emitInfix(struct CEmitter* e, struct CFunction* f,
+                        InfixExpr* pInfixExpr)
+{
+    const char* opt = getStr(pInfixExpr->opt);
+    size_t left     = emitExpr(e, f, pInfixExpr->left);
+    size_t right    = emitExpr(e, f, pInfixExpr->right);
+
+    size_t n = sizeof(infixFunctions) / sizeof(infixFunctions[0]);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (infixFunctions[i].opt == opt[0])
+            return newTemp(f, "%s(t%zu, t%zu)", infixFunctions[i].function,
+                           left, right);
+    }
+
+    return newTemp(f, "unknownInfix(\"%s\", t%zu, t%zu)", opt, left, right);
+}
+
+// The if always returns when both of its branches do, and then has no
+// value to declare
+static size_t emitIf(struct CEmitter* e, struct CFunction* f,
+                     IfExpr* pIfExpr)
+{
+    size_t condition = emitExpr(e, f, pIfExpr->condition);
+    size_t result    = f->numTemps++;
+    int returned     = f->returned;
+
+    StringBuilder* outer = f->sb;
+    f->sb                = mkStringBuilder();
+    emitLine(f, "if (isTruthy(t%zu))", condition);
+    int consequence = emitBranch(e, f, pIfExpr->consequence, result);
+    emitLine(f, "else");
+    int alternative = emitBranch(e, f, pIfExpr->alternative, result);
+    StringBuilder* branches = f->sb;
+    f->sb                   = outer;
+
+    if (!consequence || !alternative)
+        emitLine(f, "Value t%zu;", result);
+    builderAppendFreeString(f->sb, buildString(branches));
+    freeStringBuilder(branches);
+
+    f->returned = returned || (consequence && alternative);
+    if (!consequence || !alternative)
+        emitLine(f, "t%zu = orNull(t%zu);", result, result);
+
+    return result;
+}
+
+// Write a branch of an if storing its value in result, unless it returns.
+// Returns whether it does.
+static int emitBranch(struct CEmitter* e, struct CFunction* f,
+                      BlockStmt* pBlockStmt, size_t result)
+{
+    emitLine(f, "{");
+    ++f->indent;
+    f->returned = 0;
+    if (pBlockStmt)
+    {
+        size_t value = emitBlock(e, f, pBlockStmt);
+        if (!f->returned)
+            emitLine(f, "t%zu = t%zu;", result, valueTemp(f, value));
+    }
+    else
+    {
+        emitLine(f, "t%zu = NULL_VALUE;", result);
+    }
+    --f->indent;
+    emitLine(f, "}");
+
+    return f->returned;
+}
+
+// Write the C function of the literal, then create its closure in f
+static size_t emitFunction(struct CEmitter* e, struct CFunction* f,
+                           Expr* pExpr)
+{
+    FntExpr* fntExpr = pExpr->inner.fntExpr;
+    size_t index     = e->numFunctions++;
+
+    StringBuilder* header = mkStringBuilder();
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "static Value fn%zu(Closure* self",
+             index);
+    builderAppendStr(header, buffer);
+    for (size_t i = 0; i < fntExpr->parameters->len; ++i)
+    {
+        snprintf(buffer, sizeof(buffer), ", Value p%zu", i);
+        builderAppendStr(header, buffer);
+    }
+    builderAppendChar(header, ')');
+    String* signature = buildString(header);
+    freeStringBuilder(header);
+
+    builderAppendString(e->prototypes, signature);
+    builderAppendStr(e->prototypes, ";\n");
+
+    struct CFunction body = {mkStringBuilder(), 1, 0, index,
+                             fntExpr->selfSlot, 0, fntExpr->parameters, 0};
+    if (fntExpr->numLocals > 0)
+        emitLine(&body, "Value l[%d] = {UNDEFINED_VALUE};",
+                 fntExpr->numLocals);
+    if (fntExpr->numCaptures == 0 && fntExpr->selfSlot < 0)
+        emitLine(&body, "(void)self;");
+
+    size_t i                = 0;
+    struct ParamNode* param = fntExpr->parameters->tail->before;
+    while (param != fntExpr->parameters->head)
+    {
+        emitLine(&body, "l[%d] = p%zu;", param->value->slot, i++);
+        param = param->before;
+    }
+    if (fntExpr->selfSlot >= 0)
+        emitLine(&body, "l[%d] = CLOSURE_VALUE(self);", fntExpr->selfSlot);
+
+    // The entry is only labelled once the body is known to jump to it
+    StringBuilder* prologue = body.sb;
+    body.sb                 = mkStringBuilder();
+    size_t result           = emitBlock(e, &body, fntExpr->body);
+    if (!body.returned)
+        emitLine(&body, "return orNull(t%zu);", valueTemp(&body, result));
+    if (body.loops)
+        builderAppendStr(prologue, "entry:;\n");
+
+    builderAppendString(e->functions, signature);
+    builderAppendStr(e->functions, "\n{\n");
+    builderAppendFreeString(e->functions, buildString(prologue));
+    builderAppendFreeString(e->functions, buildString(body.sb));
+    builderAppendStr(e->functions, "}\n\n");
+    freeStringBuilder(prologue);
+    freeStringBuilder(body.sb);
+    freeString(signature);
+
+    // The source is printed as the value of the closure
+    StringBuilder* source = mkStringBuilder();
+    String* text          = stringifyFntExpr(fntExpr);
+    appendCString(source, text);
+    freeString(text);
+    text = buildString(source);
+    freeStringBuilder(source);
+
+    size_t closure = f->numTemps++;
+    emitLine(f, "Value t%zu = mkClosure((Code)fn%zu, %zu, %d, %s);", closure,
+             index, fntExpr->parameters->len, fntExpr->numCaptures,
+             getStr(text));
+    freeString(text);
+
+    Capture* capture = fntExpr->captures;
+    for (int j = 0; j < fntExpr->numCaptures; ++j)
+    {
+        if (capture[j].source == CAPTURE_LOCAL)
+            emitLine(f, "t%zu.as.closure->captures[%d] = l[%d];", closure, j,
+                     capture[j].index);
+        else
+            emitLine(f, "t%zu.as.closure->captures[%d] = self->captures[%d];",
+                     closure, j, capture[j].index);
+    }
+
+    return closure;
+}
+
+// The callee and its arity are checked before the arguments are run.
+// Arguments are passed as C parameters, through a pointer cast to the
+// CodeN type of their number, or directly when a function calls itself.
+static size_t emitCall(struct CEmitter* e, struct CFunction* f,
+                       CallExpr* pCallExpr)
+{
+    Arguments* arguments = pCallExpr->arguments;
+    Expr* function       = pCallExpr->function;
+    size_t callee        = emitExpr(e, f, function);
+
+    emitLine(f, "checkCall(t%zu, %zu);", callee, arguments->len);
+    if (arguments->len > e->maxArity)
+        e->maxArity = arguments->len;
+
+    size_t* temps       = malloc(sizeof(size_t) * (arguments->len + 1));
+    size_t argc         = 0;
+    StringBuilder* list = mkStringBuilder();
+    struct ArgNode* arg = arguments->tail->before;
+    char buffer[32];
+    while (arg != arguments->head)
+    {
+        temps[argc] = emitExpr(e, f, arg->value);
+        snprintf(buffer, sizeof(buffer), ", t%zu", temps[argc++]);
+        builderAppendStr(list, buffer);
+        arg = arg->before;
+    }
+    String* values = buildString(list);
+    freeStringBuilder(list);
+
+    if (pCallExpr->tail && f->parameters)
+    {
+        emitTailCall(f, callee, argc, temps, values);
+        free(temps);
+        freeString(values);
+        return UNDEFINED_TEMP;
+    }
+    free(temps);
+
+    size_t result = f->numTemps++;
+    int isSelf    = f->selfSlot >= 0 && function
+                 && function->type == EXPR_IDENT
+                 && function->inner.identExpr->kind == RESOLVE_LOCAL
+                 && function->inner.identExpr->slot == f->selfSlot;
+    if (isSelf)
+        emitLine(f,
+                 "Value t%zu = t%zu.as.closure == self ? fn%zu(self%s) "
+                 ": ((Code%zu)t%zu.as.closure->code)(t%zu.as.closure%s);",
+                 result, callee, f->index, getStr(values), arguments->len,
+                 callee, callee, getStr(values));
+    else
+        emitLine(f,
+                 "Value t%zu = ((Code%zu)t%zu.as.closure->code)"
+                 "(t%zu.as.closure%s);",
+                 result, arguments->len, callee, callee, getStr(values));
+    freeString(values);
+
+    return result;
+}
+
+// A call in tail position returns the callee's value as it is, which is
+// never undefined, so that the C compiler can make it a jump. A call of
+// the function to itself, which its arity check leaves with as many
+// arguments as parameters, stores them in their slots and jumps back to
+// the entry instead.
+static void emitTailCall(struct CFunction* f, size_t callee, size_t argc,
+                         const size_t* temps, const String* values)
+{
+    if (argc == f->parameters->len)
+    {
+        emitLine(f, "if (t%zu.as.closure == self)", callee);
+        emitLine(f, "{");
+        ++f->indent;
+        size_t i                = 0;
+        struct ParamNode* param = f->parameters->tail->before;
+        while (param != f->parameters->head)
+        {
+            emitLine(f, "l[%d] = t%zu;", param->value->slot, temps[i++]);
+            param = param->before;
+        }
+        emitLine(f, "goto entry;");
+        --f->indent;
+        emitLine(f, "}");
+        f->loops = 1;
+    }
+    emitLine(f, "return ((Code%zu)t%zu.as.closure->code)(t%zu.as.closure%s);",
+             argc, callee, callee, getStr(values));
+    f->returned = 1;
+}
+
+// A temporary for the value of a statement, which is UNDEFINED_TEMP after
+// a `let`
+static size_t emitArray(struct CEmitter* e, struct CFunction* f,
+                        ArrayExpr* pArrayExpr)
+{
+    size_t array = newTemp(f, "mkArray(%zu)", pArrayExpr->elements->len);
+
+    struct ArgNode* tmp = pArrayExpr->elements->tail->before;
+    while (tmp != pArrayExpr->elements->head)
+    {
+        emitLine(f, "arrayPush(t%zu, t%zu);", array,
+                 emitExpr(e, f, tmp->value));
+        tmp = tmp->before;
+    }
+
+    return array;
+}
+
+// Each key is checked before its value is run, as eval does
+static size_t emitHash(struct CEmitter* e, struct CFunction* f,
+                       HashExpr* pHashExpr)
+{
+    size_t hash = newTemp(f, "mkHash(%zu)", pHashExpr->pairs->len / 2);
+
+    struct ArgNode* tmp = pHashExpr->pairs->tail->before;
+    while (tmp != pHashExpr->pairs->head)
+    {
+        size_t key = emitExpr(e, f, tmp->value);
+        emitLine(f, "checkHashKey(t%zu);", key);
+        tmp = tmp->before;
+
+        emitLine(f, "hashPut(t%zu, t%zu, t%zu);", hash, key,
+                 emitExpr(e, f, tmp->value));
+        tmp = tmp->before;
+    }
+
+    return hash;
+}
+
+static size_t valueTemp(struct CFunction* f, size_t temp)
+{
+    if (temp == UNDEFINED_TEMP)
+        return newTemp(f, "UNDEFINED_VALUE");
+    return temp;
+}
+
+static void useGlobal(struct CEmitter* e, int slot)
+{
+    if (slot >= e->numGlobals)
+        e->numGlobals = slot + 1;
+}
+
+// Function pointer types of the bodies taking up to maxArity arguments
+static void appendCodeTypes(StringBuilder* sb, size_t maxArity)
+{
+    char buffer[64];
+
+    for (size_t i = 0; i <= maxArity; ++i)
+    {
+        snprintf(buffer, sizeof(buffer), "typedef Value (*Code%zu)(Closure*",
+                 i);
+        builderAppendStr(sb, buffer);
+        for (size_t j = 0; j < i; ++j)
+            builderAppendStr(sb, ", Value");
+        builderAppendStr(sb, ");\n");
+    }
+    builderAppendChar(sb, '\n');
+}
+
+// Quote text as a C string literal
+static void appendCString(StringBuilder* sb, const String* text)
+{
+    const char* str = getStr(text);
+    char buffer[8];
+
+    builderAppendChar(sb, '"');
+    for (size_t i = 0; i < getLen(text); ++i)
+    {
+        unsigned char c = (unsigned char)str[i];
+        if (c == '"' || c == '\\')
+        {
+            builderAppendChar(sb, '\\');
+            builderAppendChar(sb, (char)c);
+        }
+        else if (c < 0x20 || c >= 0x7f)
+        {
+            snprintf(buffer, sizeof(buffer), "\\%03o", c);
+            builderAppendStr(sb, buffer);
+        }
+        else
+        {
+            builderAppendChar(sb, (char)c);
+        }
+    }
+    builderAppendChar(sb, '"');
+}
@@ -0,0 +1,20 @@
+#ifndef _MONKEY_LANG_SRC_CEMITTER_H_
+#define _MONKEY_LANG_SRC_CEMITTER_H_
+
+#include "ast.h"
+#include "dynString.h"
+
+// Translate a program that went through resolveProgram and analyzeCaptures
+// into a standalone C program, built against runtime/monkeyRuntime.h:
+//
+//   monkey --emit-c prog.mk > prog.c
+//   cc -O2 -Iruntime prog.c -o prog
+//
+// Each function literal becomes a C function taking its closure and its
+// arguments, with its frame slots in a local array; globals are a static
+// array. Every expression is computed into a temporary of its own, in the
+// order eval runs it, and `return` is a C return. The program prints what
+// `monkey prog.mk` prints, and ends with the same message on an error.
+String* emitC(Program*);
+
+#endif //_MONKEY_LANG_SRC_CEMITTER_H_
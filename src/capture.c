@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "capture.h"
+#include "dynString.h"
+#include "stringBuilder.h"
+#include "walker.h"
+
+struct CaptureState
+{
+    FntExpr** functions; // functions[1] is the outermost function literal
+    int depth;
+    int capacity;
+    size_t added;
+    StringBuilder* out; // used by dumpCaptures only
+};
+
+/* Private Function Signatures */
+static void pushFunction(struct CaptureState*, FntExpr*);
+static int captureIndex(struct CaptureState*, int, int, int, const String*);
+static WalkResult analyzePre(AstNode, void*);
+static WalkResult dumpPre(AstNode, void*);
+static WalkResult capturePost(AstNode, void*);
+
+size_t analyzeCaptures(Program* pProg)
+{
+    static const Visitor visitor = {analyzePre, NULL, capturePost};
+
+    if (!pProg)
+        return 0;
+
+    struct CaptureState state = {NULL, 0, 0, 0, NULL};
+    walkProgram(pProg, &visitor, &state);
+    free(state.functions);
+
+    return state.added;
+}
+
+String* dumpCaptures(Program* pProg)
+{
+    static const Visitor visitor = {dumpPre, NULL, capturePost};
+
+    struct CaptureState state = {NULL, 0, 0, 0, mkStringBuilder()};
+    if (pProg)
+        walkProgram(pProg, &visitor, &state);
+    free(state.functions);
+
+    String* output = buildString(state.out);
+    freeStringBuilder(state.out);
+    return output;
+}
+
+static WalkResult analyzePre(AstNode node, void* ctx)
+{
+    struct CaptureState* state = ctx;
+
+    if (node.kind != NODE_EXPR || !node.as.expr->inner.checkIsNull)
+        return WALK_CONTINUE;
+
+    if (node.as.expr->type == EXPR_FUNCTION)
+    {
+        pushFunction(state, node.as.expr->inner.fntExpr);
+    }
+    else if (node.as.expr->type == EXPR_IDENT)
+    {
+        IdentExpr* ident = node.as.expr->inner.identExpr;
+        if (ident->kind != RESOLVE_FREE || ident->depth > state->depth - 1)
+            return WALK_CONTINUE;
+
+        ident->slot = captureIndex(state, state->depth, ident->depth,
+                                   ident->slot, ident->value);
+        ident->kind = RESOLVE_CAPTURE;
+    }
+
+    return WALK_CONTINUE;
+}
+
+static WalkResult capturePost(AstNode node, void* ctx)
+{
+    struct CaptureState* state = ctx;
+
+    if (node.kind == NODE_EXPR && node.as.expr->inner.checkIsNull
+        && node.as.expr->type == EXPR_FUNCTION)
+        --state->depth;
+
+    return WALK_CONTINUE;
+}
+
+// Index of the capture through which functions[level] reaches slot of the
+// function `depth` levels out, adding it and the captures it relies on in
+// the functions in between when they are missing.
+static int captureIndex(struct CaptureState* state, int level, int depth,
+                        int slot, const String* name)
+{
+    FntExpr* fn = state->functions[level];
+
+    CaptureSource source = CAPTURE_LOCAL;
+    int index            = slot;
+    if (depth > 1)
+    {
+        source = CAPTURE_OUTER;
+        index  = captureIndex(state, level - 1, depth - 1, slot, name);
+    }
+
+    for (int i = 0; i < fn->numCaptures; ++i)
+    {
+        if (fn->captures[i].source == source && fn->captures[i].index == index)
+            return i;
+    }
+
+    fn->captures = realloc(fn->captures,
+                           sizeof(Capture) * (size_t)(fn->numCaptures + 1));
+    fn->captures[fn->numCaptures].name   = mkString(getStr(name));
+    fn->captures[fn->numCaptures].source = source;
+    fn->captures[fn->numCaptures].index  = index;
+    ++state->added;
+
+    return fn->numCaptures++;
+}
+
+static void pushFunction(struct CaptureState* state, FntExpr* pFntExpr)
+{
+    if (state->depth + 1 >= state->capacity)
+    {
+        state->capacity  = state->capacity ? state->capacity << 1 : 8;
+        state->functions = realloc(state->functions,
+                                   sizeof(FntExpr*) * (size_t)state->capacity);
+    }
+
+    state->functions[++state->depth] = pFntExpr;
+}
+
+static WalkResult dumpPre(AstNode node, void* ctx)
+{
+    struct CaptureState* state = ctx;
+
+    if (node.kind != NODE_EXPR || !node.as.expr->inner.checkIsNull
+        || node.as.expr->type != EXPR_FUNCTION)
+        return WALK_CONTINUE;
+
+    FntExpr* fn = node.as.expr->inner.fntExpr;
+    pushFunction(state, fn);
+
+    for (int i = 1; i < state->depth; ++i)
+        builderAppendStr(state->out, "  ");
+
+    builderAppendStr(state->out, "fn(");
+    struct ParamNode* tmp = fn->parameters->tail->before;
+    while (tmp != fn->parameters->head)
+    {
+        builderAppendString(state->out, tmp->value->value);
+        if (tmp->before != fn->parameters->head)
+            builderAppendStr(state->out, ", ");
+        tmp = tmp->before;
+    }
+    builderAppendStr(state->out, "):");
+
+    if (fn->numCaptures == 0)
+        builderAppendStr(state->out, " none");
+
+    for (int i = 0; i < fn->numCaptures; ++i)
+    {
+        char index[32];
+        snprintf(index, sizeof(index), "[%d]", fn->captures[i].index);
+
+        builderAppendChar(state->out, ' ');
+        builderAppendString(state->out, fn->captures[i].name);
+        builderAppendStr(state->out, fn->captures[i].source == CAPTURE_LOCAL
+                                         ? "=local"
+                                         : "=outer");
+        builderAppendStr(state->out, index);
+    }
+    builderAppendChar(state->out, '\n');
+
+    return WALK_CONTINUE;
+}
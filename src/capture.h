@@ -0,0 +1,27 @@
+#ifndef _MONKEY_LANG_SRC_CAPTURE_H_
+#define _MONKEY_LANG_SRC_CAPTURE_H_
+
+#include <stddef.h>
+
+#include "ast.h"
+
+// Record on every function literal the variables of enclosing functions
+// its body uses, so that a closure copies just those values when it is
+// created and never refers to the frames it was created in. Every frame
+// can then live on a stack, whether or not a closure was made from it.
+//
+// A variable used in a nested function is also captured by each function
+// in between, so that each closure only copies from its creator. Uses
+// marked RESOLVE_FREE by resolveProgram become RESOLVE_CAPTURE, with slot
+// the index into the captures of the enclosing function literal.
+//
+// Run it after resolveProgram and before hashConsProgram. Returns the
+// number of captures added.
+size_t analyzeCaptures(Program*);
+
+// One line per function literal, in source order and indented by nesting
+// depth, listing its parameters and what it captures, for example
+//   fn(x): y=local[1] z=outer[0]
+String* dumpCaptures(Program*);
+
+#endif //_MONKEY_LANG_SRC_CAPTURE_H_
@@ -0,0 +1,178 @@
+#define MAIN_TEST_NAME TestCapture
+
+#include "capture.h"
+#include "parser.h"
+#include "purity.h"
+#include "resolver.h"
+#include "testing.h"
+#include "walker.h"
+
+/* Function Signatures */
+Program* parseForCapture(const char*);
+WalkResult dumpPurity(AstNode, void*);
+
+Program* parseForCapture(const char* input)
+{
+    Resolver* r      = mkResolver();
+    Program* program = parseForTest(input, r);
+    freeResolver(r);
+    return program;
+}
+
+// Function literals in source order, as P when pure and I otherwise
+WalkResult dumpPurity(AstNode node, void* ctx)
+{
+    if (node.kind == NODE_EXPR && node.as.expr->type == EXPR_FUNCTION)
+        appendStr(ctx, node.as.expr->inner.fntExpr->pure ? "P" : "I");
+    return WALK_CONTINUE;
+}
+
+TEST(AnalyzeCaptures)
+{
+    int testStatus = TEST_SUCESSED;
+    struct
+    {
+        const char* input;
+        const char* expected;
+        size_t expectedAdded;
+    } tests[] = {
+        {"let a = 1; fn(x) { x + a }", "fn(x): none\n", 0},
+        {"fn(a) { fn() { a + a } }", "fn(a): none\n  fn(): a=local[0]\n", 1},
+        {"let a = 1; "
+         "let f = fn(x) { let y = 2; fn(z) { fn() { x + y + z + a } } };",
+         "fn(x): none\n"
+         "  fn(z): x=local[1] y=local[2]\n"
+         "    fn(): x=outer[0] y=outer[1] z=local[0]\n",
+         5},
+        {"let f = fn(n) { fn() { f(n) } };",
+         "fn(n): none\n  fn(): f=local[0] n=local[1]\n", 2},
+        {"fn(a, b) { let f = fn() { b }; let g = fn() { a }; f() + g() }",
+         "fn(a, b): none\n  fn(): b=local[1]\n  fn(): a=local[0]\n", 2},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        Program* program = parseForCapture(tests[i].input);
+        if (!program)
+            return TEST_FAILED;
+
+        size_t added = analyzeCaptures(program);
+        String* got = dumpCaptures(program);
+
+        if (cmpStringStr(got, tests[i].expected) != 0)
+        {
+            PRINT_ERR("`%s`: expected `%s`, got = `%s`", tests[i].input,
+                      tests[i].expected, getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        if (added != tests[i].expectedAdded)
+        {
+            PRINT_ERR("`%s`: expected %zu captures, got = %zu", tests[i].input,
+                      tests[i].expectedAdded, added);
+            testStatus = TEST_FAILED;
+        }
+        if (analyzeCaptures(program) != 0)
+        {
+            PRINT_ERR("`%s`: second analysis added captures", tests[i].input);
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeProgram(program);
+    }
+
+    return testStatus;
+}
+
+TEST(RewriteFreeUses)
+{
+    int testStatus = TEST_SUCESSED;
+    Program* program = parseForCapture("fn(a, b) { fn() { b + a } }");
+    if (!program)
+        return TEST_FAILED;
+
+    analyzeCaptures(program);
+
+    // program -> fn(a, b) -> body -> fn() -> body -> b + a
+    FntExpr* outer = program->tail->before->value->inner.exprStmt->expression
+                         ->inner.fntExpr;
+    FntExpr* inner = outer->body->tail->before->value->inner.exprStmt
+                         ->expression->inner.fntExpr;
+    InfixExpr* sum = inner->body->tail->before->value->inner.exprStmt
+                         ->expression->inner.infixExpr;
+
+    IdentExpr* b = sum->left->inner.identExpr;
+    IdentExpr* a = sum->right->inner.identExpr;
+    if (b->kind != RESOLVE_CAPTURE || b->slot != 0
+        || a->kind != RESOLVE_CAPTURE || a->slot != 1)
+    {
+        PRINT_ERR("expected captures 0 and 1, got = %d:%d and %d:%d",
+                  b->kind, b->slot, a->kind, a->slot);
+        testStatus = TEST_FAILED;
+    }
+
+    freeProgram(program);
+    return testStatus;
+}
+
+TEST(AnalyzePurity)
+{
+    int testStatus = TEST_SUCESSED;
+    struct
+    {
+        const char* input;
+        const char* expected;
+    } tests[] = {
+        {"let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) };",
+         "P"},
+        {"let even = fn(n) { if (n == 0) { true } else { odd(n - 1) } };"
+         "let odd = fn(n) { if (n == 0) { false } else { even(n - 1) } };",
+         "PP"},
+        {"let sq = fn(x) { x * x }; let f = fn(x) { let y = sq(x); -y / 2 };",
+         "PP"},
+        {"let a = 1; let f = fn(x) { x + a };", "I"},
+        {"let f = fn(x) { g(x) }; let g = fn(x) { x }; let g = 2;", "IP"},
+        {"let f = fn(x) { h(x) }; let h = 3; let g = fn(x) { f(x) };", "II"},
+        {"let apply = fn(f, x) { f(x) };", "I"},
+        {"fn(a) { fn(b) { a + b } }", "II"},
+        {"let mk = fn() { fn(x) { x } };", "IP"},
+        {"let f = fn(x) { fn(y) { y }(x) };", "IP"},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        Program* program = parseForCapture(tests[i].input);
+        if (!program)
+            return TEST_FAILED;
+
+        Visitor visitor = {dumpPurity, NULL, NULL};
+        String* got     = mkString("");
+        analyzeCaptures(program);
+        size_t pure = analyzePurity(program);
+        walkProgram(program, &visitor, got);
+
+        size_t expectedPure = 0;
+        for (const char* c = tests[i].expected; *c; ++c)
+            expectedPure += *c == 'P';
+        if (cmpStringStr(got, tests[i].expected) != 0 || pure != expectedPure)
+        {
+            PRINT_ERR("`%s`: expected `%s`, got = `%s` (%zu pure)",
+                      tests[i].input, tests[i].expected, getStr(got), pure);
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeProgram(program);
+    }
+
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(AnalyzeCaptures);
+        RUN_TEST(RewriteFreeUses);
+        RUN_TEST(AnalyzePurity);
+    })
+
+#undef MAIN_TEST_NAME // End TestCapture
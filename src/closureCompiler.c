@@ -0,0 +1,1081 @@
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "ast.h"
+#include "closureCompiler.h"
+#include "collection.h"
+#include "environment.h"
+#include "memo.h"
+#include "object.h"
+#include "stringBuilder.h"
+
+// Calls nest on the C stack, each taking a few hundred bytes of it;
+// deeper ones fail with a stack overflow
+#define MAX_CALL_DEPTH 10000
+
+typedef enum
+{
+    RUN_OK = 0,
+    RUN_RETURN,    // a `return` is unwinding to the enclosing call
+    RUN_TAIL_CALL, // a call took over the frame, and is left to run
+    RUN_ERROR,
+} RunStatus;
+
+struct Runner
+{
+    Environment* env;
+    size_t base;        // frame of the function being run
+    size_t closureRoot; // root of the function being run, see pushRoot
+    RunStatus status;
+};
+
+typedef Value (*Handler)(const Node*, struct Runner*);
+
+// A compiled expression or statement: the handler that runs it, and the
+// fields that handler reads
+struct Node
+{
+    Handler run;
+    Node* left;         // operand, condition, callee or value of a `let`
+    Node* right;        // right operand or consequence
+    Node* alternative;  // of an if with an else
+    Node** children;    // statements of a block or arguments of a call
+    size_t numChildren;
+    Value constant;     // literal, or integer literal right operand
+    size_t slot;        // global, local or capture read or written
+    const char* opt;    // operator, for error messages
+    const String* name; // identifier, for error messages, or string literal
+    NodeTree* tree;     // of a function literal
+};
+
+/* Private Function Signatures */
+static Node* mkNode(Handler);
+static Node* mkConstantNode(Value);
+static NodeTree* compileFunctionTree(Environment*, Expr*);
+static Node* compileBlock(Environment*, BlockStmt*);
+static Node* compileStmt(Environment*, Stmt*);
+static Node* compileExpr(Environment*, Expr*);
+static Node* compileIdent(IdentExpr*);
+static Node* compilePrefix(Environment*, PrefixExpr*);
+static Node* compileInfix(Environment*, InfixExpr*);
+static Node* compileIf(Environment*, IfExpr*);
+static Node* compileCall(Environment*, CallExpr*);
+static void compileChildren(Environment*, Node*, Arguments*);
+static Value runConstant(const Node*, struct Runner*);
+static Value runString(const Node*, struct Runner*);
+static Value runGlobal(const Node*, struct Runner*);
+static Value runLocal(const Node*, struct Runner*);
+static Value runCapture(const Node*, struct Runner*);
+static Value runUnbound(const Node*, struct Runner*);
+static Value runNot(const Node*, struct Runner*);
+static Value runNegate(const Node*, struct Runner*);
+static Value runUnknownPrefix(const Node*, struct Runner*);
+static Value runUnknownInfix(const Node*, struct Runner*);
+static Value runIf(const Node*, struct Runner*);
+static Value runIfElse(const Node*, struct Runner*);
+static Value runFunction(const Node*, struct Runner*);
+static inline Value enterCall(const Node*, struct Runner*, size_t*);
+static Value runCall(const Node*, struct Runner*);
+static Value runTailCall(const Node*, struct Runner*);
+static int memoKeyOf(Environment*, size_t, MemoKey*);
+static Value runArray(const Node*, struct Runner*);
+static Value runHash(const Node*, struct Runner*);
+static Value runIndex(const Node*, struct Runner*);
+static Value runLetGlobal(const Node*, struct Runner*);
+static Value runLetLocal(const Node*, struct Runner*);
+static Value runReturn(const Node*, struct Runner*);
+static Value runBlock(const Node*, struct Runner*);
+static Value infixFallback(const Node*, struct Runner*, Value, Value);
+static Value divide(struct Runner*, int64_t, int64_t);
+static Value runtimeError(struct Runner*, const char*, ...);
+static void dumpNode(StringBuilder*, const Node*, int);
+
+#define CURRENT_CLOSURE(r) ((Closure*)(r)->env->roots[(r)->closureRoot])
+
+// Handlers of an infix operator, by its operands: any two expressions, an
+// expression and an integer literal, or a local and an integer literal.
+// Integers take the path in result, written in terms of left and right;
+// anything else is left to infixFallback.
+#define INFIX_HANDLERS(name, result)                                         \
+    static Value name(const Node* n, struct Runner* r)                       \
+    {                                                                        \
+        Value left = n->left->run(n->left, r);                               \
+        if (r->status != RUN_OK)                                             \
+            return left;                                                     \
+        size_t leftRoot = pushRoot(                                          \
+            r->env, IS_OBJECT_VALUE(left) ? left.as.object : NULL);          \
+        Value right = n->right->run(n->right, r);                            \
+        if (IS_OBJECT_VALUE(left))                                           \
+            left.as.object = r->env->roots[leftRoot];                        \
+        popRoot(r->env);                                                     \
+        if (r->status != RUN_OK)                                             \
+            return right;                                                    \
+        if (left.type == VALUE_INT && right.type == VALUE_INT)               \
+            return result;                                                   \
+        return infixFallback(n, r, left, right);                             \
+    }                                                                        \
+                                                                             \
+    static Value name##Constant(const Node* n, struct Runner* r)             \
+    {                                                                        \
+        Value left = n->left->run(n->left, r);                               \
+        if (r->status != RUN_OK)                                             \
+            return left;                                                     \
+        Value right = n->constant;                                           \
+        if (left.type == VALUE_INT)                                          \
+            return result;                                                   \
+        return infixFallback(n, r, left, right);                             \
+    }                                                                        \
+                                                                             \
+    static Value name##LocalConstant(const Node* n, struct Runner* r)        \
+    {                                                                        \
+        Value left  = r->env->stack[r->base + n->slot];                      \
+        Value right = n->constant;                                           \
+        if (left.type == VALUE_INT)                                          \
+            return result;                                                   \
+        return infixFallback(n, r, left, right);                             \
+    }
+
+// Arithmetic wraps around on overflow
+#define INT_ARITHMETIC(op)                                                   \
+    INT_VALUE((int64_t)((uint64_t)left.as.integer op(uint64_t)               \
+                            right.as.integer))
+
+INFIX_HANDLERS(runAdd, INT_ARITHMETIC(+))
+INFIX_HANDLERS(runSub, INT_ARITHMETIC(-))
+INFIX_HANDLERS(runMul, INT_ARITHMETIC(*))
+INFIX_HANDLERS(runDiv, divide(r, left.as.integer, right.as.integer))
+INFIX_HANDLERS(runLess, BOOL_VALUE(left.as.integer < right.as.integer))
+INFIX_HANDLERS(runGreater, BOOL_VALUE(left.as.integer > right.as.integer))
+INFIX_HANDLERS(runEqual, BOOL_VALUE(left.as.integer == right.as.integer))
+INFIX_HANDLERS(runNotEqual, BOOL_VALUE(left.as.integer != right.as.integer))
+
+// Handlers of an infix operator, picked by the first character of the
+// operator as eval does
+static const struct
+{
+    char opt;
+    Handler any;
+    Handler constant;
+    Handler localConstant;
+} infixHandlers[] = {
+    {'+', runAdd, runAddConstant, runAddLocalConstant},
+    {'-', runSub, runSubConstant, runSubLocalConstant},
+    {'*', runMul, runMulConstant, runMulLocalConstant},
+    {'/', runDiv, runDivConstant, runDivLocalConstant},
+    {'<', runLess, runLessConstant, runLessLocalConstant},
+    {'>', runGreater, runGreaterConstant, runGreaterLocalConstant},
+    {'=', runEqual, runEqualConstant, runEqualLocalConstant},
+    {'!', runNotEqual, runNotEqualConstant, runNotEqualLocalConstant},
+};
+
+#define SHOW_SLOT     1
+#define SHOW_CONSTANT 2
+
+#define INFIX_NAMES(name, text)                                              \
+    {name, text, 0}, {name##Constant, text "-constant", SHOW_CONSTANT},      \
+        {name##LocalConstant, text "-local-constant",                        \
+         SHOW_SLOT | SHOW_CONSTANT}
+
+// Names of the handlers for dumpNodes, with the fields they show
+static const struct
+{
+    Handler run;
+    const char* name;
+    int show;
+} handlerNames[] = {
+    {runConstant, "constant", SHOW_CONSTANT},
+    {runString, "string", 0},
+    {runGlobal, "global", SHOW_SLOT},
+    {runLocal, "local", SHOW_SLOT},
+    {runCapture, "capture", SHOW_SLOT},
+    {runUnbound, "unbound", 0},
+    {runNot, "not", 0},
+    {runNegate, "negate", 0},
+    {runUnknownPrefix, "prefix", 0},
+    INFIX_NAMES(runAdd, "add"),
+    INFIX_NAMES(runSub, "sub"),
+    INFIX_NAMES(runMul, "mul"),
+    INFIX_NAMES(runDiv, "div"),
+    INFIX_NAMES(runLess, "less"),
+    INFIX_NAMES(runGreater, "greater"),
+    INFIX_NAMES(runEqual, "equal"),
+    INFIX_NAMES(runNotEqual, "not-equal"),
+    {runUnknownInfix, "infix", 0},
+    {runIf, "if", 0},
+    {runIfElse, "if-else", 0},
+    {runFunction, "function", 0},
+    {runCall, "call", 0},
+    {runTailCall, "tail-call", 0},
+    {runArray, "array", 0},
+    {runHash, "hash", 0},
+    {runIndex, "index", 0},
+    {runLetGlobal, "let-global", SHOW_SLOT},
+    {runLetLocal, "let-local", SHOW_SLOT},
+    {runReturn, "return", 0},
+    {runBlock, "block", 0},
+};
+
+NodeTree* compileClosures(Program* pProg, Environment* env)
+{
+    NodeTree* program = mkNodeTree(NULL);
+    program->root     = compileBlock(env, pProg);
+    return program;
+}
+
+Value runClosures(NodeTree* program, Environment* env)
+{
+    struct Runner r = {env, 0, 0, RUN_OK};
+
+    freeString(env->error);
+    env->error     = NULL;
+    env->stackLen  = 0;
+    env->callDepth = 0;
+    reserveGlobals(env);
+
+    pushRoot(env, &program->object);
+    Value result = program->root->run(program->root, &r);
+    popRoot(env);
+
+    // An error leaves no value, while a top-level `return` ends the
+    // program with its own
+    if (r.status == RUN_ERROR)
+        result = UNDEFINED_VALUE;
+    env->stackLen = 0;
+
+    return result;
+}
+
+void freeNodes(Node* node)
+{
+    if (!node)
+        return;
+
+    // Trees of function literals belong to the environment
+    freeNodes(node->left);
+    freeNodes(node->right);
+    freeNodes(node->alternative);
+    for (size_t i = 0; i < node->numChildren; ++i)
+        freeNodes(node->children[i]);
+    free(node->children);
+    free(node);
+}
+
+void visitNodeTrees(const Node* node, void (*visit)(NodeTree*, void*),
+                    void* data)
+{
+    if (!node)
+        return;
+
+    if (node->tree)
+        visit(node->tree, data);
+    visitNodeTrees(node->left, visit, data);
+    visitNodeTrees(node->right, visit, data);
+    visitNodeTrees(node->alternative, visit, data);
+    for (size_t i = 0; i < node->numChildren; ++i)
+        visitNodeTrees(node->children[i], visit, data);
+}
+
+String* dumpNodes(const NodeTree* program)
+{
+    StringBuilder* sb = mkStringBuilder();
+    if (program)
+        dumpNode(sb, program->root, 0);
+
+    String* output = buildString(sb);
+    freeStringBuilder(sb);
+    return output;
+}
+
+static Node* mkNode(Handler run)
+{
+    Node* output = calloc(1, sizeof(Node));
+    output->run  = run;
+    return output;
+}
+
+static Node* mkConstantNode(Value value)
+{
+    Node* output     = mkNode(runConstant);
+    output->constant = value;
+    return output;
+}
+
+// The tree of a function literal, kept by env until it is freed
+static NodeTree* compileFunctionTree(Environment* env, Expr* pExpr)
+{
+    FntExpr* fntExpr = pExpr->inner.fntExpr;
+    NodeTree* tree   = mkNodeTree(pExpr);
+
+    tree->numParams  = (int)fntExpr->parameters->len;
+    tree->numLocals  = fntExpr->numLocals;
+    tree->selfSlot   = fntExpr->selfSlot;
+    tree->paramSlots = malloc(sizeof(int) * (fntExpr->parameters->len + 1));
+
+    int i                   = 0;
+    struct ParamNode* param = fntExpr->parameters->tail->before;
+    while (param != fntExpr->parameters->head)
+    {
+        tree->paramSlots[i++] = param->value->slot;
+        param                 = param->before;
+    }
+
+    tree->root = compileBlock(env, fntExpr->body);
+    trackObject(env, &tree->object);
+    return tree;
+}
+
+// A block of one statement runs as that statement, and an empty one as
+// its undefined value
+static Node* compileBlock(Environment* env, BlockStmt* pBlockStmt)
+{
+    if (pBlockStmt->len == 0)
+        return mkConstantNode(UNDEFINED_VALUE);
+    if (pBlockStmt->len == 1)
+        return compileStmt(env, pBlockStmt->tail->before->value);
+
+    Node* output     = mkNode(runBlock);
+    output->children = malloc(sizeof(Node*) * pBlockStmt->len);
+
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head)
+    {
+        output->children[output->numChildren++] = compileStmt(env,
+                                                              tmp->value);
+        tmp = tmp->before;
+    }
+
+    return output;
+}
+
+static Node* compileStmt(Environment* env, Stmt* pStmt)
+{
+    if (!pStmt->inner.checkIsNull)
+        return mkConstantNode(UNDEFINED_VALUE);
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+    {
+        LetStmt* letStmt = pStmt->inner.letStmt;
+        Node* output     = mkNode(letStmt->name->kind == RESOLVE_GLOBAL
+                                      ? runLetGlobal
+                                      : runLetLocal);
+        output->left     = compileExpr(env, letStmt->value);
+        output->slot     = (size_t)letStmt->name->slot;
+        return output;
+    }
+
+    case STMT_RETURN:
+    {
+        Node* output = mkNode(runReturn);
+        output->left = compileExpr(env,
+                                   pStmt->inner.returnStmt->returnValue);
+        return output;
+    }
+
+    case STMT_EXPRESSION:
+        return compileExpr(env, pStmt->inner.exprStmt->expression);
+
+    case STMT_BLOCK:
+        return compileBlock(env, pStmt->inner.blockStmt);
+
+    default:
+        return mkConstantNode(UNDEFINED_VALUE);
+    }
+}
+
+static Node* compileExpr(Environment* env, Expr* pExpr)
+{
+    if (!pExpr || !pExpr->inner.checkIsNull)
+        return mkConstantNode(NULL_VALUE);
+
+    switch (pExpr->type)
+    {
+    case EXPR_IDENT:
+        return compileIdent(pExpr->inner.identExpr);
+
+    case EXPR_INTEGER:
+        return mkConstantNode(INT_VALUE(pExpr->inner.intExpr->value));
+
+    case EXPR_BOOL:
+        return mkConstantNode(BOOL_VALUE(pExpr->inner.boolExpr->value));
+
+    case EXPR_STRING:
+    {
+        // Made when run, as the tree does not hold the objects it makes
+        Node* output = mkNode(runString);
+        output->name = pExpr->inner.stringExpr->value;
+        return output;
+    }
+
+    case EXPR_PREFIX:
+        return compilePrefix(env, pExpr->inner.prefixExpr);
+
+    case EXPR_INFIX:
+        return compileInfix(env, pExpr->inner.infixExpr);
+
+    case EXPR_IF:
+        return compileIf(env, pExpr->inner.ifExpr);
+
+    case EXPR_FUNCTION:
+    {
+        Node* output = mkNode(runFunction);
+        output->tree = compileFunctionTree(env, pExpr);
+        return output;
+    }
+
+    case EXPR_CALL:
+        return compileCall(env, pExpr->inner.callExpr);
+
+    case EXPR_ARRAY:
+    {
+        Node* output = mkNode(runArray);
+        compileChildren(env, output, pExpr->inner.arrayExpr->elements);
+        return output;
+    }
+
+    case EXPR_HASH:
+    {
+        Node* output = mkNode(runHash);
+        compileChildren(env, output, pExpr->inner.hashExpr->pairs);
+        return output;
+    }
+
+    case EXPR_INDEX:
+    {
+        Node* output  = mkNode(runIndex);
+        output->left  = compileExpr(env, pExpr->inner.indexExpr->left);
+        output->right = compileExpr(env, pExpr->inner.indexExpr->index);
+        return output;
+    }
+
+    default:
+        return mkConstantNode(NULL_VALUE);
+    }
+}
+
+static Node* compileIdent(IdentExpr* pIdentExpr)
+{
+    Handler run;
+    switch (pIdentExpr->kind)
+    {
+    case RESOLVE_GLOBAL:
+        run = runGlobal;
+        break;
+    case RESOLVE_LOCAL:
+        run = runLocal;
+        break;
+    case RESOLVE_CAPTURE:
+        run = runCapture;
+        break;
+    default:
+        run = runUnbound;
+        break;
+    }
+
+    Node* output = mkNode(run);
+    output->slot = (size_t)pIdentExpr->slot;
+    output->name = pIdentExpr->value;
+    return output;
+}
+
+static Node* compilePrefix(Environment* env, PrefixExpr* pPrefixExpr)
+{
+    const char* opt = getStr(pPrefixExpr->opt);
+    Handler run     = runUnknownPrefix;
+    if (opt[0] == '!')
+        run = runNot;
+    else if (opt[0] == '-')
+        run = runNegate;
+
+    Node* output = mkNode(run);
+    output->left = compileExpr(env, pPrefixExpr->right);
+    output->opt  = opt;
+    return output;
+}
+
+static Node* compileInfix(Environment* env, InfixExpr* pInfixExpr)
+{
+    const char* opt = getStr(pInfixExpr->opt);
+    Expr* left      = pInfixExpr->left;
+    Expr* right     = pInfixExpr->right;
+
+    size_t i = 0;
+    size_t n = sizeof(infixHandlers) / sizeof(infixHandlers[0]);
+    while (i < n && infixHandlers[i].opt != opt[0])
+        ++i;
+
+    Node* output = NULL;
+    if (i == n)
+    {
+        output        = mkNode(runUnknownInfix);
+        output->left  = compileExpr(env, left);
+        output->right = compileExpr(env, right);
+    }
+    else if (!right || right->type != EXPR_INTEGER
+             || !right->inner.checkIsNull)
+    {
+        output        = mkNode(infixHandlers[i].any);
+        output->left  = compileExpr(env, left);
+        output->right = compileExpr(env, right);
+    }
+    else if (left && left->type == EXPR_IDENT && left->inner.checkIsNull
+             && left->inner.identExpr->kind == RESOLVE_LOCAL)
+    {
+        output           = mkNode(infixHandlers[i].localConstant);
+        output->slot     = (size_t)left->inner.identExpr->slot;
+        output->constant = INT_VALUE(right->inner.intExpr->value);
+    }
+    else
+    {
+        output           = mkNode(infixHandlers[i].constant);
+        output->left     = compileExpr(env, left);
+        output->constant = INT_VALUE(right->inner.intExpr->value);
+    }
+
+    output->opt = opt;
+    return output;
+}
+
+static Node* compileIf(Environment* env, IfExpr* pIfExpr)
+{
+    Node* output = mkNode(pIfExpr->alternative ? runIfElse : runIf);
+    output->left = compileExpr(env, pIfExpr->condition);
+    output->right = pIfExpr->consequence
+                        ? compileBlock(env, pIfExpr->consequence)
+                        : mkConstantNode(NULL_VALUE);
+    if (pIfExpr->alternative)
+        output->alternative = compileBlock(env, pIfExpr->alternative);
+    return output;
+}
+
+static Node* compileCall(Environment* env, CallExpr* pCallExpr)
+{
+    Node* output = mkNode(pCallExpr->tail ? runTailCall : runCall);
+    output->left = compileExpr(env, pCallExpr->function);
+    compileChildren(env, output, pCallExpr->arguments);
+    return output;
+}
+
+// Arguments of a call, elements of an array or keys and values of a hash
+static void compileChildren(Environment* env, Node* output,
+                            Arguments* arguments)
+{
+    output->children = malloc(sizeof(Node*) * (arguments->len + 1));
+
+    struct ArgNode* arg = arguments->tail->before;
+    while (arg != arguments->head)
+    {
+        output->children[output->numChildren++] = compileExpr(env,
+                                                              arg->value);
+        arg = arg->before;
+    }
+}
+
+static Value runConstant(const Node* n, struct Runner* r)
+{
+    (void)r;
+    return n->constant;
+}
+
+static Value runString(const Node* n, struct Runner* r)
+{
+    return OBJECT_VALUE(VALUE_STRING,
+                        newString(r->env, getStr(n->name), getLen(n->name)));
+}
+
+static Value runGlobal(const Node* n, struct Runner* r)
+{
+    Environment* env = r->env;
+    if (n->slot < env->globalLen
+        && env->globals[n->slot].type != VALUE_UNDEFINED)
+        return env->globals[n->slot];
+
+    return runUnbound(n, r);
+}
+
+static Value runLocal(const Node* n, struct Runner* r)
+{
+    return r->env->stack[r->base + n->slot];
+}
+
+static Value runCapture(const Node* n, struct Runner* r)
+{
+    return CURRENT_CLOSURE(r)->captures[n->slot];
+}
+
+static Value runUnbound(const Node* n, struct Runner* r)
+{
+    return runtimeError(r, "identifier not found: %s", getStr(n->name));
+}
+
+static Value runNot(const Node* n, struct Runner* r)
+{
+    Value right = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return right;
+    return BOOL_VALUE(!isTruthy(right));
+}
+
+static Value runNegate(const Node* n, struct Runner* r)
+{
+    Value right = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return right;
+
+    if (right.type == VALUE_INT)
+        return INT_VALUE((int64_t)(0 - (uint64_t)right.as.integer));
+
+    return runtimeError(r, "unknown operator: %s%s", n->opt,
+                        valueTypeName(right.type));
+}
+
+static Value runUnknownPrefix(const Node* n, struct Runner* r)
+{
+    Value right = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return right;
+
+    return runtimeError(r, "unknown operator: %s%s", n->opt,
+                        valueTypeName(right.type));
+}
+
+static Value runUnknownInfix(const Node* n, struct Runner* r)
+{
+    Value left = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return left;
+
+    Value right = n->right->run(n->right, r);
+    if (r->status != RUN_OK)
+        return right;
+
+    if (left.type == VALUE_INT && right.type == VALUE_INT)
+        return runtimeError(r, "unknown operator: INTEGER %s INTEGER",
+                            n->opt);
+
+    return infixFallback(n, r, left, right);
+}
+
+static Value runIf(const Node* n, struct Runner* r)
+{
+    Value condition = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return condition;
+    if (!isTruthy(condition))
+        return NULL_VALUE;
+
+    Value result = n->right->run(n->right, r);
+    if (result.type == VALUE_UNDEFINED)
+        return NULL_VALUE;
+    return result;
+}
+
+static Value runIfElse(const Node* n, struct Runner* r)
+{
+    Value condition = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return condition;
+
+    const Node* branch = isTruthy(condition) ? n->right : n->alternative;
+    Value result       = branch->run(branch, r);
+    if (result.type == VALUE_UNDEFINED)
+        return NULL_VALUE;
+    return result;
+}
+
+static Value runFunction(const Node* n, struct Runner* r)
+{
+    Closure* closure = newClosure(r->env, n->tree->function);
+    Capture* capture = n->tree->function->inner.fntExpr->captures;
+
+    closure->tree = n->tree;
+    for (int i = 0; i < closure->numCaptures; ++i)
+    {
+        if (capture[i].source == CAPTURE_LOCAL)
+            closure->captures[i] = r->env->stack[r->base
+                                                 + (size_t)capture[i].index];
+        else
+            closure->captures[i] =
+                CURRENT_CLOSURE(r)->captures[capture[i].index];
+        WRITE_BARRIER(r->env, &closure->object, closure->captures[i]);
+    }
+
+    return OBJECT_VALUE(VALUE_CLOSURE, closure);
+}
+
+// Run the callee and the arguments of a call, and set up the frame of the
+// callee above the running one, the callee pinned on top of the roots.
+// Returns the callee, or what stopped the call with the status of r.
+static inline Value enterCall(const Node* n, struct Runner* r, size_t* base)
+{
+    Environment* env = r->env;
+
+    Value callee = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return callee;
+
+    if (callee.type != VALUE_CLOSURE)
+        return runtimeError(r, "not a function: %s",
+                            valueTypeName(callee.type));
+
+    // Closures made by another engine of env are compiled on their first
+    // call here
+    Closure* closure = (Closure*)callee.as.object;
+    if (!closure->tree)
+        closure->tree = compileFunctionTree(env, closure->function);
+    NodeTree* tree = closure->tree;
+
+    if (n->numChildren != (size_t)tree->numParams)
+        return runtimeError(r, "wrong number of arguments: want=%zu, got=%zu",
+                            (size_t)tree->numParams, n->numChildren);
+
+    // Arguments are run in the frame of the caller and stored in the frame
+    // of the callee, which sits above it. The callee stays pinned until it
+    // returns, and is read back from its root once it may have moved.
+    size_t calleeRoot = pushRoot(env, callee.as.object);
+    *base             = pushFrame(env, (size_t)tree->numLocals);
+    for (size_t i = 0; i < n->numChildren; ++i)
+    {
+        const Node* arg = n->children[i];
+        Value value     = arg->run(arg, r);
+        if (r->status != RUN_OK)
+        {
+            env->stackLen = *base;
+            popRoot(env);
+            return value;
+        }
+
+        env->stack[*base + (size_t)tree->paramSlots[i]] = value;
+    }
+
+    return OBJECT_VALUE(VALUE_CLOSURE, env->roots[calleeRoot]);
+}
+
+static Value runCall(const Node* n, struct Runner* r)
+{
+    Environment* env = r->env;
+
+    size_t base  = 0;
+    Value callee = enterCall(n, r, &base);
+    if (r->status != RUN_OK)
+        return callee;
+
+    // Pure functions called before with the same arguments are not run
+    // again
+    MemoKey key;
+    int memoize = env->memo && memoKeyOf(env, base, &key);
+    Value result;
+    if (memoize && lookUpMemo(env, &key, &result))
+    {
+        env->stackLen = base;
+        popRoot(env);
+        return result;
+    }
+
+    if (env->callDepth >= MAX_CALL_DEPTH)
+    {
+        env->stackLen = base;
+        popRoot(env);
+        return runtimeError(r, "stack overflow");
+    }
+
+    size_t calleeRoot = env->rootLen - 1;
+    size_t callerBase = r->base;
+    size_t callerRoot = r->closureRoot;
+    r->base           = base;
+    r->closureRoot    = calleeRoot;
+
+    // Tail calls of the callee leave the next function to run in its frame
+    ++env->callDepth;
+    do
+    {
+        r->status        = RUN_OK;
+        callee.as.object = env->roots[calleeRoot];
+        NodeTree* tree   = ((Closure*)callee.as.object)->tree;
+        if (tree->selfSlot >= 0)
+            env->stack[base + (size_t)tree->selfSlot] = callee;
+
+        result = tree->root->run(tree->root, r);
+    } while (r->status == RUN_TAIL_CALL);
+    --env->callDepth;
+
+    r->base        = callerBase;
+    r->closureRoot = callerRoot;
+    env->stackLen  = base;
+    popRoot(env);
+
+    if (r->status == RUN_RETURN)
+        r->status = RUN_OK;
+    if (result.type == VALUE_UNDEFINED)
+        result = NULL_VALUE;
+    if (memoize && r->status == RUN_OK)
+        storeMemo(env, &key, result);
+    return result;
+}
+
+// A call in tail position takes over the frame and the root of the running
+// function, for the call that ran it to run the callee in its place
+static Value runTailCall(const Node* n, struct Runner* r)
+{
+    Environment* env = r->env;
+
+    size_t base  = 0;
+    Value callee = enterCall(n, r, &base);
+    if (r->status != RUN_OK)
+        return callee;
+
+    MemoKey key;
+    Value result;
+    if (env->memo && memoKeyOf(env, base, &key)
+        && lookUpMemo(env, &key, &result))
+    {
+        env->stackLen = base;
+        popRoot(env);
+        return result;
+    }
+
+    size_t numLocals = (size_t)((Closure*)callee.as.object)->tree->numLocals;
+    memmove(env->stack + r->base, env->stack + base,
+            sizeof(Value) * numLocals);
+    env->stackLen              = r->base + numLocals;
+    env->roots[r->closureRoot] = callee.as.object;
+    popRoot(env);
+
+    ++env->tailCalls;
+    r->status = RUN_TAIL_CALL;
+    return UNDEFINED_VALUE;
+}
+
+// Key of the call of the closure pinned on top of the roots, whose
+// arguments are in the frame at base, if it can be memoized
+static int memoKeyOf(Environment* env, size_t base, MemoKey* key)
+{
+    Closure* closure = (Closure*)env->roots[env->rootLen - 1];
+    NodeTree* tree   = closure->tree;
+    if (!closure->function->inner.fntExpr->pure
+        || tree->numParams > MEMO_MAX_ARGS)
+        return 0;
+
+    Value args[MEMO_MAX_ARGS];
+    for (int i = 0; i < tree->numParams; ++i)
+        args[i] = env->stack[base + (size_t)tree->paramSlots[i]];
+    return makeMemoKey(closure->function, args, (size_t)tree->numParams, key);
+}
+
+static Value runArray(const Node* n, struct Runner* r)
+{
+    Array* array = newArray(r->env, n->numChildren);
+
+    pushRoot(r->env, &array->object);
+    for (size_t i = 0; i < n->numChildren; ++i)
+    {
+        Value value = n->children[i]->run(n->children[i], r);
+        if (r->status != RUN_OK)
+        {
+            popRoot(r->env);
+            return value;
+        }
+
+        arrayPush(array, value);
+        WRITE_BARRIER(r->env, &array->object, value);
+    }
+    popRoot(r->env);
+
+    return OBJECT_VALUE(VALUE_ARRAY, array);
+}
+
+static Value runHash(const Node* n, struct Runner* r)
+{
+    Hash* hash = newHash(r->env, n->numChildren / 2);
+
+    pushRoot(r->env, &hash->object);
+    for (size_t i = 0; i < n->numChildren; i += 2)
+    {
+        Value key = n->children[i]->run(n->children[i], r);
+        if (r->status == RUN_OK && !isHashable(key))
+            key = runtimeError(r, UNUSABLE_HASH_KEY, valueTypeName(key.type));
+        if (r->status != RUN_OK)
+        {
+            popRoot(r->env);
+            return key;
+        }
+
+        // A string key is pinned along with the hash, and never moves
+        pushRoot(r->env, IS_OBJECT_VALUE(key) ? key.as.object : NULL);
+        Value value = n->children[i + 1]->run(n->children[i + 1], r);
+        popRoot(r->env);
+        if (r->status != RUN_OK)
+        {
+            popRoot(r->env);
+            return value;
+        }
+
+        hashPut(hash, key, value);
+        WRITE_BARRIER(r->env, &hash->object, key);
+        WRITE_BARRIER(r->env, &hash->object, value);
+    }
+    popRoot(r->env);
+
+    return OBJECT_VALUE(VALUE_HASH, hash);
+}
+
+static Value runIndex(const Node* n, struct Runner* r)
+{
+    Value left = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return left;
+
+    size_t leftRoot =
+        pushRoot(r->env, IS_OBJECT_VALUE(left) ? left.as.object : NULL);
+    Value index = n->right->run(n->right, r);
+    if (IS_OBJECT_VALUE(left))
+        left.as.object = r->env->roots[leftRoot];
+    popRoot(r->env);
+    if (r->status != RUN_OK)
+        return index;
+
+    Value result      = NULL_VALUE;
+    ValueType culprit = VALUE_UNDEFINED;
+    const char* error = indexValue(left, index, &result, &culprit);
+    if (error)
+        return runtimeError(r, error, valueTypeName(culprit));
+    return result;
+}
+
+static Value runLetGlobal(const Node* n, struct Runner* r)
+{
+    Value value = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return value;
+
+    Value* global = &r->env->globals[n->slot];
+    if (r->env->memo && global->type != VALUE_UNDEFINED)
+        forgetMemo(r->env);
+    *global = value;
+    return UNDEFINED_VALUE;
+}
+
+static Value runLetLocal(const Node* n, struct Runner* r)
+{
+    Value value = n->left->run(n->left, r);
+    if (r->status != RUN_OK)
+        return value;
+
+    r->env->stack[r->base + n->slot] = value;
+    return UNDEFINED_VALUE;
+}
+
+static Value runReturn(const Node* n, struct Runner* r)
+{
+    Value value = n->left->run(n->left, r);
+    if (r->status == RUN_OK)
+        r->status = RUN_RETURN;
+    return value;
+}
+
+static Value runBlock(const Node* n, struct Runner* r)
+{
+    Value result = UNDEFINED_VALUE;
+
+    for (size_t i = 0; i < n->numChildren; ++i)
+    {
+        result = n->children[i]->run(n->children[i], r);
+        if (r->status != RUN_OK)
+            break;
+    }
+
+    return result;
+}
+
+// Operands of an infix operator that are not both integers
+static Value infixFallback(const Node* n, struct Runner* r, Value left,
+                           Value right)
+{
+    const char* opt = n->opt;
+    if ((opt[0] == '=' || opt[0] == '!') && opt[1] == '=')
+    {
+        int equal = valuesEqual(left, right);
+        return BOOL_VALUE(opt[0] == '=' ? equal : !equal);
+    }
+    if (left.type == VALUE_STRING && right.type == VALUE_STRING
+        && opt[0] == '+')
+        return OBJECT_VALUE(VALUE_STRING,
+                            newConcat(r->env, (Rope*)left.as.object,
+                                      (Rope*)right.as.object));
+
+    if (left.type != right.type)
+        return runtimeError(r, "type mismatch: %s %s %s",
+                            valueTypeName(left.type), opt,
+                            valueTypeName(right.type));
+
+    return runtimeError(r, "unknown operator: %s %s %s",
+                        valueTypeName(left.type), opt,
+                        valueTypeName(right.type));
+}
+
+static Value divide(struct Runner* r, int64_t left, int64_t right)
+{
+    if (right == 0)
+        return runtimeError(r, "division by zero");
+    if (left == INT64_MIN && right == -1)
+        return INT_VALUE(INT64_MIN);
+    return INT_VALUE(left / right);
+}
+
+static Value runtimeError(struct Runner* r, const char* fmt, ...)
+{
+    char msg[128];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    setEnvError(r->env, "%s", msg);
+    r->status = RUN_ERROR;
+
+    return NULL_VALUE;
+}
+
+static void dumpNode(StringBuilder* sb, const Node* node, int depth)
+{
+    char buffer[64];
+
+    for (int i = 0; i < depth; ++i)
+        builderAppendStr(sb, "  ");
+
+    size_t i = 0;
+    size_t n = sizeof(handlerNames) / sizeof(handlerNames[0]);
+    while (i < n && handlerNames[i].run != node->run)
+        ++i;
+
+    builderAppendStr(sb, i < n ? handlerNames[i].name : "?");
+    if (i < n && handlerNames[i].show & SHOW_SLOT)
+    {
+        snprintf(buffer, sizeof(buffer), " %zu", node->slot);
+        builderAppendStr(sb, buffer);
+    }
+    if (i < n && handlerNames[i].show & SHOW_CONSTANT)
+    {
+        builderAppendChar(sb, ' ');
+        builderAppendFreeString(sb, inspectValue(node->constant));
+    }
+    builderAppendChar(sb, '\n');
+
+    if (node->left)
+        dumpNode(sb, node->left, depth + 1);
+    if (node->right)
+        dumpNode(sb, node->right, depth + 1);
+    if (node->alternative)
+        dumpNode(sb, node->alternative, depth + 1);
+    for (size_t j = 0; j < node->numChildren; ++j)
+        dumpNode(sb, node->children[j], depth + 1);
+    if (node->tree)
+        dumpNode(sb, node->tree->root, depth + 1);
+}
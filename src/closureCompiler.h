@@ -0,0 +1,41 @@
+#ifndef _MONKEY_LANG_SRC_CLOSURECOMPILER_H_
+#define _MONKEY_LANG_SRC_CLOSURECOMPILER_H_
+
+#include "ast.h"
+#include "dynString.h"
+#include "environment.h"
+#include "object.h"
+
+typedef struct Node Node;
+
+// Compile a program that went through resolveProgram, with the resolver of
+// env, and analyzeCaptures into a tree of nodes, each holding the C handler
+// that runs it. Handlers are picked once, here, by expression type,
+// operator, operand kinds and the kind of each identifier, so that running
+// the tree is a chain of indirect calls that never look at the AST again.
+//
+// The program tree is freed with freeObject; the trees of function
+// literals belong to env, as closures refer to them.
+NodeTree* compileClosures(Program*, Environment*);
+
+// Run a tree made by compileClosures with the same env. Returns the same
+// value eval would, and on a runtime error leaves the same message for
+// getEvalError. Frames are pushed on the frame stack of env, as eval does.
+Value runClosures(NodeTree*, Environment*);
+
+void freeNodes(Node*);
+// Call visit on the tree of each function literal among node and the nodes
+// under it, for the collector to trace
+void visitNodeTrees(const Node*, void (*visit)(NodeTree*, void*), void*);
+
+// Handler of each node of program and of the function literals it
+// creates, indented by nesting:
+//
+//   block
+//     let-global 0
+//       constant 1
+//     add-constant 2
+//       global 0
+String* dumpNodes(const NodeTree* program);
+
+#endif //_MONKEY_LANG_SRC_CLOSURECOMPILER_H_
@@ -0,0 +1,161 @@
+#include <stdio.h>
+
+#include "code.h"
+#include "stringBuilder.h"
+
+static const char* const opcodeNames[OPCODE_COUNT] = {
+    [OP_CONSTANT] = "OP_CONSTANT",       [OP_TRUE] = "OP_TRUE",
+    [OP_FALSE] = "OP_FALSE",             [OP_NULL] = "OP_NULL",
+    [OP_UNDEFINED] = "OP_UNDEFINED",     [OP_POP] = "OP_POP",
+    [OP_ADD] = "OP_ADD",                 [OP_SUB] = "OP_SUB",
+    [OP_MUL] = "OP_MUL",                 [OP_DIV] = "OP_DIV",
+    [OP_EQ] = "OP_EQ",                   [OP_NE] = "OP_NE",
+    [OP_LT] = "OP_LT",                   [OP_GT] = "OP_GT",
+    [OP_MINUS] = "OP_MINUS",             [OP_BANG] = "OP_BANG",
+    [OP_JUMP] = "OP_JUMP",               [OP_JUMP_FALSY] = "OP_JUMP_FALSY",
+    [OP_GET_GLOBAL] = "OP_GET_GLOBAL",   [OP_SET_GLOBAL] = "OP_SET_GLOBAL",
+    [OP_GET_LOCAL] = "OP_GET_LOCAL",     [OP_SET_LOCAL] = "OP_SET_LOCAL",
+    [OP_GET_CAPTURE] = "OP_GET_CAPTURE", [OP_ARRAY] = "OP_ARRAY",
+    [OP_HASH] = "OP_HASH",               [OP_INDEX] = "OP_INDEX",
+    [OP_CLOSURE] = "OP_CLOSURE",
+    [OP_CALL] = "OP_CALL",               [OP_TAIL_CALL] = "OP_TAIL_CALL",
+    [OP_RETURN] = "OP_RETURN",
+#define SUPER_PAIR(name, a, b)      [name] = #name,
+#define SUPER_TRIPLE(name, a, b, c) [name] = #name,
+#include "superinstructions.h"
+#undef SUPER_PAIR
+#undef SUPER_TRIPLE
+};
+
+static const struct
+{
+    Opcode parts[MAX_SUPER_LENGTH];
+    int len;
+} superinstructions[OPCODE_COUNT] = {
+    [OP_CONSTANT] = {{OP_CONSTANT, OP_CONSTANT, OP_CONSTANT}, 0}, // plain
+#define SUPER_PAIR(name, a, b)      [name] = {{a, b, a}, 2},
+#define SUPER_TRIPLE(name, a, b, c) [name] = {{a, b, c}, 3},
+#include "superinstructions.h"
+#undef SUPER_PAIR
+#undef SUPER_TRIPLE
+};
+
+// Whether the operand of an instruction is meaningful
+static const int hasOperand[OPCODE_COUNT] = {
+    [OP_CONSTANT] = 1,   [OP_JUMP] = 1,      [OP_JUMP_FALSY] = 1,
+    [OP_GET_GLOBAL] = 1, [OP_SET_GLOBAL] = 1, [OP_GET_LOCAL] = 1,
+    [OP_SET_LOCAL] = 1,  [OP_GET_CAPTURE] = 1, [OP_CLOSURE] = 1,
+    [OP_CALL] = 1,       [OP_TAIL_CALL] = 1,  [OP_ARRAY] = 1,
+    [OP_HASH] = 1,
+};
+
+const char* opcodeName(Opcode op)
+{
+    if ((unsigned)op >= OPCODE_COUNT)
+        return "OP_UNKNOWN";
+    return opcodeNames[op];
+}
+
+int getStackEffect(Opcode op, uint32_t arg)
+{
+    switch (op)
+    {
+    case OP_CONSTANT:
+    case OP_TRUE:
+    case OP_FALSE:
+    case OP_NULL:
+    case OP_UNDEFINED:
+    case OP_GET_GLOBAL:
+    case OP_GET_LOCAL:
+    case OP_GET_CAPTURE:
+    case OP_CLOSURE:
+        return 1;
+    case OP_MINUS:
+    case OP_BANG:
+    case OP_JUMP:
+        return 0;
+    case OP_CALL:
+    case OP_TAIL_CALL:
+        return -(int)CALL_ARGC(arg);
+    case OP_ARRAY:
+        return 1 - (int)arg;
+    case OP_HASH:
+        return 1 - 2 * (int)arg;
+    default:
+        return -1;
+    }
+}
+
+int getSuperinstruction(Opcode op, Opcode parts[MAX_SUPER_LENGTH])
+{
+    if ((unsigned)op >= OPCODE_COUNT || !superinstructions[op].len)
+        return 0;
+
+    for (int i = 0; i < MAX_SUPER_LENGTH; ++i)
+        parts[i] = superinstructions[op].parts[i];
+    return superinstructions[op].len;
+}
+
+void fuseInstructions(CompiledFunction* fn)
+{
+    // The instructions behind i are still the original ones, so sequences
+    // can overlap: a jump into one finds the next superinstruction
+    for (size_t i = 0; i < fn->codeLen; ++i)
+    {
+        int bestLen = 1;
+        Opcode best = INSTR_OP(fn->code[i]);
+
+        for (int op = BASE_OPCODE_COUNT; op < OPCODE_COUNT; ++op)
+        {
+            int len = superinstructions[op].len;
+            if (len <= bestLen || i + (size_t)len > fn->codeLen)
+                continue;
+
+            int j = 0;
+            while (j < len
+                   && INSTR_OP(fn->code[i + (size_t)j])
+                          == superinstructions[op].parts[j])
+                ++j;
+
+            if (j == len)
+            {
+                bestLen = len;
+                best    = (Opcode)op;
+            }
+        }
+
+        fn->code[i] = MAKE_INSTR(best, INSTR_ARG(fn->code[i]));
+    }
+
+    for (size_t i = 0; i < fn->numFunctions; ++i)
+        fuseInstructions(fn->functions[i]);
+}
+
+String* disassemble(const CompiledFunction* fn)
+{
+    StringBuilder* sb = mkStringBuilder();
+    char buffer[64];
+
+    for (size_t i = 0; i < fn->codeLen; ++i)
+    {
+        Opcode op = INSTR_OP(fn->code[i]);
+        Opcode parts[MAX_SUPER_LENGTH];
+
+        // A superinstruction carries the operand of its first part
+        Opcode operandOf = getSuperinstruction(op, parts) ? parts[0] : op;
+        if (operandOf == OP_CALL || operandOf == OP_TAIL_CALL)
+            snprintf(buffer, sizeof(buffer), "%04zu %s %u\n", i,
+                     opcodeName(op), CALL_ARGC(INSTR_ARG(fn->code[i])));
+        else if ((unsigned)operandOf < OPCODE_COUNT && hasOperand[operandOf])
+            snprintf(buffer, sizeof(buffer), "%04zu %s %u\n", i,
+                     opcodeName(op), INSTR_ARG(fn->code[i]));
+        else
+            snprintf(buffer, sizeof(buffer), "%04zu %s\n", i, opcodeName(op));
+
+        builderAppendStr(sb, buffer);
+    }
+
+    String* output = buildString(sb);
+    freeStringBuilder(sb);
+    return output;
+}
@@ -0,0 +1,97 @@
+#ifndef _MONKEY_LANG_SRC_CODE_H_
+#define _MONKEY_LANG_SRC_CODE_H_
+
+#include <stdint.h>
+
+#include "dynString.h"
+#include "object.h"
+
+// An instruction is a 32-bit word: the opcode in the low 8 bits and a
+// single unsigned operand in the high 24 bits.
+#define MAX_OPERAND ((1u << 24) - 1)
+
+#define MAKE_INSTR(op, arg) ((uint32_t)(op) | ((uint32_t)(arg) << 8))
+#define INSTR_OP(instr)     ((Opcode)((instr) & 0xff))
+#define INSTR_ARG(instr)    ((uint32_t)(instr) >> 8)
+
+// The operand of OP_CALL and OP_TAIL_CALL holds the number of arguments in its low 8 bits,
+// and the call site, the index of its cache in the function, above them
+#define MAX_CALL_ARGS           0xffu
+#define MAX_CALL_SITES          0xffffu
+#define CALL_OPERAND(argc, site) ((uint32_t)(argc) | ((uint32_t)(site) << 8))
+#define CALL_ARGC(arg)          ((arg) & MAX_CALL_ARGS)
+#define CALL_SITE(arg)          ((arg) >> 8)
+
+typedef enum
+{
+    OP_CONSTANT = 0, // push constants[arg]
+    OP_TRUE,
+    OP_FALSE,
+    OP_NULL,
+    OP_UNDEFINED, // value of a program ending with `let`
+    OP_POP,
+
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_GT,
+    OP_MINUS,
+    OP_BANG,
+
+    OP_JUMP,       // continue at code[arg]
+    OP_JUMP_FALSY, // pop, and continue at code[arg] if falsy
+
+    OP_GET_GLOBAL,  // arg: global slot
+    OP_SET_GLOBAL,  // pop into a global slot
+    OP_GET_LOCAL,   // arg: frame slot
+    OP_SET_LOCAL,   // pop into a frame slot
+    OP_GET_CAPTURE, // arg: capture of the running closure
+
+    OP_ARRAY, // pop arg elements into an array
+    OP_HASH,  // pop arg keys and values, keys first, into a hash
+    OP_INDEX, // pop an index and the value it indexes, push the element
+
+    OP_CLOSURE, // push a closure of functions[arg]
+    OP_CALL,      // arg: number of arguments above the callee, and call site
+    OP_TAIL_CALL, // as OP_CALL, the callee taking over the running frame
+    OP_RETURN,    // return the top of the stack to the caller
+
+    // Superinstructions, picked from a training profile at build time; see
+    // superinstructions.h. One stands in place of the first instruction of
+    // its sequence, the others staying behind it, and runs all of them
+    // with a single dispatch.
+#define SUPER_PAIR(name, a, b)      name,
+#define SUPER_TRIPLE(name, a, b, c) name,
+#include "superinstructions.h"
+#undef SUPER_PAIR
+#undef SUPER_TRIPLE
+
+    OPCODE_COUNT,
+} Opcode;
+
+#define BASE_OPCODE_COUNT (OP_RETURN + 1)
+#define MAX_SUPER_LENGTH  3
+
+const char* opcodeName(Opcode);
+
+// Operand stack slots pushed (positive) or popped (negative) by a plain
+// instruction
+int getStackEffect(Opcode op, uint32_t arg);
+
+// Number of instructions the superinstruction op runs, which it writes to
+// parts, or 0 if op is a plain instruction
+int getSuperinstruction(Opcode op, Opcode parts[MAX_SUPER_LENGTH]);
+
+// Replace the first instruction of every sequence that has a
+// superinstruction, in fn and the functions it creates. Jumps still land
+// on the instructions left behind, so the code keeps its layout.
+void fuseInstructions(CompiledFunction* fn);
+
+// One line per instruction: its index, opcode and operand
+String* disassemble(const CompiledFunction*);
+
+#endif //_MONKEY_LANG_SRC_CODE_H_
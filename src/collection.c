@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "collection.h"
+#include "rope.h"
+
+// Slots are probed a group at a time. A control byte is CONTROL_EMPTY, or
+// the low 7 bits of the hash of the key in its slot, so that most slots
+// of other keys are passed over without looking at their entry. Groups
+// are visited at triangular offsets from the slot the high bits of the
+// hash pick, which reaches every group of a power-of-two table, and a
+// group with an empty slot ends the probe. Pairs are never removed, so
+// there are no tombstones.
+#define GROUP_WIDTH   16
+#define CONTROL_EMPTY ((uint8_t)0x80)
+#define MIN_SLOTS     16
+
+/* Private Function Signatures */
+static uint64_t hashKey(Value);
+static uint32_t matchByte(const uint8_t*, uint8_t);
+static uint32_t matchEmpty(const uint8_t*);
+static HashEntry* findEntry(const Hash*, Value, uint64_t);
+static size_t findEmpty(const Hash*, uint64_t);
+static void setControl(Hash*, size_t, uint8_t);
+static void allocTable(Hash*, size_t);
+static void growHash(Hash*);
+
+Array* mkArray(size_t capacity)
+{
+    Array* output = malloc(sizeof(Array));
+
+    output->object.type       = OBJECT_ARRAY;
+    output->object.marked     = 0;
+    output->object.remembered = 0;
+    output->object.forwarded  = 0;
+    output->object.next       = NULL;
+
+    output->len      = 0;
+    output->capacity = capacity;
+    output->elements = capacity ? malloc(sizeof(Value) * capacity) : NULL;
+
+    return output;
+}
+
+void arrayPush(Array* array, Value value)
+{
+    if (array->len == array->capacity)
+    {
+        array->capacity = array->capacity ? array->capacity << 1 : 4;
+        array->elements =
+            realloc(array->elements, sizeof(Value) * array->capacity);
+    }
+    array->elements[array->len++] = value;
+}
+
+Value arrayGet(const Array* array, int64_t index)
+{
+    if (index < 0 || (uint64_t)index >= array->len)
+        return NULL_VALUE;
+    return array->elements[index];
+}
+
+Hash* mkHash(size_t capacity)
+{
+    Hash* output = malloc(sizeof(Hash));
+
+    output->object.type       = OBJECT_HASH;
+    output->object.marked     = 0;
+    output->object.remembered = 0;
+    output->object.forwarded  = 0;
+    output->object.next       = NULL;
+
+    // At most 7 slots in 8 are full
+    size_t slots = MIN_SLOTS;
+    while (slots / 8 * 7 < capacity)
+        slots <<= 1;
+
+    output->len      = 0;
+    output->capacity = slots / 8 * 7;
+    output->entries  = malloc(sizeof(HashEntry) * output->capacity);
+    allocTable(output, slots);
+
+    return output;
+}
+
+int isHashable(Value value)
+{
+    return value.type == VALUE_INT || value.type == VALUE_BOOL
+        || value.type == VALUE_STRING;
+}
+
+void hashPut(Hash* hash, Value key, Value value)
+{
+    uint64_t code    = hashKey(key);
+    HashEntry* entry = findEntry(hash, key, code);
+    if (entry)
+    {
+        entry->value = value;
+        return;
+    }
+
+    if (hash->len == hash->capacity)
+        growHash(hash);
+
+    size_t slot       = findEmpty(hash, code);
+    hash->slots[slot] = (uint32_t)hash->len;
+    setControl(hash, slot, (uint8_t)(code & 0x7f));
+    hash->entries[hash->len++] = (HashEntry){key, value};
+}
+
+Value hashGet(const Hash* hash, Value key)
+{
+    HashEntry* entry = findEntry(hash, key, hashKey(key));
+    return entry ? entry->value : NULL_VALUE;
+}
+
+const char* indexValue(Value left, Value index, Value* result,
+                       ValueType* culprit)
+{
+    if (left.type == VALUE_ARRAY && index.type == VALUE_INT)
+    {
+        *result = arrayGet((Array*)left.as.object, index.as.integer);
+        return NULL;
+    }
+    if (left.type == VALUE_STRING && index.type == VALUE_INT)
+    {
+        Rope* c = ropeCharAt((Rope*)left.as.object, index.as.integer);
+        *result = c ? OBJECT_VALUE(VALUE_STRING, c) : NULL_VALUE;
+        return NULL;
+    }
+
+    if (left.type != VALUE_HASH)
+    {
+        *culprit = left.type;
+        return INDEX_NOT_SUPPORTED;
+    }
+    if (!isHashable(index))
+    {
+        *culprit = index.type;
+        return UNUSABLE_HASH_KEY;
+    }
+
+    *result = hashGet((Hash*)left.as.object, index);
+    return NULL;
+}
+
+// Keys equal as values hash the same, whatever the rest of the payload
+// holds. Strings hash their characters, once.
+static uint64_t hashKey(Value key)
+{
+    uint64_t x = key.type == VALUE_INT    ? (uint64_t)key.as.integer
+               : key.type == VALUE_STRING ? ropeHash((Rope*)key.as.object)
+                                          : (uint64_t)(key.as.boolean != 0);
+
+    x += 0x9e3779b97f4a7c15ULL * (uint64_t)key.type;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Bit i is set when byte i of the group is byte
+static uint32_t matchByte(const uint8_t* group, uint8_t byte)
+{
+#ifdef __SSE2__
+    __m128i control = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; ++i)
+        mask |= (uint32_t)(group[i] == byte) << i;
+    return mask;
+#endif
+}
+
+// Only empty slots have the high bit of their control byte set
+static uint32_t matchEmpty(const uint8_t* group)
+{
+#ifdef __SSE2__
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_loadu_si128((const __m128i*)group));
+#else
+    return matchByte(group, CONTROL_EMPTY);
+#endif
+}
+
+static HashEntry* findEntry(const Hash* hash, Value key, uint64_t code)
+{
+    uint8_t h2 = (uint8_t)(code & 0x7f);
+    size_t pos = (size_t)(code >> 7) & hash->slotMask;
+
+    for (size_t stride = GROUP_WIDTH;; stride += GROUP_WIDTH)
+    {
+        const uint8_t* group = hash->control + pos;
+        for (uint32_t mask = matchByte(group, h2); mask; mask &= mask - 1)
+        {
+            size_t slot = (pos + (size_t)__builtin_ctz(mask)) & hash->slotMask;
+            HashEntry* entry = &hash->entries[hash->slots[slot]];
+            if (valuesEqual(entry->key, key))
+                return entry;
+        }
+        if (matchEmpty(group))
+            return NULL;
+        pos = (pos + stride) & hash->slotMask;
+    }
+}
+
+// The first empty slot on the probe sequence of code
+static size_t findEmpty(const Hash* hash, uint64_t code)
+{
+    size_t pos = (size_t)(code >> 7) & hash->slotMask;
+
+    for (size_t stride = GROUP_WIDTH;; stride += GROUP_WIDTH)
+    {
+        uint32_t mask = matchEmpty(hash->control + pos);
+        if (mask)
+            return (pos + (size_t)__builtin_ctz(mask)) & hash->slotMask;
+        pos = (pos + stride) & hash->slotMask;
+    }
+}
+
+// The first group is repeated after the last slot, so that a group can be
+// loaded from any slot without wrapping around
+static void setControl(Hash* hash, size_t slot, uint8_t byte)
+{
+    hash->control[slot] = byte;
+    if (slot < GROUP_WIDTH)
+        hash->control[hash->slotMask + 1 + slot] = byte;
+}
+
+static void allocTable(Hash* hash, size_t slots)
+{
+    hash->control  = malloc(slots + GROUP_WIDTH);
+    hash->slots    = malloc(sizeof(uint32_t) * slots);
+    hash->slotMask = slots - 1;
+    memset(hash->control, CONTROL_EMPTY, slots + GROUP_WIDTH);
+}
+
+static void growHash(Hash* hash)
+{
+    size_t slots = (hash->slotMask + 1) << 1;
+
+    free(hash->control);
+    free(hash->slots);
+    allocTable(hash, slots);
+
+    hash->capacity = slots / 8 * 7;
+    hash->entries =
+        realloc(hash->entries, sizeof(HashEntry) * hash->capacity);
+
+    for (size_t i = 0; i < hash->len; ++i)
+    {
+        uint64_t code     = hashKey(hash->entries[i].key);
+        size_t slot       = findEmpty(hash, code);
+        hash->slots[slot] = (uint32_t)i;
+        setControl(hash, slot, (uint8_t)(code & 0x7f));
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef _MONKEY_LANG_SRC_COLLECTION_H_
+#define _MONKEY_LANG_SRC_COLLECTION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "object.h"
+
+#define INDEX_NOT_SUPPORTED "index operator not supported: %s"
+#define UNUSABLE_HASH_KEY   "unusable as hash key: %s"
+
+// Arrays and hashes start out with room for capacity elements or pairs
+// and grow past it. An environment counts the objects it tracks towards
+// its heap by the size they were made with, so the engines make them for
+// the length of their literal and never grow them; see newArray in
+// environment.h.
+Array* mkArray(size_t capacity);
+void arrayPush(Array*, Value);
+// The element at index, or null out of bounds
+Value arrayGet(const Array*, int64_t index);
+
+// Hashes are Swiss tables: a slot is found by comparing a group of 16
+// control bytes at once, each holding 7 bits of the hash of the key in its
+// slot, with SSE2 where the target has it. Keys are integers, booleans and
+// strings.
+Hash* mkHash(size_t capacity);
+int isHashable(Value);
+// Insert key, which must be hashable, or replace its value. A key keeps
+// the place where it was first inserted.
+void hashPut(Hash*, Value key, Value value);
+// The value of key, or null without one
+Value hashGet(const Hash*, Value key);
+
+// left[index] as an index expression gives it: an element of an array, a
+// character of a string, or the value of a key in a hash. Returns NULL, or
+// the format of the error when left cannot be indexed or index cannot be a
+// key, given the name of the type of *culprit.
+const char* indexValue(Value left, Value index, Value* result,
+                       ValueType* culprit);
+
+#endif //_MONKEY_LANG_SRC_COLLECTION_H_
@@ -0,0 +1,227 @@
+#define MAIN_TEST_NAME TestCollection
+
+#include "collection.h"
+#include "object.h"
+#include "rope.h"
+#include "testing.h"
+
+TEST(GrowArrays)
+{
+    int testStatus = TEST_SUCESSED;
+    Array* array   = mkArray(0);
+
+    for (int64_t i = 0; i < 1000; ++i)
+        arrayPush(array, INT_VALUE(i * 3));
+
+    if (array->len != 1000 || array->capacity < 1000)
+    {
+        PRINT_ERR("expected 1000 elements, got %zu of %zu", array->len,
+                  array->capacity);
+        testStatus = TEST_FAILED;
+    }
+    for (int64_t i = 0; i < 1000; ++i)
+    {
+        Value got = arrayGet(array, i);
+        if (got.type != VALUE_INT || got.as.integer != i * 3)
+        {
+            PRINT_ERR("element %d is not %d", (int)i, (int)(i * 3));
+            testStatus = TEST_FAILED;
+            break;
+        }
+    }
+    if (arrayGet(array, -1).type != VALUE_NULL
+        || arrayGet(array, 1000).type != VALUE_NULL)
+    {
+        PRINT_ERR("%s", "elements out of bounds are not null");
+        testStatus = TEST_FAILED;
+    }
+
+    freeObject(&array->object);
+    return testStatus;
+}
+
+TEST(GrowHashes)
+{
+    int testStatus = TEST_SUCESSED;
+    Hash* hash     = mkHash(0);
+
+    // Keys spread over every group, and over a single one in their low bits
+    for (int64_t i = 0; i < 20000; ++i)
+        hashPut(hash, INT_VALUE(i % 2 ? i : i << 20), INT_VALUE(i));
+    hashPut(hash, BOOL_VALUE(1), INT_VALUE(-1));
+    hashPut(hash, INT_VALUE(1), INT_VALUE(-2));
+
+    if (hash->len != 20001)
+    {
+        PRINT_ERR("expected 20001 pairs, got %zu", hash->len);
+        testStatus = TEST_FAILED;
+    }
+    for (int64_t i = 2; i < 20000; ++i)
+    {
+        Value got = hashGet(hash, INT_VALUE(i % 2 ? i : i << 20));
+        if (got.type != VALUE_INT || got.as.integer != i)
+        {
+            PRINT_ERR("key of pair %d lost its value", (int)i);
+            testStatus = TEST_FAILED;
+            break;
+        }
+    }
+
+    // true is not 1, and replacing a value keeps the place of its key
+    Value one = hashGet(hash, INT_VALUE(1));
+    Value yes = hashGet(hash, BOOL_VALUE(1));
+    if (one.as.integer != -2 || yes.as.integer != -1
+        || hash->entries[1].key.as.integer != 1
+        || hashGet(hash, INT_VALUE(20000)).type != VALUE_NULL
+        || hashGet(hash, BOOL_VALUE(0)).type != VALUE_NULL)
+    {
+        PRINT_ERR("1 = %d, true = %d", (int)one.as.integer,
+                  (int)yes.as.integer);
+        testStatus = TEST_FAILED;
+    }
+
+    freeObject(&hash->object);
+    return testStatus;
+}
+
+TEST(IndexValues)
+{
+    int testStatus = TEST_SUCESSED;
+    Array* array   = mkArray(2);
+    Hash* hash     = mkHash(1);
+    arrayPush(array, INT_VALUE(7));
+    hashPut(hash, BOOL_VALUE(0), INT_VALUE(8));
+
+    Value result      = NULL_VALUE;
+    ValueType culprit = VALUE_UNDEFINED;
+    if (indexValue(OBJECT_VALUE(VALUE_ARRAY, array), INT_VALUE(0), &result,
+                   &culprit)
+        || result.as.integer != 7
+        || indexValue(OBJECT_VALUE(VALUE_HASH, hash), BOOL_VALUE(0), &result,
+                      &culprit)
+        || result.as.integer != 8)
+    {
+        PRINT_ERR("%s", "cannot index an array or a hash");
+        testStatus = TEST_FAILED;
+    }
+
+    const char* error =
+        indexValue(OBJECT_VALUE(VALUE_HASH, hash),
+                   OBJECT_VALUE(VALUE_ARRAY, array), &result, &culprit);
+    if (!error || strcmp(error, UNUSABLE_HASH_KEY) != 0
+        || culprit != VALUE_ARRAY)
+    {
+        PRINT_ERR("an array is usable as a hash key: %s",
+                  error ? error : "no error");
+        testStatus = TEST_FAILED;
+    }
+    error = indexValue(INT_VALUE(1), INT_VALUE(0), &result, &culprit);
+    if (!error || strcmp(error, INDEX_NOT_SUPPORTED) != 0
+        || culprit != VALUE_INT)
+    {
+        PRINT_ERR("an integer can be indexed: %s",
+                  error ? error : "no error");
+        testStatus = TEST_FAILED;
+    }
+
+    freeObject(&array->object);
+    freeObject(&hash->object);
+    return testStatus;
+}
+
+TEST(FlattenRopes)
+{
+    int testStatus = TEST_SUCESSED;
+    size_t depth   = 200000;
+    Rope** nodes   = malloc(sizeof(Rope*) * depth);
+    Rope* piece    = mkRope("ab", 2);
+    Rope* rope     = piece;
+
+    // Deeper than the C stack could recurse, appending and prepending
+    for (size_t i = 0; i < depth; ++i)
+    {
+        rope     = i % 2 ? mkConcat(rope, piece) : mkConcat(piece, rope);
+        nodes[i] = rope;
+    }
+
+    Rope* last = ropeCharAt(rope, (int64_t)rope->len - 1);
+    if (rope->len != 2 * depth + 2 || !last || last->chars[0] != 'b'
+        || ropeCharAt(rope, (int64_t)rope->len) || ropeCharAt(rope, -1))
+    {
+        PRINT_ERR("indexing a rope of %zu characters fails", rope->len);
+        testStatus = TEST_FAILED;
+    }
+    if (rope->left || rope->right || strncmp(rope->chars, "abab", 4) != 0)
+    {
+        PRINT_ERR("%s", "a flattened rope keeps its halves");
+        testStatus = TEST_FAILED;
+    }
+
+    Rope* half = mkRope("ab", 2);
+    Rope* same = mkConcat(half, piece);
+    Rope* flat = mkRope("abab", 4);
+    if (!ropesEqual(same, flat) || ropeHash(same) != ropeHash(flat)
+        || ropeHash(flat) != hashChars("abab", 4) || ropesEqual(flat, piece))
+    {
+        PRINT_ERR("%s", "equal strings compare or hash differently");
+        testStatus = TEST_FAILED;
+    }
+
+    for (size_t i = 0; i < depth; ++i)
+        freeObject(&nodes[i]->object);
+    free(nodes);
+    freeObject(&piece->object);
+    freeObject(&half->object);
+    freeObject(&same->object);
+    freeObject(&flat->object);
+    return testStatus;
+}
+
+TEST(InternStrings)
+{
+    int testStatus     = TEST_SUCESSED;
+    InternTable* table = mkInternTable();
+    Rope* ropes[200];
+    char chars[8];
+
+    for (int i = 0; i < 200; ++i)
+    {
+        snprintf(chars, sizeof(chars), "s%d", i);
+        ropes[i] = mkRope(chars, strlen(chars));
+        addInterned(table, ropes[i]);
+    }
+
+    // Forgetting a string moves back those that probed past it
+    for (int i = 0; i < 200; i += 2)
+        forgetInterned(table, ropes[i]);
+
+    for (int i = 0; i < 200; ++i)
+    {
+        snprintf(chars, sizeof(chars), "s%d", i);
+        size_t len  = strlen(chars);
+        Rope* found = findInterned(table, chars, len, hashChars(chars, len));
+        if (found != (i % 2 ? ropes[i] : NULL) || ropes[i]->interned != i % 2)
+        {
+            PRINT_ERR("string %s is %s", chars,
+                      found ? "still interned" : "no longer interned");
+            testStatus = TEST_FAILED;
+            break;
+        }
+    }
+
+    for (int i = 0; i < 200; ++i)
+        freeObject(&ropes[i]->object);
+    freeInternTable(table);
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(GrowArrays);
+        RUN_TEST(GrowHashes);
+        RUN_TEST(IndexValues);
+        RUN_TEST(FlattenRopes);
+        RUN_TEST(InternStrings);
+    })
+
+#undef MAIN_TEST_NAME // End TestCollection
@@ -0,0 +1,429 @@
+#include <stdlib.h>
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "ast.h"
+#include "code.h"
+#include "compiler.h"
+#include "environment.h"
+#include "object.h"
+
+struct Compiler
+{
+    Environment* env;
+    CompiledFunction* fn;
+    size_t codeCapacity;
+    size_t constantCapacity;
+    size_t functionCapacity;
+    int depth; // operand stack depth at the end of the code so far
+    int failed;
+};
+
+/* Private Function Signatures */
+static void initCompiler(struct Compiler*, Environment*, CompiledFunction*);
+static size_t emit(struct Compiler*, Opcode, uint32_t);
+static void patchJump(struct Compiler*, size_t);
+static uint32_t addConstant(struct Compiler*, Value);
+static void compileBlock(struct Compiler*, BlockStmt*, Opcode);
+static void compileStmt(struct Compiler*, Stmt*, int, Opcode);
+static void compileExpr(struct Compiler*, Expr*);
+static void compileIdent(struct Compiler*, IdentExpr*);
+static void compileInfix(struct Compiler*, InfixExpr*);
+static void compileIf(struct Compiler*, IfExpr*);
+static void compileFunction(struct Compiler*, Expr*);
+static void compileCall(struct Compiler*, CallExpr*);
+static void compileList(struct Compiler*, Arguments*);
+static void compileError(struct Compiler*, const char*, const char*);
+
+CompiledFunction* compileProgram(Program* pProg, Environment* env)
+{
+    struct Compiler c;
+    initCompiler(&c, env, mkCompiledFunction(NULL));
+
+    // A program ending with `let` has no value, as in eval
+    compileBlock(&c, pProg, OP_UNDEFINED);
+    emit(&c, OP_RETURN, 0);
+    c.fn->callCaches = calloc(c.fn->numCallSites, sizeof(CallCache));
+
+    if (c.failed)
+    {
+        freeObject(&c.fn->object);
+        return NULL;
+    }
+
+    return c.fn;
+}
+
+static void initCompiler(struct Compiler* c, Environment* env,
+                         CompiledFunction* fn)
+{
+    c->env              = env;
+    c->fn               = fn;
+    c->codeCapacity     = 0;
+    c->constantCapacity = 0;
+    c->functionCapacity = 0;
+    c->depth            = 0;
+    c->failed           = 0;
+}
+
+static size_t emit(struct Compiler* c, Opcode op, uint32_t arg)
+{
+    CompiledFunction* fn = c->fn;
+
+    if (arg > MAX_OPERAND)
+    {
+        compileError(c, "operand out of range in ", opcodeName(op));
+        arg = 0;
+    }
+
+    if (fn->codeLen == c->codeCapacity)
+    {
+        c->codeCapacity = c->codeCapacity ? c->codeCapacity << 1 : 16;
+        fn->code = realloc(fn->code, sizeof(uint32_t) * c->codeCapacity);
+    }
+    fn->code[fn->codeLen] = MAKE_INSTR(op, arg);
+
+    c->depth += getStackEffect(op, arg);
+    if (c->depth > fn->maxStack)
+        fn->maxStack = c->depth;
+
+    return fn->codeLen++;
+}
+
+// Point a jump emitted earlier at the next instruction
+static void patchJump(struct Compiler* c, size_t at)
+{
+    Opcode op = INSTR_OP(c->fn->code[at]);
+    c->fn->code[at] = MAKE_INSTR(op, (uint32_t)c->fn->codeLen);
+}
+
+static uint32_t addConstant(struct Compiler* c, Value value)
+{
+    CompiledFunction* fn = c->fn;
+
+    for (size_t i = 0; i < fn->numConstants; ++i)
+    {
+        if (valuesEqual(fn->constants[i], value))
+            return (uint32_t)i;
+    }
+
+    if (fn->numConstants == c->constantCapacity)
+    {
+        c->constantCapacity = c->constantCapacity ? c->constantCapacity << 1
+                                                  : 8;
+        fn->constants = realloc(fn->constants,
+                                sizeof(Value) * c->constantCapacity);
+    }
+    fn->constants[fn->numConstants] = value;
+
+    return (uint32_t)fn->numConstants++;
+}
+
+// Leave the value of the last statement of the block on the stack, or the
+// value pushed by empty if there is none.
+static void compileBlock(struct Compiler* c, BlockStmt* pBlockStmt,
+                         Opcode empty)
+{
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    if (tmp == pBlockStmt->head)
+    {
+        emit(c, empty, 0);
+        return;
+    }
+
+    while (tmp != pBlockStmt->head)
+    {
+        compileStmt(c, tmp->value, tmp->before == pBlockStmt->head, empty);
+        tmp = tmp->before;
+    }
+}
+
+static void compileStmt(struct Compiler* c, Stmt* pStmt, int wantValue,
+                        Opcode empty)
+{
+    if (!pStmt->inner.checkIsNull)
+    {
+        if (wantValue)
+            emit(c, empty, 0);
+        return;
+    }
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+    {
+        IdentExpr* name = pStmt->inner.letStmt->name;
+        compileExpr(c, pStmt->inner.letStmt->value);
+        emit(c, name->kind == RESOLVE_GLOBAL ? OP_SET_GLOBAL : OP_SET_LOCAL,
+             (uint32_t)name->slot);
+        if (wantValue)
+            emit(c, empty, 0);
+        break;
+    }
+
+    case STMT_RETURN:
+        compileExpr(c, pStmt->inner.returnStmt->returnValue);
+        emit(c, OP_RETURN, 0);
+        // Nothing follows at run time, but the enclosing code expects a
+        // value
+        if (wantValue)
+            ++c->depth;
+        break;
+
+    case STMT_EXPRESSION:
+        compileExpr(c, pStmt->inner.exprStmt->expression);
+        if (!wantValue)
+            emit(c, OP_POP, 0);
+        break;
+
+    case STMT_BLOCK:
+        compileBlock(c, pStmt->inner.blockStmt, empty);
+        if (!wantValue)
+            emit(c, OP_POP, 0);
+        break;
+
+    default:
+        if (wantValue)
+            emit(c, empty, 0);
+        break;
+    }
+}
+
+static void compileExpr(struct Compiler* c, Expr* pExpr)
+{
+    if (!pExpr || !pExpr->inner.checkIsNull)
+    {
+        emit(c, OP_NULL, 0);
+        return;
+    }
+
+    switch (pExpr->type)
+    {
+    case EXPR_IDENT:
+        compileIdent(c, pExpr->inner.identExpr);
+        break;
+
+    case EXPR_INTEGER:
+        emit(c, OP_CONSTANT,
+             addConstant(c, INT_VALUE(pExpr->inner.intExpr->value)));
+        break;
+
+    case EXPR_BOOL:
+        emit(c, pExpr->inner.boolExpr->value ? OP_TRUE : OP_FALSE, 0);
+        break;
+
+    case EXPR_STRING:
+    {
+        String* value = pExpr->inner.stringExpr->value;
+        Rope* rope = newConstantString(c->env, getStr(value), getLen(value));
+        emit(c, OP_CONSTANT,
+             addConstant(c, OBJECT_VALUE(VALUE_STRING, rope)));
+        break;
+    }
+
+    case EXPR_PREFIX:
+        compileExpr(c, pExpr->inner.prefixExpr->right);
+        emit(c, getStr(pExpr->inner.prefixExpr->opt)[0] == '!' ? OP_BANG
+                                                               : OP_MINUS,
+             0);
+        break;
+
+    case EXPR_INFIX:
+        compileInfix(c, pExpr->inner.infixExpr);
+        break;
+
+    case EXPR_IF:
+        compileIf(c, pExpr->inner.ifExpr);
+        break;
+
+    case EXPR_FUNCTION:
+        compileFunction(c, pExpr);
+        break;
+
+    case EXPR_CALL:
+        compileCall(c, pExpr->inner.callExpr);
+        break;
+
+    case EXPR_ARRAY:
+        compileList(c, pExpr->inner.arrayExpr->elements);
+        emit(c, OP_ARRAY, (uint32_t)pExpr->inner.arrayExpr->elements->len);
+        break;
+
+    case EXPR_HASH:
+        compileList(c, pExpr->inner.hashExpr->pairs);
+        emit(c, OP_HASH, (uint32_t)pExpr->inner.hashExpr->pairs->len / 2);
+        break;
+
+    case EXPR_INDEX:
+        compileExpr(c, pExpr->inner.indexExpr->left);
+        compileExpr(c, pExpr->inner.indexExpr->index);
+        emit(c, OP_INDEX, 0);
+        break;
+
+    default:
+        emit(c, OP_NULL, 0);
+        break;
+    }
+}
+
+static void compileIdent(struct Compiler* c, IdentExpr* pIdentExpr)
+{
+    switch (pIdentExpr->kind)
+    {
+    case RESOLVE_GLOBAL:
+        emit(c, OP_GET_GLOBAL, (uint32_t)pIdentExpr->slot);
+        break;
+    case RESOLVE_LOCAL:
+        emit(c, OP_GET_LOCAL, (uint32_t)pIdentExpr->slot);
+        break;
+    case RESOLVE_CAPTURE:
+        emit(c, OP_GET_CAPTURE, (uint32_t)pIdentExpr->slot);
+        break;
+    default:
+        compileError(c, "identifier not found: ", getStr(pIdentExpr->value));
+        emit(c, OP_NULL, 0);
+        break;
+    }
+}
+
+static void compileInfix(struct Compiler* c, InfixExpr* pInfixExpr)
+{
+    compileExpr(c, pInfixExpr->left);
+    compileExpr(c, pInfixExpr->right);
+
+    const char* opt = getStr(pInfixExpr->opt);
+    switch (opt[0])
+    {
+    case '+':
+        emit(c, OP_ADD, 0);
+        break;
+    case '-':
+        emit(c, OP_SUB, 0);
+        break;
+    case '*':
+        emit(c, OP_MUL, 0);
+        break;
+    case '/':
+        emit(c, OP_DIV, 0);
+        break;
+    case '<':
+        emit(c, OP_LT, 0);
+        break;
+    case '>':
+        emit(c, OP_GT, 0);
+        break;
+    case '=':
+        emit(c, OP_EQ, 0);
+        break;
+    case '!':
+        emit(c, OP_NE, 0);
+        break;
+    default:
+        compileError(c, "unknown operator: ", opt);
+        break;
+    }
+}
+
+static void compileIf(struct Compiler* c, IfExpr* pIfExpr)
+{
+    compileExpr(c, pIfExpr->condition);
+    size_t jumpToElse = emit(c, OP_JUMP_FALSY, 0);
+
+    compileBlock(c, pIfExpr->consequence, OP_NULL);
+    size_t jumpToEnd = emit(c, OP_JUMP, 0);
+
+    // Only one branch runs: the alternative starts from the depth before
+    // the consequence pushed its value
+    --c->depth;
+    patchJump(c, jumpToElse);
+    if (pIfExpr->alternative)
+        compileBlock(c, pIfExpr->alternative, OP_NULL);
+    else
+        emit(c, OP_NULL, 0);
+
+    patchJump(c, jumpToEnd);
+}
+
+static void compileFunction(struct Compiler* c, Expr* pExpr)
+{
+    FntExpr* fntExpr = pExpr->inner.fntExpr;
+    struct Compiler inner;
+    initCompiler(&inner, c->env, mkCompiledFunction(pExpr));
+    inner.failed = c->failed; // keep the first error
+
+    CompiledFunction* fn = inner.fn;
+    fn->numParams        = (int)fntExpr->parameters->len;
+    fn->firstParam       = fntExpr->selfSlot >= 0 ? 1 : 0;
+    fn->frameSize        = fntExpr->numLocals;
+    if (fn->frameSize < fn->firstParam + fn->numParams)
+        fn->frameSize = fn->firstParam + fn->numParams;
+
+    // Arguments arrive in consecutive slots. A parameter repeating an
+    // earlier name shares its slot, and takes the later argument.
+    int i                 = 0;
+    struct ParamNode* tmp = fntExpr->parameters->tail->before;
+    while (tmp != fntExpr->parameters->head)
+    {
+        uint32_t arrived = (uint32_t)(fn->firstParam + i++);
+        if ((uint32_t)tmp->value->slot != arrived)
+        {
+            emit(&inner, OP_GET_LOCAL, arrived);
+            emit(&inner, OP_SET_LOCAL, (uint32_t)tmp->value->slot);
+        }
+        tmp = tmp->before;
+    }
+
+    compileBlock(&inner, fntExpr->body, OP_NULL);
+    emit(&inner, OP_RETURN, 0);
+    fn->callCaches = calloc(fn->numCallSites, sizeof(CallCache));
+
+    trackObject(c->env, &fn->object);
+    if (inner.failed)
+        c->failed = 1;
+
+    CompiledFunction* parent = c->fn;
+    if (parent->numFunctions == c->functionCapacity)
+    {
+        c->functionCapacity = c->functionCapacity ? c->functionCapacity << 1
+                                                  : 4;
+        parent->functions = realloc(parent->functions,
+                                    sizeof(CompiledFunction*)
+                                        * c->functionCapacity);
+    }
+    parent->functions[parent->numFunctions] = fn;
+
+    emit(c, OP_CLOSURE, (uint32_t)parent->numFunctions++);
+}
+
+static void compileCall(struct Compiler* c, CallExpr* pCallExpr)
+{
+    compileExpr(c, pCallExpr->function);
+    compileList(c, pCallExpr->arguments);
+
+    size_t site = c->fn->numCallSites++;
+    if (pCallExpr->arguments->len > MAX_CALL_ARGS)
+        compileError(c, "too many arguments in a call", "");
+    else if (site > MAX_CALL_SITES)
+        compileError(c, "too many calls in a function", "");
+    else
+        emit(c, pCallExpr->tail ? OP_TAIL_CALL : OP_CALL,
+             CALL_OPERAND(pCallExpr->arguments->len, site));
+}
+
+// Push the values of the expressions in order
+static void compileList(struct Compiler* c, Arguments* list)
+{
+    struct ArgNode* tmp = list->tail->before;
+    while (tmp != list->head)
+    {
+        compileExpr(c, tmp->value);
+        tmp = tmp->before;
+    }
+}
+
+static void compileError(struct Compiler* c, const char* msg,
+                         const char* detail)
+{
+    if (!c->failed)
+        setEnvError(c->env, "%s%s", msg, detail);
+    c->failed = 1;
+}
@@ -0,0 +1,19 @@
+#ifndef _MONKEY_LANG_SRC_COMPILER_H_
+#define _MONKEY_LANG_SRC_COMPILER_H_
+
+#include "ast.h"
+#include "environment.h"
+#include "object.h"
+
+// Compile a program that went through resolveProgram, with the resolver of
+// env, and analyzeCaptures, to bytecode for runBytecode. Identifiers
+// become slot operands and literals entries of a constant pool, so the VM
+// never looks at the AST.
+//
+// The function literals of the program are compiled once, up front, and
+// tracked by env like any other object. The returned program is owned by
+// the caller, who frees it with freeObject. Returns NULL, with an error for
+// getEvalError, if the program cannot be compiled.
+CompiledFunction* compileProgram(Program*, Environment*);
+
+#endif //_MONKEY_LANG_SRC_COMPILER_H_
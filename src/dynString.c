@@ -37,6 +37,18 @@ struct String* mkNString(const char* str, size_t strLen)
     return string;
 }
 
+struct String* mkStringWithCapacity(size_t capacity)
+{
+    struct String* string = malloc(sizeof(struct String));
+
+    string->capacity = capacity + 1;
+    string->len = 0;
+    string->inner = malloc(string->capacity);
+    string->inner[0] = '\0';
+
+    return string;
+}
+
 void freeString(struct String* pString)
 {
     if (!pString)
@@ -46,6 +58,20 @@ void freeString(struct String* pString)
     free(pString);
 }
 
+void reserveString(struct String* pString, size_t additional)
+{
+    size_t needed = pString->len + additional + 1;
+    if (needed <= pString->capacity)
+        return;
+
+    // Grow geometrically so that repeated appends stay amortized O(1),
+    // but never by more than what is actually requested on top of that.
+    pString->capacity <<= 1;
+    if (pString->capacity < needed)
+        pString->capacity = needed;
+    pString->inner = realloc(pString->inner, pString->capacity);
+}
+
 void appendChar(struct String* pString, char chr)
 {
     if (pString->len + 1 >= pString->capacity)
@@ -60,11 +86,7 @@ void appendChar(struct String* pString, char chr)
 void appendStr(struct String* pString, const char* str)
 {
     size_t strLen = strlen(str);
-    if (pString->len + strLen + 1 >= pString->capacity)
-    {
-        pString->capacity = (pString->capacity + strLen + 1) << 1;
-        pString->inner = realloc(pString->inner, pString->capacity);
-    }
+    reserveString(pString, strLen);
     memcpy(pString->inner + pString->len, str, strLen);
     pString->inner[pString->len + strLen] = '\0';
     pString->len += strLen;
@@ -72,11 +94,7 @@ void appendStr(struct String* pString, const char* str)
 
 void appendNStr(struct String* pString, const char* str, size_t strLen)
 {
-    if (pString->len + strLen + 1 >= pString->capacity)
-    {
-        pString->capacity = (pString->capacity + strLen + 1) << 1;
-        pString->inner = realloc(pString->inner, pString->capacity);
-    }
+    reserveString(pString, strLen);
     memcpy(pString->inner + pString->len, str, strLen);
     pString->inner[pString->len + strLen] = '\0';
     pString->len += strLen;
@@ -87,11 +105,7 @@ void concatString(struct String* pString1, struct String* pString2)
     if (!pString1 || !pString2)
         return;
 
-    if (pString1->len + pString2->len + 1 >= pString1->capacity)
-    {
-        pString1->capacity = (pString1->capacity + pString2->len + 1) << 1;
-        pString1->inner = realloc(pString1->inner, pString1->capacity);
-    }
+    reserveString(pString1, pString2->len);
     memcpy(pString1->inner + pString1->len, pString2->inner, pString2->len);
     pString1->inner[pString1->len + pString2->len] = '\0';
     pString1->len += pString2->len;
@@ -142,3 +156,22 @@ size_t getLen(const struct String* pString)
         return 0;
     return pString->len;
 }
+
+// FNV-1a, finished like a splitmix step so that every bit of the result
+// depends on every character, whichever bits a table indexes with
+uint64_t hashChars(const char* chars, size_t len)
+{
+    uint64_t x = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i)
+        x = (x ^ (unsigned char)chars[i]) * 1099511628211ULL;
+
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x ? x : 1;
+}
+
+uint64_t hashString(const struct String* pString)
+{
+    return hashChars(pString->inner, pString->len);
+}
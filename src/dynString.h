@@ -2,14 +2,18 @@
 #define _MONKEY_LANG_SRC_DYNSTRING_H_
 
 #include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef struct String String;
 
 String* mkString(const char*);
 String* mkNString(const char*, size_t);
+String* mkStringWithCapacity(size_t);
 
 void freeString(String*);
 
+void reserveString(String*, size_t);
 void appendChar(String*, char);
 void appendStr(String*, const char*);
 void appendNStr(String*, const char*, size_t);
@@ -23,4 +27,9 @@ int cmpStrString(const char*, const String*);
 const char* getStr(const String*);
 size_t getLen(const String*);
 
+// The one string hash of the interpreter, for symbol tables as well as
+// string values. Never 0, which callers may keep for "not computed".
+uint64_t hashChars(const char* chars, size_t len);
+uint64_t hashString(const String*);
+
 #endif //_MONKEY_LANG_SRC_DYNSTRING_H_
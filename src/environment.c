@@ -0,0 +1,155 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "environment.h"
+#include "memo.h"
+#include "rope.h"
+
+#define INITIAL_STACK_CAPACITY 1024
+
+Environment* mkEnvironment(void)
+{
+    Environment* output = malloc(sizeof(Environment));
+
+    output->resolver  = mkResolver();
+    output->globals   = NULL;
+    output->globalLen = 0;
+
+    output->stackCapacity = INITIAL_STACK_CAPACITY;
+    output->stackLen      = 0;
+    output->stack         = malloc(sizeof(Value) * output->stackCapacity);
+
+    output->objects     = NULL;
+    output->objectCount = 0;
+    output->error       = NULL;
+    output->strings     = mkInternTable();
+    output->profile     = NULL;
+
+    output->roots          = NULL;
+    output->rootLen        = 0;
+    output->rootCapacity   = 0;
+    output->gray           = NULL;
+    output->grayLen        = 0;
+    output->grayCapacity   = 0;
+    output->cached         = NULL;
+    output->cachedLen      = 0;
+    output->cachedCapacity = 0;
+    output->unswept        = NULL;
+    output->heapGrowth     = GC_DEFAULT_GROWTH;
+    output->markBudget     = 0;
+    output->marking        = 0;
+    output->sweeping       = 0;
+    memset(&output->gcStats, 0, sizeof(GCStats));
+    output->gcStats.nextCollection = GC_MIN_HEAP;
+
+    initNursery(output);
+
+    output->remembered         = NULL;
+    output->rememberedLen      = 0;
+    output->rememberedCapacity = 0;
+
+    output->jitThreshold  = 0;
+    output->nativeDepth   = 0;
+    output->callDepth     = 0;
+    output->frames        = NULL;
+    output->frameLen      = 0;
+    output->frameCapacity = 0;
+    output->tailCalls     = 0;
+    output->memo          = NULL;
+
+    return output;
+}
+
+void freeEnvironment(Environment* env)
+{
+    if (!env)
+        return;
+
+    // Along with the objects an incremental collection has yet to sweep
+    Object* lists[] = {env->objects, env->unswept};
+    for (size_t i = 0; i < 2; ++i)
+    {
+        Object* tmp = lists[i];
+        while (tmp)
+        {
+            Object* next = tmp->next;
+            freeObject(tmp);
+            tmp = next;
+        }
+    }
+    freeNursery(env);
+    freeInternTable(env->strings);
+    setMemoCapacity(env, 0);
+
+    freeResolver(env->resolver);
+    free(env->roots);
+    free(env->gray);
+    free(env->cached);
+    free(env->remembered);
+    free(env->globals);
+    free(env->stack);
+    free(env->frames);
+    freeString(env->error);
+    free(env);
+}
+
+Resolver* getResolver(Environment* env) { return env->resolver; }
+
+size_t getObjectCount(const Environment* env)
+{
+    return env->objectCount + env->youngCount;
+}
+
+size_t getTailCallCount(const Environment* env) { return env->tailCalls; }
+
+String* getEvalError(Environment* env)
+{
+    String* output = env->error;
+    env->error     = NULL;
+    return output;
+}
+
+void reserveGlobals(Environment* env)
+{
+    size_t globalLen = (size_t)getGlobalCount(env->resolver);
+    if (globalLen <= env->globalLen)
+        return;
+
+    env->globals = realloc(env->globals, sizeof(Value) * globalLen);
+    memset(env->globals + env->globalLen, 0,
+           sizeof(Value) * (globalLen - env->globalLen));
+    env->globalLen = globalLen;
+}
+
+size_t pushFrame(Environment* env, size_t n)
+{
+    size_t base = env->stackLen;
+
+    if (base + n > env->stackCapacity)
+    {
+        while (base + n > env->stackCapacity)
+            env->stackCapacity <<= 1;
+        env->stack = realloc(env->stack, sizeof(Value) * env->stackCapacity);
+    }
+
+    memset(env->stack + base, 0, sizeof(Value) * n);
+    env->stackLen = base + n;
+
+    return base;
+}
+
+void setEnvError(Environment* env, const char* fmt, ...)
+{
+    char msg[128];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    freeString(env->error);
+    env->error = mkString(msg);
+}
@@ -0,0 +1,184 @@
+#ifndef _MONKEY_LANG_SRC_ENVIRONMENT_H_
+#define _MONKEY_LANG_SRC_ENVIRONMENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gc.h"
+#include "object.h"
+#include "resolver.h"
+
+// Everything that outlives a single program: the resolver that assigns
+// global slots, the global values, the stack of call frames and the heap
+// objects. A REPL evaluates every line in the same Environment.
+typedef struct Environment Environment;
+
+Environment* mkEnvironment(void);
+void freeEnvironment(Environment*);
+
+// Programs evaluated in an Environment must be resolved with its resolver
+Resolver* getResolver(Environment*);
+// Number of heap objects the environment holds
+size_t getObjectCount(const Environment*);
+// Number of calls in tail position that took over the frame of their
+// caller, by every engine, since the environment was made
+size_t getTailCallCount(const Environment*);
+
+// Message of the error that stopped the last program run in env, by any
+// engine, or NULL. The caller owns the returned String.
+String* getEvalError(Environment*);
+
+#ifdef __PRIVATE_ENVIRONMENT_OBJECTS__
+
+struct Environment
+{
+    Resolver* resolver;
+
+    Value* globals;
+    size_t globalLen;
+
+    // Frames of locals, one above the other. A frame is addressed by the
+    // index of its first slot, since the stack moves when it grows.
+    Value* stack;
+    size_t stackLen;
+    size_t stackCapacity;
+
+    Object* objects;
+    size_t objectCount;
+    String* error;
+
+    // The short strings among the objects, see rope.h
+    struct InternTable* strings;
+
+    // Collector state, see gc.h. Roots are the objects pinned by pushRoot;
+    // gray holds the objects marked, or promoted, and not yet traced.
+    // Traced functions with call sites have their caches pruned before the
+    // sweep, which frees the unswept objects still unmarked.
+    Object** roots;
+    size_t rootLen;
+    size_t rootCapacity;
+    Object** gray;
+    size_t grayLen;
+    size_t grayCapacity;
+    CompiledFunction** cached;
+    size_t cachedLen;
+    size_t cachedCapacity;
+    Object* unswept;
+    double heapGrowth;
+    size_t markBudget;
+    int marking;  // an incremental collection is marking
+    int sweeping; // and then sweeping
+    GCStats gcStats;
+
+    // Closures are bump-allocated in nursery[0, nurseryTop), in 16-byte
+    // steps. Remembered old objects may refer to young closures, which
+    // hold no reference to their function: the nursery holds one for each
+    // function in youngFunctions, until it is emptied.
+    char* nursery;
+    size_t nurseryTop;
+    size_t nurserySize;
+    size_t youngCount;
+    Expr** youngFunctions;
+    size_t youngFunctionLen;
+    size_t youngFunctionCapacity;
+    size_t nurseryEpoch; // of this filling, unique to it
+    Object** remembered;
+    size_t rememberedLen;
+    size_t rememberedCapacity;
+
+    // Calls after which the bytecode VM compiles a function to native
+    // code, or 0, and the native calls running on the C stack
+    int jitThreshold;
+    int nativeDepth;
+
+    // Calls of eval and the closure compiler running on the C stack, which
+    // each bounds so that a deep recursion fails instead of crashing
+    int callDepth;
+
+    // Call frames of the bytecode VM, see vm.c, kept from run to run
+    struct CallFrame* frames;
+    size_t frameLen;
+    size_t frameCapacity;
+
+    // Calls that took over the frame of their caller, by every engine
+    size_t tailCalls;
+
+    // Results of calls of pure functions, see memo.h, or NULL
+    struct MemoTable* memo;
+
+    // Counts of the bytecode VM, kept in builds with MONKEY_PROFILE_DISPATCH
+    struct DispatchProfile* profile;
+};
+
+// Make room for every global slot the resolver has handed out
+void reserveGlobals(Environment*);
+// Push a frame of n undefined slots and return its base
+size_t pushFrame(Environment*, size_t n);
+// Hand an object made by a compiler to env, which frees it once it is
+// unreachable
+void trackObject(Environment*, Object*);
+// A closure of function, in the nursery while there is room, whose
+// captures are left for the caller to set. Allocating may collect, moving
+// young closures, so the engines keep every value they hold on the stack,
+// in a global or pinned, set stackLen above the live slots, and read them
+// back afterwards.
+Closure* newClosure(Environment*, Expr* function);
+// An empty array or hash with room for capacity elements or pairs, in the
+// old space, which may collect like newClosure. The engines pin it while
+// they fill it in, through WRITE_BARRIER, and keep within its capacity.
+Array* newArray(Environment*, size_t capacity);
+Hash* newHash(Environment*, size_t capacity);
+// A string of len characters copied from chars, which must not be those of
+// a string env may free, in the old space, which may collect like newArray.
+// A short string is the one interned with the same characters, if any.
+Rope* newString(Environment*, const char* chars, size_t len);
+// A string constant of a compiler, made as newString does but without
+// collecting, since the function it goes into is not tracked yet
+Rope* newConstantString(Environment*, const char* chars, size_t len);
+// left followed by right, a concatenation unless the result is short.
+// Both are kept alive while it may collect.
+Rope* newConcat(Environment*, Rope* left, Rope* right);
+// Keep an object, and what it refers to, alive until the matching popRoot.
+// NULL is allowed, to keep the pairs simple. Returns the index of the
+// root, where env->roots has the object once a collection moved it.
+size_t pushRoot(Environment*, Object*);
+void popRoot(Environment*);
+void rememberObject(Environment*, Object*);
+// Mark an old object gray while the old space is being marked
+void shadeObject(Environment*, Object*);
+// Drop an object that env does not own from the remembered set, before
+// its owner frees it
+void forgetObject(Environment*, Object*);
+// Make the nursery of a new environment
+void initNursery(Environment*);
+// Release the young closures and the nursery of an environment being freed
+void freeNursery(Environment*);
+
+#define IS_YOUNG(env, pObject)                                               \
+    ((uintptr_t)(pObject) - (uintptr_t)(env)->nursery < (env)->nurserySize)
+
+// Write barrier: value was stored in holder. An old holder of a young
+// closure is a root of the next minor collection, and a white object
+// stored into a marked holder is shaded. Only marking leaves objects
+// marked.
+#define WRITE_BARRIER(env, holder, value)                                    \
+    do                                                                       \
+    {                                                                        \
+        if (!IS_OBJECT_VALUE(value))                                         \
+            break;                                                           \
+        if (IS_YOUNG(env, (value).as.object))                                \
+        {                                                                    \
+            if (!(holder)->remembered && !IS_YOUNG(env, holder))             \
+                rememberObject(env, holder);                                 \
+        }                                                                    \
+        else if ((holder)->marked && !(value).as.object->marked)             \
+        {                                                                    \
+            shadeObject(env, (value).as.object);                             \
+        }                                                                    \
+    } while (0)
+// Replace the error reported by getEvalError
+void setEnvError(Environment*, const char* fmt, ...);
+
+#endif // __PRIVATE_ENVIRONMENT_OBJECTS__
+
+#endif //_MONKEY_LANG_SRC_ENVIRONMENT_H_
@@ -0,0 +1,570 @@
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "ast.h"
+#include "collection.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "memo.h"
+#include "object.h"
+
+// Calls nest on the C stack, each taking about 1 KB of it, 2 KB with
+// sanitizers; deeper ones fail with a stack overflow
+#define MAX_CALL_DEPTH 3000
+
+typedef enum
+{
+    EVAL_OK = 0,
+    EVAL_RETURN,    // a `return` is unwinding to the enclosing call
+    EVAL_TAIL_CALL, // a call took over the frame, and is left to run
+    EVAL_ERROR,
+} EvalStatus;
+
+struct Evaluator
+{
+    Environment* env;
+    size_t base;        // frame of the function being run
+    size_t closureRoot; // root of the function being run, see pushRoot
+    EvalStatus status;
+};
+
+#define CURRENT_CLOSURE(e) ((Closure*)(e)->env->roots[(e)->closureRoot])
+
+/* Private Function Signatures */
+static Value evalBlock(struct Evaluator*, BlockStmt*);
+static Value evalStmt(struct Evaluator*, Stmt*);
+static Value evalExpr(struct Evaluator*, Expr*);
+static Value evalIdent(struct Evaluator*, IdentExpr*);
+static Value evalPrefix(struct Evaluator*, PrefixExpr*);
+static Value evalInfix(struct Evaluator*, InfixExpr*);
+static Value evalIntInfix(struct Evaluator*, const char*, int64_t, int64_t);
+static Value evalIf(struct Evaluator*, IfExpr*);
+static Value evalFunction(struct Evaluator*, Expr*);
+static Value evalCall(struct Evaluator*, CallExpr*);
+static Value evalArray(struct Evaluator*, ArrayExpr*);
+static Value evalHash(struct Evaluator*, HashExpr*);
+static Value evalIndex(struct Evaluator*, IndexExpr*);
+static int memoKeyOf(Environment*, Closure*, size_t, MemoKey*);
+static Value runtimeError(struct Evaluator*, const char*, ...);
+
+Value eval(Program* pProg, Environment* env)
+{
+    struct Evaluator e = {env, 0, 0, EVAL_OK};
+
+    freeString(env->error);
+    env->error     = NULL;
+    env->stackLen  = 0;
+    env->callDepth = 0;
+    reserveGlobals(env);
+
+    Value result = evalBlock(&e, pProg);
+
+    // An error leaves no value, while a top-level `return` ends the
+    // program with its own
+    if (e.status == EVAL_ERROR)
+        result = UNDEFINED_VALUE;
+    env->stackLen = 0;
+
+    return result;
+}
+
+static Value evalBlock(struct Evaluator* e, BlockStmt* pBlockStmt)
+{
+    Value result         = UNDEFINED_VALUE;
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+
+    while (tmp != pBlockStmt->head)
+    {
+        result = evalStmt(e, tmp->value);
+        if (e->status != EVAL_OK)
+            break;
+        tmp = tmp->before;
+    }
+
+    return result;
+}
+
+static Value evalStmt(struct Evaluator* e, Stmt* pStmt)
+{
+    if (!pStmt->inner.checkIsNull)
+        return UNDEFINED_VALUE;
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+    {
+        LetStmt* letStmt = pStmt->inner.letStmt;
+        Value value      = evalExpr(e, letStmt->value);
+        if (e->status != EVAL_OK)
+            return value;
+
+        if (letStmt->name->kind == RESOLVE_GLOBAL)
+        {
+            Value* global = &e->env->globals[letStmt->name->slot];
+            if (e->env->memo && global->type != VALUE_UNDEFINED)
+                forgetMemo(e->env);
+            *global = value;
+        }
+        else
+            e->env->stack[e->base + (size_t)letStmt->name->slot] = value;
+
+        return UNDEFINED_VALUE;
+    }
+
+    case STMT_RETURN:
+    {
+        Value value = evalExpr(e, pStmt->inner.returnStmt->returnValue);
+        if (e->status == EVAL_OK)
+            e->status = EVAL_RETURN;
+        return value;
+    }
+
+    case STMT_EXPRESSION:
+        return evalExpr(e, pStmt->inner.exprStmt->expression);
+
+    case STMT_BLOCK:
+        return evalBlock(e, pStmt->inner.blockStmt);
+
+    default:
+        return UNDEFINED_VALUE;
+    }
+}
+
+static Value evalExpr(struct Evaluator* e, Expr* pExpr)
+{
+    if (!pExpr || !pExpr->inner.checkIsNull)
+        return NULL_VALUE;
+
+    switch (pExpr->type)
+    {
+    case EXPR_IDENT:
+        return evalIdent(e, pExpr->inner.identExpr);
+
+    case EXPR_INTEGER:
+        return INT_VALUE(pExpr->inner.intExpr->value);
+
+    case EXPR_BOOL:
+        return BOOL_VALUE(pExpr->inner.boolExpr->value);
+
+    case EXPR_STRING:
+    {
+        String* value = pExpr->inner.stringExpr->value;
+        return OBJECT_VALUE(VALUE_STRING,
+                            newString(e->env, getStr(value), getLen(value)));
+    }
+
+    case EXPR_PREFIX:
+        return evalPrefix(e, pExpr->inner.prefixExpr);
+
+    case EXPR_INFIX:
+        return evalInfix(e, pExpr->inner.infixExpr);
+
+    case EXPR_IF:
+        return evalIf(e, pExpr->inner.ifExpr);
+
+    case EXPR_FUNCTION:
+        return evalFunction(e, pExpr);
+
+    case EXPR_CALL:
+        return evalCall(e, pExpr->inner.callExpr);
+
+    case EXPR_ARRAY:
+        return evalArray(e, pExpr->inner.arrayExpr);
+
+    case EXPR_HASH:
+        return evalHash(e, pExpr->inner.hashExpr);
+
+    case EXPR_INDEX:
+        return evalIndex(e, pExpr->inner.indexExpr);
+
+    default:
+        return NULL_VALUE;
+    }
+}
+
+static Value evalIdent(struct Evaluator* e, IdentExpr* pIdentExpr)
+{
+    size_t slot = (size_t)pIdentExpr->slot;
+
+    switch (pIdentExpr->kind)
+    {
+    case RESOLVE_GLOBAL:
+        if (slot < e->env->globalLen
+            && e->env->globals[slot].type != VALUE_UNDEFINED)
+            return e->env->globals[slot];
+        break;
+
+    case RESOLVE_LOCAL:
+        return e->env->stack[e->base + slot];
+
+    case RESOLVE_CAPTURE:
+        return CURRENT_CLOSURE(e)->captures[slot];
+
+    default:
+        break;
+    }
+
+    return runtimeError(e, "identifier not found: %s",
+                        getStr(pIdentExpr->value));
+}
+
+static Value evalPrefix(struct Evaluator* e, PrefixExpr* pPrefixExpr)
+{
+    Value right = evalExpr(e, pPrefixExpr->right);
+    if (e->status != EVAL_OK)
+        return right;
+
+    const char* opt = getStr(pPrefixExpr->opt);
+    if (opt[0] == '!')
+        return BOOL_VALUE(!isTruthy(right));
+
+    if (opt[0] == '-' && right.type == VALUE_INT)
+        return INT_VALUE((int64_t)(0 - (uint64_t)right.as.integer));
+
+    return runtimeError(e, "unknown operator: %s%s", opt,
+                        valueTypeName(right.type));
+}
+
+static Value evalInfix(struct Evaluator* e, InfixExpr* pInfixExpr)
+{
+    Value left = evalExpr(e, pInfixExpr->left);
+    if (e->status != EVAL_OK)
+        return left;
+
+    // The left operand may be the only reference to an object, which a
+    // collection may free or move
+    size_t leftRoot =
+        pushRoot(e->env, IS_OBJECT_VALUE(left) ? left.as.object : NULL);
+    Value right = evalExpr(e, pInfixExpr->right);
+    if (IS_OBJECT_VALUE(left))
+        left.as.object = e->env->roots[leftRoot];
+    popRoot(e->env);
+    if (e->status != EVAL_OK)
+        return right;
+
+    const char* opt = getStr(pInfixExpr->opt);
+    if (left.type == VALUE_INT && right.type == VALUE_INT)
+        return evalIntInfix(e, opt, left.as.integer, right.as.integer);
+    if (left.type == VALUE_STRING && right.type == VALUE_STRING
+        && opt[0] == '+')
+        return OBJECT_VALUE(VALUE_STRING,
+                            newConcat(e->env, (Rope*)left.as.object,
+                                      (Rope*)right.as.object));
+
+    if ((opt[0] == '=' || opt[0] == '!') && opt[1] == '=')
+    {
+        int equal = valuesEqual(left, right);
+        return BOOL_VALUE(opt[0] == '=' ? equal : !equal);
+    }
+
+    if (left.type != right.type)
+        return runtimeError(e, "type mismatch: %s %s %s",
+                            valueTypeName(left.type), opt,
+                            valueTypeName(right.type));
+
+    return runtimeError(e, "unknown operator: %s %s %s",
+                        valueTypeName(left.type), opt,
+                        valueTypeName(right.type));
+}
+
+// Arithmetic wraps around on overflow
+static Value evalIntInfix(struct Evaluator* e, const char* opt, int64_t left,
+                          int64_t right)
+{
+    switch (opt[0])
+    {
+    case '+':
+        return INT_VALUE((int64_t)((uint64_t)left + (uint64_t)right));
+    case '-':
+        return INT_VALUE((int64_t)((uint64_t)left - (uint64_t)right));
+    case '*':
+        return INT_VALUE((int64_t)((uint64_t)left * (uint64_t)right));
+    case '/':
+        if (right == 0)
+            return runtimeError(e, "division by zero");
+        if (left == INT64_MIN && right == -1)
+            return INT_VALUE(INT64_MIN);
+        return INT_VALUE(left / right);
+    case '<':
+        return BOOL_VALUE(left < right);
+    case '>':
+        return BOOL_VALUE(left > right);
+    case '=':
+        return BOOL_VALUE(left == right);
+    case '!':
+        return BOOL_VALUE(left != right);
+    default:
+        return runtimeError(e, "unknown operator: INTEGER %s INTEGER", opt);
+    }
+}
+
+static Value evalIf(struct Evaluator* e, IfExpr* pIfExpr)
+{
+    Value condition = evalExpr(e, pIfExpr->condition);
+    if (e->status != EVAL_OK)
+        return condition;
+
+    BlockStmt* branch = isTruthy(condition) ? pIfExpr->consequence
+                                            : pIfExpr->alternative;
+    if (!branch)
+        return NULL_VALUE;
+
+    Value result = evalBlock(e, branch);
+    if (result.type == VALUE_UNDEFINED)
+        return NULL_VALUE;
+    return result;
+}
+
+static Value evalFunction(struct Evaluator* e, Expr* pExpr)
+{
+    Closure* closure = newClosure(e->env, pExpr);
+    Capture* capture = pExpr->inner.fntExpr->captures;
+
+    for (int i = 0; i < closure->numCaptures; ++i)
+    {
+        if (capture[i].source == CAPTURE_LOCAL)
+            closure->captures[i] = e->env->stack[e->base
+                                                 + (size_t)capture[i].index];
+        else
+            closure->captures[i] =
+                CURRENT_CLOSURE(e)->captures[capture[i].index];
+        WRITE_BARRIER(e->env, &closure->object, closure->captures[i]);
+    }
+
+    return OBJECT_VALUE(VALUE_CLOSURE, closure);
+}
+
+static Value evalCall(struct Evaluator* e, CallExpr* pCallExpr)
+{
+    Environment* env = e->env;
+
+    Value callee = evalExpr(e, pCallExpr->function);
+    if (e->status != EVAL_OK)
+        return callee;
+
+    if (callee.type != VALUE_CLOSURE)
+        return runtimeError(e, "not a function: %s",
+                            valueTypeName(callee.type));
+
+    Closure* closure = (Closure*)callee.as.object;
+    FntExpr* fn      = closure->function->inner.fntExpr;
+
+    if (pCallExpr->arguments->len != fn->parameters->len)
+        return runtimeError(e, "wrong number of arguments: want=%zu, got=%zu",
+                            fn->parameters->len, pCallExpr->arguments->len);
+
+    // Arguments are evaluated in the frame of the caller and stored in the
+    // frame of the callee, which sits above it. The callee stays pinned
+    // until it returns, and is read back from its root once it may have
+    // moved.
+    size_t calleeRoot       = pushRoot(env, callee.as.object);
+    size_t base             = pushFrame(env, (size_t)fn->numLocals);
+    struct ArgNode* arg     = pCallExpr->arguments->tail->before;
+    struct ParamNode* param = fn->parameters->tail->before;
+    while (arg != pCallExpr->arguments->head)
+    {
+        Value value = evalExpr(e, arg->value);
+        if (e->status != EVAL_OK)
+        {
+            env->stackLen = base;
+            popRoot(env);
+            return value;
+        }
+
+        env->stack[base + (size_t)param->value->slot] = value;
+        arg   = arg->before;
+        param = param->before;
+    }
+
+    // Pure functions called before with the same arguments are not run
+    // again, in tail position too
+    MemoKey key;
+    int memoize = env->memo && memoKeyOf(env, closure, base, &key);
+    Value result;
+    if (memoize && lookUpMemo(env, &key, &result))
+    {
+        env->stackLen = base;
+        popRoot(env);
+        return result;
+    }
+
+    // In tail position, the frame and root of the running function are
+    // taken over, and the call that ran it runs the callee in its place
+    if (pCallExpr->tail)
+    {
+        memmove(env->stack + e->base, env->stack + base,
+                sizeof(Value) * (size_t)fn->numLocals);
+        env->stackLen              = e->base + (size_t)fn->numLocals;
+        env->roots[e->closureRoot] = env->roots[calleeRoot];
+        popRoot(env);
+
+        ++env->tailCalls;
+        e->status = EVAL_TAIL_CALL;
+        return UNDEFINED_VALUE;
+    }
+
+    if (env->callDepth >= MAX_CALL_DEPTH)
+    {
+        env->stackLen = base;
+        popRoot(env);
+        return runtimeError(e, "stack overflow");
+    }
+
+    size_t callerBase = e->base;
+    size_t callerRoot = e->closureRoot;
+    e->base           = base;
+    e->closureRoot    = calleeRoot;
+
+    ++env->callDepth;
+    do
+    {
+        e->status        = EVAL_OK;
+        callee.as.object = env->roots[calleeRoot];
+        fn = ((Closure*)callee.as.object)->function->inner.fntExpr;
+        if (fn->selfSlot >= 0)
+            env->stack[base + (size_t)fn->selfSlot] = callee;
+
+        result = evalBlock(e, fn->body);
+    } while (e->status == EVAL_TAIL_CALL);
+    --env->callDepth;
+
+    e->base        = callerBase;
+    e->closureRoot = callerRoot;
+    env->stackLen  = base;
+    popRoot(env);
+
+    if (e->status == EVAL_RETURN)
+        e->status = EVAL_OK;
+    if (result.type == VALUE_UNDEFINED)
+        result = NULL_VALUE;
+    if (memoize && e->status == EVAL_OK)
+        storeMemo(env, &key, result);
+    return result;
+}
+
+// Key of the call of closure whose arguments are in the frame at base, if
+// it can be memoized
+// The array is made first and pinned while its elements are evaluated
+static Value evalArray(struct Evaluator* e, ArrayExpr* pArrayExpr)
+{
+    Arguments* elements = pArrayExpr->elements;
+    Array* array        = newArray(e->env, elements->len);
+    struct ArgNode* tmp = elements->tail->before;
+
+    pushRoot(e->env, &array->object);
+    while (tmp != elements->head)
+    {
+        Value value = evalExpr(e, tmp->value);
+        if (e->status != EVAL_OK)
+        {
+            popRoot(e->env);
+            return value;
+        }
+
+        arrayPush(array, value);
+        WRITE_BARRIER(e->env, &array->object, value);
+        tmp = tmp->before;
+    }
+    popRoot(e->env);
+
+    return OBJECT_VALUE(VALUE_ARRAY, array);
+}
+
+static Value evalHash(struct Evaluator* e, HashExpr* pHashExpr)
+{
+    Arguments* pairs    = pHashExpr->pairs;
+    Hash* hash          = newHash(e->env, pairs->len / 2);
+    struct ArgNode* tmp = pairs->tail->before;
+
+    pushRoot(e->env, &hash->object);
+    while (tmp != pairs->head)
+    {
+        Value key = evalExpr(e, tmp->value);
+        if (e->status == EVAL_OK && !isHashable(key))
+            key = runtimeError(e, UNUSABLE_HASH_KEY, valueTypeName(key.type));
+        if (e->status != EVAL_OK)
+        {
+            popRoot(e->env);
+            return key;
+        }
+
+        // A string key is pinned along with the hash, and never moves
+        pushRoot(e->env, IS_OBJECT_VALUE(key) ? key.as.object : NULL);
+        Value value = evalExpr(e, tmp->before->value);
+        popRoot(e->env);
+        if (e->status != EVAL_OK)
+        {
+            popRoot(e->env);
+            return value;
+        }
+
+        hashPut(hash, key, value);
+        WRITE_BARRIER(e->env, &hash->object, key);
+        WRITE_BARRIER(e->env, &hash->object, value);
+        tmp = tmp->before->before;
+    }
+    popRoot(e->env);
+
+    return OBJECT_VALUE(VALUE_HASH, hash);
+}
+
+static Value evalIndex(struct Evaluator* e, IndexExpr* pIndexExpr)
+{
+    Value left = evalExpr(e, pIndexExpr->left);
+    if (e->status != EVAL_OK)
+        return left;
+
+    size_t leftRoot =
+        pushRoot(e->env, IS_OBJECT_VALUE(left) ? left.as.object : NULL);
+    Value index = evalExpr(e, pIndexExpr->index);
+    if (IS_OBJECT_VALUE(left))
+        left.as.object = e->env->roots[leftRoot];
+    popRoot(e->env);
+    if (e->status != EVAL_OK)
+        return index;
+
+    Value result      = NULL_VALUE;
+    ValueType culprit = VALUE_UNDEFINED;
+    const char* error = indexValue(left, index, &result, &culprit);
+    if (error)
+        return runtimeError(e, error, valueTypeName(culprit));
+    return result;
+}
+
+static int memoKeyOf(Environment* env, Closure* closure, size_t base,
+                     MemoKey* key)
+{
+    FntExpr* fn = closure->function->inner.fntExpr;
+    if (!fn->pure || fn->parameters->len > MEMO_MAX_ARGS)
+        return 0;
+
+    Value args[MEMO_MAX_ARGS];
+    size_t argc             = 0;
+    struct ParamNode* param = fn->parameters->tail->before;
+    while (param != fn->parameters->head)
+    {
+        args[argc++] = env->stack[base + (size_t)param->value->slot];
+        param        = param->before;
+    }
+
+    return makeMemoKey(closure->function, args, argc, key);
+}
+
+static Value runtimeError(struct Evaluator* e, const char* fmt, ...)
+{
+    char msg[128];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    setEnvError(e->env, "%s", msg);
+    e->status = EVAL_ERROR;
+
+    return NULL_VALUE;
+}
@@ -0,0 +1,20 @@
+#ifndef _MONKEY_LANG_SRC_EVALUATOR_H_
+#define _MONKEY_LANG_SRC_EVALUATOR_H_
+
+#include "ast.h"
+#include "environment.h"
+#include "object.h"
+
+// Run a program that went through resolveProgram, with the resolver of
+// env, and analyzeCaptures. Returns the value of the last statement, or of
+// the top-level `return` that ended the program; VALUE_UNDEFINED if that
+// statement was a `let`.
+//
+// Integers, booleans and null are passed by value and locals live in the
+// frame stack of env, so only function literals allocate.
+//
+// A runtime error stops the program and is kept in env until it is taken
+// with getEvalError.
+Value eval(Program*, Environment*);
+
+#endif //_MONKEY_LANG_SRC_EVALUATOR_H_
@@ -0,0 +1,286 @@
+#define MAIN_TEST_NAME TestEvaluator
+
+#include "capture.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "parser.h"
+#include "resolver.h"
+#include "testing.h"
+
+/* Function Signatures */
+String* evalForTest(Environment*, const char*);
+int expectEvals(const char* [][2], size_t);
+
+// The inspected value of the program, or "ERROR: <message>" if resolving or
+// running it failed
+String* evalForTest(Environment* env, const char* input)
+{
+    Lexer* l = mkLexer(input);
+    Parser* p = mkParser(l);
+    Program* program = parseProgram(p);
+    String* output = NULL;
+
+    if (getErrLen(p) != 0)
+    {
+        PRINT_ERR("cannot parse `%s`", input);
+        freeProgram(program);
+        freeParser(p);
+        return mkString("PARSE ERROR");
+    }
+
+    if (resolveProgram(getResolver(env), program) != 0)
+    {
+        String** errors = getResolverErrors(getResolver(env));
+        output = mkString("ERROR: ");
+        appendStr(output, getStr(errors[0]));
+        for (int i = 0; errors[i]; ++i)
+            freeString(errors[i]);
+        free(errors);
+    }
+    else
+    {
+        analyzeCaptures(program);
+        Value result = eval(program, env);
+        String* error = getEvalError(env);
+        if (error)
+        {
+            output = mkString("ERROR: ");
+            concatFreeString(output, error);
+        }
+        else
+        {
+            output = inspectValue(result);
+        }
+    }
+
+    freeProgram(program);
+    freeParser(p);
+    return output;
+}
+
+int expectEvals(const char* tests[][2], size_t len)
+{
+    int testStatus = TEST_SUCESSED;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        Environment* env = mkEnvironment();
+        String* got = evalForTest(env, tests[i][0]);
+
+        if (cmpStringStr(got, tests[i][1]) != 0)
+        {
+            PRINT_ERR("`%s`: expected `%s`, got = `%s`", tests[i][0],
+                      tests[i][1], getStr(got));
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeEnvironment(env);
+    }
+
+    return testStatus;
+}
+
+TEST(EvalExpressions)
+{
+    const char* tests[][2] = {
+        {"5", "5"},
+        {"-5", "-5"},
+        {"5 + 5 + 5 + 5 - 10", "10"},
+        {"(5 + 10 * 2 + 15 / 3) * 2 + -10", "50"},
+        {"9223372036854775807 + 1", "-9223372036854775808"},
+        {"1 < 2", "true"},
+        {"(1 > 2) == false", "true"},
+        {"true != false", "true"},
+        {"!5", "false"},
+        {"!!true", "true"},
+        {"1 == true", "false"},
+        {"if (1 > 2) { 10 }", "null"},
+        {"if (1) { 10 } else { 20 }", "10"},
+        {"if (false) { 10 } else { let a = 1; }", "null"},
+        {"let a = 5; let b = a; let c = a + b + 5; c;", "15"},
+        {"let a = 5;", ""},
+        {"if (true) { let a = 2; a * 3 }", "6"},
+    };
+
+    return expectEvals(tests, sizeof(tests) / sizeof(tests[0]));
+}
+
+TEST(EvalReturns)
+{
+    const char* tests[][2] = {
+        {"9; return 2 * 5; 9;", "10"},
+        {"if (10 > 1) { if (10 > 1) { return 10; } return 1; }", "10"},
+        {"let f = fn(x) { if (x > 1) { return x; } 0 }; f(3) + f(1)", "3"},
+        {"let f = fn(x) { let y = if (x) { return 1; } else { 2 }; y + 10 }; "
+         "f(true) * 100 + f(false)",
+         "112"},
+        {"let f = fn() { let a = 1; }; f()", "null"},
+    };
+
+    return expectEvals(tests, sizeof(tests) / sizeof(tests[0]));
+}
+
+TEST(EvalErrors)
+{
+    const char* tests[][2] = {
+        {"5 + true; 5", "ERROR: type mismatch: INTEGER + BOOLEAN"},
+        {"-true", "ERROR: unknown operator: -BOOLEAN"},
+        {"if (10 > 1) { true + false; 1 }",
+         "ERROR: unknown operator: BOOLEAN + BOOLEAN"},
+        {"1 / 0", "ERROR: division by zero"},
+        {"5()", "ERROR: not a function: INTEGER"},
+        {"let f = fn(x) { x }; f(1, 2)",
+         "ERROR: wrong number of arguments: want=1, got=2"},
+        {"let f = fn() { g }; f(); let g = 1;",
+         "ERROR: identifier not found: g"},
+        {"foobar", "ERROR: identifier not found: foobar"},
+        {"let w = fn(n) { if (n == 0) { 0 } else { 1 + w(n - 1) } }; w(9000)",
+         "ERROR: stack overflow"},
+    };
+
+    return expectEvals(tests, sizeof(tests) / sizeof(tests[0]));
+}
+
+TEST(EvalFunctions)
+{
+    const char* tests[][2] = {
+        {"fn(x) { x + 2 }", "fn(x) { (x + 2) }"},
+        {"let identity = fn(x) { x; }; identity(5);", "5"},
+        {"fn(x) { x; }(5)", "5"},
+        {"let add = fn(a, b) { a + b }; add(5 + 5, add(5, 5));", "20"},
+        {"let f = fn() { g() }; let g = fn() { 7 }; f()", "7"},
+        {"let newAdder = fn(x) { fn(y) { x + y } }; newAdder(2)(3)", "5"},
+        {"let f = fn(a) { fn(b) { fn(c) { a * 100 + b * 10 + c } } }; "
+         "f(1)(2)(3)",
+         "123"},
+        {"let f = fn(n) { let g = fn() { f(n - 1) }; if (n > 0) { g() } "
+         "else { 0 } }; f(3)",
+         "0"},
+        {"let a = 1; let f = fn() { a }; let a = 2; f()", "2"},
+    };
+
+    return expectEvals(tests, sizeof(tests) / sizeof(tests[0]));
+}
+
+TEST(EvalCollections)
+{
+    const char* tests[][2] = {
+        {"[1, 2 * 2, 3 + 3]", "[1, 4, 6]"},
+        {"[]", "[]"},
+        {"let a = [1, [2, 3]]; a[1][0] + a[0]", "3"},
+        {"[1, 2, 3][3]", "null"},
+        {"[1, 2, 3][-1]", "null"},
+        {"let i = 0; [1][i]", "1"},
+        {"{1: 2, true: 3, 1: 7}", "{1: 7, true: 3}"},
+        {"{}", "{}"},
+        {"let h = {5 - 4: fn(x) { x * 2 }, false: [1]}; h[1](h[false][0])",
+         "2"},
+        {"{1: 2}[2]", "null"},
+        {"{true: 1}[1 == 1]", "1"},
+        {"let a = [1]; a == a", "true"},
+        {"[1] == [1]", "false"},
+        {"{[1]: 2}", "ERROR: unusable as hash key: ARRAY"},
+        {"{1: 2}[fn(x) { x }]", "ERROR: unusable as hash key: FUNCTION"},
+        {"1[0]", "ERROR: index operator not supported: INTEGER"},
+        {"[1][true]", "ERROR: index operator not supported: ARRAY"},
+        {"[1] + [2]", "ERROR: unknown operator: ARRAY + ARRAY"},
+    };
+
+    return expectEvals(tests, sizeof(tests) / sizeof(tests[0]));
+}
+
+TEST(EvalStrings)
+{
+    const char* tests[][2] = {
+        {"\"Hello World!\"", "Hello World!"},
+        {"\"Hello\" + \" \" + \"World!\"", "Hello World!"},
+        {"\"\" + \"\"", ""},
+        {"\"abc\"[1]", "b"},
+        {"\"abc\"[3]", "null"},
+        {"\"abc\"[-1]", "null"},
+        {"let s = \"abc\"; s + s + s + s + s + s + s + s + s + s + s + s",
+         "abcabcabcabcabcabcabcabcabcabcabcabc"},
+        {"\"ab\" + \"c\" == \"a\" + \"bc\"", "true"},
+        {"\"this one is longer than thirty-two\" + \"!\" == "
+         "\"this one is longer than thirty-two!\"",
+         "true"},
+        {"\"a\" != \"b\"", "true"},
+        {"\"1\" == 1", "false"},
+        {"if (\"\") { 1 } else { 2 }", "1"},
+        {"!\"a\"", "false"},
+        {"let h = {\"one\": 1, \"t\" + \"wo\": 2}; "
+         "h[\"o\" + \"ne\"] + h[\"two\"]",
+         "3"},
+        {"{\"a\": 1}[\"b\"]", "null"},
+        {"\"a\" - \"b\"", "ERROR: unknown operator: STRING - STRING"},
+        {"\"a\" + 1", "ERROR: type mismatch: STRING + INTEGER"},
+        {"\"abc\"[\"a\"]", "ERROR: index operator not supported: STRING"},
+    };
+
+    return expectEvals(tests, sizeof(tests) / sizeof(tests[0]));
+}
+
+TEST(RecurseWithoutAllocating)
+{
+    int testStatus = TEST_SUCESSED;
+    Environment* env = mkEnvironment();
+
+    String* got = evalForTest(
+        env, "let fib = fn(n) { if (n < 2) { return n; } "
+             "fib(n - 1) + fib(n - 2) }; fib(25)");
+
+    if (cmpStringStr(got, "75025") != 0)
+    {
+        PRINT_ERR("expected 75025, got = %s", getStr(got));
+        testStatus = TEST_FAILED;
+    }
+    // The closure bound to fib is the only heap object
+    if (getObjectCount(env) != 1)
+    {
+        PRINT_ERR("expected 1 object, got = %zu", getObjectCount(env));
+        testStatus = TEST_FAILED;
+    }
+
+    freeString(got);
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(KeepStateAcrossPrograms)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {"let a = 2; let f = fn(x) { x * a };", "f(21)",
+                            "let a = 3; f(2)", "let g = fn(x) { f(x) }; g(1)"};
+    const char* expected[] = {"", "42", "6", "3"};
+
+    Environment* env = mkEnvironment();
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        String* got = evalForTest(env, inputs[i]);
+        if (cmpStringStr(got, expected[i]) != 0)
+        {
+            PRINT_ERR("`%s`: expected `%s`, got = `%s`", inputs[i],
+                      expected[i], getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        freeString(got);
+    }
+
+    freeEnvironment(env);
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(EvalExpressions);
+        RUN_TEST(EvalReturns);
+        RUN_TEST(EvalErrors);
+        RUN_TEST(EvalFunctions);
+        RUN_TEST(EvalCollections);
+        RUN_TEST(EvalStrings);
+        RUN_TEST(RecurseWithoutAllocating);
+        RUN_TEST(KeepStateAcrossPrograms);
+    })
+
+#undef MAIN_TEST_NAME // End TestEvaluator
@@ -0,0 +1,860 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "closureCompiler.h"
+#include "collection.h"
+#include "environment.h"
+#include "gc.h"
+#include "object.h"
+#include "rope.h"
+
+// Closures are laid out in the nursery at this alignment
+#define NURSERY_ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+// Fillings of a nursery are numbered across environments, which may share
+// an AST
+static size_t lastNurseryEpoch = 0;
+
+/* Private Function Signatures */
+static void stepCollector(Environment*, int);
+static Rope* makeString(Environment*, const char*, size_t);
+static void linkObject(Environment*, Object*);
+static void minorCollection(Environment*);
+static Object* evacuate(Environment*, Object*);
+static void evacuateValue(Environment*, Value*);
+static void evacuateFields(Environment*, Object*);
+static void updateCallCaches(Environment*, CompiledFunction*);
+static void retainYoungFunction(Environment*, Expr*);
+static void releaseNursery(Environment*);
+static size_t objectSize(const Object*);
+static void pushGray(Environment*, Object*);
+static void markObject(Environment*, Object*);
+static void markValue(Environment*, Value);
+static void markTree(NodeTree*, void*);
+static void markRoots(Environment*);
+static void traceObject(Environment*, Object*);
+static void traceGray(Environment*);
+static void startMarking(Environment*);
+static void markSlice(Environment*);
+static void finishMarking(Environment*);
+static void sweepSlice(Environment*, size_t);
+static void pruneCallCaches(CompiledFunction*);
+static void countPause(GCStats*, double);
+static double now(void);
+
+void trackObject(Environment* env, Object* pObject)
+{
+    linkObject(env, pObject);
+
+    // Objects made while the old space is marked start out gray
+    if (env->marking)
+        markObject(env, pObject);
+}
+
+Closure* newClosure(Environment* env, Expr* function)
+{
+    int numCaptures = function->inner.fntExpr->numCaptures;
+    size_t size     = NURSERY_ALIGN(closureSize(numCaptures));
+    int young       = size <= env->nurserySize / 4;
+
+    stepCollector(env, young && env->nurseryTop + size > env->nurserySize);
+
+    // Closures too big for the nursery start out old
+    if (!young)
+    {
+        Closure* closure = mkClosure(function);
+        trackObject(env, &closure->object);
+        return closure;
+    }
+
+    Closure* closure = initClosure(env->nursery + env->nurseryTop, function);
+    retainYoungFunction(env, function);
+    env->nurseryTop += size;
+    ++env->youngCount;
+    return closure;
+}
+
+Array* newArray(Environment* env, size_t capacity)
+{
+    stepCollector(env, 0);
+
+    Array* array = mkArray(capacity);
+    trackObject(env, &array->object);
+    return array;
+}
+
+Hash* newHash(Environment* env, size_t capacity)
+{
+    stepCollector(env, 0);
+
+    Hash* hash = mkHash(capacity);
+    trackObject(env, &hash->object);
+    return hash;
+}
+
+Rope* newString(Environment* env, const char* chars, size_t len)
+{
+    stepCollector(env, 0);
+    return makeString(env, chars, len);
+}
+
+Rope* newConstantString(Environment* env, const char* chars, size_t len)
+{
+    return makeString(env, chars, len);
+}
+
+Rope* newConcat(Environment* env, Rope* left, Rope* right)
+{
+    if (left->len == 0)
+        return right;
+    if (right->len == 0)
+        return left;
+
+    // Halves of a short result are shorter still, so flat
+    size_t len = left->len + right->len;
+    if (len <= INTERN_MAX_LEN)
+    {
+        char chars[INTERN_MAX_LEN];
+        memcpy(chars, left->chars, left->len);
+        memcpy(chars + left->len, right->chars, right->len);
+        return newString(env, chars, len);
+    }
+
+    pushRoot(env, &left->object);
+    pushRoot(env, &right->object);
+    stepCollector(env, 0);
+    popRoot(env);
+    popRoot(env);
+
+    Rope* rope = mkConcat(left, right);
+    trackObject(env, &rope->object);
+    return rope;
+}
+
+size_t pushRoot(Environment* env, Object* pObject)
+{
+    if (env->rootLen == env->rootCapacity)
+    {
+        env->rootCapacity = env->rootCapacity ? env->rootCapacity * 2 : 64;
+        env->roots = realloc(env->roots, sizeof(Object*) * env->rootCapacity);
+    }
+    env->roots[env->rootLen] = pObject;
+    return env->rootLen++;
+}
+
+void popRoot(Environment* env)
+{
+    --env->rootLen;
+}
+
+void rememberObject(Environment* env, Object* pObject)
+{
+    if (env->rememberedLen == env->rememberedCapacity)
+    {
+        env->rememberedCapacity = env->rememberedCapacity
+                                      ? env->rememberedCapacity * 2
+                                      : 16;
+        env->remembered = realloc(env->remembered,
+                                  sizeof(Object*) * env->rememberedCapacity);
+    }
+    pObject->remembered = 1;
+    env->remembered[env->rememberedLen++] = pObject;
+}
+
+void shadeObject(Environment* env, Object* pObject)
+{
+    // Objects left to sweep are still marked
+    if (env->marking)
+        markObject(env, pObject);
+}
+
+void forgetObject(Environment* env, Object* pObject)
+{
+    if (!pObject->remembered)
+        return;
+
+    for (size_t i = 0; i < env->rememberedLen; ++i)
+    {
+        if (env->remembered[i] == pObject)
+        {
+            env->remembered[i] = env->remembered[--env->rememberedLen];
+            break;
+        }
+    }
+    pObject->remembered = 0;
+}
+
+void initNursery(Environment* env)
+{
+    env->nurserySize           = GC_NURSERY_SIZE;
+    env->nursery               = malloc(env->nurserySize);
+    env->nurseryTop            = 0;
+    env->youngCount            = 0;
+    env->youngFunctions        = NULL;
+    env->youngFunctionLen      = 0;
+    env->youngFunctionCapacity = 0;
+    env->nurseryEpoch          = ++lastNurseryEpoch;
+}
+
+void freeNursery(Environment* env)
+{
+    releaseNursery(env);
+    free(env->youngFunctions);
+    free(env->nursery);
+    env->youngFunctions = NULL;
+    env->nursery        = NULL;
+    env->nurserySize    = 0;
+}
+
+void collectGarbage(Environment* env)
+{
+    sweepSlice(env, SIZE_MAX);
+    finishMarking(env);
+    sweepSlice(env, SIZE_MAX);
+}
+
+void setHeapGrowth(Environment* env, double factor)
+{
+    env->heapGrowth = factor > 0 ? factor : 0;
+    if (env->heapGrowth <= 0)
+        env->gcStats.nextCollection = 0;
+}
+
+void setNurserySize(Environment* env, size_t bytes)
+{
+    if (env->nurseryTop > 0)
+        minorCollection(env);
+
+    free(env->nursery);
+    env->nurserySize = NURSERY_ALIGN(bytes);
+    env->nursery     = env->nurserySize ? malloc(env->nurserySize) : NULL;
+}
+
+void setMarkBudget(Environment* env, size_t objects)
+{
+    env->markBudget = objects;
+
+    // Slices of nothing would never end the collection under way
+    if (!objects && (env->marking || env->sweeping))
+        collectGarbage(env);
+}
+
+GCStats getGCStats(const Environment* env)
+{
+    return env->gcStats;
+}
+
+String* dumpGCStats(const Environment* env)
+{
+    const GCStats* stats = &env->gcStats;
+    char buffer[256];
+
+    snprintf(buffer, sizeof(buffer),
+             "gc: %zu collections, %.3f ms paused (max %.3f ms), "
+             "%zu survivors, %zu freed, %zu objects in %zu bytes\n",
+             stats->collections, stats->totalPause * 1e3,
+             stats->maxPause * 1e3, stats->survivors, stats->freed,
+             getObjectCount(env), stats->heapBytes);
+    String* output = mkString(buffer);
+
+    snprintf(buffer, sizeof(buffer),
+             "gc: %zu minor collections, %.3f ms paused (max %.3f ms), "
+             "%zu promoted, %zu of %zu nursery bytes in use\n",
+             stats->minorCollections, stats->minorPause * 1e3,
+             stats->maxMinorPause * 1e3, stats->promoted, env->nurseryTop,
+             env->nurserySize);
+    appendStr(output, buffer);
+
+    appendStr(output, "gc: pauses");
+    const char* separator = " ";
+    for (int i = 0; i < GC_PAUSE_BUCKETS; ++i)
+    {
+        if (!stats->pauses[i])
+            continue;
+        snprintf(buffer, sizeof(buffer), "%s%s%d us %zu", separator,
+                 i < GC_PAUSE_BUCKETS - 1 ? "<" : ">=",
+                 16 << (i < GC_PAUSE_BUCKETS - 1 ? i : i - 1),
+                 stats->pauses[i]);
+        appendStr(output, buffer);
+        separator = ", ";
+    }
+    appendStr(output, "\n");
+    return output;
+}
+
+// The work of the collector before an allocation: a minor collection if
+// the nursery is full, and a step of the collection of the old space
+static void stepCollector(Environment* env, int nurseryFull)
+{
+    if (env->heapGrowth <= 0)
+    {
+        collectGarbage(env);
+        return;
+    }
+
+    if (nurseryFull)
+        minorCollection(env);
+
+    int grown = env->gcStats.heapBytes > env->gcStats.nextCollection;
+    if (env->marking)
+        markSlice(env);
+    else if (env->sweeping)
+        sweepSlice(env, env->markBudget);
+    else if (grown && env->markBudget > 0)
+        startMarking(env);
+    else if (grown)
+        collectGarbage(env);
+}
+
+static Rope* makeString(Environment* env, const char* chars, size_t len)
+{
+    if (len == 1)
+        return charRope(chars[0]);
+    if (len > INTERN_MAX_LEN)
+    {
+        Rope* rope = mkRope(chars, len);
+        trackObject(env, &rope->object);
+        return rope;
+    }
+
+    uint64_t hash = hashChars(chars, len);
+    Rope* rope    = findInterned(env->strings, chars, len, hash);
+    if (rope)
+    {
+        // The table holds its strings weakly, so this one may be unmarked
+        // and among the objects left to sweep
+        if (env->marking)
+            markObject(env, &rope->object);
+        else if (env->sweeping)
+            rope->object.marked = 1;
+        return rope;
+    }
+
+    rope       = mkRope(chars, len);
+    rope->hash = hash;
+    trackObject(env, &rope->object);
+    addInterned(env->strings, rope);
+    return rope;
+}
+
+static void linkObject(Environment* env, Object* pObject)
+{
+    pObject->next = env->objects;
+    env->objects  = pObject;
+    ++env->objectCount;
+    env->gcStats.heapBytes += objectSize(pObject);
+}
+
+// Copy the young closures reachable from the roots and the remembered set
+// to the old space, breadth first through gray, and empty the nursery
+static void minorCollection(Environment* env)
+{
+    double start    = now();
+    size_t promoted = env->gcStats.promoted;
+
+    // Below floor, gray holds the objects an incremental marking left
+    size_t floor = env->grayLen;
+
+    for (size_t i = 0; i < env->globalLen; ++i)
+        evacuateValue(env, &env->globals[i]);
+    for (size_t i = 0; i < env->stackLen; ++i)
+        evacuateValue(env, &env->stack[i]);
+    for (size_t i = 0; i < env->rootLen; ++i)
+        env->roots[i] = evacuate(env, env->roots[i]);
+
+    for (size_t i = 0; i < env->rememberedLen; ++i)
+    {
+        Object* holder = env->remembered[i];
+        if (holder->type != OBJECT_FUNCTION)
+            pushGray(env, holder);
+    }
+
+    while (env->grayLen > floor)
+        evacuateFields(env, env->gray[--env->grayLen]);
+
+    // Copies are linked first in objects, and are marked like any object
+    // made during marking
+    Object* copy = env->objects;
+    for (size_t i = promoted; env->marking && i < env->gcStats.promoted; ++i)
+    {
+        markObject(env, copy);
+        copy = copy->next;
+    }
+
+    // Call caches only keep the closures that survived
+    for (size_t i = 0; i < env->rememberedLen; ++i)
+    {
+        Object* holder = env->remembered[i];
+        if (holder->type == OBJECT_FUNCTION)
+            updateCallCaches(env, (CompiledFunction*)holder);
+        holder->remembered = 0;
+    }
+    env->rememberedLen = 0;
+
+    // The closures left behind are freed with the nursery
+    env->gcStats.freed += env->youngCount - (env->gcStats.promoted - promoted);
+    releaseNursery(env);
+
+    GCStats* stats = &env->gcStats;
+    double pause   = now() - start;
+    stats->minorPause += pause;
+    stats->maxMinorPause = pause > stats->maxMinorPause ? pause
+                                                         : stats->maxMinorPause;
+    ++stats->minorCollections;
+    countPause(stats, pause);
+}
+
+// The old copy of a young object, made on first sight
+static Object* evacuate(Environment* env, Object* pObject)
+{
+    if (!pObject || !IS_YOUNG(env, pObject))
+        return pObject;
+    if (pObject->forwarded)
+        return pObject->next;
+
+    size_t size  = objectSize(pObject);
+    Object* copy = malloc(size);
+    memcpy(copy, pObject, size);
+    retainExpr(((Closure*)copy)->function);
+    pObject->forwarded = 1;
+    pObject->next      = copy;
+
+    linkObject(env, copy);
+    ++env->gcStats.promoted;
+    pushGray(env, copy);
+    return copy;
+}
+
+static void evacuateValue(Environment* env, Value* value)
+{
+    if (IS_OBJECT_VALUE(*value))
+        value->as.object = evacuate(env, value->as.object);
+}
+
+// Copy out the young closures a copied or remembered object refers to
+static void evacuateFields(Environment* env, Object* pObject)
+{
+    switch (pObject->type)
+    {
+    case OBJECT_CLOSURE:
+    {
+        Closure* closure = (Closure*)pObject;
+        for (int i = 0; i < closure->numCaptures; ++i)
+            evacuateValue(env, &closure->captures[i]);
+        break;
+    }
+
+    case OBJECT_ARRAY:
+    {
+        Array* array = (Array*)pObject;
+        for (size_t i = 0; i < array->len; ++i)
+            evacuateValue(env, &array->elements[i]);
+        break;
+    }
+
+    case OBJECT_HASH:
+    {
+        Hash* hash = (Hash*)pObject;
+        for (size_t i = 0; i < hash->len; ++i)
+        {
+            evacuateValue(env, &hash->entries[i].key);
+            evacuateValue(env, &hash->entries[i].value);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+static void updateCallCaches(Environment* env, CompiledFunction* fn)
+{
+    for (size_t i = 0; i < fn->numCallSites; ++i)
+    {
+        CallCache* cache = &fn->callCaches[i];
+        int len          = 0;
+        for (int j = 0; j < cache->len; ++j)
+        {
+            Object* entry = &cache->closures[j]->object;
+            if (IS_YOUNG(env, entry) && !entry->forwarded)
+                continue;
+            if (IS_YOUNG(env, entry))
+                entry = entry->next;
+            cache->closures[len++] = (Closure*)entry;
+        }
+        cache->len = len;
+    }
+}
+
+// Hold a reference to the function of a young closure, once per filling
+// of the nursery, so that emptying it does not have to look at the
+// closures that died
+static void retainYoungFunction(Environment* env, Expr* function)
+{
+    FntExpr* fntExpr = function->inner.fntExpr;
+    if (fntExpr->nurseryEpoch == env->nurseryEpoch)
+        return;
+    fntExpr->nurseryEpoch = env->nurseryEpoch;
+
+    if (env->youngFunctionLen == env->youngFunctionCapacity)
+    {
+        env->youngFunctionCapacity = env->youngFunctionCapacity
+                                         ? env->youngFunctionCapacity * 2
+                                         : 16;
+        env->youngFunctions = realloc(env->youngFunctions,
+                                      sizeof(Expr*)
+                                          * env->youngFunctionCapacity);
+    }
+    env->youngFunctions[env->youngFunctionLen++] = retainExpr(function);
+}
+
+// Empty the nursery, dropping its references to the functions of the
+// young closures. The copies of the survivors hold their own, so its
+// dead closures are never looked at: this costs one release per distinct
+// function, not one per closure.
+static void releaseNursery(Environment* env)
+{
+    for (size_t i = 0; i < env->youngFunctionLen; ++i)
+        freeExpr(env->youngFunctions[i]);
+
+    env->youngFunctionLen = 0;
+    env->nurseryEpoch     = ++lastNurseryEpoch;
+    env->nurseryTop       = 0;
+    env->youngCount       = 0;
+}
+
+// Bytes counted towards the heap, the same when an object is tracked and
+// when it is swept
+static size_t objectSize(const Object* pObject)
+{
+    switch (pObject->type)
+    {
+    case OBJECT_CLOSURE:
+        return closureSize(((const Closure*)pObject)->numCaptures);
+
+    case OBJECT_FUNCTION:
+    {
+        const CompiledFunction* fn = (const CompiledFunction*)pObject;
+        return sizeof(CompiledFunction) + sizeof(uint32_t) * fn->codeLen
+               + sizeof(Value) * fn->numConstants
+               + sizeof(CompiledFunction*) * fn->numFunctions
+               + sizeof(CallCache) * fn->numCallSites;
+    }
+
+    case OBJECT_ARRAY:
+        return sizeof(Array)
+               + sizeof(Value) * ((const Array*)pObject)->capacity;
+
+    case OBJECT_HASH:
+    {
+        const Hash* hash = (const Hash*)pObject;
+        size_t slots     = hash->slotMask + 1;
+        // A control byte per slot, and a group of 16 repeated
+        return sizeof(Hash) + sizeof(HashEntry) * hash->capacity
+               + (sizeof(uint32_t) + 1) * slots + 16;
+    }
+
+    case OBJECT_STRING:
+    {
+        // Characters a concatenation gets by flattening are left out
+        const Rope* rope = (const Rope*)pObject;
+        return sizeof(Rope) + (rope->leaf ? rope->len + 1 : 0);
+    }
+
+    default:
+        return sizeof(NodeTree);
+    }
+}
+
+static void pushGray(Environment* env, Object* pObject)
+{
+    if (env->grayLen == env->grayCapacity)
+    {
+        env->grayCapacity = env->grayCapacity ? env->grayCapacity * 2 : 64;
+        env->gray = realloc(env->gray, sizeof(Object*) * env->grayCapacity);
+    }
+    env->gray[env->grayLen++] = pObject;
+}
+
+// Young objects are left to minor collections, and hold old ones alive
+// once copied out
+static void markObject(Environment* env, Object* pObject)
+{
+    if (!pObject || pObject->marked || IS_YOUNG(env, pObject))
+        return;
+
+    pObject->marked = 1;
+    pushGray(env, pObject);
+}
+
+static void markValue(Environment* env, Value value)
+{
+    if (IS_OBJECT_VALUE(value))
+        markObject(env, value.as.object);
+}
+
+static void markTree(NodeTree* tree, void* env)
+{
+    markObject(env, &tree->object);
+}
+
+// Roots the environment does not hold, like a program being run, may be
+// freed before marking ends, so they are traced right away
+static void markRoots(Environment* env)
+{
+    for (size_t i = 0; i < env->globalLen; ++i)
+        markValue(env, env->globals[i]);
+    for (size_t i = 0; i < env->stackLen; ++i)
+        markValue(env, env->stack[i]);
+    for (size_t i = 0; i < env->rootLen; ++i)
+    {
+        Object* root = env->roots[i];
+        if (root && !root->marked && !IS_YOUNG(env, root))
+        {
+            root->marked = 1;
+            traceObject(env, root);
+        }
+    }
+}
+
+static void traceObject(Environment* env, Object* pObject)
+{
+    switch (pObject->type)
+    {
+    case OBJECT_CLOSURE:
+    {
+        Closure* closure = (Closure*)pObject;
+        markObject(env, closure->compiled ? &closure->compiled->object : NULL);
+        markObject(env, closure->tree ? &closure->tree->object : NULL);
+        for (int i = 0; i < closure->numCaptures; ++i)
+            markValue(env, closure->captures[i]);
+        break;
+    }
+
+    case OBJECT_FUNCTION:
+    {
+        CompiledFunction* fn = (CompiledFunction*)pObject;
+        for (size_t i = 0; i < fn->numConstants; ++i)
+            markValue(env, fn->constants[i]);
+        for (size_t i = 0; i < fn->numFunctions; ++i)
+            markObject(env, &fn->functions[i]->object);
+        break;
+    }
+
+    case OBJECT_NODE_TREE:
+        visitNodeTrees(((NodeTree*)pObject)->root, markTree, env);
+        break;
+
+    case OBJECT_ARRAY:
+    {
+        Array* array = (Array*)pObject;
+        for (size_t i = 0; i < array->len; ++i)
+            markValue(env, array->elements[i]);
+        break;
+    }
+
+    case OBJECT_HASH:
+    {
+        Hash* hash = (Hash*)pObject;
+        for (size_t i = 0; i < hash->len; ++i)
+        {
+            markValue(env, hash->entries[i].key);
+            markValue(env, hash->entries[i].value);
+        }
+        break;
+    }
+
+    case OBJECT_STRING:
+    {
+        Rope* rope = (Rope*)pObject;
+        markObject(env, rope->left ? &rope->left->object : NULL);
+        markObject(env, rope->right ? &rope->right->object : NULL);
+        break;
+    }
+    }
+}
+
+// Trace the last object made gray. Only objects env holds are gray, so
+// the functions among them stay until their caches are pruned.
+static void traceGray(Environment* env)
+{
+    Object* pObject = env->gray[--env->grayLen];
+    traceObject(env, pObject);
+
+    CompiledFunction* fn = (CompiledFunction*)pObject;
+    if (pObject->type != OBJECT_FUNCTION || fn->numCallSites == 0)
+        return;
+
+    if (env->cachedLen == env->cachedCapacity)
+    {
+        env->cachedCapacity = env->cachedCapacity ? env->cachedCapacity * 2
+                                                  : 64;
+        env->cached = realloc(env->cached, sizeof(CompiledFunction*)
+                                               * env->cachedCapacity);
+    }
+    env->cached[env->cachedLen++] = fn;
+}
+
+static void startMarking(Environment* env)
+{
+    double start = now();
+
+    env->marking = 1;
+    markRoots(env);
+
+    GCStats* stats     = &env->gcStats;
+    double pause       = now() - start;
+    stats->totalPause += pause;
+    stats->maxPause    = pause > stats->maxPause ? pause : stats->maxPause;
+    countPause(stats, pause);
+}
+
+static void markSlice(Environment* env)
+{
+    double start = now();
+
+    for (size_t i = 0; i < env->markBudget && env->grayLen > 0; ++i)
+        traceGray(env);
+
+    GCStats* stats     = &env->gcStats;
+    double pause       = now() - start;
+    stats->totalPause += pause;
+    stats->maxPause    = pause > stats->maxPause ? pause : stats->maxPause;
+    ++stats->markSlices;
+    countPause(stats, pause);
+
+    if (env->grayLen == 0)
+        finishMarking(env);
+}
+
+// Mark what is left at once and sweep. Neither the stack nor the globals
+// have a write barrier, so the roots are marked again.
+static void finishMarking(Environment* env)
+{
+    // The old space is only swept with an empty nursery
+    if (env->nurseryTop > 0)
+        minorCollection(env);
+
+    double start = now();
+
+    markRoots(env);
+    while (env->grayLen > 0)
+        traceGray(env);
+
+    // Call caches hold their closures weakly: a freed closure could
+    // otherwise hit for a new one made at the same address
+    for (size_t i = 0; i < env->cachedLen; ++i)
+        pruneCallCaches(env->cached[i]);
+    env->cachedLen = 0;
+    for (size_t i = 0; i < env->rootLen; ++i)
+    {
+        Object* root = env->roots[i];
+        if (root && root->type == OBJECT_FUNCTION)
+            pruneCallCaches((CompiledFunction*)root);
+    }
+
+    // Objects made from now on are linked in front of the ones to sweep
+    env->unswept           = env->objects;
+    env->objects           = NULL;
+    env->marking           = 0;
+    env->sweeping          = 1;
+    env->gcStats.survivors = 0;
+
+    GCStats* stats     = &env->gcStats;
+    double pause       = now() - start;
+    stats->totalPause += pause;
+    stats->maxPause    = pause > stats->maxPause ? pause : stats->maxPause;
+    countPause(stats, pause);
+}
+
+// Free at most budget of the unmarked objects left to sweep, and relink
+// the rest. The collection ends with the last of them.
+static void sweepSlice(Environment* env, size_t budget)
+{
+    if (!env->sweeping)
+        return;
+
+    GCStats* stats = &env->gcStats;
+    double start   = now();
+
+    for (size_t i = 0; i < budget && env->unswept; ++i)
+    {
+        Object* tmp  = env->unswept;
+        env->unswept = tmp->next;
+        if (tmp->marked)
+        {
+            tmp->marked  = 0;
+            tmp->next    = env->objects;
+            env->objects = tmp;
+            ++stats->survivors;
+        }
+        else
+        {
+            --env->objectCount;
+            ++stats->freed;
+            stats->heapBytes -= objectSize(tmp);
+            if (tmp->type == OBJECT_STRING)
+                forgetInterned(env->strings, (Rope*)tmp);
+            freeObject(tmp);
+        }
+    }
+
+    if (!env->unswept)
+    {
+        // Roots the environment does not hold, like a program being run
+        for (size_t i = 0; i < env->rootLen; ++i)
+        {
+            if (env->roots[i])
+                env->roots[i]->marked = 0;
+        }
+
+        double next = (double)stats->heapBytes * env->heapGrowth;
+        if (env->heapGrowth <= 0)
+            stats->nextCollection = 0;
+        else
+            stats->nextCollection = next > GC_MIN_HEAP ? (size_t)next
+                                                       : GC_MIN_HEAP;
+        env->sweeping = 0;
+        ++stats->collections;
+    }
+
+    double pause       = now() - start;
+    stats->totalPause += pause;
+    stats->maxPause    = pause > stats->maxPause ? pause : stats->maxPause;
+    countPause(stats, pause);
+}
+
+static void pruneCallCaches(CompiledFunction* fn)
+{
+    for (size_t i = 0; i < fn->numCallSites; ++i)
+    {
+        CallCache* cache = &fn->callCaches[i];
+        int len          = 0;
+        for (int j = 0; j < cache->len; ++j)
+        {
+            if (cache->closures[j]->object.marked)
+                cache->closures[len++] = cache->closures[j];
+        }
+        cache->len = len;
+    }
+}
+
+static void countPause(GCStats* stats, double pause)
+{
+    int bucket = 0;
+    for (double bound = 16e-6; pause >= bound && bucket < GC_PAUSE_BUCKETS - 1;
+         bound *= 2)
+        ++bucket;
+    ++stats->pauses[bucket];
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,77 @@
+#ifndef _MONKEY_LANG_SRC_GC_H_
+#define _MONKEY_LANG_SRC_GC_H_
+
+#include <stddef.h>
+
+#include "dynString.h"
+
+typedef struct Environment Environment;
+
+#define GC_DEFAULT_GROWTH 2.0
+#define GC_MIN_HEAP       (1 << 20)
+#define GC_NURSERY_SIZE   (256 << 10)
+
+// Pauses are counted in buckets of their length: under 16 us, under 32 us
+// and so on, doubling up to the last bucket, which has the longest ones
+#define GC_PAUSE_BUCKETS 12
+
+// Counters of the collector of an Environment, since it was made
+typedef struct
+{
+    size_t collections;
+    double totalPause; // seconds, of every step of the collections
+    double maxPause;   // of one step: a slice, or the whole collection
+    size_t markSlices;
+    size_t survivors; // objects left by the last collection
+    size_t freed;     // objects freed by every collection
+    size_t heapBytes; // held by the objects of the old space
+    size_t nextCollection;
+
+    size_t minorCollections;
+    double minorPause; // seconds, in total
+    double maxMinorPause;
+    size_t promoted; // closures copied out of the nursery
+
+    size_t pauses[GC_PAUSE_BUCKETS]; // minor and major, by length
+} GCStats;
+
+// Heap objects are traced from the roots of their environment: the
+// globals, the frames on its stack and the objects an engine pinned while
+// it runs. Everything else is freed, cycles included. Interned strings are
+// held weakly, and leave their table as they are freed.
+//
+// Closures are bump-allocated in a nursery, while arrays, hashes and
+// strings start out in the old space. When the nursery fills up, a minor
+// collection copies the closures reachable from the roots, and from old
+// objects in the remembered set, to the old space and empties the nursery
+// at once: its cost grows with the survivors and the distinct functions
+// of the young closures, not with the closures that died. A write barrier
+// adds an old object to the remembered set when it is made to refer to a
+// young closure.
+//
+// The old space is marked and swept by collectGarbage, which empties the
+// nursery first. It runs when a closure or another object is allocated and
+// the old space has grown past the size it had after the last collection
+// times the growth factor.
+//
+// With a mark budget, that collection is incremental instead. Marking
+// starts from the roots and goes on in slices, one per object allocated,
+// each tracing at most the budget in objects. Objects are white until
+// reached, gray until traced and black afterwards; a write barrier shades
+// what is stored into a black object, and objects made meanwhile start
+// gray. Once no gray object is left, the nursery is emptied and the roots
+// are marked again in one pause, and the old space is then swept in slices
+// of the same budget.
+void collectGarbage(Environment*);
+// Default 2.0, with a heap of at least GC_MIN_HEAP bytes between
+// collections. A factor of 0 collects on every allocation, to test the
+// roots.
+void setHeapGrowth(Environment*, double factor);
+// Default GC_NURSERY_SIZE; 0 allocates every closure in the old space
+void setNurserySize(Environment*, size_t bytes);
+// Objects traced per marking slice; the default 0 marks all at once
+void setMarkBudget(Environment*, size_t objects);
+GCStats getGCStats(const Environment*);
+String* dumpGCStats(const Environment*);
+
+#endif //_MONKEY_LANG_SRC_GC_H_
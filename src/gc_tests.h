@@ -0,0 +1,251 @@
+#define MAIN_TEST_NAME TestGC
+
+#include "environment.h"
+#include "gc.h"
+#include "testing.h"
+
+/* Function Signatures */
+int expectProgramsIn(Environment*, const char* [][2], size_t);
+
+// Run each program in env, one after the other, against its expected value
+int expectProgramsIn(Environment* env, const char* tests[][2], size_t len)
+{
+    int testStatus = TEST_SUCESSED;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        String* got = evalForTest(env, tests[i][0]);
+        if (cmpStringStr(got, tests[i][1]) != 0)
+        {
+            PRINT_ERR("`%s`: expected `%s`, got = `%s`", tests[i][0],
+                      tests[i][1], getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        freeString(got);
+    }
+
+    return testStatus;
+}
+
+TEST(FreeUnreachableClosures)
+{
+    Environment* env = mkEnvironment();
+    const char* tests[][2] = {
+        {"let make = fn(x) { fn() { x } }; make(1); make(2); make(3)",
+         "fn() { x }"},
+        {"let keep = make(4); keep()", "4"},
+    };
+
+    int testStatus = expectProgramsIn(env, tests, 2);
+    collectGarbage(env);
+
+    // make and keep are reachable from the globals
+    GCStats stats = getGCStats(env);
+    if (getObjectCount(env) != 2 || stats.survivors != 2 || stats.freed != 3)
+    {
+        PRINT_ERR("expected 2 objects left and 3 freed, got = %zu and %zu",
+                  getObjectCount(env), stats.freed);
+        testStatus = TEST_FAILED;
+    }
+
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(KeepCapturedClosures)
+{
+    Environment* env = mkEnvironment();
+    const char* tests[][2] = {
+        {"let make = fn(x) { fn() { x } }; "
+         "let wrap = fn(f) { fn() { f() + 1 } }; let w = wrap(make(7));",
+         ""},
+        {"let make = 0; let wrap = 0;", ""},
+        {"w()", "8"},
+    };
+
+    int testStatus = expectProgramsIn(env, tests, 2);
+    collectGarbage(env);
+
+    // w, and the closure of make(7) it captured
+    if (getObjectCount(env) != 2)
+    {
+        PRINT_ERR("expected 2 objects, got = %zu", getObjectCount(env));
+        testStatus = TEST_FAILED;
+    }
+    if (expectProgramsIn(env, tests + 2, 1) != TEST_SUCESSED)
+        testStatus = TEST_FAILED;
+
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(CollectAsTheHeapGrows)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* program =
+        "let make = fn(x) { fn() { x } }; "
+        "let spin = fn(n) { if (n > 0) { make(n); spin(n - 1); spin(n - 1) } "
+        "else { 0 } }; spin(15); make(5)()";
+
+    for (int stress = 0; stress <= 1; ++stress)
+    {
+        Environment* env = mkEnvironment();
+        if (stress)
+            setHeapGrowth(env, 0);
+
+        const char* tests[][2] = {{program, "5"}};
+        if (expectProgramsIn(env, tests, 1) != TEST_SUCESSED)
+            testStatus = TEST_FAILED;
+
+        // 2^15 closures outgrow the nursery, and die young
+        GCStats stats      = getGCStats(env);
+        size_t least       = stress ? 32768 : 1;
+        size_t collections = stats.collections + stats.minorCollections;
+        if (collections < least || getObjectCount(env) > 32768 / 2)
+        {
+            PRINT_ERR("expected %zu collections or more, got = %zu with %zu "
+                      "objects left",
+                      least, collections, getObjectCount(env));
+            testStatus = TEST_FAILED;
+        }
+        if (stats.nextCollection != (stress ? 0 : GC_MIN_HEAP))
+        {
+            PRINT_ERR("expected the next collection at %d bytes, got = %zu",
+                      stress ? 0 : GC_MIN_HEAP, stats.nextCollection);
+            testStatus = TEST_FAILED;
+        }
+
+        freeEnvironment(env);
+    }
+
+    return testStatus;
+}
+
+TEST(PromoteSurvivors)
+{
+    Environment* env = mkEnvironment();
+    setNurserySize(env, 4096);
+    const char* tests[][2] = {
+        {"let make = fn(x) { fn() { x } }; let keep = make(42); "
+         "let spin = fn(n) { if (n > 0) { make(n); spin(n - 1) } else { 0 } "
+         "}; spin(500); keep()",
+         "42"},
+        {"keep() + make(1)()", "43"},
+    };
+
+    int testStatus = expectProgramsIn(env, tests, 2);
+
+    // Only make, keep and spin outlive a minor collection
+    GCStats stats = getGCStats(env);
+    if (stats.minorCollections < 5 || stats.promoted > 3
+        || stats.collections != 0)
+    {
+        PRINT_ERR("expected 5 minor collections or more promoting 3 closures, "
+                  "got = %zu promoting %zu, and %zu major",
+                  stats.minorCollections, stats.promoted, stats.collections);
+        testStatus = TEST_FAILED;
+    }
+
+    collectGarbage(env);
+    if (getObjectCount(env) != 3)
+    {
+        PRINT_ERR("expected 3 objects, got = %zu", getObjectCount(env));
+        testStatus = TEST_FAILED;
+    }
+
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(RunWithoutNursery)
+{
+    Environment* env = mkEnvironment();
+    setNurserySize(env, 0);
+    const char* tests[][2] = {
+        {"let make = fn(x) { fn() { x } }; let a = make(1); make(2)() + a()",
+         "3"},
+    };
+
+    int testStatus = expectProgramsIn(env, tests, 1);
+
+    GCStats stats = getGCStats(env);
+    if (stats.minorCollections != 0 || getObjectCount(env) != 3)
+    {
+        PRINT_ERR("expected 3 old objects, got = %zu after %zu minor "
+                  "collections",
+                  getObjectCount(env), stats.minorCollections);
+        testStatus = TEST_FAILED;
+    }
+
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(MarkInSlices)
+{
+    Environment* env = mkEnvironment();
+    setNurserySize(env, 0);
+    setMarkBudget(env, 16);
+    const char* tests[][2] = {
+        {"let make = fn(x) { fn() { x } }; "
+         "let tree = fn(d) { if (d > 0) { let l = tree(d - 1); "
+         "let r = tree(d - 1); make(d); fn(f) { f(l, r, d) } } "
+         "else { make(1) } }; "
+         "let total = fn(t, d) { if (d > 0) { t(fn(l, r, x) { "
+         "total(l, d - 1) + total(r, d - 1) + x }) } else { t() } }; "
+         "let big = tree(12); let small = tree(12); total(big, 12)",
+         "12274"},
+    };
+
+    int testStatus = expectProgramsIn(env, tests, 1);
+
+    // Every slice and collection counts as a pause
+    GCStats stats = getGCStats(env);
+    size_t pauses = 0;
+    for (int i = 0; i < GC_PAUSE_BUCKETS; ++i)
+        pauses += stats.pauses[i];
+    if (stats.collections < 1 || stats.markSlices < 16
+        || pauses < stats.markSlices + stats.collections)
+    {
+        PRINT_ERR("expected slices of 16 objects, got = %zu slices, %zu "
+                  "collections and %zu pauses",
+                  stats.markSlices, stats.collections, pauses);
+        testStatus = TEST_FAILED;
+    }
+
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(DumpStats)
+{
+    int testStatus = TEST_SUCESSED;
+    Environment* env = mkEnvironment();
+
+    collectGarbage(env);
+    String* got = dumpGCStats(env);
+    if (strncmp(getStr(got), "gc: 1 collections, ", 19) != 0
+        || !strstr(getStr(got), "0 survivors, 0 freed, 0 objects in 0 bytes")
+        || !strstr(getStr(got), "\ngc: pauses "))
+    {
+        PRINT_ERR("unexpected stats `%s`", getStr(got));
+        testStatus = TEST_FAILED;
+    }
+
+    freeString(got);
+    freeEnvironment(env);
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(FreeUnreachableClosures);
+        RUN_TEST(KeepCapturedClosures);
+        RUN_TEST(CollectAsTheHeapGrows);
+        RUN_TEST(PromoteSurvivors);
+        RUN_TEST(RunWithoutNursery);
+        RUN_TEST(MarkInSlices);
+        RUN_TEST(DumpStats);
+    })
+
+#undef MAIN_TEST_NAME // End TestGC
@@ -0,0 +1,579 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "dynString.h"
+#include "hashCons.h"
+
+// Hash-consing works bottom-up: the children of a node are made canonical
+// before the node itself is looked up. Two nodes are then structurally equal
+// exactly when their own fields are equal and their children are the same
+// pointers, and the address of a canonical child stands for the hash of the
+// whole subtree below it.
+
+struct ConsEntry
+{
+    size_t hash;
+    Expr* expr;
+};
+
+struct ConsTable
+{
+    struct ConsEntry* entries;
+    size_t capacity;
+    size_t len;
+    size_t visited;
+    size_t visitedBytes;
+    size_t uniqueBytes;
+};
+
+/* Private Function Signatures */
+static void consBlock(struct ConsTable*, BlockStmt*);
+static void consStmt(struct ConsTable*, Stmt*);
+static void consExpr(struct ConsTable*, Expr**);
+static void consArguments(struct ConsTable*, Arguments*);
+static Expr* internExpr(struct ConsTable*, Expr*, size_t);
+static size_t exprBytes(const Expr*);
+static size_t argumentBytes(const Arguments*);
+static size_t hashExpr(Expr*);
+static size_t hashBlock(BlockStmt*);
+static size_t hashStmt(Stmt*);
+static size_t hashArguments(Arguments*);
+static int equalIdent(IdentExpr*, IdentExpr*);
+static int equalCaptures(FntExpr*, FntExpr*);
+static int equalExpr(Expr*, Expr*);
+static int equalBlock(BlockStmt*, BlockStmt*);
+static int equalStmt(Stmt*, Stmt*);
+static int equalArguments(Arguments*, Arguments*);
+
+HashConsStats hashConsProgram(Program* pProg)
+{
+    struct ConsTable table = {NULL, 0, 0, 0, 0, 0};
+
+    consBlock(&table, (BlockStmt*)pProg);
+    free(table.entries);
+
+    return (HashConsStats){table.visited, table.len, table.visitedBytes,
+                           table.uniqueBytes};
+}
+
+static void consBlock(struct ConsTable* table, BlockStmt* pBlockStmt)
+{
+    if (!pBlockStmt)
+        return;
+
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head)
+    {
+        consStmt(table, tmp->value);
+        tmp = tmp->before;
+    }
+}
+
+static void consStmt(struct ConsTable* table, Stmt* pStmt)
+{
+    if (!pStmt)
+        return;
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+        consExpr(table, &pStmt->inner.letStmt->value);
+        break;
+
+    case STMT_RETURN:
+        consExpr(table, &pStmt->inner.returnStmt->returnValue);
+        break;
+
+    case STMT_EXPRESSION:
+        consExpr(table, &pStmt->inner.exprStmt->expression);
+        break;
+
+    case STMT_BLOCK:
+        consBlock(table, pStmt->inner.blockStmt);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void consExpr(struct ConsTable* table, Expr** pExpr)
+{
+    Expr* expr = *pExpr;
+    if (!expr)
+        return;
+
+    // Already canonical, e.g. reached again through another parent
+    if (expr->refCount > 1)
+        return;
+
+    switch (expr->type)
+    {
+    case EXPR_PREFIX:
+        consExpr(table, &expr->inner.prefixExpr->right);
+        break;
+
+    case EXPR_INFIX:
+        consExpr(table, &expr->inner.infixExpr->left);
+        consExpr(table, &expr->inner.infixExpr->right);
+        break;
+
+    case EXPR_IF:
+        consExpr(table, &expr->inner.ifExpr->condition);
+        consBlock(table, expr->inner.ifExpr->consequence);
+        consBlock(table, expr->inner.ifExpr->alternative);
+        break;
+
+    case EXPR_FUNCTION:
+        consBlock(table, expr->inner.fntExpr->body);
+        break;
+
+    case EXPR_CALL:
+        consExpr(table, &expr->inner.callExpr->function);
+        consArguments(table, expr->inner.callExpr->arguments);
+        break;
+
+    case EXPR_ARRAY:
+        consArguments(table, expr->inner.arrayExpr->elements);
+        break;
+
+    case EXPR_HASH:
+        consArguments(table, expr->inner.hashExpr->pairs);
+        break;
+
+    case EXPR_INDEX:
+        consExpr(table, &expr->inner.indexExpr->left);
+        consExpr(table, &expr->inner.indexExpr->index);
+        break;
+
+    default:
+        break;
+    }
+
+    ++table->visited;
+    table->visitedBytes += exprBytes(expr);
+
+    Expr* canonical = internExpr(table, expr, hashExpr(expr));
+    if (canonical != expr)
+    {
+        freeExpr(expr);
+        *pExpr = retainExpr(canonical);
+    }
+}
+
+static void consArguments(struct ConsTable* table, Arguments* pArgs)
+{
+    struct ArgNode* tmp = pArgs->tail->before;
+    while (tmp != pArgs->head)
+    {
+        consExpr(table, &tmp->value);
+        tmp = tmp->before;
+    }
+}
+
+// Returns the canonical node equal to pExpr, inserting pExpr if it is new
+static Expr* internExpr(struct ConsTable* table, Expr* pExpr, size_t hash)
+{
+    if ((table->len + 1) * 2 > table->capacity)
+    {
+        size_t oldCapacity    = table->capacity;
+        struct ConsEntry* old = table->entries;
+
+        table->capacity = oldCapacity ? oldCapacity << 1 : 64;
+        table->entries  = calloc(table->capacity, sizeof(struct ConsEntry));
+
+        for (size_t i = 0; i < oldCapacity; ++i)
+        {
+            if (!old[i].expr)
+                continue;
+
+            size_t j = old[i].hash & (table->capacity - 1);
+            while (table->entries[j].expr)
+                j = (j + 1) & (table->capacity - 1);
+            table->entries[j] = old[i];
+        }
+        free(old);
+    }
+
+    size_t i = hash & (table->capacity - 1);
+    while (table->entries[i].expr)
+    {
+        if (table->entries[i].hash == hash
+            && equalExpr(table->entries[i].expr, pExpr))
+            return table->entries[i].expr;
+        i = (i + 1) & (table->capacity - 1);
+    }
+
+    table->entries[i] = (struct ConsEntry){hash, pExpr};
+    ++table->len;
+    table->uniqueBytes += exprBytes(pExpr);
+
+    return pExpr;
+}
+
+static size_t exprBytes(const Expr* pExpr)
+{
+    switch (pExpr->type)
+    {
+    case EXPR_IDENT:
+        return sizeof(Expr) + sizeof(IdentExpr);
+    case EXPR_INTEGER:
+        return sizeof(Expr) + sizeof(IntExpr);
+    case EXPR_BOOL:
+        return sizeof(Expr) + sizeof(BoolExpr);
+    case EXPR_PREFIX:
+        return sizeof(Expr) + sizeof(PrefixExpr);
+    case EXPR_INFIX:
+        return sizeof(Expr) + sizeof(InfixExpr);
+    case EXPR_IF:
+        return sizeof(Expr) + sizeof(IfExpr);
+    case EXPR_FUNCTION:
+        return sizeof(Expr) + sizeof(FntExpr);
+    case EXPR_CALL:
+        return sizeof(Expr) + sizeof(CallExpr)
+             + argumentBytes(pExpr->inner.callExpr->arguments);
+    case EXPR_ARRAY:
+        return sizeof(Expr) + sizeof(ArrayExpr)
+             + argumentBytes(pExpr->inner.arrayExpr->elements);
+    case EXPR_HASH:
+        return sizeof(Expr) + sizeof(HashExpr)
+             + argumentBytes(pExpr->inner.hashExpr->pairs);
+    case EXPR_INDEX:
+        return sizeof(Expr) + sizeof(IndexExpr);
+    case EXPR_STRING:
+        return sizeof(Expr) + sizeof(StringExpr);
+    default:
+        return sizeof(Expr);
+    }
+}
+
+// A list has a sentinel node at either end
+static size_t argumentBytes(const Arguments* pArgs)
+{
+    return sizeof(Arguments) + sizeof(struct ArgNode) * (pArgs->len + 2);
+}
+
+#define HASH_MIX(hash, value) \
+    ((hash) = ((hash) ^ (size_t)(value)) * (size_t)1099511628211ULL)
+
+static size_t hashExpr(Expr* pExpr)
+{
+    size_t hash = (size_t)14695981039346656037ULL;
+    HASH_MIX(hash, pExpr->type);
+
+    switch (pExpr->type)
+    {
+    case EXPR_IDENT:
+        HASH_MIX(hash, hashString(pExpr->inner.identExpr->value));
+        break;
+
+    case EXPR_INTEGER:
+        HASH_MIX(hash, (uint64_t)pExpr->inner.intExpr->value);
+        HASH_MIX(hash, (uint64_t)pExpr->inner.intExpr->value >> 32);
+        break;
+
+    case EXPR_BOOL:
+        HASH_MIX(hash, pExpr->inner.boolExpr->value != 0);
+        break;
+
+    case EXPR_STRING:
+        HASH_MIX(hash, hashString(pExpr->inner.stringExpr->value));
+        break;
+
+    case EXPR_PREFIX:
+        HASH_MIX(hash, hashString(pExpr->inner.prefixExpr->opt));
+        HASH_MIX(hash, (uintptr_t)pExpr->inner.prefixExpr->right);
+        break;
+
+    case EXPR_INFIX:
+        HASH_MIX(hash, (uintptr_t)pExpr->inner.infixExpr->left);
+        HASH_MIX(hash, hashString(pExpr->inner.infixExpr->opt));
+        HASH_MIX(hash, (uintptr_t)pExpr->inner.infixExpr->right);
+        break;
+
+    case EXPR_IF:
+        HASH_MIX(hash, (uintptr_t)pExpr->inner.ifExpr->condition);
+        HASH_MIX(hash, hashBlock(pExpr->inner.ifExpr->consequence));
+        HASH_MIX(hash, hashBlock(pExpr->inner.ifExpr->alternative));
+        break;
+
+    case EXPR_FUNCTION:
+    {
+        Parameters* params    = pExpr->inner.fntExpr->parameters;
+        struct ParamNode* tmp = params->tail->before;
+        while (tmp != params->head)
+        {
+            HASH_MIX(hash, hashString(tmp->value->value));
+            tmp = tmp->before;
+        }
+        HASH_MIX(hash, hashBlock(pExpr->inner.fntExpr->body));
+        break;
+    }
+
+    case EXPR_CALL:
+        HASH_MIX(hash, (uintptr_t)pExpr->inner.callExpr->function);
+        HASH_MIX(hash, pExpr->inner.callExpr->tail != 0);
+        HASH_MIX(hash, hashArguments(pExpr->inner.callExpr->arguments));
+        break;
+
+    case EXPR_ARRAY:
+        HASH_MIX(hash, hashArguments(pExpr->inner.arrayExpr->elements));
+        break;
+
+    case EXPR_HASH:
+        HASH_MIX(hash, hashArguments(pExpr->inner.hashExpr->pairs));
+        break;
+
+    case EXPR_INDEX:
+        HASH_MIX(hash, (uintptr_t)pExpr->inner.indexExpr->left);
+        HASH_MIX(hash, (uintptr_t)pExpr->inner.indexExpr->index);
+        break;
+
+    default:
+        break;
+    }
+
+    return hash;
+}
+
+static size_t hashArguments(Arguments* pArgs)
+{
+    size_t hash = (size_t)14695981039346656037ULL;
+    HASH_MIX(hash, pArgs->len);
+
+    struct ArgNode* tmp = pArgs->tail->before;
+    while (tmp != pArgs->head)
+    {
+        HASH_MIX(hash, (uintptr_t)tmp->value);
+        tmp = tmp->before;
+    }
+
+    return hash;
+}
+
+static size_t hashBlock(BlockStmt* pBlockStmt)
+{
+    size_t hash = (size_t)14695981039346656037ULL;
+    if (!pBlockStmt)
+        return hash;
+
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head)
+    {
+        HASH_MIX(hash, hashStmt(tmp->value));
+        tmp = tmp->before;
+    }
+
+    return hash;
+}
+
+static size_t hashStmt(Stmt* pStmt)
+{
+    size_t hash = (size_t)14695981039346656037ULL;
+    HASH_MIX(hash, pStmt->type);
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+        HASH_MIX(hash, hashString(pStmt->inner.letStmt->name->value));
+        HASH_MIX(hash, (uintptr_t)pStmt->inner.letStmt->value);
+        break;
+
+    case STMT_RETURN:
+        HASH_MIX(hash, (uintptr_t)pStmt->inner.returnStmt->returnValue);
+        break;
+
+    case STMT_EXPRESSION:
+        HASH_MIX(hash, (uintptr_t)pStmt->inner.exprStmt->expression);
+        break;
+
+    case STMT_BLOCK:
+        HASH_MIX(hash, hashBlock(pStmt->inner.blockStmt));
+        break;
+
+    default:
+        break;
+    }
+
+    return hash;
+}
+
+#undef HASH_MIX
+
+// Identifiers resolved to different slots must stay apart, so that
+// resolution can run before hash-consing.
+static int equalIdent(IdentExpr* lhs, IdentExpr* rhs)
+{
+    return lhs->kind == rhs->kind && lhs->depth == rhs->depth
+        && lhs->slot == rhs->slot && cmpString(lhs->value, rhs->value) == 0;
+}
+
+static int equalCaptures(FntExpr* lhs, FntExpr* rhs)
+{
+    if (lhs->numCaptures != rhs->numCaptures)
+        return 0;
+
+    for (int i = 0; i < lhs->numCaptures; ++i)
+    {
+        if (lhs->captures[i].source != rhs->captures[i].source
+            || lhs->captures[i].index != rhs->captures[i].index)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int equalExpr(Expr* lhs, Expr* rhs)
+{
+    if (lhs->type != rhs->type)
+        return 0;
+
+    switch (lhs->type)
+    {
+    case EXPR_IDENT:
+        return equalIdent(lhs->inner.identExpr, rhs->inner.identExpr);
+
+    case EXPR_INTEGER:
+        return lhs->inner.intExpr->value == rhs->inner.intExpr->value;
+
+    case EXPR_BOOL:
+        return (lhs->inner.boolExpr->value != 0)
+            == (rhs->inner.boolExpr->value != 0);
+
+    case EXPR_STRING:
+        return cmpString(lhs->inner.stringExpr->value,
+                         rhs->inner.stringExpr->value)
+            == 0;
+
+    case EXPR_PREFIX:
+        return lhs->inner.prefixExpr->right == rhs->inner.prefixExpr->right
+            && cmpString(lhs->inner.prefixExpr->opt,
+                         rhs->inner.prefixExpr->opt)
+                   == 0;
+
+    case EXPR_INFIX:
+        return lhs->inner.infixExpr->left == rhs->inner.infixExpr->left
+            && lhs->inner.infixExpr->right == rhs->inner.infixExpr->right
+            && cmpString(lhs->inner.infixExpr->opt, rhs->inner.infixExpr->opt)
+                   == 0;
+
+    case EXPR_IF:
+        return lhs->inner.ifExpr->condition == rhs->inner.ifExpr->condition
+            && equalBlock(lhs->inner.ifExpr->consequence,
+                          rhs->inner.ifExpr->consequence)
+            && equalBlock(lhs->inner.ifExpr->alternative,
+                          rhs->inner.ifExpr->alternative);
+
+    case EXPR_FUNCTION:
+    {
+        Parameters* lParams = lhs->inner.fntExpr->parameters;
+        Parameters* rParams = rhs->inner.fntExpr->parameters;
+        if (lParams->len != rParams->len)
+            return 0;
+
+        struct ParamNode* lTmp = lParams->tail->before;
+        struct ParamNode* rTmp = rParams->tail->before;
+        while (lTmp != lParams->head)
+        {
+            if (!equalIdent(lTmp->value, rTmp->value))
+                return 0;
+            lTmp = lTmp->before;
+            rTmp = rTmp->before;
+        }
+
+        return lhs->inner.fntExpr->numLocals == rhs->inner.fntExpr->numLocals
+            && lhs->inner.fntExpr->selfSlot == rhs->inner.fntExpr->selfSlot
+            && lhs->inner.fntExpr->pure == rhs->inner.fntExpr->pure
+            && equalCaptures(lhs->inner.fntExpr, rhs->inner.fntExpr)
+            && equalBlock(lhs->inner.fntExpr->body, rhs->inner.fntExpr->body);
+    }
+
+    case EXPR_CALL:
+        return lhs->inner.callExpr->function == rhs->inner.callExpr->function
+            && lhs->inner.callExpr->tail == rhs->inner.callExpr->tail
+            && equalArguments(lhs->inner.callExpr->arguments,
+                              rhs->inner.callExpr->arguments);
+
+    case EXPR_ARRAY:
+        return equalArguments(lhs->inner.arrayExpr->elements,
+                              rhs->inner.arrayExpr->elements);
+
+    case EXPR_HASH:
+        return equalArguments(lhs->inner.hashExpr->pairs,
+                              rhs->inner.hashExpr->pairs);
+
+    case EXPR_INDEX:
+        return lhs->inner.indexExpr->left == rhs->inner.indexExpr->left
+            && lhs->inner.indexExpr->index == rhs->inner.indexExpr->index;
+
+    default:
+        return 1;
+    }
+}
+
+static int equalArguments(Arguments* lhs, Arguments* rhs)
+{
+    if (lhs->len != rhs->len)
+        return 0;
+
+    struct ArgNode* lTmp = lhs->tail->before;
+    struct ArgNode* rTmp = rhs->tail->before;
+    while (lTmp != lhs->head)
+    {
+        if (lTmp->value != rTmp->value)
+            return 0;
+        lTmp = lTmp->before;
+        rTmp = rTmp->before;
+    }
+
+    return 1;
+}
+
+static int equalBlock(BlockStmt* lhs, BlockStmt* rhs)
+{
+    if (!lhs || !rhs)
+        return lhs == rhs;
+    if (lhs->len != rhs->len)
+        return 0;
+
+    struct ProgNode* lTmp = lhs->tail->before;
+    struct ProgNode* rTmp = rhs->tail->before;
+    while (lTmp != lhs->head)
+    {
+        if (!equalStmt(lTmp->value, rTmp->value))
+            return 0;
+        lTmp = lTmp->before;
+        rTmp = rTmp->before;
+    }
+
+    return 1;
+}
+
+static int equalStmt(Stmt* lhs, Stmt* rhs)
+{
+    if (lhs->type != rhs->type)
+        return 0;
+
+    switch (lhs->type)
+    {
+    case STMT_LET:
+        return lhs->inner.letStmt->value == rhs->inner.letStmt->value
+            && equalIdent(lhs->inner.letStmt->name, rhs->inner.letStmt->name);
+
+    case STMT_RETURN:
+        return lhs->inner.returnStmt->returnValue
+            == rhs->inner.returnStmt->returnValue;
+
+    case STMT_EXPRESSION:
+        return lhs->inner.exprStmt->expression
+            == rhs->inner.exprStmt->expression;
+
+    case STMT_BLOCK:
+        return equalBlock(lhs->inner.blockStmt, rhs->inner.blockStmt);
+
+    default:
+        return 1;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef _MONKEY_LANG_SRC_HASHCONS_H_
+#define _MONKEY_LANG_SRC_HASHCONS_H_
+
+#include <stddef.h>
+
+#include "ast.h"
+
+// Bytes count each Expr with the struct and argument list it owns, but
+// not its strings or the statements of a function body
+typedef struct
+{
+    size_t exprNodes;   // Expr nodes found in the program
+    size_t uniqueNodes; // Expr nodes left after sharing
+    size_t exprBytes;   // of the nodes found
+    size_t uniqueBytes; // of the nodes left
+} HashConsStats;
+
+// Make structurally equal Expr subtrees of the program share one node.
+// Shared nodes are reference counted, so freeProgram stays safe, but they
+// must not be mutated afterwards: run foldConstants/simplifyProgram and
+// resolveProgram/analyzeCaptures/analyzePurity first.
+HashConsStats hashConsProgram(Program*);
+
+#endif //_MONKEY_LANG_SRC_HASHCONS_H_
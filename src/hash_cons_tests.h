@@ -0,0 +1,64 @@
+#define MAIN_TEST_NAME TestHashCons
+
+#include "hashCons.h"
+#include "parser.h"
+#include "testing.h"
+
+TEST(SharesEqualSubtrees)
+{
+    int testStatus = TEST_SUCESSED;
+    struct
+    {
+        const char* input;
+        size_t expectedNodes;
+        size_t expectedUnique;
+    } tests[] = {
+        {"f(g(1, 2)); f(g(1, 2)); f(g(1, 2));", 18, 6},
+        {"let a = fn(x) { x * 2 }; let b = fn(x) { x * 2 };", 8, 4},
+        {"let a = fn(x) { x * 2 }; let b = fn(y) { y * 2 };", 8, 7},
+        {"1 + 2; 2 + 1; -1; !1", 10, 6},
+        {"if (a) { b } else { c }; if (a) { b }", 7, 5},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        Program* program = parseForTest(tests[i].input, NULL);
+        if (!program)
+            return TEST_FAILED;
+
+        String* expected = stringifyProgram(program);
+        HashConsStats stats = hashConsProgram(program);
+        String* got = stringifyProgram(program);
+
+        if (cmpString(got, expected) != 0)
+        {
+            PRINT_ERR("expected `%s`, got = `%s`", getStr(expected),
+                      getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        else if (stats.exprNodes != tests[i].expectedNodes
+                 || stats.uniqueNodes != tests[i].expectedUnique
+                 || stats.uniqueBytes > stats.exprBytes
+                 || (stats.uniqueBytes == stats.exprBytes)
+                        != (stats.uniqueNodes == stats.exprNodes))
+        {
+            PRINT_ERR("`%s` kept %zu of %zu nodes, expected %zu of %zu",
+                      tests[i].input, stats.uniqueNodes, stats.exprNodes,
+                      tests[i].expectedUnique, tests[i].expectedNodes);
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(expected);
+        freeString(got);
+        freeProgram(program);
+    }
+
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(SharesEqualSubtrees);
+    })
+
+#undef MAIN_TEST_NAME // End TestHashCons
@@ -0,0 +1,1033 @@
+#define _DEFAULT_SOURCE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "code.h"
+#include "environment.h"
+#include "jit.h"
+#include "object.h"
+
+int isJitSupported(void)
+{
+#ifdef JIT_SUPPORTED
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void setJitThreshold(Environment* env, int threshold)
+{
+    env->jitThreshold = threshold > 0 ? threshold : 0;
+}
+
+#ifndef JIT_SUPPORTED
+
+int compileNative(CompiledFunction* fn)
+{
+    (void)fn;
+    return 0;
+}
+
+void freeNativeCode(CompiledFunction* fn) { (void)fn; }
+
+#else
+
+
+// A baseline compiler: every instruction becomes a fixed template working
+// on the same stack slots as the interpreter. The depth of the operand
+// stack before each instruction is known at compile time, so operands sit
+// at fixed offsets from the frame. Pushes of constants and locals are
+// deferred until their value has to be in its slot, so that arithmetic and
+// comparisons read them where they are, and a comparison feeding a
+// conditional jump branches on the flags. Only calls, and operands other
+// than integers, go back to C.
+//
+// Registers live through the whole function, all callee-saved so that
+// calls into the runtime keep them:
+//   rbx  address of the frame, reloaded after calls since the stack moves
+//   r12  env
+//   r13  closure, reloaded with rbx since a collection may move it
+//   r14  byte offset of the frame in the stack
+enum
+{
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+    RSP = 4,
+    RDI = 7,
+    R12 = 12,
+    R13 = 13,
+    R14 = 14,
+};
+
+// Condition codes of jcc and setcc; flipping the low bit negates one
+enum
+{
+    CC_E  = 0x4,
+    CC_NE = 0x5,
+    CC_L  = 0xc,
+    CC_G  = 0xf,
+};
+
+// Jump targets that are not instructions
+#define TO_FAIL ((size_t)-1) // return 1, the error being set
+#define TO_EXIT ((size_t)-2) // return eax
+
+// Byte offsets from rbx of the tag and payload of slot i of the frame
+#define SLOT(i)    ((int32_t)(i) * (int32_t)sizeof(Value))
+#define PAYLOAD(i) (SLOT(i) + (int32_t)offsetof(Value, as))
+
+// Where the value of an operand is while compiling: in its own slot above
+// the frame, or still in a local or a constant, its push deferred
+enum
+{
+    IN_SLOT = 0,
+    IN_LOCAL,
+    IN_CONSTANT,
+};
+
+struct Operand
+{
+    int kind;
+    int local;
+    Value constant;
+};
+
+struct Fixup
+{
+    size_t at;     // offset of a rel32 operand
+    size_t target; // instruction index, TO_FAIL or TO_EXIT
+};
+
+struct Jit
+{
+    CompiledFunction* fn;
+
+    uint8_t* code;
+    size_t len;
+    size_t capacity;
+    int failed; // a short jump went out of range
+
+    size_t* offsets; // native offset of each instruction
+    int* depths;     // operand stack depth before each, -1 if unreachable
+    char* targets;   // whether a jump lands on each
+
+    struct Operand* operands;
+    int numOperands;
+
+    struct Fixup* fixups;
+    size_t numFixups;
+    size_t fixupCapacity;
+};
+
+#define PUT(j, ...)                                       \
+    putBytes((j), sizeof((const uint8_t[]){__VA_ARGS__}), \
+             (const uint8_t[]){__VA_ARGS__})
+#define MEM(j, wide, reg, base, disp, ...)             \
+    memOperand((j), (wide), (reg), (base), (disp),     \
+               sizeof((const uint8_t[]){__VA_ARGS__}), \
+               (const uint8_t[]){__VA_ARGS__})
+
+/* Private Function Signatures */
+static Opcode plainOpcode(uint32_t);
+static size_t compileInstr(struct Jit*, size_t);
+static void compileArithmetic(struct Jit*, Opcode, uint32_t);
+static size_t compileComparison(struct Jit*, Opcode, uint32_t, int, size_t);
+static int flowTo(struct Jit*, size_t, size_t, int);
+static void pushOperand(struct Jit*, int, int, Value);
+static void materialize(struct Jit*, int);
+static void materializeAll(struct Jit*);
+static void spill(struct Jit*, int);
+static void storeOperand(struct Jit*, int, int32_t, int);
+static void loadOperand(struct Jit*, int, int);
+static void checkInt(struct Jit*, int, size_t*, int*);
+static void put8(struct Jit*, uint8_t);
+static void put32(struct Jit*, uint32_t);
+static void put64(struct Jit*, uint64_t);
+static void putBytes(struct Jit*, size_t, const uint8_t*);
+static void memOperand(struct Jit*, int, int, int, int32_t, size_t,
+                       const uint8_t*);
+static void jumpTo(struct Jit*, int, size_t);
+static size_t jumpShort(struct Jit*, int);
+static void landShort(struct Jit*, size_t);
+static void callRuntime(struct Jit*, uint64_t);
+static void reloadFrame(struct Jit*);
+static void loadImmediate(struct Jit*, int, uint64_t);
+static void copySlot(struct Jit*, int, int32_t, int, int32_t);
+static void storeType(struct Jit*, int, ValueType);
+static void storeValue(struct Jit*, int, int32_t, Value);
+static void storeBool(struct Jit*, int, int);
+static void testFalsy(struct Jit*, int);
+static void raiseError(struct Jit*, uint32_t, int);
+static uint64_t payloadOf(Value);
+static void nativeError(Environment*, uint32_t, const Value*);
+static int nativeAdd(Environment*, uint32_t, Value*);
+static int nativeEqual(const Value*);
+
+int compileNative(CompiledFunction* fn)
+{
+    struct Jit j;
+    j.fn            = fn;
+    j.code          = NULL;
+    j.len           = 0;
+    j.capacity      = 0;
+    j.failed        = 0;
+    j.offsets       = malloc(sizeof(size_t) * (fn->codeLen + 1));
+    j.depths        = malloc(sizeof(int) * (fn->codeLen + 1));
+    j.targets       = calloc(fn->codeLen + 1, 1);
+    j.operands      = malloc(sizeof(struct Operand) * (size_t)(fn->maxStack + 1));
+    j.numOperands   = 0;
+    j.fixups        = NULL;
+    j.numFixups     = 0;
+    j.fixupCapacity = 0;
+
+    for (size_t pc = 0; pc <= fn->codeLen; ++pc)
+        j.depths[pc] = -1;
+    j.depths[0] = 0;
+
+    for (size_t pc = 0; pc < fn->codeLen; ++pc)
+    {
+        Opcode op = plainOpcode(fn->code[pc]);
+        if ((op == OP_JUMP || op == OP_JUMP_FALSY)
+            && INSTR_ARG(fn->code[pc]) <= fn->codeLen)
+            j.targets[INSTR_ARG(fn->code[pc])] = 1;
+    }
+
+    // Save the callee-saved registers, which also aligns the stack for
+    // calls, and set up the ones the templates rely on
+    PUT(&j, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56);
+    PUT(&j, 0x49, 0x89, 0xfc);       // mov r12, rdi
+    PUT(&j, 0x49, 0x89, 0xf6);       // mov r14, rsi
+    PUT(&j, 0x49, 0xc1, 0xe6, 0x04); // shl r14, 4
+    PUT(&j, 0x49, 0x89, 0xd5);       // mov r13, rdx
+    reloadFrame(&j);
+
+    // Jumps only go forward, so the depth of an instruction is settled by
+    // the time it is reached. Operands are all in their slots where
+    // control flow merges.
+    int ok   = 1;
+    int live = 1; // whether the code so far falls through
+    size_t pc = 0;
+    while (pc < fn->codeLen && ok)
+    {
+        if (j.depths[pc] < 0)
+        {
+            j.offsets[pc++] = j.len;
+            live            = 0;
+            continue;
+        }
+
+        if (j.targets[pc])
+        {
+            if (live)
+                materializeAll(&j);
+            j.numOperands = j.depths[pc];
+            for (int k = 0; k < j.numOperands; ++k)
+                j.operands[k].kind = IN_SLOT;
+        }
+        if (j.numOperands != j.depths[pc])
+            break;
+
+        j.offsets[pc] = j.len;
+        size_t n      = compileInstr(&j, pc);
+        ok            = n > 0;
+
+        int depth = j.depths[pc];
+        for (size_t at = pc; at < pc + n && ok; ++at)
+        {
+            Opcode op    = plainOpcode(fn->code[at]);
+            uint32_t arg = INSTR_ARG(fn->code[at]);
+            depth += getStackEffect(op, arg);
+            j.offsets[at] = j.offsets[pc];
+
+            if (op == OP_JUMP || op == OP_JUMP_FALSY)
+                ok = flowTo(&j, at, arg, depth);
+            live = op != OP_JUMP && op != OP_TAIL_CALL && op != OP_RETURN;
+            if (ok && live)
+                ok = flowTo(&j, at, at + 1, depth);
+        }
+        pc += n;
+    }
+    ok = ok && pc == fn->codeLen && !j.failed;
+
+    size_t failAt = j.len;
+    PUT(&j, 0xb8, 0x01, 0x00, 0x00, 0x00); // mov eax, 1
+    size_t exitAt = j.len;
+    PUT(&j, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5d, 0x5b, 0xc3);
+
+    for (size_t i = 0; i < j.numFixups && ok; ++i)
+    {
+        size_t target = j.fixups[i].target;
+        size_t to     = target == TO_FAIL   ? failAt
+                      : target == TO_EXIT ? exitAt
+                                          : j.offsets[target];
+        uint32_t rel = (uint32_t)(to - (j.fixups[i].at + 4));
+        memcpy(j.code + j.fixups[i].at, &rel, sizeof(rel));
+    }
+
+    // Write the code, then make it executable but no longer writable
+    void* memory = MAP_FAILED;
+    size_t size  = 0;
+    if (ok)
+    {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size        = (j.len + page - 1) / page * page;
+        memory      = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (memory != MAP_FAILED)
+    {
+        memcpy(memory, j.code, j.len);
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) == 0)
+        {
+            fn->native     = memory;
+            fn->nativeSize = size;
+        }
+        else
+        {
+            munmap(memory, size);
+        }
+    }
+
+    free(j.code);
+    free(j.offsets);
+    free(j.depths);
+    free(j.targets);
+    free(j.operands);
+    free(j.fixups);
+    return fn->native != NULL;
+}
+
+void freeNativeCode(CompiledFunction* fn)
+{
+    if (fn->native)
+        munmap(fn->native, fn->nativeSize);
+    fn->native     = NULL;
+    fn->nativeSize = 0;
+}
+
+// A superinstruction stands for its first part, the others following it
+static Opcode plainOpcode(uint32_t instr)
+{
+    Opcode parts[MAX_SUPER_LENGTH];
+    Opcode op = INSTR_OP(instr);
+    return getSuperinstruction(op, parts) ? parts[0] : op;
+}
+
+// Emit the template of the instruction at pc. Returns the number of
+// instructions compiled, 2 when a conditional jump was folded into the
+// comparison before it, or 0 for instructions left to the interpreter.
+static size_t compileInstr(struct Jit* j, size_t pc)
+{
+    CompiledFunction* fn = j->fn;
+    Opcode op            = plainOpcode(fn->code[pc]);
+    uint32_t arg         = INSTR_ARG(fn->code[pc]);
+    uint32_t instr       = MAKE_INSTR(op, arg);
+    int top              = j->numOperands - 1;
+    int topSlot          = fn->frameSize + top;
+    size_t error, over;
+
+    switch (op)
+    {
+    case OP_CONSTANT:
+        pushOperand(j, IN_CONSTANT, 0, fn->constants[arg]);
+        return 1;
+
+    case OP_TRUE:
+    case OP_FALSE:
+        pushOperand(j, IN_CONSTANT, 0, BOOL_VALUE(op == OP_TRUE));
+        return 1;
+
+    case OP_NULL:
+        pushOperand(j, IN_CONSTANT, 0, NULL_VALUE);
+        return 1;
+
+    case OP_UNDEFINED:
+        pushOperand(j, IN_CONSTANT, 0, UNDEFINED_VALUE);
+        return 1;
+
+    case OP_POP:
+        --j->numOperands;
+        return 1;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+        compileArithmetic(j, op, instr);
+        return 1;
+
+    case OP_EQ:
+    case OP_NE:
+    case OP_LT:
+    case OP_GT:
+    {
+        int fused = pc + 1 < fn->codeLen && !j->targets[pc + 1]
+                 && plainOpcode(fn->code[pc + 1]) == OP_JUMP_FALSY;
+        return compileComparison(j, op, instr, fused,
+                                 fused ? INSTR_ARG(fn->code[pc + 1]) : 0);
+    }
+
+    case OP_MINUS:
+        if (j->operands[top].kind == IN_CONSTANT
+            && j->operands[top].constant.type == VALUE_INT)
+        {
+            int64_t* value = &j->operands[top].constant.as.integer;
+            *value         = (int64_t)(0 - (uint64_t)*value);
+            return 1;
+        }
+        materialize(j, top);
+        MEM(j, 0, 7, RBX, SLOT(topSlot), 0x83); // cmp dword [top], INT
+        put8(j, VALUE_INT);
+        error = jumpShort(j, CC_NE);
+        MEM(j, 1, 3, RBX, PAYLOAD(topSlot), 0xf7); // neg qword [top]
+        over = jumpShort(j, -1);
+        landShort(j, error);
+        raiseError(j, instr, topSlot);
+        landShort(j, over);
+        return 1;
+
+    case OP_BANG:
+        if (j->operands[top].kind == IN_CONSTANT)
+        {
+            Value value = j->operands[top].constant;
+            j->operands[top].constant =
+                BOOL_VALUE(value.type == VALUE_BOOL ? !value.as.boolean
+                                                    : value.type <= VALUE_NULL);
+            return 1;
+        }
+        materialize(j, top);
+        testFalsy(j, topSlot);
+        storeBool(j, topSlot, CC_NE);
+        return 1;
+
+    case OP_JUMP:
+        materializeAll(j);
+        jumpTo(j, -1, arg);
+        return 1;
+
+    case OP_JUMP_FALSY:
+        materializeAll(j);
+        testFalsy(j, topSlot);
+        --j->numOperands;
+        jumpTo(j, CC_NE, arg);
+        return 1;
+
+    case OP_GET_GLOBAL:
+        MEM(j, 1, RAX, R12, (int32_t)offsetof(Environment, globals), 0x8b);
+        MEM(j, 0, 7, RAX, SLOT(arg), 0x83); // cmp dword [global], UNDEFINED
+        put8(j, VALUE_UNDEFINED);
+        error = jumpShort(j, CC_E);
+        copySlot(j, RBX, SLOT(topSlot + 1), RAX, SLOT(arg));
+        over = jumpShort(j, -1);
+        landShort(j, error);
+        raiseError(j, instr, topSlot);
+        landShort(j, over);
+        pushOperand(j, IN_SLOT, 0, UNDEFINED_VALUE);
+        return 1;
+
+    case OP_SET_GLOBAL:
+        MEM(j, 1, RAX, R12, (int32_t)offsetof(Environment, globals), 0x8b);
+        storeOperand(j, RAX, SLOT(arg), top);
+        --j->numOperands;
+        return 1;
+
+    case OP_GET_LOCAL:
+        pushOperand(j, IN_LOCAL, (int)arg, UNDEFINED_VALUE);
+        return 1;
+
+    case OP_SET_LOCAL:
+        // Deferred reads of the local must see its old value
+        for (int k = 0; k < top; ++k)
+        {
+            if (j->operands[k].kind == IN_LOCAL
+                && j->operands[k].local == (int)arg)
+                materialize(j, k);
+        }
+        storeOperand(j, RBX, SLOT(arg), top);
+        --j->numOperands;
+        return 1;
+
+    case OP_GET_CAPTURE:
+        copySlot(j, RBX, SLOT(topSlot + 1), R13,
+                 (int32_t)offsetof(Closure, captures) + SLOT(arg));
+        pushOperand(j, IN_SLOT, 0, UNDEFINED_VALUE);
+        return 1;
+
+    case OP_CALL:
+    {
+        uint32_t argc = CALL_ARGC(arg);
+        int callee    = topSlot - (int)argc;
+        materializeAll(j);
+        PUT(j, 0x4c, 0x89, 0xe7);       // mov rdi, r12
+        PUT(j, 0x4c, 0x89, 0xf6);       // mov rsi, r14
+        PUT(j, 0x48, 0xc1, 0xee, 0x04); // shr rsi, 4
+        PUT(j, 0x48, 0x81, 0xc6);       // add rsi, callee
+        put32(j, (uint32_t)callee);
+        put8(j, 0xba); // mov edx, argc
+        put32(j, argc);
+        callRuntime(j, (uint64_t)(uintptr_t)callFromNative);
+        reloadFrame(j);
+        PUT(j, 0x85, 0xc0); // test eax, eax
+        jumpTo(j, CC_NE, TO_FAIL);
+        j->numOperands -= (int)argc;
+        return 1;
+    }
+
+    case OP_TAIL_CALL:
+    {
+        // The callee takes over the frame, and the VM runs it from there
+        uint32_t argc = CALL_ARGC(arg);
+        int callee    = topSlot - (int)argc;
+        materializeAll(j);
+        PUT(j, 0x4c, 0x89, 0xe7);       // mov rdi, r12
+        PUT(j, 0x4c, 0x89, 0xf6);       // mov rsi, r14
+        PUT(j, 0x48, 0xc1, 0xee, 0x04); // shr rsi, 4
+        PUT(j, 0x48, 0x89, 0xf1);       // mov rcx, rsi
+        PUT(j, 0x48, 0x81, 0xc6);       // add rsi, callee
+        put32(j, (uint32_t)callee);
+        PUT(j, 0x48, 0x81, 0xc1); // add rcx, slot of the running callee
+        put32(j, (uint32_t)(fn->firstParam - 1));
+        put8(j, 0xba); // mov edx, argc
+        put32(j, argc);
+        callRuntime(j, (uint64_t)(uintptr_t)tailCallFromNative);
+        PUT(j, 0x85, 0xc0); // test eax, eax
+        jumpTo(j, CC_NE, TO_FAIL);
+        put8(j, 0xb8); // mov eax, NATIVE_TAIL_CALL
+        put32(j, NATIVE_TAIL_CALL);
+        jumpTo(j, -1, TO_EXIT);
+        j->numOperands -= (int)argc;
+        return 1;
+    }
+
+    case OP_RETURN:
+        // The result replaces the callee below the arguments
+        storeOperand(j, RBX, SLOT(fn->firstParam - 1), top);
+        PUT(j, 0x31, 0xc0); // xor eax, eax
+        jumpTo(j, -1, TO_EXIT);
+        return 1;
+
+    default:
+        // Closures stay with the interpreter, as do unknown opcodes
+        return 0;
+    }
+}
+
+// Integer arithmetic on the two operands on top, wrapping around as the
+// hardware does. The result goes to the slot of the left operand.
+static void compileArithmetic(struct Jit* j, Opcode op, uint32_t instr)
+{
+    int left     = j->numOperands - 2;
+    int right    = left + 1;
+    int leftSlot = j->fn->frameSize + left;
+
+    size_t errors[4];
+    int numErrors = 0;
+    checkInt(j, left, errors, &numErrors);
+    checkInt(j, right, errors, &numErrors);
+    loadOperand(j, RAX, left);
+    loadOperand(j, RCX, right);
+
+    if (op == OP_ADD)
+        PUT(j, 0x48, 0x01, 0xc8); // add rax, rcx
+    else if (op == OP_SUB)
+        PUT(j, 0x48, 0x29, 0xc8); // sub rax, rcx
+    else if (op == OP_MUL)
+        PUT(j, 0x48, 0x0f, 0xaf, 0xc1); // imul rax, rcx
+    else
+    {
+        // Division by zero is an error, and by -1 a negation, which wraps
+        // instead of trapping for the smallest integer. Known divisors
+        // skip the checks.
+        const struct Operand* divisor = &j->operands[right];
+        int known   = divisor->kind == IN_CONSTANT
+                 && divisor->constant.type == VALUE_INT;
+        int64_t by  = known ? divisor->constant.as.integer : 0;
+
+        if (!known)
+        {
+            PUT(j, 0x48, 0x85, 0xc9); // test rcx, rcx
+            errors[numErrors++] = jumpShort(j, CC_E);
+            PUT(j, 0x48, 0x83, 0xf9, 0xff); // cmp rcx, -1
+            size_t divide = jumpShort(j, CC_NE);
+            PUT(j, 0x48, 0xf7, 0xd8); // neg rax
+            size_t done = jumpShort(j, -1);
+            landShort(j, divide);
+            PUT(j, 0x48, 0x99, 0x48, 0xf7, 0xf9); // cqo; idiv rcx
+            landShort(j, done);
+        }
+        else if (by == 0)
+            errors[numErrors++] = jumpShort(j, -1);
+        else if (by == -1)
+            PUT(j, 0x48, 0xf7, 0xd8); // neg rax
+        else
+            PUT(j, 0x48, 0x99, 0x48, 0xf7, 0xf9); // cqo; idiv rcx
+    }
+
+    // A left operand checked in its slot is already tagged as an integer
+    if (j->operands[left].kind != IN_SLOT)
+        storeType(j, leftSlot, VALUE_INT);
+    MEM(j, 1, RAX, RBX, PAYLOAD(leftSlot), 0x89); // mov [left], rax
+
+    if (numErrors)
+    {
+        size_t over = jumpShort(j, -1);
+        for (int i = 0; i < numErrors; ++i)
+            landShort(j, errors[i]);
+        spill(j, left);
+        spill(j, right);
+        if (op == OP_ADD)
+        {
+            // Strings concatenate in C, which may collect
+            PUT(j, 0x4c, 0x89, 0xe7); // mov rdi, r12
+            put8(j, 0xbe);            // mov esi, instr
+            put32(j, instr);
+            MEM(j, 1, RDX, RBX, SLOT(leftSlot), 0x8d); // lea rdx, [left]
+            callRuntime(j, (uint64_t)(uintptr_t)nativeAdd);
+            reloadFrame(j);
+            PUT(j, 0x85, 0xc0); // test eax, eax
+            jumpTo(j, CC_NE, TO_FAIL);
+        }
+        else
+        {
+            raiseError(j, instr, leftSlot);
+        }
+        landShort(j, over);
+    }
+
+    --j->numOperands;
+    j->operands[left].kind = IN_SLOT;
+}
+
+// Compare the two operands on top. Folded with the conditional jump after
+// it, the comparison branches on the flags rather than making a boolean.
+// Anything but two integers is equal as valuesEqual says, and cannot be
+// ordered.
+static size_t compileComparison(struct Jit* j, Opcode op, uint32_t instr,
+                                int fused, size_t target)
+{
+    int left     = j->numOperands - 2;
+    int right    = left + 1;
+    int leftSlot = j->fn->frameSize + left;
+    int cc       = op == OP_EQ ? CC_E
+                 : op == OP_NE ? CC_NE
+                 : op == OP_LT ? CC_L
+                               : CC_G;
+
+    // The jump ends the block, so the operands below must be in place
+    if (fused)
+    {
+        for (int k = 0; k < left; ++k)
+            materialize(j, k);
+    }
+
+    size_t slow[4];
+    int numSlow = 0;
+    checkInt(j, left, slow, &numSlow);
+    checkInt(j, right, slow, &numSlow);
+    loadOperand(j, RAX, left);
+    loadOperand(j, RCX, right);
+    PUT(j, 0x48, 0x39, 0xc8); // cmp rax, rcx
+
+    if (numSlow)
+    {
+        size_t join = jumpShort(j, -1);
+        for (int i = 0; i < numSlow; ++i)
+            landShort(j, slow[i]);
+        spill(j, left);
+        spill(j, right);
+
+        if (op == OP_EQ || op == OP_NE)
+        {
+            MEM(j, 1, RDI, RBX, SLOT(leftSlot), 0x8d); // lea rdi, [left]
+            callRuntime(j, (uint64_t)(uintptr_t)nativeEqual);
+            PUT(j, 0x83, 0xf8, 0x01); // cmp eax, 1: equal if true
+        }
+        else
+        {
+            raiseError(j, instr, leftSlot);
+        }
+        landShort(j, join);
+    }
+
+    if (fused)
+    {
+        j->numOperands -= 2;
+        jumpTo(j, cc ^ 1, target);
+        return 2;
+    }
+
+    storeBool(j, leftSlot, cc);
+    --j->numOperands;
+    j->operands[left].kind = IN_SLOT;
+    return 1;
+}
+
+// Record that the instruction at pc continues at target with depth
+// operands. Returns 0 if the jump goes backward or out of the code, or
+// disagrees on the depth, none of which the compiler emits.
+static int flowTo(struct Jit* j, size_t pc, size_t target, int depth)
+{
+    if (target <= pc || target >= j->fn->codeLen)
+        return target == pc + 1 && target == j->fn->codeLen;
+
+    if (j->depths[target] < 0)
+        j->depths[target] = depth;
+    return j->depths[target] == depth;
+}
+
+static void pushOperand(struct Jit* j, int kind, int local, Value constant)
+{
+    struct Operand* operand = &j->operands[j->numOperands++];
+    operand->kind           = kind;
+    operand->local          = local;
+    operand->constant       = constant;
+}
+
+// Emit the deferred push of operand k, which is in its slot from then on
+static void materialize(struct Jit* j, int k)
+{
+    spill(j, k);
+    j->operands[k].kind = IN_SLOT;
+}
+
+static void materializeAll(struct Jit* j)
+{
+    for (int k = 0; k < j->numOperands; ++k)
+        materialize(j, k);
+}
+
+// Write operand k to its slot, on a path where it stays deferred
+static void spill(struct Jit* j, int k)
+{
+    if (j->operands[k].kind != IN_SLOT)
+        storeOperand(j, RBX, SLOT(j->fn->frameSize + k), k);
+}
+
+// Copy operand k to [base + disp]
+static void storeOperand(struct Jit* j, int base, int32_t disp, int k)
+{
+    const struct Operand* operand = &j->operands[k];
+    if (operand->kind == IN_CONSTANT)
+        storeValue(j, base, disp, operand->constant);
+    else if (operand->kind == IN_LOCAL)
+        copySlot(j, base, disp, RBX, SLOT(operand->local));
+    else
+        copySlot(j, base, disp, RBX, SLOT(j->fn->frameSize + k));
+}
+
+// Load the payload of operand k into reg
+static void loadOperand(struct Jit* j, int reg, int k)
+{
+    const struct Operand* operand = &j->operands[k];
+    if (operand->kind == IN_CONSTANT)
+        loadImmediate(j, reg, payloadOf(operand->constant));
+    else if (operand->kind == IN_LOCAL)
+        MEM(j, 1, reg, RBX, PAYLOAD(operand->local), 0x8b);
+    else
+        MEM(j, 1, reg, RBX, PAYLOAD(j->fn->frameSize + k), 0x8b);
+}
+
+// Add a short jump to jumps, taken unless operand k is an integer
+static void checkInt(struct Jit* j, int k, size_t* jumps, int* numJumps)
+{
+    const struct Operand* operand = &j->operands[k];
+    if (operand->kind == IN_CONSTANT)
+    {
+        if (operand->constant.type != VALUE_INT)
+            jumps[(*numJumps)++] = jumpShort(j, -1);
+        return;
+    }
+
+    int slot = operand->kind == IN_LOCAL ? operand->local
+                                         : j->fn->frameSize + k;
+    MEM(j, 0, 7, RBX, SLOT(slot), 0x83); // cmp dword [slot], INT
+    put8(j, VALUE_INT);
+    jumps[(*numJumps)++] = jumpShort(j, CC_NE);
+}
+
+static void put8(struct Jit* j, uint8_t byte)
+{
+    if (j->len == j->capacity)
+    {
+        j->capacity = j->capacity ? j->capacity << 1 : 256;
+        j->code     = realloc(j->code, j->capacity);
+    }
+    j->code[j->len++] = byte;
+}
+
+static void put32(struct Jit* j, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        put8(j, (uint8_t)(value >> (8 * i)));
+}
+
+static void put64(struct Jit* j, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+        put8(j, (uint8_t)(value >> (8 * i)));
+}
+
+static void putBytes(struct Jit* j, size_t n, const uint8_t* bytes)
+{
+    for (size_t i = 0; i < n; ++i)
+        put8(j, bytes[i]);
+}
+
+// An instruction whose memory operand is [base + disp]: the REX prefix if
+// needed, the opcode, then ModRM with a 32-bit displacement
+static void memOperand(struct Jit* j, int wide, int reg, int base,
+                       int32_t disp, size_t opcodeLen, const uint8_t* opcode)
+{
+    uint8_t rex = (uint8_t)((wide ? 0x48 : 0) | (reg & 8 ? 0x44 : 0)
+                            | (base & 8 ? 0x41 : 0));
+    if (rex)
+        put8(j, rex);
+    putBytes(j, opcodeLen, opcode);
+    put8(j, (uint8_t)(0x80 | (reg & 7) << 3 | (base & 7)));
+    if ((base & 7) == RSP)
+        put8(j, 0x24); // SIB: no index
+    put32(j, (uint32_t)disp);
+}
+
+// jcc, or jmp when cc is -1, to an instruction or to TO_FAIL or TO_EXIT
+static void jumpTo(struct Jit* j, int cc, size_t target)
+{
+    if (cc < 0)
+        put8(j, 0xe9);
+    else
+        PUT(j, 0x0f, (uint8_t)(0x80 | cc));
+
+    if (j->numFixups == j->fixupCapacity)
+    {
+        j->fixupCapacity = j->fixupCapacity ? j->fixupCapacity << 1 : 16;
+        j->fixups =
+            realloc(j->fixups, sizeof(struct Fixup) * j->fixupCapacity);
+    }
+    j->fixups[j->numFixups].at     = j->len;
+    j->fixups[j->numFixups].target = target;
+    ++j->numFixups;
+    put32(j, 0);
+}
+
+// A jump within a template, or jmp when cc is -1; landShort points it at
+// the code that follows
+static size_t jumpShort(struct Jit* j, int cc)
+{
+    put8(j, (uint8_t)(cc < 0 ? 0xeb : 0x70 | cc));
+    put8(j, 0);
+    return j->len - 1;
+}
+
+static void landShort(struct Jit* j, size_t at)
+{
+    size_t distance = j->len - (at + 1);
+    if (distance > 127)
+        j->failed = 1;
+    j->code[at] = (uint8_t)distance;
+}
+
+static void callRuntime(struct Jit* j, uint64_t address)
+{
+    PUT(j, 0x48, 0xb8); // mov rax, address
+    put64(j, address);
+    PUT(j, 0xff, 0xd0); // call rax
+}
+
+// rbx = env->stack + r14, and r13 = the callee below the arguments when
+// the function reads captures
+static void reloadFrame(struct Jit* j)
+{
+    MEM(j, 1, RBX, R12, (int32_t)offsetof(Environment, stack), 0x8b);
+    PUT(j, 0x4c, 0x01, 0xf3); // add rbx, r14
+    if (j->fn->function->inner.fntExpr->numCaptures > 0)
+        MEM(j, 1, R13, RBX, SLOT(j->fn->firstParam - 1) + 8, 0x8b);
+}
+
+// The shortest mov of value to rax or rcx
+static void loadImmediate(struct Jit* j, int reg, uint64_t value)
+{
+    if (value <= UINT32_MAX)
+    {
+        put8(j, (uint8_t)(0xb8 | reg)); // mov r32, imm32
+        put32(j, (uint32_t)value);
+    }
+    else if ((int64_t)value >= INT32_MIN && (int64_t)value <= INT32_MAX)
+    {
+        PUT(j, 0x48, 0xc7, (uint8_t)(0xc0 | reg)); // mov r64, simm32
+        put32(j, (uint32_t)value);
+    }
+    else
+    {
+        PUT(j, 0x48, (uint8_t)(0xb8 | reg)); // mov r64, imm64
+        put64(j, value);
+    }
+}
+
+// Copy a whole value in two words through rcx and rdx. Values are only
+// ever written as two words, so that the loads can be forwarded from the
+// stores still in flight.
+static void copySlot(struct Jit* j, int to, int32_t toDisp, int from,
+                     int32_t fromDisp)
+{
+    MEM(j, 1, RCX, from, fromDisp, 0x8b);     // mov rcx, [from]
+    MEM(j, 1, RDX, from, fromDisp + 8, 0x8b); // mov rdx, [from + 8]
+    MEM(j, 1, RCX, to, toDisp, 0x89);
+    MEM(j, 1, RDX, to, toDisp + 8, 0x89);
+}
+
+// The tag and the padding after it, as one word
+static void storeType(struct Jit* j, int slot, ValueType type)
+{
+    MEM(j, 1, 0, RBX, SLOT(slot), 0xc7); // mov qword [slot], type
+    put32(j, (uint32_t)type);
+}
+
+static void storeValue(struct Jit* j, int base, int32_t disp, Value value)
+{
+    uint64_t payload = payloadOf(value);
+
+    MEM(j, 1, 0, base, disp, 0xc7); // mov qword [tag], type
+    put32(j, (uint32_t)value.type);
+    if ((int64_t)payload >= INT32_MIN && (int64_t)payload <= INT32_MAX)
+    {
+        MEM(j, 1, 0, base, disp + 8, 0xc7); // mov qword [payload], simm32
+        put32(j, (uint32_t)payload);
+    }
+    else
+    {
+        PUT(j, 0x48, 0xba); // mov rdx, payload
+        put64(j, payload);
+        MEM(j, 1, RDX, base, disp + 8, 0x89);
+    }
+}
+
+// Store the condition cc of the flags as a boolean
+static void storeBool(struct Jit* j, int slot, int cc)
+{
+    PUT(j, 0x0f, (uint8_t)(0x90 | cc), 0xc0); // setcc al
+    PUT(j, 0x0f, 0xb6, 0xc0);                 // movzx eax, al
+    storeType(j, slot, VALUE_BOOL);
+    MEM(j, 1, RAX, RBX, PAYLOAD(slot), 0x89);
+}
+
+// Set the flags to "not equal" if the value in slot is falsy: false, null
+// or undefined
+static void testFalsy(struct Jit* j, int slot)
+{
+    MEM(j, 0, RAX, RBX, SLOT(slot), 0x8b); // mov eax, [slot]
+    PUT(j, 0x83, 0xf8, VALUE_BOOL);        // cmp eax, BOOL
+    size_t notBool = jumpShort(j, CC_NE);
+    MEM(j, 0, 7, RBX, PAYLOAD(slot), 0x83); // cmp dword [payload], 0
+    put8(j, 0);
+    PUT(j, 0x0f, 0x94, 0xc0); // sete al
+    size_t done = jumpShort(j, -1);
+    landShort(j, notBool);
+    PUT(j, 0x83, 0xf8, VALUE_NULL); // cmp eax, NULL
+    PUT(j, 0x0f, 0x96, 0xc0);       // setbe al
+    landShort(j, done);
+    PUT(j, 0x84, 0xc0); // test al, al
+}
+
+// Report the error of instr, whose operands start at slot, and fail
+static void raiseError(struct Jit* j, uint32_t instr, int slot)
+{
+    PUT(j, 0x4c, 0x89, 0xe7); // mov rdi, r12
+    put8(j, 0xbe);            // mov esi, instr
+    put32(j, instr);
+    MEM(j, 1, RDX, RBX, SLOT(slot), 0x8d); // lea rdx, [slot]
+    callRuntime(j, (uint64_t)(uintptr_t)nativeError);
+    jumpTo(j, -1, TO_FAIL);
+}
+
+// The payload as the interpreter would leave it in a slot
+static uint64_t payloadOf(Value value)
+{
+    switch (value.type)
+    {
+    case VALUE_INT:
+        return (uint64_t)value.as.integer;
+    case VALUE_BOOL:
+        return (uint32_t)value.as.boolean;
+    default:
+        return IS_OBJECT_VALUE(value) ? (uint64_t)(uintptr_t)value.as.object
+                                      : 0;
+    }
+}
+
+// The messages runBytecode gives for the same errors
+static void nativeError(Environment* env, uint32_t instr,
+                        const Value* operands)
+{
+    static const char* const operators[BASE_OPCODE_COUNT] = {
+        [OP_ADD] = "+", [OP_SUB] = "-", [OP_MUL] = "*",
+        [OP_DIV] = "/", [OP_LT] = "<",  [OP_GT] = ">",
+    };
+
+    Opcode op = INSTR_OP(instr);
+    if (op == OP_GET_GLOBAL)
+    {
+        const String* name =
+            getGlobalName(env->resolver, (int)INSTR_ARG(instr));
+        setEnvError(env, "identifier not found: %s",
+                    name ? getStr(name) : "?");
+        return;
+    }
+    if (op == OP_MINUS)
+    {
+        setEnvError(env, "unknown operator: -%s",
+                    valueTypeName(operands[0].type));
+        return;
+    }
+
+    Value left  = operands[0];
+    Value right = operands[1];
+    if (op == OP_DIV && left.type == VALUE_INT && right.type == VALUE_INT)
+    {
+        setEnvError(env, "division by zero");
+        return;
+    }
+
+    setEnvError(env, "%s: %s %s %s",
+                left.type != right.type ? "type mismatch" : "unknown operator",
+                valueTypeName(left.type), operators[op],
+                valueTypeName(right.type));
+}
+
+// Concatenate two strings into operands[0], as the interpreter does, or
+// fail with its error. Returns 0 or 1 like native code.
+static int nativeAdd(Environment* env, uint32_t instr, Value* operands)
+{
+    Value left  = operands[0];
+    Value right = operands[1];
+    if (left.type != VALUE_STRING || right.type != VALUE_STRING)
+    {
+        nativeError(env, instr, operands);
+        return 1;
+    }
+
+    env->stackLen = (size_t)(operands - env->stack) + 2;
+    operands[0]   = OBJECT_VALUE(VALUE_STRING,
+                                 newConcat(env, (Rope*)left.as.object,
+                                           (Rope*)right.as.object));
+    return 0;
+}
+
+static int nativeEqual(const Value* operands)
+{
+    return valuesEqual(operands[0], operands[1]);
+}
+
+#endif // JIT_SUPPORTED
@@ -0,0 +1,47 @@
+#ifndef _MONKEY_LANG_SRC_JIT_H_
+#define _MONKEY_LANG_SRC_JIT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "environment.h"
+#include "object.h"
+
+// Calls of a function after which runBytecode compiles it to native code
+#define DEFAULT_JIT_THRESHOLD 100
+
+// Native code of a function, run on the frame at stack[base] of env with
+// its arguments and locals in place. It leaves the result where the callee
+// was, as OP_RETURN does, and returns 0, or 1 after setting the error of
+// env. A tail call returns NATIVE_TAIL_CALL instead, once the callee and
+// its frame took the place of the function's, for the VM to run next.
+typedef int (*NativeCode)(Environment* env, size_t base, Closure* closure);
+
+#define NATIVE_TAIL_CALL 2
+
+// Whether the JIT can compile on this platform, x86-64 Linux
+int isJitSupported(void);
+
+// Let runBytecode compile functions to native code once they were called
+// threshold times, or never with 0, the default
+void setJitThreshold(Environment*, int threshold);
+
+// Compile the bytecode of fn in fresh executable memory, kept in
+// fn->native. Returns 0 if fn creates closures, which is left to the
+// interpreter, or if the platform is not supported.
+int compileNative(CompiledFunction* fn);
+void freeNativeCode(CompiledFunction* fn);
+
+// Call the closure at stack[callee] of env with the argc arguments above
+// it, natively or in the interpreter, leaving the result in place of the
+// callee. Returns 0, or 1 after setting the error of env. Native code
+// calls back into the VM through it.
+int callFromNative(Environment* env, size_t callee, uint32_t argc);
+// Move the closure at stack[callee] and its argc arguments down to
+// stack[frame], where the callee of the running function is, and set up
+// the frame of the call there. Returns 0, or 1 after setting the error of
+// env.
+int tailCallFromNative(Environment* env, size_t callee, uint32_t argc,
+                       size_t frame);
+
+#endif //_MONKEY_LANG_SRC_JIT_H_
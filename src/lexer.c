@@ -7,6 +7,7 @@
 struct Lexer
 {
     const char* input;
+    size_t inputLen;
     int position;
     int readPosition;
     char ch;
@@ -18,6 +19,7 @@ char peekChar(const Lexer*);
 void skipWhitespace(Lexer*);
 String* readIdentifier(Lexer*);
 String* readNumber(Lexer*);
+String* readString(Lexer*);
 int isLetter(char);
 int isDigit(char);
 
@@ -29,6 +31,7 @@ Lexer* mkLexer(const char* input)
     l->readPosition = 0;
     l->ch = '\0';
     l->input = input;
+    l->inputLen = strlen(input);
 
     readChar(l);
 
@@ -44,7 +47,7 @@ void freeLexer(Lexer* l)
 
 void readChar(Lexer* l)
 {
-    if ((size_t)l->readPosition >= strlen(l->input))
+    if ((size_t)l->readPosition >= l->inputLen)
         l->ch = '\0';
     else
         l->ch = l->input[l->readPosition];
@@ -54,7 +57,7 @@ void readChar(Lexer* l)
 
 char peekChar(const Lexer* l)
 {
-    if ((size_t)l->readPosition >= strlen(l->input))
+    if ((size_t)l->readPosition >= l->inputLen)
         return '\0';
     else
         return l->input[l->readPosition];
@@ -115,7 +118,15 @@ Token nextToken(Lexer* l)
         TOKENIZE(')', T_RPAREN, ")");
         TOKENIZE('{', T_LBRACE, "{");
         TOKENIZE('}', T_RBRACE, "}");
+        TOKENIZE('[', T_LBRACKET, "[");
+        TOKENIZE(']', T_RBRACKET, "]");
+        TOKENIZE(':', T_COLON, ":");
         TOKENIZE(0, T_EOF, "");
+    case '"':
+        // The literal is what the quotes enclose, without escapes
+        tok.literal = readString(l);
+        tok.type    = l->ch == '"' ? T_STRING : T_ILLEGAL;
+        break;
     default:
         if (isLetter(l->ch))
         {
@@ -156,6 +167,18 @@ String* readNumber(Lexer* l)
     return mkNString(l->input + position, (size_t)(l->position - position));
 }
 
+// Read up to the closing quote, or to the end of the input when there is
+// none, starting at the opening one
+String* readString(Lexer* l)
+{
+    int position = l->position + 1;
+    do
+        readChar(l);
+    while (l->ch != '"' && l->ch != '\0');
+
+    return mkNString(l->input + position, (size_t)(l->position - position));
+}
+
 int isLetter(char ch)
 {
     return ('A' <= ch && ch <= 'Z') || ('a' <= ch && ch <= 'z') || ch == '_';
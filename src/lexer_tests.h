@@ -134,9 +134,63 @@ TEST(TestComplexLexing)
     TEST_LEXER;
 }
 
+TEST(TestCollectionLexing)
+{
+    int isTestPassed = TEST_SUCESSED;
+    Token tok;
+    const char* input = "[1, 2][0];\n"
+                        "{1: true}[1];\n";
+
+    struct
+    {
+        TokenType expectedType;
+        String* expectedLiteral;
+    } tests[] = {
+        TOKEN(T_LBRACKET, "["),  TOKEN(T_INT, "1"),
+        TOKEN(T_COMMA, ","),     TOKEN(T_INT, "2"),
+        TOKEN(T_RBRACKET, "]"),  TOKEN(T_LBRACKET, "["),
+        TOKEN(T_INT, "0"),       TOKEN(T_RBRACKET, "]"),
+        TOKEN(T_SEMICOLON, ";"), TOKEN(T_LBRACE, "{"),
+        TOKEN(T_INT, "1"),       TOKEN(T_COLON, ":"),
+        TOKEN(T_TRUE, "true"),   TOKEN(T_RBRACE, "}"),
+        TOKEN(T_LBRACKET, "["),  TOKEN(T_INT, "1"),
+        TOKEN(T_RBRACKET, "]"),  TOKEN(T_SEMICOLON, ";"),
+        TOKEN(T_EOF, ""),        TOKEN(T_ENDTEST, ""),
+    };
+
+    TEST_LEXER;
+}
+
+TEST(TestStringLexing)
+{
+    int isTestPassed = TEST_SUCESSED;
+    Token tok;
+    const char* input = "\"foo bar\" + \"\";\n"
+                        "{\"a\": 1}[\"a\"]; \"open";
+
+    struct
+    {
+        TokenType expectedType;
+        String* expectedLiteral;
+    } tests[] = {
+        TOKEN(T_STRING, "foo bar"), TOKEN(T_PLUS, "+"),
+        TOKEN(T_STRING, ""),        TOKEN(T_SEMICOLON, ";"),
+        TOKEN(T_LBRACE, "{"),       TOKEN(T_STRING, "a"),
+        TOKEN(T_COLON, ":"),        TOKEN(T_INT, "1"),
+        TOKEN(T_RBRACE, "}"),       TOKEN(T_LBRACKET, "["),
+        TOKEN(T_STRING, "a"),       TOKEN(T_RBRACKET, "]"),
+        TOKEN(T_SEMICOLON, ";"),    TOKEN(T_ILLEGAL, "open"),
+        TOKEN(T_EOF, ""),           TOKEN(T_ENDTEST, ""),
+    };
+
+    TEST_LEXER;
+}
+
 MAIN_TEST(
     {
         RUN_TEST(TestNextToken);
         RUN_TEST(TestComplexLexing);
+        RUN_TEST(TestCollectionLexing);
+        RUN_TEST(TestStringLexing);
     })
 #undef MAIN_TEST_NAME // End TestLexer
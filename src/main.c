@@ -1,12 +1,141 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "memo.h"
 #include "repl.h"
 
 #define __DEBUG__
 
-int main(void)
+static void printUsage(const char* name)
 {
-    startREPL();
+    fprintf(stderr,
+            "usage: %s [--vm [--super] [--calls] [--no-jit] | --registers "
+            "| --closures] [--gc-stats] [--gc-growth=F]\n"
+            "       [--gc-nursery=KB] [--gc-incremental=N] [--tail-calls] "
+            "[--memo[=N]] [--hash-cons] [file]\n"
+            "       %s --emit-c file | --emit-asm file\n",
+            name, name);
+    fprintf(stderr, "  --vm          run on the bytecode VM instead of eval\n");
+    fprintf(stderr, "  --super       let the VM fuse instructions\n");
+    fprintf(stderr, "  --calls       dump the hit rates of the VM's call sites\n");
+    fprintf(stderr, "  --no-jit      keep the VM from compiling hot functions\n");
+    fprintf(stderr, "  --registers   run on the register VM instead of eval\n");
+    fprintf(stderr, "  --closures    run compiled handler trees instead of eval\n");
+    fprintf(stderr, "  --emit-c      print the program as C, to build against\n"
+                    "                runtime/monkeyRuntime.h\n");
+    fprintf(stderr, "  --emit-asm    print the program as x86-64 assembly, to\n"
+                    "                link with runtime/asmRuntime.c\n");
+    fprintf(stderr, "  --gc-stats    print the collector statistics after a run\n");
+    fprintf(stderr, "  --gc-growth=F collect once the heap grew F times its\n"
+                    "                size after the last collection (2.0)\n");
+    fprintf(stderr, "  --gc-nursery=KB allocate closures in a nursery of KB\n"
+                    "                kilobytes, or none with 0 (256)\n");
+    fprintf(stderr, "  --gc-incremental=N mark the heap in slices of N objects\n"
+                    "                between allocations\n");
+    fprintf(stderr, "  --tail-calls  print how many calls in tail position ran\n"
+                    "                in the frame of their caller\n");
+    fprintf(stderr, "  --memo[=N]    remember the last N results of pure\n"
+                    "                functions (4096) and print the hit rate\n");
+    fprintf(stderr, "  --hash-cons   share equal subtrees of the program and\n"
+                    "                print the nodes and bytes it saved\n");
+}
+
+int main(int argc, char** argv)
+{
+    RunOptions options = {ENGINE_EVAL, 0, 0, 0, 1, 0, 0,
+                          0, 0, 0.0, -1, 0, 0, 0};
+    const char* path   = NULL;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--vm") == 0)
+        {
+            options.engine = ENGINE_VM;
+        }
+        else if (strcmp(argv[i], "--super") == 0)
+        {
+            options.superinstructions = 1;
+        }
+        else if (strcmp(argv[i], "--calls") == 0)
+        {
+            options.showCallCaches = 1;
+        }
+        else if (strcmp(argv[i], "--no-jit") == 0)
+        {
+            options.jit = 0;
+        }
+        else if (strcmp(argv[i], "--registers") == 0)
+        {
+            options.engine = ENGINE_REGISTERS;
+        }
+        else if (strcmp(argv[i], "--closures") == 0)
+        {
+            options.engine = ENGINE_CLOSURES;
+        }
+        else if (strcmp(argv[i], "--emit-c") == 0)
+        {
+            options.emitC = 1;
+        }
+        else if (strcmp(argv[i], "--emit-asm") == 0)
+        {
+            options.emitAsm = 1;
+        }
+        else if (strcmp(argv[i], "--gc-stats") == 0)
+        {
+            options.showGCStats = 1;
+        }
+        else if (strcmp(argv[i], "--tail-calls") == 0)
+        {
+            options.showTailCalls = 1;
+        }
+        else if (strcmp(argv[i], "--hash-cons") == 0)
+        {
+            options.hashCons = 1;
+        }
+        else if (strcmp(argv[i], "--memo") == 0)
+        {
+            options.memoEntries = MEMO_DEFAULT_ENTRIES;
+        }
+        else if (strncmp(argv[i], "--memo=", 7) == 0 && atol(argv[i] + 7) > 0)
+        {
+            options.memoEntries = atol(argv[i] + 7);
+        }
+        else if (strncmp(argv[i], "--gc-growth=", 12) == 0
+                 && atof(argv[i] + 12) > 0)
+        {
+            options.heapGrowth = atof(argv[i] + 12);
+        }
+        else if (strncmp(argv[i], "--gc-nursery=", 13) == 0
+                 && atol(argv[i] + 13) >= 0)
+        {
+            options.nurseryKB = atol(argv[i] + 13);
+        }
+        else if (strncmp(argv[i], "--gc-incremental=", 17) == 0
+                 && atol(argv[i] + 17) > 0)
+        {
+            options.markBudget = atol(argv[i] + 17);
+        }
+        else if (argv[i][0] != '-' && !path)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (path)
+        return runFile(path, &options);
+    if (options.emitC || options.emitAsm)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    startREPL(&options);
 
     return 0;
 }
@@ -0,0 +1,287 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "environment.h"
+#include "memo.h"
+
+#define NO_ENTRY UINT32_MAX
+
+#define HASH_MIX(hash, value) \
+    ((hash) = ((hash) ^ (uint64_t)(value)) * 1099511628211ULL)
+
+// A remembered call, in a bucket chain of its hash and in the list of
+// entries from the most to the least recently used
+struct MemoEntry
+{
+    MemoKey key;
+    Value result;
+    uint32_t chain;
+    uint32_t newer;
+    uint32_t older;
+};
+
+struct MemoTable
+{
+    struct MemoEntry* entries; // stats.entries of stats.capacity in use
+    uint32_t* buckets;
+    size_t bucketMask;
+    uint32_t newest;
+    uint32_t oldest;
+    MemoStats stats;
+
+    MemoKey* pending; // see pushMemoKey
+    size_t pendingLen;
+    size_t pendingCapacity;
+};
+
+/* Private Function Signatures */
+static int sameKey(const MemoKey*, const MemoKey*);
+static uint32_t* findEntry(struct MemoTable*, const MemoKey*);
+static void unlinkEntry(struct MemoTable*, uint32_t);
+static void linkNewest(struct MemoTable*, uint32_t);
+
+void setMemoCapacity(Environment* env, size_t entries)
+{
+    struct MemoTable* table = env->memo;
+    if (table)
+    {
+        for (size_t i = 0; i < table->stats.entries; ++i)
+            freeExpr(table->entries[i].key.function);
+        free(table->entries);
+        free(table->buckets);
+        free(table->pending);
+        free(table);
+        env->memo = NULL;
+    }
+    if (entries == 0)
+        return;
+
+    if (entries >= NO_ENTRY)
+        entries = NO_ENTRY - 1;
+    size_t buckets = 1;
+    while (buckets < entries)
+        buckets <<= 1;
+
+    table                  = malloc(sizeof(struct MemoTable));
+    table->entries         = malloc(sizeof(struct MemoEntry) * entries);
+    table->buckets         = malloc(sizeof(uint32_t) * buckets);
+    table->bucketMask      = buckets - 1;
+    table->newest          = NO_ENTRY;
+    table->oldest          = NO_ENTRY;
+    table->pending         = NULL;
+    table->pendingLen      = 0;
+    table->pendingCapacity = 0;
+    for (size_t i = 0; i < buckets; ++i)
+        table->buckets[i] = NO_ENTRY;
+
+    memset(&table->stats, 0, sizeof(MemoStats));
+    table->stats.capacity = entries;
+    env->memo             = table;
+}
+
+MemoStats getMemoStats(const Environment* env)
+{
+    MemoStats none = {0, 0, 0, 0, 0, 0};
+    return env->memo ? env->memo->stats : none;
+}
+
+String* dumpMemoStats(const Environment* env)
+{
+    MemoStats stats = getMemoStats(env);
+    uint64_t calls  = stats.hits + stats.misses;
+    char buffer[256];
+
+    snprintf(buffer, sizeof(buffer),
+             "memo: %" PRIu64 " calls, %" PRIu64 " hits (%.1f%%), %zu of %zu "
+             "entries, %" PRIu64 " evicted, %" PRIu64 " flushes\n",
+             calls, stats.hits,
+             calls ? 100.0 * (double)stats.hits / (double)calls : 0.0,
+             stats.entries, stats.capacity, stats.evictions, stats.flushes);
+    return mkString(buffer);
+}
+
+int makeMemoKey(Expr* function, const Value* args, size_t argc, MemoKey* key)
+{
+    if (!function->inner.fntExpr->pure || argc > MEMO_MAX_ARGS)
+        return 0;
+
+    uint64_t hash = 14695981039346656037ULL;
+    HASH_MIX(hash, (uintptr_t)function);
+    for (size_t i = 0; i < argc; ++i)
+    {
+        if (args[i].type == VALUE_INT)
+            HASH_MIX(hash, args[i].as.integer);
+        else if (args[i].type == VALUE_BOOL)
+            HASH_MIX(hash, args[i].as.boolean != 0);
+        else
+            return 0;
+        HASH_MIX(hash, args[i].type);
+        key->args[i] = args[i];
+    }
+
+    key->function = function;
+    key->argc     = argc;
+    key->hash     = hash ^ hash >> 32;
+    return 1;
+}
+
+int lookUpMemo(Environment* env, const MemoKey* key, Value* result)
+{
+    struct MemoTable* table = env->memo;
+    uint32_t index          = *findEntry(table, key);
+    if (index == NO_ENTRY)
+    {
+        ++table->stats.misses;
+        return 0;
+    }
+
+    if (index != table->newest)
+    {
+        unlinkEntry(table, index);
+        linkNewest(table, index);
+    }
+    ++table->stats.hits;
+    *result = table->entries[index].result;
+    return 1;
+}
+
+void storeMemo(Environment* env, const MemoKey* key, Value result)
+{
+    if (result.type != VALUE_INT && result.type != VALUE_BOOL
+        && result.type != VALUE_NULL)
+        return;
+
+    struct MemoTable* table = env->memo;
+    uint32_t* link          = findEntry(table, key);
+    uint32_t index          = *link;
+    if (index != NO_ENTRY)
+    {
+        table->entries[index].result = result;
+        return;
+    }
+
+    if (table->stats.entries < table->stats.capacity)
+    {
+        index = (uint32_t)table->stats.entries++;
+    }
+    else
+    {
+        // The least recently used entry makes room, leaving its chain
+        index                 = table->oldest;
+        struct MemoEntry* old = &table->entries[index];
+        uint32_t* oldLink     = findEntry(table, &old->key);
+        *oldLink              = old->chain;
+        unlinkEntry(table, index);
+        freeExpr(old->key.function);
+        ++table->stats.evictions;
+
+        link = findEntry(table, key);
+    }
+
+    struct MemoEntry* entry = &table->entries[index];
+    entry->key              = *key;
+    entry->result           = result;
+    entry->chain            = NO_ENTRY;
+    *link                   = index;
+    retainExpr(key->function);
+    linkNewest(table, index);
+}
+
+size_t pushMemoKey(Environment* env, const MemoKey* key)
+{
+    struct MemoTable* table = env->memo;
+    if (table->pendingLen == table->pendingCapacity)
+    {
+        table->pendingCapacity =
+            table->pendingCapacity ? table->pendingCapacity << 1 : 16;
+        table->pending = realloc(table->pending,
+                                 sizeof(MemoKey) * table->pendingCapacity);
+    }
+
+    table->pending[table->pendingLen++] = *key;
+    return table->pendingLen;
+}
+
+void popMemoKey(Environment* env, size_t handle, Value result)
+{
+    struct MemoTable* table = env->memo;
+    table->pendingLen       = handle - 1;
+    storeMemo(env, &table->pending[handle - 1], result);
+}
+
+void forgetMemo(Environment* env)
+{
+    struct MemoTable* table = env->memo;
+    if (!table || table->stats.entries == 0)
+        return;
+
+    for (size_t i = 0; i < table->stats.entries; ++i)
+        freeExpr(table->entries[i].key.function);
+    for (size_t i = 0; i <= table->bucketMask; ++i)
+        table->buckets[i] = NO_ENTRY;
+
+    table->stats.entries = 0;
+    table->newest        = NO_ENTRY;
+    table->oldest        = NO_ENTRY;
+    ++table->stats.flushes;
+}
+
+static int sameKey(const MemoKey* lhs, const MemoKey* rhs)
+{
+    if (lhs->hash != rhs->hash || lhs->function != rhs->function
+        || lhs->argc != rhs->argc)
+        return 0;
+
+    // Booleans fill only part of the payload
+    for (size_t i = 0; i < lhs->argc; ++i)
+    {
+        if (lhs->args[i].type != rhs->args[i].type)
+            return 0;
+        if (lhs->args[i].type == VALUE_INT
+                ? lhs->args[i].as.integer != rhs->args[i].as.integer
+                : !lhs->args[i].as.boolean != !rhs->args[i].as.boolean)
+            return 0;
+    }
+    return 1;
+}
+
+// The link to the entry of key in its bucket chain, holding NO_ENTRY at
+// the end of the chain when there is none
+static uint32_t* findEntry(struct MemoTable* table, const MemoKey* key)
+{
+    uint32_t* link = &table->buckets[key->hash & table->bucketMask];
+    while (*link != NO_ENTRY && !sameKey(&table->entries[*link].key, key))
+        link = &table->entries[*link].chain;
+    return link;
+}
+
+static void unlinkEntry(struct MemoTable* table, uint32_t index)
+{
+    struct MemoEntry* entry = &table->entries[index];
+
+    if (entry->newer != NO_ENTRY)
+        table->entries[entry->newer].older = entry->older;
+    else
+        table->newest = entry->older;
+
+    if (entry->older != NO_ENTRY)
+        table->entries[entry->older].newer = entry->newer;
+    else
+        table->oldest = entry->newer;
+}
+
+static void linkNewest(struct MemoTable* table, uint32_t index)
+{
+    struct MemoEntry* entry = &table->entries[index];
+    entry->newer            = NO_ENTRY;
+    entry->older            = table->newest;
+
+    if (table->newest != NO_ENTRY)
+        table->entries[table->newest].newer = index;
+    else
+        table->oldest = index;
+    table->newest = index;
+}
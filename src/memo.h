@@ -0,0 +1,70 @@
+#ifndef _MONKEY_LANG_SRC_MEMO_H_
+#define _MONKEY_LANG_SRC_MEMO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dynString.h"
+#include "object.h"
+
+typedef struct Environment Environment;
+
+#define MEMO_MAX_ARGS        4
+#define MEMO_DEFAULT_ENTRIES 4096
+
+// Counters of the memo table of an Environment, since it was made
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;    // calls not found, which ran
+    uint64_t evictions; // of the least recently used result, to make room
+    uint64_t flushes;   // of every result, by a global bound again
+    size_t entries;
+    size_t capacity;
+} MemoStats;
+
+// With a memo table, every engine but the emitted code remembers what the
+// calls of functions found pure by analyzePurity returned, keyed by the
+// function literal and up to MEMO_MAX_ARGS integer or boolean arguments,
+// and answers the same call from the table. Calls that fail, and results
+// other than integers, booleans and null, are not remembered. A full table
+// evicts its least recently used result.
+//
+// Pure functions may call the functions bound to globals, so binding a
+// global that had a value forgets every result.
+//
+// Default 0, without a table
+void setMemoCapacity(Environment*, size_t entries);
+MemoStats getMemoStats(const Environment*);
+String* dumpMemoStats(const Environment*);
+
+#ifdef __PRIVATE_ENVIRONMENT_OBJECTS__
+
+// A call to look up, copied out of its arguments before they are
+// overwritten by the frame of the call
+typedef struct
+{
+    Expr* function;
+    size_t argc;
+    Value args[MEMO_MAX_ARGS];
+    uint64_t hash;
+} MemoKey;
+
+// Whether the call of a closure of function with these arguments may be
+// memoized, filling key if so
+int makeMemoKey(Expr* function, const Value* args, size_t argc, MemoKey*);
+// 1 and the result of the call, or 0 to run it
+int lookUpMemo(Environment*, const MemoKey*, Value* result);
+void storeMemo(Environment*, const MemoKey*, Value result);
+// For engines whose frames are not on the C stack: keep the key of a call
+// that missed until its frame returns, and return the handle to give
+// popMemoKey along with the result. Keys of frames that failed are dropped
+// by the next pop below them.
+size_t pushMemoKey(Environment*, const MemoKey*);
+void popMemoKey(Environment*, size_t handle, Value result);
+// Forget every result, before a global that had a value is bound again
+void forgetMemo(Environment*);
+
+#endif // __PRIVATE_ENVIRONMENT_OBJECTS__
+
+#endif //_MONKEY_LANG_SRC_MEMO_H_
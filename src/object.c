@@ -0,0 +1,256 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "closureCompiler.h"
+#include "jit.h"
+#include "object.h"
+#include "rope.h"
+
+size_t closureSize(int numCaptures)
+{
+    return sizeof(Closure) + sizeof(Value) * (size_t)numCaptures;
+}
+
+Closure* initClosure(void* memory, Expr* function)
+{
+    Closure* output = memory;
+
+    output->object.type       = OBJECT_CLOSURE;
+    output->object.marked     = 0;
+    output->object.remembered = 0;
+    output->object.forwarded  = 0;
+    output->object.next       = NULL;
+    output->function          = function;
+    output->compiled          = NULL;
+    output->tree              = NULL;
+    output->numCaptures       = function->inner.fntExpr->numCaptures;
+
+    return output;
+}
+
+Closure* mkClosure(Expr* function)
+{
+    int numCaptures = function->inner.fntExpr->numCaptures;
+    retainExpr(function);
+    return initClosure(malloc(closureSize(numCaptures)), function);
+}
+
+CompiledFunction* mkCompiledFunction(Expr* function)
+{
+    CompiledFunction* output = malloc(sizeof(CompiledFunction));
+
+    output->object.type       = OBJECT_FUNCTION;
+    output->object.marked     = 0;
+    output->object.remembered = 0;
+    output->object.forwarded  = 0;
+    output->object.next       = NULL;
+    output->function          = retainExpr(function);
+
+    output->code         = NULL;
+    output->codeLen      = 0;
+    output->threaded     = NULL;
+    output->constants    = NULL;
+    output->numConstants = 0;
+    output->functions    = NULL;
+    output->numFunctions = 0;
+    output->callCaches   = NULL;
+    output->numCallSites = 0;
+    output->native       = NULL;
+    output->nativeSize   = 0;
+    output->calls        = 0;
+
+    output->numParams  = 0;
+    output->firstParam = 0;
+    output->frameSize  = 0;
+    output->maxStack   = 0;
+
+    return output;
+}
+
+NodeTree* mkNodeTree(Expr* function)
+{
+    NodeTree* output = malloc(sizeof(NodeTree));
+
+    output->object.type       = OBJECT_NODE_TREE;
+    output->object.marked     = 0;
+    output->object.remembered = 0;
+    output->object.forwarded  = 0;
+    output->object.next       = NULL;
+    output->function          = retainExpr(function);
+    output->root              = NULL;
+
+    output->paramSlots = NULL;
+    output->numParams  = 0;
+    output->numLocals  = 0;
+    output->selfSlot   = -1;
+
+    return output;
+}
+
+void freeObject(Object* pObject)
+{
+    if (!pObject)
+        return;
+
+    switch (pObject->type)
+    {
+    case OBJECT_CLOSURE:
+        freeExpr(((Closure*)pObject)->function);
+        break;
+
+    case OBJECT_FUNCTION:
+    {
+        // Nested functions are objects of their own
+        CompiledFunction* fn = (CompiledFunction*)pObject;
+        freeExpr(fn->function);
+        free(fn->code);
+        free(fn->threaded);
+        free(fn->constants);
+        free(fn->functions);
+        free(fn->callCaches);
+        freeNativeCode(fn);
+        break;
+    }
+
+    case OBJECT_NODE_TREE:
+    {
+        NodeTree* tree = (NodeTree*)pObject;
+        freeExpr(tree->function);
+        freeNodes(tree->root);
+        free(tree->paramSlots);
+        break;
+    }
+
+    case OBJECT_ARRAY:
+        free(((Array*)pObject)->elements);
+        break;
+
+    case OBJECT_HASH:
+    {
+        Hash* hash = (Hash*)pObject;
+        free(hash->entries);
+        free(hash->control);
+        free(hash->slots);
+        break;
+    }
+
+    case OBJECT_STRING:
+        // The halves of a concatenation are objects of their own
+        free(((Rope*)pObject)->chars);
+        break;
+    }
+
+    free(pObject);
+}
+
+const char* valueTypeName(ValueType type)
+{
+    switch (type)
+    {
+    case VALUE_NULL:
+        return "NULL";
+    case VALUE_INT:
+        return "INTEGER";
+    case VALUE_BOOL:
+        return "BOOLEAN";
+    case VALUE_CLOSURE:
+        return "FUNCTION";
+    case VALUE_ARRAY:
+        return "ARRAY";
+    case VALUE_HASH:
+        return "HASH";
+    case VALUE_STRING:
+        return "STRING";
+    default:
+        return "UNDEFINED";
+    }
+}
+
+int isTruthy(Value value)
+{
+    switch (value.type)
+    {
+    case VALUE_NULL:
+    case VALUE_UNDEFINED:
+        return 0;
+    case VALUE_BOOL:
+        return value.as.boolean;
+    default:
+        return 1;
+    }
+}
+
+int valuesEqual(Value lhs, Value rhs)
+{
+    if (lhs.type != rhs.type)
+        return 0;
+
+    switch (lhs.type)
+    {
+    case VALUE_INT:
+        return lhs.as.integer == rhs.as.integer;
+    case VALUE_BOOL:
+        return lhs.as.boolean == rhs.as.boolean;
+    case VALUE_CLOSURE:
+    case VALUE_ARRAY:
+    case VALUE_HASH:
+        return lhs.as.object == rhs.as.object;
+    case VALUE_STRING:
+        return ropesEqual((Rope*)lhs.as.object, (Rope*)rhs.as.object);
+    default:
+        return 1;
+    }
+}
+
+String* inspectValue(Value value)
+{
+    char buffer[32];
+    String* output = NULL;
+
+    switch (value.type)
+    {
+    case VALUE_NULL:
+        return mkString("null");
+    case VALUE_INT:
+        snprintf(buffer, sizeof(buffer), "%" PRId64, value.as.integer);
+        return mkString(buffer);
+    case VALUE_BOOL:
+        return mkString(value.as.boolean ? "true" : "false");
+    case VALUE_CLOSURE:
+        return stringifyFntExpr(
+            ((Closure*)value.as.object)->function->inner.fntExpr);
+    case VALUE_ARRAY:
+    {
+        Array* array = (Array*)value.as.object;
+        output       = mkString("[");
+        for (size_t i = 0; i < array->len; ++i)
+        {
+            appendStr(output, i ? ", " : "");
+            concatFreeString(output, inspectValue(array->elements[i]));
+        }
+        appendStr(output, "]");
+        return output;
+    }
+    case VALUE_HASH:
+    {
+        Hash* hash = (Hash*)value.as.object;
+        output     = mkString("{");
+        for (size_t i = 0; i < hash->len; ++i)
+        {
+            appendStr(output, i ? ", " : "");
+            concatFreeString(output, inspectValue(hash->entries[i].key));
+            appendStr(output, ": ");
+            concatFreeString(output, inspectValue(hash->entries[i].value));
+        }
+        appendStr(output, "}");
+        return output;
+    }
+    case VALUE_STRING:
+        return mkString(flattenRope((Rope*)value.as.object));
+    default:
+        return mkString("");
+    }
+}
+
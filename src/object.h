@@ -0,0 +1,207 @@
+#ifndef _MONKEY_LANG_SRC_OBJECT_H_
+#define _MONKEY_LANG_SRC_OBJECT_H_
+
+#include <stdint.h>
+
+#include "ast.h"
+#include "dynString.h"
+
+typedef enum
+{
+    VALUE_UNDEFINED = 0, // no value: a `let`, or a global not yet bound
+    VALUE_NULL,
+    VALUE_INT,
+    VALUE_BOOL,
+    VALUE_CLOSURE, // first of the values with an object on the heap
+    VALUE_ARRAY,
+    VALUE_HASH,
+    VALUE_STRING,
+} ValueType;
+
+typedef enum
+{
+    OBJECT_CLOSURE = 0,
+    OBJECT_FUNCTION,
+    OBJECT_NODE_TREE,
+    OBJECT_ARRAY,
+    OBJECT_HASH,
+    OBJECT_STRING,
+} ObjectType;
+
+typedef struct Object Object;
+typedef struct Closure Closure;
+typedef struct CompiledFunction CompiledFunction;
+typedef struct NodeTree NodeTree;
+typedef struct Array Array;
+typedef struct Hash Hash;
+typedef struct Rope Rope;
+
+// A value is a 16-byte tag and payload passed around by copy. Integers,
+// booleans and null live in the payload; only objects are on the heap.
+typedef struct
+{
+    ValueType type;
+    union
+    {
+        int64_t integer;
+        int boolean;
+        Object* object;
+    } as;
+} Value;
+
+_Static_assert(sizeof(Value) == 16, "Value must stay 16 bytes");
+
+#define UNDEFINED_VALUE ((Value){VALUE_UNDEFINED, {0}})
+#define NULL_VALUE      ((Value){VALUE_NULL, {0}})
+#define INT_VALUE(v)    ((Value){VALUE_INT, {.integer = (v)}})
+#define BOOL_VALUE(v)   ((Value){VALUE_BOOL, {.boolean = (v)}})
+#define OBJECT_VALUE(t, o) \
+    ((Value){(t), {.object = (Object*)(o)}})
+#define IS_OBJECT_VALUE(v) ((v).type >= VALUE_CLOSURE)
+
+// Header of every heap-allocated value. Objects are linked into the list of
+// the environment that created them, which frees them once its collector
+// finds them unreachable. Closures start out in the nursery of the
+// environment instead, outside of the list; see gc.h.
+struct Object
+{
+    ObjectType type;
+    uint8_t marked;     // reached by the collection running
+    uint8_t remembered; // old, and in the remembered set of the nursery
+    uint8_t forwarded;  // young, and copied to next by a minor collection
+    struct Object* next;
+};
+
+// A function literal with the values it captured when it was created. The
+// closure holds a reference to the EXPR_FUNCTION node, so the node outlives
+// the program it was parsed from.
+struct Closure
+{
+    Object object;
+    Expr* function;
+    CompiledFunction* compiled; // NULL unless created by the bytecode VM
+    NodeTree* tree;             // NULL unless created by runClosures
+    int numCaptures;
+    Value captures[];
+};
+
+#define CALL_CACHE_ENTRIES 4
+
+// Inline cache of a call site: the closures last called from it, whose
+// arity is known to match. A site stops adding entries, and is
+// megamorphic, once it has missed with all of them in use.
+typedef struct
+{
+    Closure* closures[CALL_CACHE_ENTRIES];
+    int len;
+    int megamorphic;
+    uint64_t hits;
+    uint64_t misses;
+} CallCache;
+
+// Bytecode of a function literal, or of a whole program when function is
+// NULL. See code.h for the instruction format.
+struct CompiledFunction
+{
+    Object object;
+    Expr* function;
+
+    uint32_t* code;
+    size_t codeLen;
+    void* threaded; // code translated by the VM for direct threading
+    Value* constants;
+    size_t numConstants;
+    CompiledFunction** functions; // function literals created by the code
+    size_t numFunctions;
+    CallCache* callCaches; // one per OP_CALL, in order
+    size_t numCallSites;
+    void* native; // code made by the JIT, see jit.h
+    size_t nativeSize;
+    int calls; // counted towards the JIT threshold, -1 once it gave up
+
+    int numParams;
+    // A frame starts with the callee when the function refers to itself by
+    // name (slot 0), and with the first parameter otherwise.
+    int firstParam;
+    int frameSize; // slots for parameters and locals
+    int maxStack;  // operand stack slots needed above the frame
+};
+
+// Nodes of a function literal, or of a whole program when function is
+// NULL, compiled by compileClosures. See closureCompiler.h.
+struct NodeTree
+{
+    Object object;
+    Expr* function;
+    struct Node* root;
+
+    int* paramSlots; // frame slot of each parameter, in order
+    int numParams;
+    int numLocals;
+    int selfSlot;
+};
+
+// Elements of an array literal, contiguous and in order. See collection.h.
+struct Array
+{
+    Object object;
+    size_t len;
+    size_t capacity;
+    Value* elements;
+};
+
+typedef struct
+{
+    Value key;
+    Value value;
+} HashEntry;
+
+// Pairs of a hash literal, in the order their keys were first inserted,
+// indexed by an open-addressing table of control bytes and entry indices.
+// See collection.h.
+struct Hash
+{
+    Object object;
+    HashEntry* entries;
+    size_t len;
+    size_t capacity; // entries before the table grows
+    uint8_t* control; // one byte per slot, then the first group again
+    uint32_t* slots;  // entry of each full slot
+    size_t slotMask;  // slots - 1, slots being a power of two
+};
+
+// A string, see rope.h. A leaf is made with its characters; a
+// concatenation holds its two halves until it is first flattened, when it
+// takes characters of its own and lets go of them.
+struct Rope
+{
+    Object object;
+    size_t len;
+    char* chars; // len characters and a '\0', or NULL until flattened
+    Rope* left;
+    Rope* right;
+    uint64_t hash;    // of the characters, or 0 until first needed
+    uint8_t leaf;     // made with its characters, counted in its size
+    uint8_t interned; // in the table of short strings of an environment
+};
+
+// Bytes of a closure with numCaptures captured values
+size_t closureSize(int numCaptures);
+// Set up a closure of function in closureSize bytes at memory, leaving it
+// to the caller to hold a reference to function
+Closure* initClosure(void* memory, Expr* function);
+Closure* mkClosure(Expr* function);
+CompiledFunction* mkCompiledFunction(Expr* function);
+NodeTree* mkNodeTree(Expr* function);
+void freeObject(Object*);
+
+// Name of the type of a value, as used in error messages
+const char* valueTypeName(ValueType);
+// Only false and null are falsy
+int isTruthy(Value);
+// Integers, booleans and strings compare by value, other objects by
+// identity
+int valuesEqual(Value, Value);
+String* inspectValue(Value);
+
+#endif //_MONKEY_LANG_SRC_OBJECT_H_
@@ -0,0 +1,896 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "dynString.h"
+#include "optimizer.h"
+
+/* Private Function Signatures */
+static size_t foldBlock(BlockStmt*);
+static size_t foldStmt(Stmt*);
+static size_t foldExpr(Expr*);
+static int foldPrefix(Expr*);
+static int foldInfix(Expr*);
+static void replaceWithInt(Expr*, int64_t);
+static void replaceWithBool(Expr*, int);
+
+// Set of identifier names that are referenced somewhere in the program.
+// The keys point into the AST, so a set only lives for one pass.
+struct NameSet
+{
+    const char** slots;
+    size_t capacity;
+    size_t len;
+};
+
+static void addName(struct NameSet*, const char*);
+static int hasName(const struct NameSet*, const char*);
+static void collectBlockNames(struct NameSet*, BlockStmt*);
+static void collectStmtNames(struct NameSet*, Stmt*);
+static void collectExprNames(struct NameSet*, Expr*);
+
+static size_t countBlockNodes(BlockStmt*);
+static size_t countStmtNodes(Stmt*);
+static size_t countExprNodes(Expr*);
+
+static size_t simplifyBlock(BlockStmt*, int, const struct NameSet*);
+static size_t simplifyStmt(Stmt*, int, const struct NameSet*);
+static size_t simplifyExpr(Expr*, int, const struct NameSet*);
+static int constantCondition(Expr*, int*);
+static int hasLetStmt(BlockStmt*);
+static int isPureExpr(Expr*);
+static Arguments* literalElements(Expr*);
+static struct ProgNode* unlinkNode(BlockStmt*, struct ProgNode*);
+
+size_t foldConstants(Program* pProg)
+{
+    if (!pProg)
+        return 0;
+
+    return foldBlock((BlockStmt*)pProg);
+}
+
+static size_t foldBlock(BlockStmt* pBlockStmt)
+{
+    if (!pBlockStmt)
+        return 0;
+
+    size_t folded        = 0;
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head)
+    {
+        folded += foldStmt(tmp->value);
+        tmp = tmp->before;
+    }
+
+    return folded;
+}
+
+static size_t foldStmt(Stmt* pStmt)
+{
+    if (!pStmt)
+        return 0;
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+        return foldExpr(pStmt->inner.letStmt->value);
+
+    case STMT_RETURN:
+        return foldExpr(pStmt->inner.returnStmt->returnValue);
+
+    case STMT_EXPRESSION:
+        return foldExpr(pStmt->inner.exprStmt->expression);
+
+    case STMT_BLOCK:
+        return foldBlock(pStmt->inner.blockStmt);
+
+    default:
+        return 0;
+    }
+}
+
+static size_t foldExpr(Expr* pExpr)
+{
+    if (!pExpr)
+        return 0;
+
+    size_t folded = 0;
+
+    switch (pExpr->type)
+    {
+    case EXPR_PREFIX:
+        folded += foldExpr(pExpr->inner.prefixExpr->right);
+        folded += (size_t)foldPrefix(pExpr);
+        break;
+
+    case EXPR_INFIX:
+        folded += foldExpr(pExpr->inner.infixExpr->left);
+        folded += foldExpr(pExpr->inner.infixExpr->right);
+        folded += (size_t)foldInfix(pExpr);
+        break;
+
+    case EXPR_IF:
+        folded += foldExpr(pExpr->inner.ifExpr->condition);
+        folded += foldBlock(pExpr->inner.ifExpr->consequence);
+        folded += foldBlock(pExpr->inner.ifExpr->alternative);
+        break;
+
+    case EXPR_FUNCTION:
+        folded += foldBlock(pExpr->inner.fntExpr->body);
+        break;
+
+    case EXPR_CALL:
+    {
+        folded += foldExpr(pExpr->inner.callExpr->function);
+
+        Arguments* args    = pExpr->inner.callExpr->arguments;
+        struct ArgNode* tmp = args->tail->before;
+        while (tmp != args->head)
+        {
+            folded += foldExpr(tmp->value);
+            tmp = tmp->before;
+        }
+        break;
+    }
+
+    case EXPR_ARRAY:
+    case EXPR_HASH:
+    {
+        Arguments* args     = literalElements(pExpr);
+        struct ArgNode* tmp = args->tail->before;
+        while (tmp != args->head)
+        {
+            folded += foldExpr(tmp->value);
+            tmp = tmp->before;
+        }
+        break;
+    }
+
+    case EXPR_INDEX:
+        folded += foldExpr(pExpr->inner.indexExpr->left);
+        folded += foldExpr(pExpr->inner.indexExpr->index);
+        break;
+
+    default:
+        break;
+    }
+
+    return folded;
+}
+
+// Returns 1 if pExpr was replaced by a literal, 0 otherwise
+static int foldPrefix(Expr* pExpr)
+{
+    PrefixExpr* prefix = pExpr->inner.prefixExpr;
+    Expr* right        = prefix->right;
+
+    if (!right)
+        return 0;
+
+    if (cmpStringStr(prefix->opt, "!") == 0)
+    {
+        // Only `false` is falsy among literals, so `!5` is `false`
+        if (right->type == EXPR_BOOL)
+        {
+            replaceWithBool(pExpr, !right->inner.boolExpr->value);
+            return 1;
+        }
+        if (right->type == EXPR_INTEGER || right->type == EXPR_STRING)
+        {
+            replaceWithBool(pExpr, 0);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (cmpStringStr(prefix->opt, "-") == 0 && right->type == EXPR_INTEGER)
+    {
+        int64_t value = right->inner.intExpr->value;
+        if (value == INT64_MIN)
+            return 0;
+
+        replaceWithInt(pExpr, -value);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Returns 1 if pExpr was replaced by a literal, 0 otherwise
+static int foldInfix(Expr* pExpr)
+{
+    InfixExpr* infix = pExpr->inner.infixExpr;
+    Expr* left       = infix->left;
+    Expr* right      = infix->right;
+    const char* opt  = getStr(infix->opt);
+
+    if (!left || !right || !opt || opt[0] == '\0')
+        return 0;
+
+    if (left->type == EXPR_INTEGER && right->type == EXPR_INTEGER)
+    {
+        int64_t lhs    = left->inner.intExpr->value;
+        int64_t rhs    = right->inner.intExpr->value;
+        int64_t result = 0;
+
+        switch (opt[0])
+        {
+        case '+':
+            if (__builtin_add_overflow(lhs, rhs, &result))
+                return 0;
+            replaceWithInt(pExpr, result);
+            return 1;
+
+        case '-':
+            if (__builtin_sub_overflow(lhs, rhs, &result))
+                return 0;
+            replaceWithInt(pExpr, result);
+            return 1;
+
+        case '*':
+            if (__builtin_mul_overflow(lhs, rhs, &result))
+                return 0;
+            replaceWithInt(pExpr, result);
+            return 1;
+
+        case '/':
+            if (rhs == 0 || (lhs == INT64_MIN && rhs == -1))
+                return 0;
+            replaceWithInt(pExpr, lhs / rhs);
+            return 1;
+
+        case '<':
+            replaceWithBool(pExpr, lhs < rhs);
+            return 1;
+
+        case '>':
+            replaceWithBool(pExpr, lhs > rhs);
+            return 1;
+
+        case '=':
+            replaceWithBool(pExpr, lhs == rhs);
+            return 1;
+
+        case '!':
+            replaceWithBool(pExpr, lhs != rhs);
+            return 1;
+
+        default:
+            return 0;
+        }
+    }
+
+    if (left->type == EXPR_BOOL && right->type == EXPR_BOOL)
+    {
+        int lhs = left->inner.boolExpr->value != 0;
+        int rhs = right->inner.boolExpr->value != 0;
+
+        if (cmpStringStr(infix->opt, "==") == 0)
+        {
+            replaceWithBool(pExpr, lhs == rhs);
+            return 1;
+        }
+        if (cmpStringStr(infix->opt, "!=") == 0)
+        {
+            replaceWithBool(pExpr, lhs != rhs);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void replaceWithInt(Expr* pExpr, int64_t value)
+{
+    freeExprWithoutSelf(pExpr);
+
+    pExpr->type                 = EXPR_INTEGER;
+    pExpr->inner.intExpr        = mkIntExpr();
+    pExpr->inner.intExpr->value = value;
+}
+
+static void replaceWithBool(Expr* pExpr, int value)
+{
+    freeExprWithoutSelf(pExpr);
+
+    pExpr->type                  = EXPR_BOOL;
+    pExpr->inner.boolExpr        = mkBoolExpr();
+    pExpr->inner.boolExpr->value = value;
+}
+
+size_t simplifyProgram(Program* pProg)
+{
+    if (!pProg)
+        return 0;
+
+    size_t removed = 0;
+    size_t round   = 0;
+
+    // Dropping a binding can make the names its value referred to unused,
+    // so repeat until nothing changes.
+    do
+    {
+        struct NameSet used = {NULL, 0, 0};
+        collectBlockNames(&used, (BlockStmt*)pProg);
+
+        round = simplifyBlock((BlockStmt*)pProg, 0, &used);
+        removed += round;
+
+        free(used.slots);
+    } while (round > 0);
+
+    return removed;
+}
+
+static size_t simplifyBlock(BlockStmt* pBlockStmt, int inFunction,
+                            const struct NameSet* used)
+{
+    if (!pBlockStmt)
+        return 0;
+
+    size_t removed        = 0;
+    size_t before         = 0;
+    int truthy            = 0;
+    Stmt* stmt            = NULL;
+    BlockStmt* chosen     = NULL;
+    struct ProgNode* node = pBlockStmt->tail->before;
+
+    while (node != pBlockStmt->head)
+    {
+        stmt = node->value;
+        removed += simplifyStmt(stmt, inFunction, used);
+
+        // Everything after a return in the same block is unreachable
+        if (stmt->type == STMT_RETURN)
+        {
+            while (node->before != pBlockStmt->head)
+            {
+                removed += countStmtNodes(node->before->value);
+                freeStmt(node->before->value);
+                free(unlinkNode(pBlockStmt, node->before));
+            }
+            break;
+        }
+
+        // A binding nobody reads is dead if computing it cannot fail. The
+        // last statement of a block is kept because it is the block value.
+        if (inFunction && stmt->type == STMT_LET
+            && node->before != pBlockStmt->head
+            && isPureExpr(stmt->inner.letStmt->value)
+            && !hasName(used, getStr(stmt->inner.letStmt->name->value)))
+        {
+            struct ProgNode* next = node->before;
+            removed += countStmtNodes(stmt);
+            freeStmt(stmt);
+            free(unlinkNode(pBlockStmt, node));
+            node = next;
+            continue;
+        }
+
+        if (stmt->type != STMT_EXPRESSION
+            || !stmt->inner.exprStmt->expression
+            || stmt->inner.exprStmt->expression->type != EXPR_IF
+            || !constantCondition(
+                stmt->inner.exprStmt->expression->inner.ifExpr->condition,
+                &truthy))
+        {
+            node = node->before;
+            continue;
+        }
+
+        IfExpr* ifExpr = stmt->inner.exprStmt->expression->inner.ifExpr;
+        chosen         = truthy ? ifExpr->consequence : ifExpr->alternative;
+        before         = countStmtNodes(stmt);
+
+        if (!chosen || chosen->len == 0)
+        {
+            // The statement evaluates to null, which only matters when it
+            // is the value of the block.
+            if (node->before == pBlockStmt->head)
+                break;
+
+            struct ProgNode* next = node->before;
+            removed += before;
+            freeStmt(stmt);
+            free(unlinkNode(pBlockStmt, node));
+            node = next;
+            continue;
+        }
+
+        if (truthy)
+            ifExpr->consequence = NULL;
+        else
+            ifExpr->alternative = NULL;
+
+        if (hasLetStmt(chosen))
+        {
+            // Keep the block boundary so that its bindings stay local
+            freeExprStmt(stmt->inner.exprStmt);
+            stmt->type            = STMT_BLOCK;
+            stmt->inner.blockStmt = chosen;
+            removed += before - countStmtNodes(stmt);
+            node = node->before;
+            continue;
+        }
+
+        // Move the statements of the branch in place of the `if`
+        removed += before - countBlockNodes(chosen);
+
+        struct ProgNode* first = chosen->tail->before;
+        struct ProgNode* last  = chosen->head->next;
+
+        first->next         = node->next;
+        last->before        = node->before;
+        node->next->before  = first;
+        node->before->next  = last;
+        pBlockStmt->len    += chosen->len - 1;
+
+        chosen->head->next   = chosen->tail;
+        chosen->tail->before = chosen->head;
+        chosen->len          = 0;
+        freeBlockStmt(chosen);
+
+        freeStmt(stmt);
+        free(node);
+        node = first;
+    }
+
+    return removed;
+}
+
+static size_t simplifyStmt(Stmt* pStmt, int inFunction,
+                           const struct NameSet* used)
+{
+    if (!pStmt)
+        return 0;
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+        return simplifyExpr(pStmt->inner.letStmt->value, inFunction, used);
+
+    case STMT_RETURN:
+        return simplifyExpr(pStmt->inner.returnStmt->returnValue, inFunction,
+                            used);
+
+    case STMT_EXPRESSION:
+        return simplifyExpr(pStmt->inner.exprStmt->expression, inFunction,
+                            used);
+
+    case STMT_BLOCK:
+        return simplifyBlock(pStmt->inner.blockStmt, inFunction, used);
+
+    default:
+        return 0;
+    }
+}
+
+static size_t simplifyExpr(Expr* pExpr, int inFunction,
+                           const struct NameSet* used)
+{
+    if (!pExpr)
+        return 0;
+
+    size_t removed = 0;
+    int truthy     = 0;
+
+    switch (pExpr->type)
+    {
+    case EXPR_PREFIX:
+        removed += simplifyExpr(pExpr->inner.prefixExpr->right, inFunction,
+                                used);
+        break;
+
+    case EXPR_INFIX:
+        removed += simplifyExpr(pExpr->inner.infixExpr->left, inFunction,
+                                used);
+        removed += simplifyExpr(pExpr->inner.infixExpr->right, inFunction,
+                                used);
+        break;
+
+    case EXPR_IF:
+    {
+        IfExpr* ifExpr = pExpr->inner.ifExpr;
+        removed += simplifyExpr(ifExpr->condition, inFunction, used);
+        removed += simplifyBlock(ifExpr->consequence, inFunction, used);
+        removed += simplifyBlock(ifExpr->alternative, inFunction, used);
+
+        if (!constantCondition(ifExpr->condition, &truthy))
+            break;
+
+        // Inside another expression the `if` can only be replaced when the
+        // taken branch is a single expression.
+        BlockStmt* chosen = truthy ? ifExpr->consequence : ifExpr->alternative;
+        if (!chosen || chosen->len != 1
+            || chosen->head->next->value->type != STMT_EXPRESSION)
+            break;
+
+        ExprStmt* exprStmt = chosen->head->next->value->inner.exprStmt;
+        Expr* value        = exprStmt->expression;
+        if (!value)
+            break;
+
+        size_t before        = countExprNodes(pExpr);
+        exprStmt->expression = NULL;
+
+        freeExprWithoutSelf(pExpr);
+        pExpr->type  = value->type;
+        pExpr->inner = value->inner;
+        free(value);
+
+        removed += before - countExprNodes(pExpr);
+        break;
+    }
+
+    case EXPR_FUNCTION:
+        removed += simplifyBlock(pExpr->inner.fntExpr->body, 1, used);
+        break;
+
+    case EXPR_CALL:
+    {
+        removed += simplifyExpr(pExpr->inner.callExpr->function, inFunction,
+                                used);
+
+        Arguments* args     = pExpr->inner.callExpr->arguments;
+        struct ArgNode* tmp = args->tail->before;
+        while (tmp != args->head)
+        {
+            removed += simplifyExpr(tmp->value, inFunction, used);
+            tmp = tmp->before;
+        }
+        break;
+    }
+
+    case EXPR_ARRAY:
+    case EXPR_HASH:
+    {
+        Arguments* args     = literalElements(pExpr);
+        struct ArgNode* tmp = args->tail->before;
+        while (tmp != args->head)
+        {
+            removed += simplifyExpr(tmp->value, inFunction, used);
+            tmp = tmp->before;
+        }
+        break;
+    }
+
+    case EXPR_INDEX:
+        removed += simplifyExpr(pExpr->inner.indexExpr->left, inFunction,
+                                used);
+        removed += simplifyExpr(pExpr->inner.indexExpr->index, inFunction,
+                                used);
+        break;
+
+    default:
+        break;
+    }
+
+    return removed;
+}
+
+// Returns 1 and stores the truthiness of pExpr if it is a literal
+static int constantCondition(Expr* pExpr, int* truthy)
+{
+    if (!pExpr)
+        return 0;
+
+    switch (pExpr->type)
+    {
+    case EXPR_BOOL:
+        *truthy = pExpr->inner.boolExpr->value != 0;
+        return 1;
+
+    case EXPR_INTEGER:
+    case EXPR_STRING:
+        *truthy = 1;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+static int hasLetStmt(BlockStmt* pBlockStmt)
+{
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head)
+    {
+        if (tmp->value->type == STMT_LET)
+            return 1;
+        tmp = tmp->before;
+    }
+
+    return 0;
+}
+
+// Evaluating a literal or building a closure can neither fail nor have an
+// observable effect, unlike operators (type errors, division by zero),
+// calls and identifier lookups.
+static int isPureExpr(Expr* pExpr)
+{
+    if (!pExpr)
+        return 1;
+
+    switch (pExpr->type)
+    {
+    case EXPR_INTEGER:
+    case EXPR_BOOL:
+    case EXPR_STRING:
+    case EXPR_FUNCTION:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+// The elements of an array literal, or the keys and values of a hash
+// literal
+static Arguments* literalElements(Expr* pExpr)
+{
+    return pExpr->type == EXPR_ARRAY ? pExpr->inner.arrayExpr->elements
+                                     : pExpr->inner.hashExpr->pairs;
+}
+
+// Unlink pNode from pBlockStmt without freeing it and return it
+static struct ProgNode* unlinkNode(BlockStmt* pBlockStmt,
+                                   struct ProgNode* pNode)
+{
+    pNode->before->next = pNode->next;
+    pNode->next->before = pNode->before;
+    --pBlockStmt->len;
+
+    return pNode;
+}
+
+static size_t countBlockNodes(BlockStmt* pBlockStmt)
+{
+    if (!pBlockStmt)
+        return 0;
+
+    size_t count         = 0;
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head)
+    {
+        count += countStmtNodes(tmp->value);
+        tmp = tmp->before;
+    }
+
+    return count;
+}
+
+static size_t countStmtNodes(Stmt* pStmt)
+{
+    if (!pStmt)
+        return 0;
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+        return 1 + countExprNodes(pStmt->inner.letStmt->value);
+
+    case STMT_RETURN:
+        return 1 + countExprNodes(pStmt->inner.returnStmt->returnValue);
+
+    case STMT_EXPRESSION:
+        return 1 + countExprNodes(pStmt->inner.exprStmt->expression);
+
+    case STMT_BLOCK:
+        return 1 + countBlockNodes(pStmt->inner.blockStmt);
+
+    default:
+        return 1;
+    }
+}
+
+static size_t countExprNodes(Expr* pExpr)
+{
+    if (!pExpr)
+        return 0;
+
+    switch (pExpr->type)
+    {
+    case EXPR_PREFIX:
+        return 1 + countExprNodes(pExpr->inner.prefixExpr->right);
+
+    case EXPR_INFIX:
+        return 1 + countExprNodes(pExpr->inner.infixExpr->left)
+             + countExprNodes(pExpr->inner.infixExpr->right);
+
+    case EXPR_IF:
+        return 1 + countExprNodes(pExpr->inner.ifExpr->condition)
+             + countBlockNodes(pExpr->inner.ifExpr->consequence)
+             + countBlockNodes(pExpr->inner.ifExpr->alternative);
+
+    case EXPR_FUNCTION:
+        return 1 + countBlockNodes(pExpr->inner.fntExpr->body);
+
+    case EXPR_CALL:
+    {
+        size_t count        = 1 + countExprNodes(pExpr->inner.callExpr->function);
+        Arguments* args     = pExpr->inner.callExpr->arguments;
+        struct ArgNode* tmp = args->tail->before;
+        while (tmp != args->head)
+        {
+            count += countExprNodes(tmp->value);
+            tmp = tmp->before;
+        }
+        return count;
+    }
+
+    case EXPR_ARRAY:
+    case EXPR_HASH:
+    {
+        size_t count        = 1;
+        Arguments* args     = literalElements(pExpr);
+        struct ArgNode* tmp = args->tail->before;
+        while (tmp != args->head)
+        {
+            count += countExprNodes(tmp->value);
+            tmp = tmp->before;
+        }
+        return count;
+    }
+
+    case EXPR_INDEX:
+        return 1 + countExprNodes(pExpr->inner.indexExpr->left)
+             + countExprNodes(pExpr->inner.indexExpr->index);
+
+    default:
+        return 1;
+    }
+}
+
+static void addName(struct NameSet* set, const char* name)
+{
+    if (!name || hasName(set, name))
+        return;
+
+    if ((set->len + 1) * 2 > set->capacity)
+    {
+        size_t oldCapacity = set->capacity;
+        const char** old   = set->slots;
+
+        set->capacity = oldCapacity ? oldCapacity << 1 : 16;
+        set->slots    = calloc(set->capacity, sizeof(const char*));
+        set->len      = 0;
+
+        for (size_t i = 0; i < oldCapacity; ++i)
+            if (old[i])
+                addName(set, old[i]);
+        free(old);
+    }
+
+    size_t i = (size_t)hashChars(name, strlen(name)) & (set->capacity - 1);
+    while (set->slots[i])
+        i = (i + 1) & (set->capacity - 1);
+
+    set->slots[i] = name;
+    ++set->len;
+}
+
+static int hasName(const struct NameSet* set, const char* name)
+{
+    if (set->capacity == 0)
+        return 0;
+
+    size_t i = (size_t)hashChars(name, strlen(name)) & (set->capacity - 1);
+    while (set->slots[i])
+    {
+        if (strcmp(set->slots[i], name) == 0)
+            return 1;
+        i = (i + 1) & (set->capacity - 1);
+    }
+
+    return 0;
+}
+
+static void collectBlockNames(struct NameSet* set, BlockStmt* pBlockStmt)
+{
+    if (!pBlockStmt)
+        return;
+
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head)
+    {
+        collectStmtNames(set, tmp->value);
+        tmp = tmp->before;
+    }
+}
+
+static void collectStmtNames(struct NameSet* set, Stmt* pStmt)
+{
+    if (!pStmt)
+        return;
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+        collectExprNames(set, pStmt->inner.letStmt->value);
+        break;
+
+    case STMT_RETURN:
+        collectExprNames(set, pStmt->inner.returnStmt->returnValue);
+        break;
+
+    case STMT_EXPRESSION:
+        collectExprNames(set, pStmt->inner.exprStmt->expression);
+        break;
+
+    case STMT_BLOCK:
+        collectBlockNames(set, pStmt->inner.blockStmt);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void collectExprNames(struct NameSet* set, Expr* pExpr)
+{
+    if (!pExpr)
+        return;
+
+    switch (pExpr->type)
+    {
+    case EXPR_IDENT:
+        addName(set, getStr(pExpr->inner.identExpr->value));
+        break;
+
+    case EXPR_PREFIX:
+        collectExprNames(set, pExpr->inner.prefixExpr->right);
+        break;
+
+    case EXPR_INFIX:
+        collectExprNames(set, pExpr->inner.infixExpr->left);
+        collectExprNames(set, pExpr->inner.infixExpr->right);
+        break;
+
+    case EXPR_IF:
+        collectExprNames(set, pExpr->inner.ifExpr->condition);
+        collectBlockNames(set, pExpr->inner.ifExpr->consequence);
+        collectBlockNames(set, pExpr->inner.ifExpr->alternative);
+        break;
+
+    case EXPR_FUNCTION:
+        collectBlockNames(set, pExpr->inner.fntExpr->body);
+        break;
+
+    case EXPR_CALL:
+    {
+        collectExprNames(set, pExpr->inner.callExpr->function);
+
+        Arguments* args     = pExpr->inner.callExpr->arguments;
+        struct ArgNode* tmp = args->tail->before;
+        while (tmp != args->head)
+        {
+            collectExprNames(set, tmp->value);
+            tmp = tmp->before;
+        }
+        break;
+    }
+
+    case EXPR_ARRAY:
+    case EXPR_HASH:
+    {
+        Arguments* args     = literalElements(pExpr);
+        struct ArgNode* tmp = args->tail->before;
+        while (tmp != args->head)
+        {
+            collectExprNames(set, tmp->value);
+            tmp = tmp->before;
+        }
+        break;
+    }
+
+    case EXPR_INDEX:
+        collectExprNames(set, pExpr->inner.indexExpr->left);
+        collectExprNames(set, pExpr->inner.indexExpr->index);
+        break;
+
+    default:
+        break;
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef _MONKEY_LANG_SRC_OPTIMIZER_H_
+#define _MONKEY_LANG_SRC_OPTIMIZER_H_
+
+#include <stddef.h>
+
+#include "ast.h"
+
+// Replace every PrefixExpr/InfixExpr whose operands are integer or boolean
+// literals by the literal it evaluates to. Arithmetic is checked, so an
+// expression that would overflow or divide by zero is left for the runtime.
+// Returns the number of operator nodes that were folded.
+size_t foldConstants(Program*);
+
+// Remove code that can never run or whose result is never observed:
+// statements following a `return` in the same block, the untaken branch of
+// an `if` whose condition is a literal, and `let` bindings inside function
+// bodies that are never referenced and whose value has no side effects.
+// Run foldConstants first so that conditions such as `1 > 2` are literals.
+// Returns the number of Stmt and Expr nodes that were removed.
+size_t simplifyProgram(Program*);
+
+#endif //_MONKEY_LANG_SRC_OPTIMIZER_H_
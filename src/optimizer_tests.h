@@ -0,0 +1,126 @@
+#define MAIN_TEST_NAME TestOptimizer
+
+#include "optimizer.h"
+#include "parser.h"
+#include "testing.h"
+
+TEST(FoldConstants)
+{
+    int testStatus = TEST_SUCESSED;
+    struct
+    {
+        const char* input;
+        const char* expected;
+        size_t expectedFolds;
+    } tests[] = {
+        {"(3 * 4) + -(2)", "10", 3},
+        {"!true == false", "true", 2},
+        {"!5", "false", 1},
+        {"1 < 2 != 3 > 4", "true", 3},
+        {"x + (1 + 2) * 3", "(x + 9)", 2},
+        {"10 / 3 - 7", "-4", 2},
+        {"5 / 0", "(5 / 0)", 0},
+        {"-(1 - 1) / (2 - 2)", "(0 / 0)", 3},
+        {"9223372036854775807 + 1", "(9223372036854775807 + 1)", 0},
+        {"-9223372036854775807 - 1", "-9223372036854775808", 2},
+        {"true + false", "(true + false)", 0},
+        {"fn(a) { return a * (2 + 2); }(1 == 1)",
+         "fn(a) { return (a * 4); }(true)", 2},
+        {"if (1 > 2) { 3 * 3 } else { 4 }", "if false { 9 }else { 4 }", 2},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        Program* program = parseForTest(tests[i].input, NULL);
+        if (!program)
+            return TEST_FAILED;
+
+        size_t folds = foldConstants(program);
+        String* got = stringifyProgram(program);
+
+        if (cmpStringStr(got, tests[i].expected) != 0)
+        {
+            PRINT_ERR("expected `%s`, got = `%s`", tests[i].expected,
+                      getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        else if (folds != tests[i].expectedFolds)
+        {
+            PRINT_ERR("`%s` folded %zu nodes, expected %zu", tests[i].input,
+                      folds, tests[i].expectedFolds);
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeProgram(program);
+    }
+
+    return testStatus;
+}
+
+TEST(SimplifyProgram)
+{
+    int testStatus = TEST_SUCESSED;
+    struct
+    {
+        const char* input;
+        const char* expected;
+        size_t expectedRemoved;
+    } tests[] = {
+        {"fn() { return 1; 2; x + 3; }", "fn() { return 1; }", 6},
+        {"return 1; 2;", "return 1;", 2},
+        {"if (true) { 1 } else { 2 }", "1", 5},
+        {"if (1 > 2) { a } else { b }; c", "bc", 5},
+        {"if (false) { a }; c", "c", 5},
+        {"if (false) { a }", "if false { a }", 0},
+        {"if (true) { let y = 1; y }; y",
+         "{ let y = 1;y }y", 2},
+        {"let x = if (true) { 5 } else { 6 };", "let x = 5;", 5},
+        {"let x = if (true) { a; b } else { 6 };",
+         "let x = if true { ab }else { 6 };", 0},
+        {"fn() { if (true) { return a; }; b; c }", "fn() { return a; }", 7},
+        {"fn(a) { let b = 1; let c = fn() { b }; a }", "fn(a) { a }", 6},
+        {"fn(a) { let b = f(1); let c = 2; a }", "fn(a) { let b = f(1);a }",
+         2},
+        {"fn(a) { let b = 1; b }", "fn(a) { let b = 1;b }", 0},
+        {"fn(a) { a; let b = 1; }", "fn(a) { alet b = 1; }", 0},
+        {"let b = 1; 2", "let b = 1;2", 0},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        Program* program = parseForTest(tests[i].input, NULL);
+        if (!program)
+            return TEST_FAILED;
+
+        foldConstants(program);
+        size_t removed = simplifyProgram(program);
+        String* got = stringifyProgram(program);
+
+        if (cmpStringStr(got, tests[i].expected) != 0)
+        {
+            PRINT_ERR("expected `%s`, got = `%s`", tests[i].expected,
+                      getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        else if (removed != tests[i].expectedRemoved)
+        {
+            PRINT_ERR("`%s` removed %zu nodes, expected %zu", tests[i].input,
+                      removed, tests[i].expectedRemoved);
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeProgram(program);
+    }
+
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(FoldConstants);
+        RUN_TEST(SimplifyProgram);
+    })
+
+#undef MAIN_TEST_NAME // End TestOptimizer
@@ -51,7 +51,7 @@ const PrefixParseFn prefixParseFns[] = {
     NULL,             // T_SEMICOLON
     parseGroupedExpr, // T_LPAREN
     NULL,             // T_RPAREN
-    NULL,             // T_LBRACE
+    parseHashExpr,    // T_LBRACE
     NULL,             // T_RBRACE
     NULL,             // T_LET
     parseFntExpr,     // T_FUNCTION
@@ -60,6 +60,10 @@ const PrefixParseFn prefixParseFns[] = {
     parseBoolExpr,    // T_TRUE
     parseBoolExpr,    // T_FALSE
     NULL,             // T_RETURN
+    parseArrayExpr,   // T_LBRACKET
+    NULL,             // T_RBRACKET
+    NULL,             // T_COLON
+    parseStringExpr,  // T_STRING
     NULL,             // T_ZERO
     NULL,             // T_ILLEGAL
 };
@@ -91,11 +95,15 @@ const InfixParseFn infixParseFns[] = {
     NULL,           // T_TRUE
     NULL,           // T_FALSE
     NULL,           // T_RETURN
+    parseIndexExpr, // T_LBRACKET
+    NULL,           // T_RBRACKET
+    NULL,           // T_COLON
+    NULL,           // T_STRING
     NULL,           // T_ZERO
     NULL,           // T_ILLEGAL
 };
 
-inline Precedence takePrec(TokenType tokType)
+static inline Precedence takePrec(TokenType tokType)
 {
     switch (tokType)
     {
@@ -118,6 +126,9 @@ inline Precedence takePrec(TokenType tokType)
     case T_LPAREN:
         return CALL_PREC;
 
+    case T_LBRACKET:
+        return INDEX_PREC;
+
     default:
         return LOWEST_PREC;
     }
@@ -154,7 +165,7 @@ void freeParser(Parser* p)
 
     if (p->errors)
     {
-        for (int i = 0; i < MAXIMUM_ERR_MSGS; ++i)
+        for (int i = 0; i < p->errLen; ++i)
             freeString(p->errors[i]);
         free(p->errors);
     }
@@ -329,6 +340,15 @@ void parseIntExpr(Parser* p, Expr** expr)
     (*expr)->inner.intExpr->value = atoll(getStr(p->curToken.literal));
 }
 
+void parseStringExpr(Parser* p, Expr** expr)
+{
+    ASSERT(expr && *expr);
+
+    (*expr)->type                    = EXPR_STRING;
+    (*expr)->inner.stringExpr        = mkStringExpr();
+    (*expr)->inner.stringExpr->value = mkString(getStr(p->curToken.literal));
+}
+
 void parseBoolExpr(Parser* p, Expr** expr)
 {
     ASSERT(expr && *expr);
@@ -415,6 +435,51 @@ void parseFntExpr(Parser* p, Expr** expr)
 #undef fntExpr
 }
 
+void parseArrayExpr(Parser* p, Expr** expr)
+{
+    ASSERT(expr && *expr);
+
+    (*expr)->type            = EXPR_ARRAY;
+    (*expr)->inner.arrayExpr = mkArrayExpr();
+    parseExprList(p, &(*expr)->inner.arrayExpr->elements, T_RBRACKET);
+}
+
+void parseHashExpr(Parser* p, Expr** expr)
+{
+    ASSERT(expr && *expr);
+
+    Expr* tmp = NULL;
+
+    (*expr)->type           = EXPR_HASH;
+    (*expr)->inner.hashExpr = mkHashExpr();
+
+#define pairs ((*expr)->inner.hashExpr->pairs)
+
+    while (!peekTokenIs(p, T_RBRACE))
+    {
+        takeToken(p);
+        tmp = mkExpr();
+        parseExpr(p, &tmp, LOWEST_PREC);
+        pushArgs(pairs, &tmp);
+
+        EXPECT_PEEK_EXPR(T_COLON);
+
+        takeToken(p);
+        tmp = mkExpr();
+        parseExpr(p, &tmp, LOWEST_PREC);
+        pushArgs(pairs, &tmp);
+
+        if (!peekTokenIs(p, T_RBRACE))
+        {
+            EXPECT_PEEK_EXPR(T_COMMA);
+        }
+    }
+
+    EXPECT_PEEK_EXPR(T_RBRACE);
+
+#undef pairs
+}
+
 void parseFntParams(Parser* p, Parameters** params)
 {
 #define params (*params)
@@ -473,12 +538,38 @@ void parseCallExpr(Parser* p, Expr* output, Expr* function)
     parseCallArguments(p, &output->inner.callExpr->arguments);
 }
 
+void parseIndexExpr(Parser* p, Expr* output, Expr* left)
+{
+    ASSERT(output && left);
+
+    output->type                  = EXPR_INDEX;
+    output->inner.indexExpr       = mkIndexExpr();
+    output->inner.indexExpr->left = left;
+
+    takeToken(p);
+    parseExpr(p, &output->inner.indexExpr->index, LOWEST_PREC);
+
+    if (!expectPeek(p, T_RBRACKET))
+    {
+        freeExprWithoutSelf(output);
+        output->type              = EMPTY_EXPR;
+        output->inner.checkIsNull = 0;
+    }
+}
+
 void parseCallArguments(Parser* p, Arguments** args)
+{
+    parseExprList(p, args, T_RPAREN);
+}
+
+// Comma separated expressions up to the end token, as in call arguments
+// and array literals
+void parseExprList(Parser* p, Arguments** args, TokenType end)
 {
 #define args (*args)
     Expr* expr = NULL;
 
-    if (peekTokenIs(p, T_RPAREN))
+    if (peekTokenIs(p, end))
     {
         takeToken(p);
         return;
@@ -499,7 +590,7 @@ void parseCallArguments(Parser* p, Arguments** args)
         pushArgs(args, &expr);
     }
 
-    if (!expectPeek(p, T_RPAREN))
+    if (!expectPeek(p, end))
     {
         freeArguments(args);
         args = NULL;
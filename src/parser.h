@@ -29,6 +29,7 @@ typedef enum
     PRODUCT_PREC,
     PREFIX_PREC,
     CALL_PREC,
+    INDEX_PREC,
 } Precedence;
 
 typedef void (*PrefixParseFn)(Parser*, Expr** output);
@@ -52,19 +53,24 @@ void parseBlockStmt(Parser*, BlockStmt*);
 void parseExpr(Parser*, Expr**, Precedence);
 void parseFntParams(Parser*, Parameters**);
 void parseCallArguments(Parser*, Arguments**);
+void parseExprList(Parser*, Arguments**, TokenType);
 
 // PrefixParseFn functions
 void parseIdentExpr(Parser*, Expr**);
 void parseIntExpr(Parser*, Expr**);
+void parseStringExpr(Parser*, Expr**);
 void parseBoolExpr(Parser*, Expr**);
 void parsePrefixExpr(Parser*, Expr**);
 void parseGroupedExpr(Parser*, Expr**);
 void parseIfExpr(Parser*, Expr**);
 void parseFntExpr(Parser*, Expr**);
+void parseArrayExpr(Parser*, Expr**);
+void parseHashExpr(Parser*, Expr**);
 
 // InfixParseFn functions
 void parseInfixExpr(Parser*, Expr*, Expr*);
 void parseCallExpr(Parser*, Expr*, Expr*);
+void parseIndexExpr(Parser*, Expr*, Expr*);
 
 #endif // __PRIVATE_PARSER_OBJECTS__
 
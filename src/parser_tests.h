@@ -504,6 +504,18 @@ TEST(TestOperatorPrecedenceParsing)
             "add(a + b + c * d / f + g)",
             "add((((a + b) + ((c * d) / f)) + g))",
         },
+        {
+            "a * [1, 2, 3, 4][b * c] * d",
+            "((a * ([1, 2, 3, 4][(b * c)])) * d)",
+        },
+        {
+            "add(a * b[2], b[1], 2 * [1, 2][1])",
+            "add((a * (b[2])), (b[1]), (2 * ([1, 2][1])))",
+        },
+        {
+            "{1: 2 + 3, true: [], 4: {}}[f(1)]",
+            "({1: (2 + 3), true: [], 4: {}}[f(1)])",
+        },
         {NULL, NULL},
     };
 
@@ -843,7 +855,7 @@ TEST(TestFunctionLiteralExprs)
         goto EXIT_IF_FAILED;
     }
 
-    gotString = stringifyBlockStmt(fntExpr->body);
+    gotString = stringifyProgram((Program*)fntExpr->body);
     if (cmpStringStr(gotString, "(x + y)") != 0)
     {
         PRINT_ERR("Expected `%s`, got = `%s`", "(x + y)", getStr(gotString));
@@ -956,6 +968,129 @@ EXIT_IF_FAILED:
     return testStatus;
 }
 
+TEST(TestCollectionExprs)
+{
+    static int testStatus = TEST_SUCESSED;
+
+    Stmt* stmt = NULL;
+    Expr* expr = NULL;
+    IndexExpr* indexExpr = NULL;
+    HashExpr* hashExpr = NULL;
+    struct ArgNode* tmp = NULL;
+
+    const char* input = "[1, true, x][{1: 2, 3: 4}[1]];";
+    MAKE_PARSER(1);
+
+    stmt = popStmt(program);
+    expr = stmt->inner.exprStmt->expression;
+    if (expr->type != EXPR_INDEX)
+    {
+        PRINT_ERR("expr->type is not %d. got = %d", EXPR_INDEX, expr->type);
+        freeStmt(stmt);
+        testStatus = TEST_FAILED;
+        goto EXIT_IF_FAILED;
+    }
+
+    indexExpr = expr->inner.indexExpr;
+    if (indexExpr->left->type != EXPR_ARRAY
+        || indexExpr->left->inner.arrayExpr->elements->len != 3)
+    {
+        PRINT_ERR("indexExpr->left is not an array of %d elements", 3);
+        freeStmt(stmt);
+        testStatus = TEST_FAILED;
+        goto EXIT_IF_FAILED;
+    }
+
+    tmp = indexExpr->left->inner.arrayExpr->elements->tail->before;
+    if (!testLiteral(tmp->value, 1) || !testLiteral(tmp->before->value, TRUE)
+        || !testIdentExpr(tmp->before->before->value, "x"))
+    {
+        freeStmt(stmt);
+        testStatus = TEST_FAILED;
+        goto EXIT_IF_FAILED;
+    }
+
+    expr = indexExpr->index;
+    if (expr->type != EXPR_INDEX
+        || expr->inner.indexExpr->left->type != EXPR_HASH)
+    {
+        PRINT_ERR("indexExpr->index does not index a hash literal", NULL);
+        freeStmt(stmt);
+        testStatus = TEST_FAILED;
+        goto EXIT_IF_FAILED;
+    }
+
+    // Keys and values alternate from the first pair on
+    hashExpr = expr->inner.indexExpr->left->inner.hashExpr;
+    tmp = hashExpr->pairs->tail->before;
+    for (int64_t i = 1; i <= 4; ++i, tmp = tmp->before)
+    {
+        if (hashExpr->pairs->len != 4 || !testLiteral(tmp->value, i))
+        {
+            PRINT_ERR("pair %d of the hash literal is wrong", (int)i);
+            freeStmt(stmt);
+            testStatus = TEST_FAILED;
+            goto EXIT_IF_FAILED;
+        }
+    }
+
+    freeStmt(stmt);
+
+EXIT_IF_FAILED:
+    freeProgram(program);
+    freeParser(p);
+    return testStatus;
+}
+
+TEST(TestStringExprs)
+{
+    static int testStatus = TEST_SUCESSED;
+
+    Stmt* stmt = NULL;
+    Expr* expr = NULL;
+    InfixExpr* infixExpr = NULL;
+    String* actual = NULL;
+
+    const char* input = "\"hello world\" + s[0];";
+    MAKE_PARSER(1);
+
+    actual = stringifyProgram(program);
+    if (cmpStringStr(actual, "(\"hello world\" + (s[0]))") != 0)
+    {
+        PRINT_ERR("program is not stringified with quotes. got = %s",
+                  getStr(actual));
+        testStatus = TEST_FAILED;
+    }
+    freeString(actual);
+
+    stmt = popStmt(program);
+    expr = stmt->inner.exprStmt->expression;
+    if (expr->type != EXPR_INFIX)
+    {
+        PRINT_ERR("expr->type is not %d. got = %d", EXPR_INFIX, expr->type);
+        freeStmt(stmt);
+        testStatus = TEST_FAILED;
+        goto EXIT_IF_FAILED;
+    }
+
+    infixExpr = expr->inner.infixExpr;
+    if (infixExpr->left->type != EXPR_STRING
+        || cmpStringStr(infixExpr->left->inner.stringExpr->value,
+                        "hello world")
+               != 0)
+    {
+        PRINT_ERR("infixExpr->left is not the string `%s`", "hello world");
+        testStatus = TEST_FAILED;
+    }
+
+    freeStmt(stmt);
+
+EXIT_IF_FAILED:
+    freeProgram(program);
+    freeParser(p);
+    return testStatus;
+}
+
 ///////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////
 
@@ -1062,6 +1197,8 @@ MAIN_TEST(
         RUN_TEST(TestIfElseExprs);
         RUN_TEST(TestFunctionLiteralExprs);
         RUN_TEST(TestCallExprs);
+        RUN_TEST(TestCollectionExprs);
+        RUN_TEST(TestStringExprs);
     })
 
 #undef MAIN_TEST_NAME // End TestParser
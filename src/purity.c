@@ -0,0 +1,236 @@
+#include <stdlib.h>
+
+#include "ast.h"
+#include "purity.h"
+#include "walker.h"
+
+// Binding of a global bound to something else than a function literal,
+// or more than once in the program
+static FntExpr notAFunction;
+#define NOT_A_FUNCTION (&notAFunction)
+
+// What the body of a function literal calls by global name. Functions
+// start out pure when their own body allows it, and stop being so when
+// one of their callees turns out not to be.
+struct Candidate
+{
+    FntExpr* function;
+    int* callees; // global slots
+    int calleeLen;
+    int calleeCapacity;
+    int globalUses; // of any global, called or not
+};
+
+struct PurityState
+{
+    struct Candidate* candidates;
+    size_t len;
+    size_t capacity;
+    size_t* open; // candidates whose body is being walked, innermost last
+    size_t depth;
+    FntExpr** bindings; // function bound to each global slot, or NULL
+    size_t bindingLen;
+};
+
+/* Private Function Signatures */
+static WalkResult purityPre(AstNode, void*);
+static WalkResult purityPost(AstNode, void*);
+static void openCandidate(struct PurityState*, FntExpr*);
+static void bindGlobal(struct PurityState*, int, Expr*);
+static void checkCall(struct Candidate*, CallExpr*);
+static int calleesArePure(const struct PurityState*, const struct Candidate*);
+
+size_t analyzePurity(Program* pProg)
+{
+    static const Visitor visitor = {purityPre, NULL, purityPost};
+
+    if (!pProg)
+        return 0;
+
+    struct PurityState state = {NULL, 0, 0, NULL, 0, NULL, 0};
+    walkProgram(pProg, &visitor, &state);
+
+    // Drop the functions calling impure ones until none is left, which
+    // keeps the functions that only call each other
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (size_t i = 0; i < state.len; ++i)
+        {
+            struct Candidate* candidate = &state.candidates[i];
+            if (candidate->function->pure
+                && !calleesArePure(&state, candidate))
+            {
+                candidate->function->pure = 0;
+                changed                   = 1;
+            }
+        }
+    }
+
+    size_t pure = 0;
+    for (size_t i = 0; i < state.len; ++i)
+    {
+        pure += state.candidates[i].function->pure != 0;
+        free(state.candidates[i].callees);
+    }
+    free(state.candidates);
+    free(state.open);
+    free(state.bindings);
+
+    return pure;
+}
+
+static WalkResult purityPre(AstNode node, void* ctx)
+{
+    struct PurityState* state = ctx;
+
+    if (node.kind == NODE_STMT && node.as.stmt->type == STMT_LET
+        && node.as.stmt->inner.letStmt->name->kind == RESOLVE_GLOBAL)
+    {
+        LetStmt* let = node.as.stmt->inner.letStmt;
+        bindGlobal(state, let->name->slot, let->value);
+        return WALK_CONTINUE;
+    }
+
+    if (node.kind != NODE_EXPR || !node.as.expr->inner.checkIsNull)
+        return WALK_CONTINUE;
+
+    Expr* expr = node.as.expr;
+    struct Candidate* candidate =
+        state->depth ? &state->candidates[state->open[state->depth - 1]]
+                     : NULL;
+
+    switch (expr->type)
+    {
+    case EXPR_FUNCTION:
+        // Closures made by a call differ from call to call
+        if (candidate)
+            candidate->function->pure = 0;
+        openCandidate(state, expr->inner.fntExpr);
+        break;
+
+    case EXPR_IDENT:
+        if (!candidate)
+            break;
+        if (expr->inner.identExpr->kind == RESOLVE_GLOBAL)
+            ++candidate->globalUses;
+        else if (expr->inner.identExpr->kind != RESOLVE_LOCAL)
+            candidate->function->pure = 0;
+        break;
+
+    case EXPR_CALL:
+        if (candidate)
+            checkCall(candidate, expr->inner.callExpr);
+        break;
+
+    default:
+        break;
+    }
+
+    return WALK_CONTINUE;
+}
+
+static WalkResult purityPost(AstNode node, void* ctx)
+{
+    struct PurityState* state = ctx;
+
+    if (node.kind != NODE_EXPR || !node.as.expr->inner.checkIsNull
+        || node.as.expr->type != EXPR_FUNCTION)
+        return WALK_CONTINUE;
+
+    // Globals may only be named to be called
+    struct Candidate* candidate =
+        &state->candidates[state->open[--state->depth]];
+    if (candidate->globalUses != candidate->calleeLen)
+        candidate->function->pure = 0;
+
+    return WALK_CONTINUE;
+}
+
+static void openCandidate(struct PurityState* state, FntExpr* pFntExpr)
+{
+    if (state->len == state->capacity)
+    {
+        state->capacity   = state->capacity ? state->capacity << 1 : 8;
+        state->candidates = realloc(state->candidates,
+                                    sizeof(struct Candidate) * state->capacity);
+        state->open = realloc(state->open, sizeof(size_t) * state->capacity);
+    }
+
+    struct Candidate* candidate = &state->candidates[state->len];
+    candidate->function         = pFntExpr;
+    candidate->callees          = NULL;
+    candidate->calleeLen        = 0;
+    candidate->calleeCapacity   = 0;
+    candidate->globalUses       = 0;
+
+    pFntExpr->pure              = pFntExpr->numCaptures == 0;
+    state->open[state->depth++] = state->len++;
+}
+
+static void bindGlobal(struct PurityState* state, int slot, Expr* value)
+{
+    if ((size_t)slot >= state->bindingLen)
+    {
+        size_t len = (size_t)slot + 1 > state->bindingLen << 1
+                         ? (size_t)slot + 1
+                         : state->bindingLen << 1;
+        state->bindings = realloc(state->bindings, sizeof(FntExpr*) * len);
+        for (size_t i = state->bindingLen; i < len; ++i)
+            state->bindings[i] = NULL;
+        state->bindingLen = len;
+    }
+
+    if (state->bindings[slot] || !value->inner.checkIsNull
+        || value->type != EXPR_FUNCTION)
+        state->bindings[slot] = NOT_A_FUNCTION;
+    else
+        state->bindings[slot] = value->inner.fntExpr;
+}
+
+// A call keeps its function pure when it calls the function itself, or a
+// global to be checked once every binding of the program is known
+static void checkCall(struct Candidate* candidate, CallExpr* pCallExpr)
+{
+    Expr* callee = pCallExpr->function;
+    if (!callee->inner.checkIsNull || callee->type != EXPR_IDENT)
+    {
+        candidate->function->pure = 0;
+        return;
+    }
+
+    IdentExpr* ident = callee->inner.identExpr;
+    if (ident->kind == RESOLVE_LOCAL
+        && ident->slot == candidate->function->selfSlot)
+        return;
+    if (ident->kind != RESOLVE_GLOBAL)
+    {
+        candidate->function->pure = 0;
+        return;
+    }
+
+    if (candidate->calleeLen == candidate->calleeCapacity)
+    {
+        candidate->calleeCapacity =
+            candidate->calleeCapacity ? candidate->calleeCapacity << 1 : 4;
+        candidate->callees =
+            realloc(candidate->callees,
+                    sizeof(int) * (size_t)candidate->calleeCapacity);
+    }
+    candidate->callees[candidate->calleeLen++] = ident->slot;
+}
+
+static int calleesArePure(const struct PurityState* state,
+                          const struct Candidate* candidate)
+{
+    for (int i = 0; i < candidate->calleeLen; ++i)
+    {
+        size_t slot = (size_t)candidate->callees[i];
+        if (slot >= state->bindingLen || !state->bindings[slot]
+            || state->bindings[slot] == NOT_A_FUNCTION
+            || !state->bindings[slot]->pure)
+            return 0;
+    }
+    return 1;
+}
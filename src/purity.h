@@ -0,0 +1,21 @@
+#ifndef _MONKEY_LANG_SRC_PURITY_H_
+#define _MONKEY_LANG_SRC_PURITY_H_
+
+#include <stddef.h>
+
+#include "ast.h"
+
+// Mark the function literals of the program whose calls depend on their
+// arguments only, so that an engine may remember what a call returned and
+// answer the same call again without running it; see memo.h.
+//
+// A function is pure when its body is made of literals, operators, ifs,
+// lets and returns over its parameters and locals, and it calls only
+// itself and pure functions bound by `let` to a global exactly once in the
+// program. It captures nothing and creates no closures, so every closure
+// of it behaves the same. Functions calling each other stay pure together.
+//
+// Run it after analyzeCaptures. Returns the number of pure functions.
+size_t analyzePurity(Program*);
+
+#endif //_MONKEY_LANG_SRC_PURITY_H_
@@ -0,0 +1,148 @@
+#include <stdio.h>
+
+#include "registerCode.h"
+#include "stringBuilder.h"
+
+#define N OPERAND_NONE
+#define R OPERAND_REG
+#define K OPERAND_RK
+#define I OPERAND_IMM
+#define W OPERAND_WIDE
+
+static const struct
+{
+    const char* name;
+    RegOperands operands;
+} regOpcodes[REG_OPCODE_COUNT] = {
+    [R_MOVE] = {"R_MOVE", {R, K, N}},
+    [R_ADD] = {"R_ADD", {R, K, K}},
+    [R_SUB] = {"R_SUB", {R, K, K}},
+    [R_MUL] = {"R_MUL", {R, K, K}},
+    [R_DIV] = {"R_DIV", {R, K, K}},
+    [R_EQ] = {"R_EQ", {R, K, K}},
+    [R_NE] = {"R_NE", {R, K, K}},
+    [R_LT] = {"R_LT", {R, K, K}},
+    [R_GT] = {"R_GT", {R, K, K}},
+    [R_MINUS] = {"R_MINUS", {R, K, N}},
+    [R_BANG] = {"R_BANG", {R, K, N}},
+    [R_JUMP] = {"R_JUMP", {N, W, N}},
+    [R_JUMP_FALSY] = {"R_JUMP_FALSY", {K, W, N}},
+    [R_GET_GLOBAL] = {"R_GET_GLOBAL", {R, W, N}},
+    [R_SET_GLOBAL] = {"R_SET_GLOBAL", {K, W, N}},
+    [R_GET_CAPTURE] = {"R_GET_CAPTURE", {R, I, N}},
+    [R_CLOSURE] = {"R_CLOSURE", {R, I, N}},
+    [R_CALL] = {"R_CALL", {R, K, I}},
+    [R_TAIL_CALL] = {"R_TAIL_CALL", {R, K, I}},
+    [R_ARGS] = {"R_ARGS", {K, K, K}},
+    [R_ARRAY] = {"R_ARRAY", {R, N, I}},
+    [R_HASH] = {"R_HASH", {R, N, I}},
+    [R_INDEX] = {"R_INDEX", {R, K, K}},
+    [R_RETURN] = {"R_RETURN", {K, N, N}},
+};
+
+#undef N
+#undef R
+#undef K
+#undef I
+#undef W
+
+const char* regOpcodeName(RegOpcode op)
+{
+    if ((unsigned)op >= REG_OPCODE_COUNT)
+        return "R_UNKNOWN";
+    return regOpcodes[op].name;
+}
+
+RegOperands regOperands(RegOpcode op)
+{
+    if ((unsigned)op >= REG_OPCODE_COUNT)
+        return (RegOperands){OPERAND_NONE, OPERAND_NONE, OPERAND_NONE};
+    return regOpcodes[op].operands;
+}
+
+uint32_t regArgCount(RegOpcode op, uint32_t c)
+{
+    switch (op)
+    {
+    case R_CALL:
+    case R_TAIL_CALL:
+    case R_ARRAY:
+        return c;
+    case R_HASH:
+        return 2 * c;
+    default:
+        return 0;
+    }
+}
+
+static void appendOperand(StringBuilder* sb, OperandKind kind, uint32_t value)
+{
+    char buffer[32];
+
+    switch (kind)
+    {
+    case OPERAND_REG:
+    case OPERAND_RK:
+        if (value & RK_CONSTANT)
+            snprintf(buffer, sizeof(buffer), " k%u", value & ~RK_CONSTANT);
+        else
+            snprintf(buffer, sizeof(buffer), " r%u", value);
+        break;
+    case OPERAND_IMM:
+    case OPERAND_WIDE:
+        snprintf(buffer, sizeof(buffer), " %u", value);
+        break;
+    default:
+        return;
+    }
+
+    builderAppendStr(sb, buffer);
+}
+
+String* disassembleRegisters(const CompiledFunction* fn)
+{
+    StringBuilder* sb = mkStringBuilder();
+    char buffer[32];
+    uint32_t remainingArgs = 0;
+
+    for (size_t i = 0; i + 1 < fn->codeLen; i += REG_INSTR_WORDS)
+    {
+        uint32_t w0         = fn->code[i];
+        uint32_t w1         = fn->code[i + 1];
+        RegOpcode op        = REG_OP(w0);
+        RegOperands operand = regOperands(op);
+
+        snprintf(buffer, sizeof(buffer), "%04zu %s", i, regOpcodeName(op));
+        builderAppendStr(sb, buffer);
+
+        if (op == R_ARGS)
+        {
+            // Only the operands that hold arguments are meaningful
+            uint32_t values[3] = {REG_A(w0), REG_B(w1), REG_C(w1)};
+            for (int j = 0; j < 3 && remainingArgs > 0; ++j, --remainingArgs)
+                appendOperand(sb, OPERAND_RK, values[j]);
+        }
+        else
+        {
+            appendOperand(sb, operand.a, REG_A(w0));
+            if (operand.b == OPERAND_WIDE)
+            {
+                appendOperand(sb, OPERAND_WIDE, w1);
+            }
+            else
+            {
+                appendOperand(sb, operand.b, REG_B(w1));
+                appendOperand(sb, operand.c, REG_C(w1));
+            }
+        }
+
+        if (op != R_ARGS)
+            remainingArgs = regArgCount(op, REG_C(w1));
+
+        builderAppendChar(sb, '\n');
+    }
+
+    String* output = buildString(sb);
+    freeStringBuilder(sb);
+    return output;
+}
@@ -0,0 +1,91 @@
+#ifndef _MONKEY_LANG_SRC_REGISTERCODE_H_
+#define _MONKEY_LANG_SRC_REGISTERCODE_H_
+
+#include <stdint.h>
+
+#include "dynString.h"
+#include "object.h"
+
+// A register instruction takes two 32-bit words. The first holds the
+// opcode in its low 8 bits and operand A above it; the second holds
+// operands B and C, 16 bits each, or a single 32-bit operand BX.
+//
+// Registers are the slots of the frame: the parameters and locals assigned
+// by the resolver come first, temporaries after them. A register operand
+// with RK_CONSTANT set names an entry of the constant pool instead.
+#define REG_INSTR_WORDS 2
+#define RK_CONSTANT     0x8000u
+#define MAX_REGISTER    0x7fffu
+
+#define REG_WORD0(op, a)  ((uint32_t)(op) | ((uint32_t)(a) << 8))
+#define REG_WORD1(b, c)   ((uint32_t)(b) | ((uint32_t)(c) << 16))
+#define REG_OP(w0)        ((RegOpcode)((w0) & 0xff))
+#define REG_A(w0)         ((uint32_t)(w0) >> 8)
+#define REG_B(w1)         ((w1) & 0xffffu)
+#define REG_C(w1)         ((uint32_t)(w1) >> 16)
+
+typedef enum
+{
+    R_MOVE = 0, // R[A] = RK[B]
+
+    R_ADD, // R[A] = RK[B] + RK[C]
+    R_SUB,
+    R_MUL,
+    R_DIV,
+    R_EQ,
+    R_NE,
+    R_LT,
+    R_GT,
+    R_MINUS, // R[A] = -RK[B]
+    R_BANG,  // R[A] = !RK[B]
+
+    R_JUMP,       // continue at code[BX]
+    R_JUMP_FALSY, // continue at code[BX] if RK[A] is falsy
+
+    R_GET_GLOBAL,  // R[A] = globals[BX]
+    R_SET_GLOBAL,  // globals[BX] = RK[A]
+    R_GET_CAPTURE, // R[A] = captures[B]
+    R_CLOSURE,     // R[A] = closure of functions[B]
+
+    // R[A] = RK[B](...), with C arguments given by the RK operands A, B and
+    // C of the R_ARGS instructions that follow
+    R_CALL,
+    R_TAIL_CALL, // as R_CALL, the callee taking over the running frame
+    R_ARGS,
+
+    R_ARRAY, // R[A] = array of C elements, given by R_ARGS as for R_CALL
+    R_HASH,  // R[A] = hash of C pairs, given by R_ARGS key first
+    R_INDEX, // R[A] = RK[B][RK[C]]
+
+    R_RETURN, // return RK[A]
+
+    REG_OPCODE_COUNT,
+} RegOpcode;
+
+typedef enum
+{
+    OPERAND_NONE = 0,
+    OPERAND_REG,  // register
+    OPERAND_RK,   // register or constant
+    OPERAND_IMM,  // index or count
+    OPERAND_WIDE, // B and C together, as BX
+} OperandKind;
+
+typedef struct
+{
+    OperandKind a;
+    OperandKind b;
+    OperandKind c;
+} RegOperands;
+
+const char* regOpcodeName(RegOpcode);
+RegOperands regOperands(RegOpcode);
+// Number of operands held by the R_ARGS instructions following an
+// instruction op whose operand C is c
+uint32_t regArgCount(RegOpcode op, uint32_t c);
+
+// One line per instruction: its word index, opcode and operands, with
+// registers as r<n> and constants as k<n>
+String* disassembleRegisters(const CompiledFunction*);
+
+#endif //_MONKEY_LANG_SRC_REGISTERCODE_H_
@@ -0,0 +1,734 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "ast.h"
+#include "environment.h"
+#include "object.h"
+#include "registerCode.h"
+#include "registerCompiler.h"
+
+#define NO_REGISTER UINT32_MAX
+
+struct RegCompiler
+{
+    Environment* env;
+    CompiledFunction* fn;
+    size_t codeCapacity;
+    size_t constantCapacity;
+    size_t functionCapacity;
+    uint32_t numLocals; // registers below are the slots of the resolver
+    uint32_t numTemps;  // virtual registers handed out, above numLocals
+    int failed;
+};
+
+// Live range of a virtual register, in instructions
+struct Interval
+{
+    size_t start;
+    size_t end;
+    uint32_t vreg;
+};
+
+typedef uint32_t (*RegisterMapFn)(uint32_t, size_t, void*);
+
+/* Private Function Signatures */
+static void initCompiler(struct RegCompiler*, Environment*, CompiledFunction*,
+                         uint32_t);
+static size_t emit(struct RegCompiler*, RegOpcode, uint32_t, uint32_t);
+static void patchJump(struct RegCompiler*, size_t);
+static uint32_t constantOperand(struct RegCompiler*, Value);
+static uint32_t newTemp(struct RegCompiler*);
+static void compileBody(struct RegCompiler*, BlockStmt*, Value);
+static void compileBlockInto(struct RegCompiler*, BlockStmt*, uint32_t, Value);
+static void compileStmt(struct RegCompiler*, Stmt*, uint32_t, Value);
+static uint32_t compileOperand(struct RegCompiler*, Expr*);
+static void compileInto(struct RegCompiler*, Expr*, uint32_t);
+static void compileIdent(struct RegCompiler*, IdentExpr*, uint32_t);
+static void compileInfix(struct RegCompiler*, InfixExpr*, uint32_t);
+static void compileIf(struct RegCompiler*, IfExpr*, uint32_t);
+static uint32_t compileFunction(struct RegCompiler*, Expr*);
+static void compileCall(struct RegCompiler*, CallExpr*, uint32_t);
+static void compileList(struct RegCompiler*, RegOpcode, Arguments*, size_t,
+                        uint32_t);
+static uint32_t* compileArgs(struct RegCompiler*, Arguments*);
+static void emitArgs(struct RegCompiler*, uint32_t*, size_t);
+static void mapRegisters(CompiledFunction*, RegisterMapFn, void*);
+static void allocateRegisters(struct RegCompiler*);
+static void compileError(struct RegCompiler*, const char*, const char*);
+
+CompiledFunction* compileRegisters(Program* pProg, Environment* env)
+{
+    struct RegCompiler c;
+    initCompiler(&c, env, mkCompiledFunction(NULL), 0);
+
+    // A program ending with `let` has no value, as in eval
+    compileBody(&c, pProg, UNDEFINED_VALUE);
+    allocateRegisters(&c);
+
+    if (c.failed)
+    {
+        freeObject(&c.fn->object);
+        return NULL;
+    }
+
+    return c.fn;
+}
+
+static void initCompiler(struct RegCompiler* c, Environment* env,
+                         CompiledFunction* fn, uint32_t numLocals)
+{
+    c->env              = env;
+    c->fn               = fn;
+    c->codeCapacity     = 0;
+    c->constantCapacity = 0;
+    c->functionCapacity = 0;
+    c->numLocals        = numLocals;
+    c->numTemps         = 0;
+    c->failed           = 0;
+}
+
+static size_t emit(struct RegCompiler* c, RegOpcode op, uint32_t a,
+                   uint32_t w1)
+{
+    CompiledFunction* fn = c->fn;
+
+    if (fn->codeLen + REG_INSTR_WORDS > c->codeCapacity)
+    {
+        c->codeCapacity = c->codeCapacity ? c->codeCapacity << 1 : 32;
+        fn->code = realloc(fn->code, sizeof(uint32_t) * c->codeCapacity);
+    }
+
+    fn->code[fn->codeLen]     = REG_WORD0(op, a);
+    fn->code[fn->codeLen + 1] = w1;
+    fn->codeLen += REG_INSTR_WORDS;
+
+    return fn->codeLen - REG_INSTR_WORDS;
+}
+
+// Point a jump emitted earlier at the next instruction
+static void patchJump(struct RegCompiler* c, size_t at)
+{
+    c->fn->code[at + 1] = (uint32_t)c->fn->codeLen;
+}
+
+static uint32_t constantOperand(struct RegCompiler* c, Value value)
+{
+    CompiledFunction* fn = c->fn;
+
+    for (size_t i = 0; i < fn->numConstants; ++i)
+    {
+        if (valuesEqual(fn->constants[i], value))
+            return RK_CONSTANT | (uint32_t)i;
+    }
+
+    if (fn->numConstants > MAX_REGISTER)
+    {
+        compileError(c, "too many constants", "");
+        return RK_CONSTANT;
+    }
+
+    if (fn->numConstants == c->constantCapacity)
+    {
+        c->constantCapacity = c->constantCapacity ? c->constantCapacity << 1
+                                                  : 8;
+        fn->constants = realloc(fn->constants,
+                                sizeof(Value) * c->constantCapacity);
+    }
+    fn->constants[fn->numConstants] = value;
+
+    return RK_CONSTANT | (uint32_t)fn->numConstants++;
+}
+
+static uint32_t newTemp(struct RegCompiler* c)
+{
+    if (c->numLocals + c->numTemps >= MAX_REGISTER)
+    {
+        compileError(c, "too many registers", "");
+        return 0;
+    }
+
+    return c->numLocals + c->numTemps++;
+}
+
+// Compile the statements of a function body or program, returning the
+// value of the last one
+static void compileBody(struct RegCompiler* c, BlockStmt* pBlockStmt,
+                        Value empty)
+{
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+
+    while (tmp != pBlockStmt->head && tmp->before != pBlockStmt->head)
+    {
+        compileStmt(c, tmp->value, NO_REGISTER, empty);
+        tmp = tmp->before;
+    }
+
+    Stmt* last = tmp->value;
+    if (tmp == pBlockStmt->head || !last->inner.checkIsNull)
+    {
+        emit(c, R_RETURN, constantOperand(c, empty), 0);
+    }
+    else if (last->type == STMT_EXPRESSION)
+    {
+        emit(c, R_RETURN,
+             compileOperand(c, last->inner.exprStmt->expression), 0);
+    }
+    else if (last->type == STMT_RETURN)
+    {
+        compileStmt(c, last, NO_REGISTER, empty);
+    }
+    else
+    {
+        uint32_t result = newTemp(c);
+        compileStmt(c, last, result, empty);
+        emit(c, R_RETURN, result, 0);
+    }
+}
+
+// Leave the value of the last statement of the block in dst, or empty if
+// there is none. With NO_REGISTER the value is dropped.
+static void compileBlockInto(struct RegCompiler* c, BlockStmt* pBlockStmt,
+                             uint32_t dst, Value empty)
+{
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    if (tmp == pBlockStmt->head)
+    {
+        if (dst != NO_REGISTER)
+            emit(c, R_MOVE, dst, constantOperand(c, empty));
+        return;
+    }
+
+    while (tmp != pBlockStmt->head)
+    {
+        compileStmt(c, tmp->value,
+                    tmp->before == pBlockStmt->head ? dst : NO_REGISTER, empty);
+        tmp = tmp->before;
+    }
+}
+
+static void compileStmt(struct RegCompiler* c, Stmt* pStmt, uint32_t dst,
+                        Value empty)
+{
+    if (!pStmt->inner.checkIsNull)
+    {
+        if (dst != NO_REGISTER)
+            emit(c, R_MOVE, dst, constantOperand(c, empty));
+        return;
+    }
+
+    switch (pStmt->type)
+    {
+    case STMT_LET:
+    {
+        IdentExpr* name = pStmt->inner.letStmt->name;
+        if (name->kind == RESOLVE_GLOBAL)
+            emit(c, R_SET_GLOBAL,
+                 compileOperand(c, pStmt->inner.letStmt->value),
+                 (uint32_t)name->slot);
+        else
+            compileInto(c, pStmt->inner.letStmt->value, (uint32_t)name->slot);
+
+        if (dst != NO_REGISTER)
+            emit(c, R_MOVE, dst, constantOperand(c, empty));
+        break;
+    }
+
+    case STMT_RETURN:
+        emit(c, R_RETURN,
+             compileOperand(c, pStmt->inner.returnStmt->returnValue), 0);
+        break;
+
+    case STMT_EXPRESSION:
+        compileInto(c, pStmt->inner.exprStmt->expression, dst);
+        break;
+
+    case STMT_BLOCK:
+        compileBlockInto(c, pStmt->inner.blockStmt, dst, empty);
+        break;
+
+    default:
+        if (dst != NO_REGISTER)
+            emit(c, R_MOVE, dst, constantOperand(c, empty));
+        break;
+    }
+}
+
+// Operand holding the value of the expression: a constant or a local
+// register when possible, a temporary otherwise
+static uint32_t compileOperand(struct RegCompiler* c, Expr* pExpr)
+{
+    if (!pExpr || !pExpr->inner.checkIsNull)
+        return constantOperand(c, NULL_VALUE);
+
+    switch (pExpr->type)
+    {
+    case EXPR_INTEGER:
+        return constantOperand(c, INT_VALUE(pExpr->inner.intExpr->value));
+
+    case EXPR_BOOL:
+        return constantOperand(c, BOOL_VALUE(pExpr->inner.boolExpr->value));
+
+    case EXPR_STRING:
+    {
+        String* value = pExpr->inner.stringExpr->value;
+        Rope* rope = newConstantString(c->env, getStr(value), getLen(value));
+        return constantOperand(c, OBJECT_VALUE(VALUE_STRING, rope));
+    }
+
+    case EXPR_IDENT:
+        if (pExpr->inner.identExpr->kind == RESOLVE_LOCAL)
+            return (uint32_t)pExpr->inner.identExpr->slot;
+        break;
+
+    default:
+        break;
+    }
+
+    uint32_t temp = newTemp(c);
+    compileInto(c, pExpr, temp);
+    return temp;
+}
+
+// Evaluate the expression into dst. With NO_REGISTER the value is only
+// computed for its effects.
+static void compileInto(struct RegCompiler* c, Expr* pExpr, uint32_t dst)
+{
+    if (dst == NO_REGISTER)
+    {
+        if (!pExpr || !pExpr->inner.checkIsNull)
+            return;
+
+        switch (pExpr->type)
+        {
+        case EXPR_INTEGER:
+        case EXPR_BOOL:
+        case EXPR_STRING:
+        case EXPR_FUNCTION:
+            return;
+        case EXPR_IF:
+            compileIf(c, pExpr->inner.ifExpr, NO_REGISTER);
+            return;
+        default:
+            compileOperand(c, pExpr);
+            return;
+        }
+    }
+
+    if (!pExpr || !pExpr->inner.checkIsNull)
+    {
+        emit(c, R_MOVE, dst, constantOperand(c, NULL_VALUE));
+        return;
+    }
+
+    switch (pExpr->type)
+    {
+    case EXPR_IDENT:
+        compileIdent(c, pExpr->inner.identExpr, dst);
+        break;
+
+    case EXPR_INTEGER:
+    case EXPR_BOOL:
+    case EXPR_STRING:
+        emit(c, R_MOVE, dst, compileOperand(c, pExpr));
+        break;
+
+    case EXPR_PREFIX:
+    {
+        uint32_t right = compileOperand(c, pExpr->inner.prefixExpr->right);
+        emit(c,
+             getStr(pExpr->inner.prefixExpr->opt)[0] == '!' ? R_BANG : R_MINUS,
+             dst, right);
+        break;
+    }
+
+    case EXPR_INFIX:
+        compileInfix(c, pExpr->inner.infixExpr, dst);
+        break;
+
+    case EXPR_IF:
+        compileIf(c, pExpr->inner.ifExpr, dst);
+        break;
+
+    case EXPR_FUNCTION:
+        emit(c, R_CLOSURE, dst, compileFunction(c, pExpr));
+        break;
+
+    case EXPR_CALL:
+        compileCall(c, pExpr->inner.callExpr, dst);
+        break;
+
+    case EXPR_ARRAY:
+    {
+        Arguments* elements = pExpr->inner.arrayExpr->elements;
+        compileList(c, R_ARRAY, elements, elements->len, dst);
+        break;
+    }
+
+    case EXPR_HASH:
+    {
+        Arguments* pairs = pExpr->inner.hashExpr->pairs;
+        compileList(c, R_HASH, pairs, pairs->len / 2, dst);
+        break;
+    }
+
+    case EXPR_INDEX:
+    {
+        uint32_t left  = compileOperand(c, pExpr->inner.indexExpr->left);
+        uint32_t index = compileOperand(c, pExpr->inner.indexExpr->index);
+        emit(c, R_INDEX, dst, REG_WORD1(left, index));
+        break;
+    }
+
+    default:
+        emit(c, R_MOVE, dst, constantOperand(c, NULL_VALUE));
+        break;
+    }
+}
+
+static void compileIdent(struct RegCompiler* c, IdentExpr* pIdentExpr,
+                         uint32_t dst)
+{
+    switch (pIdentExpr->kind)
+    {
+    case RESOLVE_GLOBAL:
+        emit(c, R_GET_GLOBAL, dst, (uint32_t)pIdentExpr->slot);
+        break;
+    case RESOLVE_LOCAL:
+        if ((uint32_t)pIdentExpr->slot != dst)
+            emit(c, R_MOVE, dst, (uint32_t)pIdentExpr->slot);
+        break;
+    case RESOLVE_CAPTURE:
+        emit(c, R_GET_CAPTURE, dst, (uint32_t)pIdentExpr->slot);
+        break;
+    default:
+        compileError(c, "identifier not found: ", getStr(pIdentExpr->value));
+        break;
+    }
+}
+
+static void compileInfix(struct RegCompiler* c, InfixExpr* pInfixExpr,
+                         uint32_t dst)
+{
+    uint32_t left  = compileOperand(c, pInfixExpr->left);
+    uint32_t right = compileOperand(c, pInfixExpr->right);
+
+    RegOpcode op    = R_ADD;
+    const char* opt = getStr(pInfixExpr->opt);
+    switch (opt[0])
+    {
+    case '+':
+        op = R_ADD;
+        break;
+    case '-':
+        op = R_SUB;
+        break;
+    case '*':
+        op = R_MUL;
+        break;
+    case '/':
+        op = R_DIV;
+        break;
+    case '<':
+        op = R_LT;
+        break;
+    case '>':
+        op = R_GT;
+        break;
+    case '=':
+        op = R_EQ;
+        break;
+    case '!':
+        op = R_NE;
+        break;
+    default:
+        compileError(c, "unknown operator: ", opt);
+        break;
+    }
+
+    emit(c, op, dst, REG_WORD1(left, right));
+}
+
+static void compileIf(struct RegCompiler* c, IfExpr* pIfExpr, uint32_t dst)
+{
+    uint32_t condition = compileOperand(c, pIfExpr->condition);
+    size_t jumpToElse  = emit(c, R_JUMP_FALSY, condition, 0);
+
+    compileBlockInto(c, pIfExpr->consequence, dst, NULL_VALUE);
+    if (!pIfExpr->alternative && dst == NO_REGISTER)
+    {
+        patchJump(c, jumpToElse);
+        return;
+    }
+
+    size_t jumpToEnd = emit(c, R_JUMP, 0, 0);
+    patchJump(c, jumpToElse);
+
+    if (pIfExpr->alternative)
+        compileBlockInto(c, pIfExpr->alternative, dst, NULL_VALUE);
+    else
+        emit(c, R_MOVE, dst, constantOperand(c, NULL_VALUE));
+
+    patchJump(c, jumpToEnd);
+}
+
+static uint32_t compileFunction(struct RegCompiler* c, Expr* pExpr)
+{
+    FntExpr* fntExpr = pExpr->inner.fntExpr;
+    int firstParam   = fntExpr->selfSlot >= 0 ? 1 : 0;
+    int numParams    = (int)fntExpr->parameters->len;
+    int numLocals    = fntExpr->numLocals;
+    if (numLocals < firstParam + numParams)
+        numLocals = firstParam + numParams;
+
+    struct RegCompiler inner;
+    initCompiler(&inner, c->env, mkCompiledFunction(pExpr),
+                 (uint32_t)numLocals);
+    inner.failed = c->failed; // keep the first error
+
+    CompiledFunction* fn = inner.fn;
+    fn->numParams        = numParams;
+    fn->firstParam       = firstParam;
+
+    // Arguments arrive in consecutive registers. A parameter repeating an
+    // earlier name shares its register, and takes the later argument.
+    uint32_t arrived      = (uint32_t)firstParam;
+    struct ParamNode* tmp = fntExpr->parameters->tail->before;
+    while (tmp != fntExpr->parameters->head)
+    {
+        if ((uint32_t)tmp->value->slot != arrived)
+            emit(&inner, R_MOVE, (uint32_t)tmp->value->slot, arrived);
+        ++arrived;
+        tmp = tmp->before;
+    }
+
+    compileBody(&inner, fntExpr->body, NULL_VALUE);
+    allocateRegisters(&inner);
+
+    trackObject(c->env, &fn->object);
+    if (inner.failed)
+        c->failed = 1;
+
+    CompiledFunction* parent = c->fn;
+    if (parent->numFunctions == c->functionCapacity)
+    {
+        c->functionCapacity = c->functionCapacity ? c->functionCapacity << 1
+                                                  : 4;
+        parent->functions = realloc(parent->functions,
+                                    sizeof(CompiledFunction*)
+                                        * c->functionCapacity);
+    }
+    parent->functions[parent->numFunctions] = fn;
+
+    return (uint32_t)parent->numFunctions++;
+}
+
+static void compileCall(struct RegCompiler* c, CallExpr* pCallExpr,
+                        uint32_t dst)
+{
+    size_t argc = pCallExpr->arguments->len;
+    if (argc > 0xffff)
+    {
+        compileError(c, "too many arguments", "");
+        return;
+    }
+
+    uint32_t callee = compileOperand(c, pCallExpr->function);
+    uint32_t* args  = compileArgs(c, pCallExpr->arguments);
+
+    emit(c, pCallExpr->tail ? R_TAIL_CALL : R_CALL, dst,
+         REG_WORD1(callee, argc));
+    emitArgs(c, args, argc);
+}
+
+// An array or hash literal into dst, its elements or pairs counted by len
+static void compileList(struct RegCompiler* c, RegOpcode op, Arguments* list,
+                        size_t len, uint32_t dst)
+{
+    if (len > 0xffff)
+    {
+        compileError(c, "too many elements", "");
+        return;
+    }
+
+    uint32_t* args = compileArgs(c, list);
+    emit(c, op, dst, REG_WORD1(0, len));
+    emitArgs(c, args, list->len);
+}
+
+// Operands holding the values of the expressions, padded for emitArgs
+static uint32_t* compileArgs(struct RegCompiler* c, Arguments* list)
+{
+    uint32_t* args      = malloc(sizeof(uint32_t) * (list->len + 3));
+    size_t i            = 0;
+    struct ArgNode* tmp = list->tail->before;
+    while (tmp != list->head)
+    {
+        args[i++] = compileOperand(c, tmp->value);
+        tmp       = tmp->before;
+    }
+    args[i] = args[i + 1] = args[i + 2] = 0;
+
+    return args;
+}
+
+// The R_ARGS instructions of the count operands in args, which are freed
+static void emitArgs(struct RegCompiler* c, uint32_t* args, size_t count)
+{
+    for (size_t i = 0; i < count; i += 3)
+        emit(c, R_ARGS, args[i], REG_WORD1(args[i + 1], args[i + 2]));
+
+    free(args);
+}
+
+static int isRegister(OperandKind kind, uint32_t value)
+{
+    return (kind == OPERAND_REG || kind == OPERAND_RK)
+        && !(value & RK_CONSTANT);
+}
+
+// Replace every register operand of the code by what map returns for it,
+// given the position of the instruction reading or writing it. Arguments
+// count as read by the instruction they follow.
+static void mapRegisters(CompiledFunction* fn, RegisterMapFn map, void* ctx)
+{
+    uint32_t remainingArgs = 0;
+    size_t callPos         = 0;
+
+    for (size_t i = 0; i + 1 < fn->codeLen; i += REG_INSTR_WORDS)
+    {
+        uint32_t w0        = fn->code[i];
+        uint32_t w1        = fn->code[i + 1];
+        RegOpcode op       = REG_OP(w0);
+        RegOperands kinds  = regOperands(op);
+        uint32_t operand[] = {REG_A(w0), REG_B(w1), REG_C(w1)};
+        size_t pos         = i / REG_INSTR_WORDS;
+
+        int used[3] = {isRegister(kinds.a, operand[0]),
+                       isRegister(kinds.b, operand[1]),
+                       isRegister(kinds.c, operand[2])};
+        if (op == R_ARGS)
+        {
+            pos = callPos;
+            for (int j = 0; j < 3; ++j)
+                used[j] = used[j] && remainingArgs > (uint32_t)j;
+            remainingArgs = remainingArgs > 3 ? remainingArgs - 3 : 0;
+        }
+        else
+        {
+            callPos       = pos;
+            remainingArgs = regArgCount(op, operand[2]);
+        }
+
+        for (int j = 0; j < 3; ++j)
+        {
+            if (used[j])
+                operand[j] = map(operand[j], pos, ctx);
+        }
+
+        fn->code[i] = REG_WORD0(op, operand[0]);
+        if (kinds.b != OPERAND_WIDE)
+            fn->code[i + 1] = REG_WORD1(operand[1], operand[2]);
+    }
+}
+
+struct LiveRanges
+{
+    uint32_t numLocals;
+    struct Interval* intervals; // indexed by virtual register
+    uint32_t* assigned;         // frame register of each virtual register
+};
+
+static uint32_t extendInterval(uint32_t reg, size_t pos, void* ctx)
+{
+    struct LiveRanges* ranges = ctx;
+    if (reg < ranges->numLocals)
+        return reg;
+
+    struct Interval* interval = &ranges->intervals[reg - ranges->numLocals];
+    if (interval->start == SIZE_MAX)
+        interval->start = pos;
+    interval->end = pos;
+
+    return reg;
+}
+
+static uint32_t assignRegister(uint32_t reg, size_t pos, void* ctx)
+{
+    struct LiveRanges* ranges = ctx;
+    (void)pos;
+
+    if (reg < ranges->numLocals)
+        return reg;
+    return ranges->assigned[reg - ranges->numLocals];
+}
+
+static int byStart(const void* lhs, const void* rhs)
+{
+    const struct Interval* l = lhs;
+    const struct Interval* r = rhs;
+    if (l->start != r->start)
+        return l->start < r->start ? -1 : 1;
+    return l->vreg < r->vreg ? -1 : l->vreg > r->vreg;
+}
+
+// Linear scan: visit the live ranges by start, and give each the lowest
+// frame register whose previous range has ended. A range may start at the
+// instruction where another ends, since instructions read their operands
+// before writing their result.
+static void allocateRegisters(struct RegCompiler* c)
+{
+    uint32_t numTemps = c->numTemps;
+    c->fn->frameSize  = (int)c->numLocals;
+    if (numTemps == 0)
+        return;
+
+    struct LiveRanges ranges;
+    ranges.numLocals = c->numLocals;
+    ranges.intervals = malloc(sizeof(struct Interval) * numTemps);
+    ranges.assigned  = malloc(sizeof(uint32_t) * numTemps);
+    for (uint32_t i = 0; i < numTemps; ++i)
+    {
+        ranges.intervals[i] = (struct Interval){SIZE_MAX, 0, i};
+        ranges.assigned[i]  = c->numLocals;
+    }
+
+    mapRegisters(c->fn, extendInterval, &ranges);
+
+    struct Interval* sorted = malloc(sizeof(struct Interval) * numTemps);
+    for (uint32_t i = 0; i < numTemps; ++i)
+        sorted[i] = ranges.intervals[i];
+    qsort(sorted, numTemps, sizeof(struct Interval), byStart);
+
+    // End of the range each frame register holds
+    size_t* busyUntil = malloc(sizeof(size_t) * numTemps);
+    uint32_t numUsed  = 0;
+
+    for (uint32_t i = 0; i < numTemps && sorted[i].start != SIZE_MAX; ++i)
+    {
+        uint32_t reg = 0;
+        while (reg < numUsed && busyUntil[reg] > sorted[i].start)
+            ++reg;
+        if (reg == numUsed)
+            ++numUsed;
+
+        busyUntil[reg]                 = sorted[i].end;
+        ranges.assigned[sorted[i].vreg] = c->numLocals + reg;
+    }
+
+    mapRegisters(c->fn, assignRegister, &ranges);
+    c->fn->frameSize = (int)(c->numLocals + numUsed);
+
+    free(busyUntil);
+    free(sorted);
+    free(ranges.assigned);
+    free(ranges.intervals);
+}
+
+static void compileError(struct RegCompiler* c, const char* msg,
+                         const char* detail)
+{
+    if (!c->failed)
+        setEnvError(c->env, "%s%s", msg, detail);
+    c->failed = 1;
+}
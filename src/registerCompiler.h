@@ -0,0 +1,19 @@
+#ifndef _MONKEY_LANG_SRC_REGISTERCOMPILER_H_
+#define _MONKEY_LANG_SRC_REGISTERCOMPILER_H_
+
+#include "ast.h"
+#include "environment.h"
+#include "object.h"
+
+// Compile a resolved program to register code for runRegisters, under the
+// same contract as compileProgram.
+//
+// Each operator becomes one three-address instruction. Literals are read
+// from the constant pool and locals from their registers in place, so
+// neither needs an instruction of its own; `let` writes its value straight
+// into the register of the binding. Temporaries are first given virtual
+// registers, which linear-scan allocation then packs into as few frame
+// registers as their live ranges allow.
+CompiledFunction* compileRegisters(Program*, Environment*);
+
+#endif //_MONKEY_LANG_SRC_REGISTERCOMPILER_H_
@@ -0,0 +1,488 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "collection.h"
+#include "environment.h"
+#include "memo.h"
+#include "object.h"
+#include "registerCode.h"
+#include "registerVM.h"
+
+#define INITIAL_FRAME_CAPACITY 64
+
+struct Frame
+{
+    CompiledFunction* fn;
+    size_t closureRoot; // root of the closure being run, see pushRoot
+    const uint32_t* ip;
+    size_t base;  // index of register 0 in the stack, which may move
+    uint32_t dst; // register of the caller receiving the result
+    size_t memo;  // 1 + index of the key to remember the result under, or 0
+};
+
+/* Private Function Signatures */
+static void binaryError(Environment*, RegOpcode, Value, Value);
+static void growStack(Environment*, Value**, size_t);
+
+// Only false and null are falsy; see isTruthy
+#define IS_FALSY(v) \
+    ((v).type == VALUE_BOOL ? !(v).as.boolean : (v).type <= VALUE_NULL)
+
+// Frames keep their closure pinned, where a collection moving it updates it
+#define FRAME_CLOSURE ((Closure*)env->roots[frame->closureRoot])
+
+#define RK(x) ((x) & RK_CONSTANT ? constants[(x) & MAX_REGISTER] : base[(x)])
+
+// Operand i of the R_ARGS instructions starting at args
+#define ARG_OPERAND(args, i)                                         \
+    ((i) % 3 == 0 ? REG_A((args)[(i) / 3 * REG_INSTR_WORDS])         \
+     : (i) % 3 == 1 ? REG_B((args)[(i) / 3 * REG_INSTR_WORDS + 1])   \
+                    : REG_C((args)[(i) / 3 * REG_INSTR_WORDS + 1]))
+
+// Return result from the running frame to the register of its caller, or
+// from the program
+#define RETURN_RESULT()                                    \
+    do                                                     \
+    {                                                      \
+        if (frame->memo)                                   \
+            popMemoKey(env, frame->memo, result);          \
+                                                           \
+        uint32_t dst = frame->dst;                         \
+        if (--frameLen == 0)                               \
+            goto done;                                     \
+                                                           \
+        popRoot(env);                                      \
+        frame     = &frames[frameLen - 1];                 \
+        ip        = frame->ip;                             \
+        base      = env->stack + frame->base;              \
+        constants = frame->fn->constants;                  \
+        base[dst] = result;                                \
+    } while (0)
+
+Value runRegisters(CompiledFunction* program, Environment* env)
+{
+    freeString(env->error);
+    env->error = NULL;
+    reserveGlobals(env);
+
+    size_t frameCapacity = INITIAL_FRAME_CAPACITY;
+    struct Frame* frames = malloc(sizeof(struct Frame) * frameCapacity);
+    size_t frameLen      = 1;
+
+    Value* base = env->stack;
+    if ((size_t)program->frameSize > env->stackCapacity)
+        growStack(env, &base, (size_t)program->frameSize);
+
+    // Each frame pins its closure, and failed frames drop theirs here
+    size_t rootLen = env->rootLen;
+    pushRoot(env, &program->object);
+
+    struct Frame* frame = &frames[0];
+    frame->fn           = program;
+    frame->closureRoot  = 0;
+    frame->base         = 0;
+    frame->dst          = 0;
+    frame->memo         = 0;
+
+    // The state of the running frame is kept in locals
+    const uint32_t* ip = program->code;
+    Value* constants   = program->constants;
+    Value* globals     = env->globals;
+    Value result       = UNDEFINED_VALUE;
+
+    for (Value* slot = base; slot < base + program->frameSize; ++slot)
+        *slot = UNDEFINED_VALUE;
+
+    for (;;)
+    {
+        uint32_t w0 = ip[0];
+        uint32_t w1 = ip[1];
+        ip += REG_INSTR_WORDS;
+
+        switch (REG_OP(w0))
+        {
+        case R_MOVE:
+            base[REG_A(w0)] = RK(REG_B(w1));
+            break;
+
+#define INT_BINARY(op, expr)                                  \
+    case op:                                                   \
+    {                                                          \
+        Value left  = RK(REG_B(w1));                           \
+        Value right = RK(REG_C(w1));                           \
+        if (left.type != VALUE_INT || right.type != VALUE_INT) \
+        {                                                      \
+            binaryError(env, op, left, right);                 \
+            goto fail;                                         \
+        }                                                      \
+        base[REG_A(w0)] = expr;                                \
+        break;                                                 \
+    }
+
+            // Arithmetic wraps around on overflow, as in eval
+            INT_BINARY(R_SUB, INT_VALUE((int64_t)((uint64_t)left.as.integer
+                                                  - (uint64_t)right.as.integer)))
+            INT_BINARY(R_MUL, INT_VALUE((int64_t)((uint64_t)left.as.integer
+                                                  * (uint64_t)right.as.integer)))
+            INT_BINARY(R_LT, BOOL_VALUE(left.as.integer < right.as.integer))
+            INT_BINARY(R_GT, BOOL_VALUE(left.as.integer > right.as.integer))
+#undef INT_BINARY
+
+        case R_ADD:
+        {
+            Value left  = RK(REG_B(w1));
+            Value right = RK(REG_C(w1));
+            if (left.type == VALUE_INT && right.type == VALUE_INT)
+            {
+                base[REG_A(w0)] = INT_VALUE((int64_t)(
+                    (uint64_t)left.as.integer + (uint64_t)right.as.integer));
+                break;
+            }
+            if (left.type != VALUE_STRING || right.type != VALUE_STRING)
+            {
+                binaryError(env, R_ADD, left, right);
+                goto fail;
+            }
+
+            env->stackLen = frame->base + (size_t)frame->fn->frameSize;
+            Rope* rope    = newConcat(env, (Rope*)left.as.object,
+                                      (Rope*)right.as.object);
+            base[REG_A(w0)] = OBJECT_VALUE(VALUE_STRING, rope);
+            break;
+        }
+
+        case R_DIV:
+        {
+            Value left  = RK(REG_B(w1));
+            Value right = RK(REG_C(w1));
+            if (left.type != VALUE_INT || right.type != VALUE_INT)
+            {
+                binaryError(env, R_DIV, left, right);
+                goto fail;
+            }
+            if (right.as.integer == 0)
+            {
+                setEnvError(env, "division by zero");
+                goto fail;
+            }
+            base[REG_A(w0)] =
+                INT_VALUE(right.as.integer == -1
+                              ? (int64_t)(0 - (uint64_t)left.as.integer)
+                              : left.as.integer / right.as.integer);
+            break;
+        }
+
+        case R_EQ:
+            base[REG_A(w0)] =
+                BOOL_VALUE(valuesEqual(RK(REG_B(w1)), RK(REG_C(w1))));
+            break;
+
+        case R_NE:
+            base[REG_A(w0)] =
+                BOOL_VALUE(!valuesEqual(RK(REG_B(w1)), RK(REG_C(w1))));
+            break;
+
+        case R_MINUS:
+        {
+            Value right = RK(REG_B(w1));
+            if (right.type != VALUE_INT)
+            {
+                setEnvError(env, "unknown operator: -%s",
+                            valueTypeName(right.type));
+                goto fail;
+            }
+            base[REG_A(w0)] =
+                INT_VALUE((int64_t)(0 - (uint64_t)right.as.integer));
+            break;
+        }
+
+        case R_BANG:
+        {
+            Value right     = RK(REG_B(w1));
+            base[REG_A(w0)] = BOOL_VALUE(IS_FALSY(right));
+            break;
+        }
+
+        case R_JUMP:
+            ip = frame->fn->code + w1;
+            break;
+
+        case R_JUMP_FALSY:
+        {
+            Value condition = RK(REG_A(w0));
+            if (IS_FALSY(condition))
+                ip = frame->fn->code + w1;
+            break;
+        }
+
+        case R_GET_GLOBAL:
+        {
+            Value value = globals[w1];
+            if (value.type == VALUE_UNDEFINED)
+            {
+                const String* name = getGlobalName(env->resolver, (int)w1);
+                setEnvError(env, "identifier not found: %s",
+                            name ? getStr(name) : "?");
+                goto fail;
+            }
+            base[REG_A(w0)] = value;
+            break;
+        }
+
+        case R_SET_GLOBAL:
+            // Binding a global again forgets the results of pure calls
+            if (env->memo && globals[w1].type != VALUE_UNDEFINED)
+                forgetMemo(env);
+            globals[w1] = RK(REG_A(w0));
+            break;
+
+        case R_GET_CAPTURE:
+            base[REG_A(w0)] = FRAME_CLOSURE->captures[REG_B(w1)];
+            break;
+
+        case R_CLOSURE:
+        {
+            env->stackLen = frame->base + (size_t)frame->fn->frameSize;
+
+            CompiledFunction* fn = frame->fn->functions[REG_B(w1)];
+            Closure* closure     = newClosure(env, fn->function);
+            Capture* capture     = fn->function->inner.fntExpr->captures;
+
+            closure->compiled = fn;
+            for (int i = 0; i < closure->numCaptures; ++i)
+            {
+                if (capture[i].source == CAPTURE_LOCAL)
+                    closure->captures[i] = base[capture[i].index];
+                else
+                    closure->captures[i] =
+                        FRAME_CLOSURE->captures[capture[i].index];
+                WRITE_BARRIER(env, &closure->object, closure->captures[i]);
+            }
+
+            base[REG_A(w0)] = OBJECT_VALUE(VALUE_CLOSURE, closure);
+            break;
+        }
+
+        case R_CALL:
+        case R_TAIL_CALL:
+        {
+            uint32_t argc = REG_C(w1);
+            Value callee  = RK(REG_B(w1));
+
+            if (callee.type != VALUE_CLOSURE
+                || !((Closure*)callee.as.object)->compiled)
+            {
+                setEnvError(env, "not a function: %s",
+                            valueTypeName(callee.type));
+                goto fail;
+            }
+
+            Closure* closure     = (Closure*)callee.as.object;
+            CompiledFunction* fn = closure->compiled;
+            if (argc != (uint32_t)fn->numParams)
+            {
+                setEnvError(env, "wrong number of arguments: want=%d, got=%u",
+                            fn->numParams, argc);
+                goto fail;
+            }
+
+            if (frameLen == frameCapacity)
+            {
+                frameCapacity <<= 1;
+                frames = realloc(frames, sizeof(struct Frame) * frameCapacity);
+                frame  = &frames[frameLen - 1];
+            }
+
+            size_t newBase = frame->base + (size_t)frame->fn->frameSize;
+            size_t needed  = newBase + (size_t)fn->frameSize;
+            if (needed > env->stackCapacity)
+                growStack(env, &base, needed);
+
+            // Copy the arguments out of the R_ARGS words into the first
+            // registers of the callee
+            Value* calleeBase   = env->stack + newBase;
+            Value* param        = calleeBase + fn->firstParam;
+            const uint32_t* args = ip;
+            for (uint32_t i = 0; i < argc; i += 3)
+            {
+                uint32_t operand[] = {REG_A(args[0]), REG_B(args[1]),
+                                      REG_C(args[1])};
+                for (uint32_t j = 0; j < 3 && i + j < argc; ++j)
+                    *param++ = RK(operand[j]);
+                args += REG_INSTR_WORDS;
+            }
+            if (fn->firstParam)
+                calleeBase[0] = callee;
+
+            // Locals that are not parameters start undefined
+            for (Value* end = calleeBase + fn->frameSize; param < end;
+                 ++param)
+                *param = UNDEFINED_VALUE;
+
+            // Pure functions called before with the same arguments are not
+            // run again, and the others remember their result on return
+            size_t memo = 0;
+            if (env->memo)
+            {
+                MemoKey key;
+                Value remembered;
+                if (makeMemoKey(closure->function, calleeBase + fn->firstParam,
+                                argc, &key))
+                {
+                    if (lookUpMemo(env, &key, &remembered))
+                    {
+                        if (REG_OP(w0) == R_CALL)
+                        {
+                            base[REG_A(w0)] = remembered;
+                            ip              = args;
+                            break;
+                        }
+                        result = remembered;
+                        RETURN_RESULT();
+                        break;
+                    }
+                    if (REG_OP(w0) == R_CALL)
+                        memo = pushMemoKey(env, &key);
+                }
+            }
+
+            // In tail position the callee takes over the running frame and
+            // its root, and returns to where the frame would have
+            if (REG_OP(w0) == R_TAIL_CALL)
+            {
+                memmove(base, calleeBase,
+                        sizeof(Value) * (size_t)fn->frameSize);
+                env->roots[frame->closureRoot] = &closure->object;
+                frame->fn                      = fn;
+                ++env->tailCalls;
+
+                ip        = fn->code;
+                constants = fn->constants;
+                break;
+            }
+
+            size_t closureRoot = pushRoot(env, &closure->object);
+            frame->ip          = args;
+            frame              = &frames[frameLen++];
+            frame->fn          = fn;
+            frame->closureRoot = closureRoot;
+            frame->base        = newBase;
+            frame->dst         = REG_A(w0);
+            frame->memo        = memo;
+
+            ip        = fn->code;
+            base      = calleeBase;
+            constants = fn->constants;
+            break;
+        }
+
+        case R_ARRAY:
+        {
+            // The elements are read once the array is made, from where a
+            // collection finds them
+            env->stackLen = frame->base + (size_t)frame->fn->frameSize;
+
+            uint32_t len = REG_C(w1);
+            Array* array = newArray(env, len);
+            for (uint32_t i = 0; i < len; ++i)
+            {
+                Value value = RK(ARG_OPERAND(ip, i));
+                arrayPush(array, value);
+                WRITE_BARRIER(env, &array->object, value);
+            }
+
+            base[REG_A(w0)] = OBJECT_VALUE(VALUE_ARRAY, array);
+            ip += REG_INSTR_WORDS * ((len + 2) / 3);
+            break;
+        }
+
+        case R_HASH:
+        {
+            env->stackLen = frame->base + (size_t)frame->fn->frameSize;
+
+            uint32_t len = 2 * REG_C(w1);
+            Hash* hash   = newHash(env, REG_C(w1));
+            for (uint32_t i = 0; i < len; i += 2)
+            {
+                Value key = RK(ARG_OPERAND(ip, i));
+                if (!isHashable(key))
+                {
+                    setEnvError(env, UNUSABLE_HASH_KEY,
+                                valueTypeName(key.type));
+                    goto fail;
+                }
+
+                Value value = RK(ARG_OPERAND(ip, i + 1));
+                hashPut(hash, key, value);
+                WRITE_BARRIER(env, &hash->object, key);
+                WRITE_BARRIER(env, &hash->object, value);
+            }
+
+            base[REG_A(w0)] = OBJECT_VALUE(VALUE_HASH, hash);
+            ip += REG_INSTR_WORDS * ((len + 2) / 3);
+            break;
+        }
+
+        case R_INDEX:
+        {
+            Value element;
+            ValueType culprit;
+            const char* error =
+                indexValue(RK(REG_B(w1)), RK(REG_C(w1)), &element, &culprit);
+            if (error)
+            {
+                setEnvError(env, error, valueTypeName(culprit));
+                goto fail;
+            }
+            base[REG_A(w0)] = element;
+            break;
+        }
+
+        case R_RETURN:
+            result = RK(REG_A(w0));
+            RETURN_RESULT();
+            break;
+
+        default:
+            setEnvError(env, "unknown opcode: %d", (int)REG_OP(w0));
+            goto fail;
+        }
+    }
+
+fail:
+    result = UNDEFINED_VALUE;
+done:
+    free(frames);
+    env->rootLen  = rootLen;
+    env->stackLen = 0;
+    return result;
+}
+
+static void binaryError(Environment* env, RegOpcode op, Value left,
+                        Value right)
+{
+    static const char* const operators[REG_OPCODE_COUNT] = {
+        [R_ADD] = "+", [R_SUB] = "-", [R_MUL] = "*",
+        [R_DIV] = "/", [R_LT] = "<",  [R_GT] = ">",
+    };
+
+    setEnvError(env, "%s: %s %s %s",
+                left.type != right.type ? "type mismatch" : "unknown operator",
+                valueTypeName(left.type), operators[op],
+                valueTypeName(right.type));
+}
+
+// Make room for needed registers, moving base along with the stack. Frames
+// refer to the stack by index, so they stay valid.
+static void growStack(Environment* env, Value** base, size_t needed)
+{
+    size_t baseIndex = (size_t)(*base - env->stack);
+
+    while (env->stackCapacity < needed)
+        env->stackCapacity <<= 1;
+    env->stack = realloc(env->stack, sizeof(Value) * env->stackCapacity);
+
+    *base = env->stack + baseIndex;
+}
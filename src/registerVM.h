@@ -0,0 +1,15 @@
+#ifndef _MONKEY_LANG_SRC_REGISTERVM_H_
+#define _MONKEY_LANG_SRC_REGISTERVM_H_
+
+#include "environment.h"
+#include "object.h"
+
+// Run a program made by compileRegisters with the same env. Returns the
+// same value eval would, and on a runtime error leaves the same message for
+// getEvalError.
+//
+// Each frame is a window of frameSize registers on the frame stack of env;
+// a callee's window starts right after its caller's.
+Value runRegisters(CompiledFunction*, Environment*);
+
+#endif //_MONKEY_LANG_SRC_REGISTERVM_H_
@@ -4,28 +4,59 @@
 
 #include <linenoise.h>
 
+#include "asmEmitter.h"
+#include "capture.h"
+#include "cEmitter.h"
+#include "closureCompiler.h"
+#include "code.h"
+#include "compiler.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "hashCons.h"
+#include "jit.h"
 #include "lexer.h"
+#include "memo.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "purity.h"
+#include "registerCompiler.h"
+#include "registerVM.h"
 #include "repl.h"
+#include "resolver.h"
+#include "vm.h"
 
 #define PROMPT     ">> "
 #define FMT_RED    "\x1b[1m\x1b[91m"
 #define FMT_NORMAL "\x1b[0m"
 
-void printParserErrors(String**);
+void printErrors(String**, FILE*);
+static int runSource(Environment*, const char*, RunOptions*, FILE*);
+static void printGCStats(Environment*, int);
+static void printTailCalls(Environment*);
+static void printMemoStats(Environment*);
+static void printHashConsStats(HashConsStats);
 
-void startREPL(void)
+void startREPL(RunOptions* options)
 {
-    char* line        = NULL;
-    Lexer* l          = NULL;
-    Parser* p         = NULL;
-    Program* program  = NULL;
-    String* stringify = NULL;
+    char* line       = NULL;
+    Environment* env = mkEnvironment();
+    if (options->heapGrowth > 0)
+        setHeapGrowth(env, options->heapGrowth);
+    if (options->nurseryKB >= 0)
+        setNurserySize(env, (size_t)options->nurseryKB << 10);
+    if (options->markBudget > 0)
+        setMarkBudget(env, (size_t)options->markBudget);
+    if (options->memoEntries > 0)
+        setMemoCapacity(env, (size_t)options->memoEntries);
 
     linenoiseHistorySetMaxLen(15);
 
     fprintf(stdout, "[ Monkey Language REPL ]\n");
     fprintf(stdout, "Press Ctrl+D or type :q to quit the REPL\n");
+    fprintf(stdout, "Type :captures to toggle the closure capture dump\n");
+    fprintf(stdout, "Type :calls to toggle the call site cache dump (--vm)\n");
+    fprintf(stdout, "Type :gc to collect garbage and show its statistics\n");
     fprintf(stdout, "-------------------------------\n\n");
 
     while (1)
@@ -40,31 +71,222 @@ void startREPL(void)
 
         linenoiseHistoryAdd(line);
 
-        l       = mkLexer(line);
-        p       = mkParser(l);
-        program = parseProgram(p);
-
-        if (getErrLen(p) != 0)
+        if (strcmp(line, ":captures") == 0)
+            options->showCaptures = !options->showCaptures;
+        else if (strcmp(line, ":calls") == 0)
+            options->showCallCaches = !options->showCallCaches;
+        else if (strcmp(line, ":gc") == 0)
+            printGCStats(env, 1);
+        else
         {
-            printParserErrors(getErrors(p));
-            continue;
+            runSource(env, line, options, stdout);
+            if (options->showGCStats)
+                printGCStats(env, 0);
+            if (options->showTailCalls)
+                printTailCalls(env);
+            if (options->memoEntries > 0)
+                printMemoStats(env);
         }
 
-        stringify = stringifyProgram(program);
-        printf("%s\n", getStr(stringify));
+        linenoiseFree(line);
+    }
 
-        freeString(stringify);
+    freeEnvironment(env);
+}
+
+int runFile(const char* path, RunOptions* options)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+
+    String* source = mkString("");
+    char buffer[4096];
+    size_t len;
+    while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        appendNStr(source, buffer, len);
+    fclose(file);
+
+    Environment* env = mkEnvironment();
+    if (options->heapGrowth > 0)
+        setHeapGrowth(env, options->heapGrowth);
+    if (options->nurseryKB >= 0)
+        setNurserySize(env, (size_t)options->nurseryKB << 10);
+    if (options->markBudget > 0)
+        setMarkBudget(env, (size_t)options->markBudget);
+    if (options->memoEntries > 0)
+        setMemoCapacity(env, (size_t)options->memoEntries);
+    int status = runSource(env, getStr(source), options, stderr);
+    if (options->showGCStats)
+        printGCStats(env, 0);
+    if (options->showTailCalls)
+        printTailCalls(env);
+    if (options->memoEntries > 0)
+        printMemoStats(env);
+
+    freeEnvironment(env);
+    freeString(source);
+    return status;
+}
+
+// Parse, check and run source in env, printing its value to stdout and
+// errors to errOut. Returns 0, or 1 on error.
+static int runSource(Environment* env, const char* source,
+                     RunOptions* options, FILE* errOut)
+{
+    Lexer* l          = mkLexer(source);
+    Parser* p         = mkParser(l);
+    Program* program  = parseProgram(p);
+    String* stringify = NULL;
+    Value result      = UNDEFINED_VALUE;
+
+    if (getErrLen(p) != 0)
+    {
+        printErrors(getErrors(p), errOut);
         freeProgram(program);
         freeParser(p);
-        linenoiseFree(line);
+        return 1;
+    }
+
+    foldConstants(program);
+    simplifyProgram(program);
+
+    if (resolveProgram(getResolver(env), program) != 0)
+    {
+        printErrors(getResolverErrors(getResolver(env)), errOut);
+        freeProgram(program);
+        freeParser(p);
+        return 1;
+    }
+
+    analyzeCaptures(program);
+    analyzePurity(program);
+    if (options->showCaptures)
+    {
+        stringify = dumpCaptures(program);
+        printf("%s", getStr(stringify));
+        freeString(stringify);
     }
+    // Last, as no pass may change a node once it is shared
+    if (options->hashCons)
+        printHashConsStats(hashConsProgram(program));
+
+    if (options->emitC)
+    {
+        stringify = emitC(program);
+        printf("%s", getStr(stringify));
+        freeString(stringify);
+    }
+    else if (options->emitAsm)
+    {
+        stringify = emitAsm(program);
+        printf("%s", getStr(stringify));
+        freeString(stringify);
+    }
+    else if (options->engine == ENGINE_VM)
+    {
+        CompiledFunction* compiled = compileProgram(program, env);
+        if (compiled && options->superinstructions)
+            fuseInstructions(compiled);
+        if (compiled)
+        {
+            setJitThreshold(env, options->jit ? DEFAULT_JIT_THRESHOLD : 0);
+            result = runBytecode(compiled, env);
+            if (options->showCallCaches)
+            {
+                stringify = dumpCallCaches(compiled);
+                printf("%s", getStr(stringify));
+                freeString(stringify);
+            }
+            freeObject(&compiled->object);
+        }
+    }
+    else if (options->engine == ENGINE_REGISTERS)
+    {
+        CompiledFunction* compiled = compileRegisters(program, env);
+        if (compiled)
+        {
+            result = runRegisters(compiled, env);
+            freeObject(&compiled->object);
+        }
+    }
+    else if (options->engine == ENGINE_CLOSURES)
+    {
+        NodeTree* compiled = compileClosures(program, env);
+        result             = runClosures(compiled, env);
+        freeObject(&compiled->object);
+    }
+    else
+    {
+        result = eval(program, env);
+    }
+
+    freeProgram(program);
+    freeParser(p);
+
+    String* error = getEvalError(env);
+    if (error)
+    {
+        fprintf(errOut, FMT_RED "[ERROR]: %s" FMT_NORMAL "\n\n",
+                getStr(error));
+        freeString(error);
+        return 1;
+    }
+
+    if (result.type != VALUE_UNDEFINED)
+    {
+        stringify = inspectValue(result);
+        printf("%s\n", getStr(stringify));
+        freeString(stringify);
+    }
+
+    return 0;
+}
+
+// Statistics of the collector of env to stderr, after a collection of
+// their own if collect is set
+static void printGCStats(Environment* env, int collect)
+{
+    if (collect)
+        collectGarbage(env);
+
+    String* stats = dumpGCStats(env);
+    fprintf(stderr, "%s", getStr(stats));
+    freeString(stats);
+}
+
+// Calls in tail position that ran in the frame of their caller, so far
+static void printTailCalls(Environment* env)
+{
+    fprintf(stderr, "tail calls: %zu eliminated\n", getTailCallCount(env));
+}
+
+// Hit rate of the memo table of env, so far
+static void printMemoStats(Environment* env)
+{
+    String* stats = dumpMemoStats(env);
+    fprintf(stderr, "%s", getStr(stats));
+    freeString(stats);
+}
+
+// Expression nodes of a program and their bytes, before and after sharing
+static void printHashConsStats(HashConsStats stats)
+{
+    fprintf(stderr,
+            "hash-consing: %zu -> %zu expression nodes, %zu -> %zu bytes\n",
+            stats.exprNodes, stats.uniqueNodes, stats.exprBytes,
+            stats.uniqueBytes);
 }
 
-void printParserErrors(String** errors)
+void printErrors(String** errors, FILE* out)
 {
     for (int i = 0; errors[i]; ++i)
     {
-        printf(FMT_RED "[ERROR]: %s" FMT_NORMAL "\n\n", getStr(errors[i]));
+        fprintf(out, FMT_RED "[ERROR]: %s" FMT_NORMAL "\n\n",
+                getStr(errors[i]));
         freeString(errors[i]);
     }
     free(errors);
@@ -1,6 +1,36 @@
 #ifndef _MONKEY_LANG_SRC_REPL_H_
 #define _MONKEY_LANG_SRC_REPL_H_
 
-void startREPL(void);
+typedef enum
+{
+    ENGINE_EVAL = 0,  // tree-walking evaluator
+    ENGINE_VM,        // bytecode compiler and stack VM
+    ENGINE_REGISTERS, // register compiler and register VM
+    ENGINE_CLOSURES,  // tree of nodes with specialized handlers
+} Engine;
+
+typedef struct
+{
+    Engine engine;
+    int superinstructions; // fuse instruction sequences for ENGINE_VM
+    int showCaptures;
+    int showCallCaches; // dump the call site caches of ENGINE_VM after a run
+    int jit;            // let ENGINE_VM compile hot functions to native code
+    int emitC;          // print the program translated to C instead of running it
+    int emitAsm;        // print the program as x86-64 assembly instead of running it
+    int showGCStats;    // print the collector statistics after a run
+    int showTailCalls;  // print the number of tail calls eliminated
+    double heapGrowth;  // of the collector, see gc.h, or 0 for the default
+    long nurseryKB;     // size of the nursery, or -1 for the default
+    long markBudget;    // objects marked per slice, or 0 to mark at once
+    long memoEntries;   // results of pure calls remembered, or 0 for none
+    int hashCons;       // share equal subtrees and print the nodes saved
+} RunOptions;
+
+void startREPL(RunOptions*);
+
+// Run a source file and print the value of its last statement. Returns 0,
+// or 1 if the file could not be read, parsed or run.
+int runFile(const char* path, RunOptions*);
 
 #endif //_MONKEY_LANG_SRC_REPL_H_
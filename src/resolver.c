@@ -0,0 +1,502 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "dynString.h"
+#include "resolver.h"
+#include "walker.h"
+
+struct Symbol
+{
+    String* name;
+    int slot;
+};
+
+// A scope is an open-addressing table from names to slots
+struct Scope
+{
+    struct Symbol* symbols;
+    size_t capacity;
+    size_t len;
+    int fnDepth; // 0 for global scopes, n inside n function literals
+};
+
+struct Resolver
+{
+    struct Scope* scopes; // scopes[0] is the global scope
+    size_t scopeLen;
+    size_t scopeCapacity;
+
+    int* slotCounts; // number of slots used by each enclosing function
+    FntExpr** functions;
+    int fnDepth;
+    int fnCapacity;
+
+    struct Scope hoisted; // top-level names of the program being resolved
+    Program* program;
+    FntExpr* pendingSelf; // function literal bound by the current `let`
+    const String* pendingName;
+
+    String** errors;
+    int errLen;
+};
+
+/* Private Function Signatures */
+static void initScope(struct Scope*, int);
+static void clearScope(struct Scope*);
+static struct Symbol* findSymbol(const struct Scope*, const char*);
+static int defineSymbol(struct Scope*, const String*, int*);
+static void pushScope(Resolver*);
+static void popScope(Resolver*);
+static void enterFunction(Resolver*, FntExpr*);
+static void leaveFunction(Resolver*);
+static void defineName(Resolver*, IdentExpr*);
+static void resolveIdent(Resolver*, IdentExpr*);
+static void undefinedIdentError(Resolver*, const char*);
+static void markTailBlock(BlockStmt*, int);
+static void markTailExpr(Expr*);
+static WalkResult resolvePre(AstNode, void*);
+static WalkResult resolvePost(AstNode, void*);
+
+Resolver* mkResolver(void)
+{
+    Resolver* output = malloc(sizeof(Resolver));
+
+    output->scopeCapacity = 8;
+    output->scopeLen      = 1;
+    output->scopes        = malloc(sizeof(struct Scope) * output->scopeCapacity);
+    initScope(&output->scopes[0], 0);
+
+    output->fnCapacity    = 8;
+    output->fnDepth       = 0;
+    output->slotCounts    = malloc(sizeof(int) * (size_t)output->fnCapacity);
+    output->functions     = malloc(sizeof(FntExpr*) * (size_t)output->fnCapacity);
+    output->slotCounts[0] = 0;
+    output->functions[0]  = NULL;
+
+    initScope(&output->hoisted, 0);
+    output->program     = NULL;
+    output->pendingSelf = NULL;
+    output->pendingName = NULL;
+
+    output->errors = NULL;
+    output->errLen = 0;
+
+    return output;
+}
+
+void freeResolver(Resolver* r)
+{
+    if (!r)
+        return;
+
+    for (size_t i = 0; i < r->scopeLen; ++i)
+        clearScope(&r->scopes[i]);
+    free(r->scopes);
+    free(r->slotCounts);
+    free(r->functions);
+    clearScope(&r->hoisted);
+
+    if (r->errors)
+    {
+        for (int i = 0; i < r->errLen; ++i)
+            freeString(r->errors[i]);
+        free(r->errors);
+    }
+
+    free(r);
+}
+
+int resolveProgram(Resolver* r, Program* pProg)
+{
+    static const Visitor visitor = {resolvePre, NULL, resolvePost};
+
+    if (!r || !pProg)
+        return 0;
+
+    int errLen = r->errLen;
+
+    // Function bodies may call top-level functions defined further down
+    int hoistedCount     = 0;
+    struct ProgNode* tmp = pProg->tail->before;
+    while (tmp != pProg->head)
+    {
+        if (tmp->value->type == STMT_LET && tmp->value->inner.letStmt)
+            defineSymbol(&r->hoisted, tmp->value->inner.letStmt->name->value,
+                         &hoistedCount);
+        tmp = tmp->before;
+    }
+
+    r->program = pProg;
+    walkProgram(pProg, &visitor, r);
+    r->program = NULL;
+
+    clearScope(&r->hoisted);
+
+    return r->errLen - errLen;
+}
+
+String** getResolverErrors(Resolver* r)
+{
+    String** output = r->errors;
+    r->errors       = NULL;
+    r->errLen       = 0;
+    return output;
+}
+
+int getResolverErrLen(Resolver* r) { return r->errLen; }
+
+int getGlobalCount(const Resolver* r) { return r->slotCounts[0]; }
+
+const String* getGlobalName(const Resolver* r, int slot)
+{
+    const struct Scope* global = &r->scopes[0];
+    for (size_t i = 0; i < global->capacity; ++i)
+    {
+        if (global->symbols[i].name && global->symbols[i].slot == slot)
+            return global->symbols[i].name;
+    }
+    return NULL;
+}
+
+static WalkResult resolvePre(AstNode node, void* ctx)
+{
+    Resolver* r = ctx;
+
+    switch (node.kind)
+    {
+    case NODE_BLOCK:
+        if (node.as.block != (BlockStmt*)r->program)
+            pushScope(r);
+        break;
+
+    case NODE_STMT:
+        if (node.as.stmt->type == STMT_LET && node.as.stmt->inner.letStmt)
+        {
+            LetStmt* letStmt = node.as.stmt->inner.letStmt;
+            if (letStmt->value && letStmt->value->type == EXPR_FUNCTION)
+            {
+                r->pendingSelf = letStmt->value->inner.fntExpr;
+                r->pendingName = letStmt->name->value;
+            }
+        }
+        break;
+
+    case NODE_EXPR:
+        if (!node.as.expr->inner.checkIsNull)
+            break;
+
+        if (node.as.expr->type == EXPR_IDENT)
+            resolveIdent(r, node.as.expr->inner.identExpr);
+        else if (node.as.expr->type == EXPR_FUNCTION)
+            enterFunction(r, node.as.expr->inner.fntExpr);
+        break;
+
+    default:
+        break;
+    }
+
+    return WALK_CONTINUE;
+}
+
+static WalkResult resolvePost(AstNode node, void* ctx)
+{
+    Resolver* r = ctx;
+
+    switch (node.kind)
+    {
+    case NODE_BLOCK:
+        if (node.as.block != (BlockStmt*)r->program)
+            popScope(r);
+        break;
+
+    case NODE_STMT:
+        // The name is bound only after its value, so `let x = x + 1` reads
+        // the outer x.
+        if (node.as.stmt->type == STMT_LET && node.as.stmt->inner.letStmt)
+            defineName(r, node.as.stmt->inner.letStmt->name);
+        break;
+
+    case NODE_EXPR:
+        if (node.as.expr->inner.checkIsNull
+            && node.as.expr->type == EXPR_FUNCTION)
+            leaveFunction(r);
+        break;
+
+    default:
+        break;
+    }
+
+    return WALK_CONTINUE;
+}
+
+static void enterFunction(Resolver* r, FntExpr* pFntExpr)
+{
+    if (r->fnDepth + 1 >= r->fnCapacity)
+    {
+        r->fnCapacity <<= 1;
+        r->slotCounts = realloc(r->slotCounts,
+                                sizeof(int) * (size_t)r->fnCapacity);
+        r->functions  = realloc(r->functions,
+                                sizeof(FntExpr*) * (size_t)r->fnCapacity);
+    }
+
+    ++r->fnDepth;
+    r->slotCounts[r->fnDepth] = 0;
+    r->functions[r->fnDepth]  = pFntExpr;
+
+    // The function's own name lives in a scope outside of its parameters,
+    // so that a parameter of the same name shadows it.
+    pushScope(r);
+    pFntExpr->selfSlot = -1;
+    if (r->pendingSelf == pFntExpr)
+    {
+        pFntExpr->selfSlot = defineSymbol(&r->scopes[r->scopeLen - 1],
+                                          r->pendingName,
+                                          &r->slotCounts[r->fnDepth]);
+        r->pendingSelf = NULL;
+        r->pendingName = NULL;
+    }
+
+    if (pFntExpr->body)
+        markTailBlock(pFntExpr->body, 1);
+
+    pushScope(r);
+    if (!pFntExpr->parameters)
+        return;
+
+    struct ParamNode* tmp = pFntExpr->parameters->tail->before;
+    while (tmp != pFntExpr->parameters->head)
+    {
+        defineName(r, tmp->value);
+        tmp = tmp->before;
+    }
+}
+
+static void leaveFunction(Resolver* r)
+{
+    popScope(r);
+    popScope(r);
+
+    r->functions[r->fnDepth]->numLocals = r->slotCounts[r->fnDepth];
+    --r->fnDepth;
+}
+
+// Mark the calls of a function body whose value the function returns: the
+// value of a `return`, and the last expression of the body, where an if
+// passes the position on to its branches. Set last for a block whose value
+// is the function's; returns are found in any block of the body that runs
+// as a statement.
+static void markTailBlock(BlockStmt* pBlockStmt, int last)
+{
+    if (!pBlockStmt)
+        return;
+
+    struct ProgNode* tmp = pBlockStmt->tail->before;
+    while (tmp != pBlockStmt->head)
+    {
+        Stmt* stmt   = tmp->value;
+        int lastStmt = last && tmp->before == pBlockStmt->head;
+        tmp          = tmp->before;
+        if (!stmt->inner.checkIsNull)
+            continue;
+
+        if (stmt->type == STMT_RETURN)
+        {
+            markTailExpr(stmt->inner.returnStmt->returnValue);
+        }
+        else if (stmt->type == STMT_BLOCK)
+        {
+            markTailBlock(stmt->inner.blockStmt, lastStmt);
+        }
+        else if (stmt->type == STMT_EXPRESSION)
+        {
+            Expr* expr = stmt->inner.exprStmt->expression;
+            if (lastStmt)
+                markTailExpr(expr);
+            else if (expr && expr->inner.checkIsNull
+                     && expr->type == EXPR_IF)
+            {
+                markTailBlock(expr->inner.ifExpr->consequence, 0);
+                markTailBlock(expr->inner.ifExpr->alternative, 0);
+            }
+        }
+    }
+}
+
+static void markTailExpr(Expr* pExpr)
+{
+    if (!pExpr || !pExpr->inner.checkIsNull)
+        return;
+
+    if (pExpr->type == EXPR_CALL)
+    {
+        pExpr->inner.callExpr->tail = 1;
+    }
+    else if (pExpr->type == EXPR_IF)
+    {
+        markTailBlock(pExpr->inner.ifExpr->consequence, 1);
+        markTailBlock(pExpr->inner.ifExpr->alternative, 1);
+    }
+}
+
+static void defineName(Resolver* r, IdentExpr* pIdentExpr)
+{
+    pIdentExpr->slot  = defineSymbol(&r->scopes[r->scopeLen - 1],
+                                     pIdentExpr->value,
+                                     &r->slotCounts[r->fnDepth]);
+    pIdentExpr->kind  = r->fnDepth == 0 ? RESOLVE_GLOBAL : RESOLVE_LOCAL;
+    pIdentExpr->depth = 0;
+}
+
+static void resolveIdent(Resolver* r, IdentExpr* pIdentExpr)
+{
+    const char* name = getStr(pIdentExpr->value);
+
+    for (size_t i = r->scopeLen; i-- > 0;)
+    {
+        struct Symbol* symbol = findSymbol(&r->scopes[i], name);
+        if (!symbol)
+            continue;
+
+        int fnDepth     = r->scopes[i].fnDepth;
+        pIdentExpr->slot = symbol->slot;
+
+        if (fnDepth == 0)
+        {
+            pIdentExpr->kind  = RESOLVE_GLOBAL;
+            pIdentExpr->depth = 0;
+        }
+        else if (fnDepth == r->fnDepth)
+        {
+            pIdentExpr->kind  = RESOLVE_LOCAL;
+            pIdentExpr->depth = 0;
+        }
+        else
+        {
+            pIdentExpr->kind  = RESOLVE_FREE;
+            pIdentExpr->depth = r->fnDepth - fnDepth;
+        }
+        return;
+    }
+
+    // A function body runs later, once the rest of the program has run
+    if (r->fnDepth > 0 && findSymbol(&r->hoisted, name))
+    {
+        pIdentExpr->kind  = RESOLVE_GLOBAL;
+        pIdentExpr->depth = 0;
+        pIdentExpr->slot  = defineSymbol(&r->scopes[0], pIdentExpr->value,
+                                         &r->slotCounts[0]);
+        return;
+    }
+
+    pIdentExpr->kind  = RESOLVE_UNRESOLVED;
+    pIdentExpr->depth = 0;
+    pIdentExpr->slot  = 0;
+    undefinedIdentError(r, name);
+}
+
+static void pushScope(Resolver* r)
+{
+    if (r->scopeLen == r->scopeCapacity)
+    {
+        r->scopeCapacity <<= 1;
+        r->scopes = realloc(r->scopes,
+                            sizeof(struct Scope) * r->scopeCapacity);
+    }
+
+    initScope(&r->scopes[r->scopeLen++], r->fnDepth);
+}
+
+static void popScope(Resolver* r) { clearScope(&r->scopes[--r->scopeLen]); }
+
+static void initScope(struct Scope* scope, int fnDepth)
+{
+    scope->symbols  = NULL;
+    scope->capacity = 0;
+    scope->len      = 0;
+    scope->fnDepth  = fnDepth;
+}
+
+static void clearScope(struct Scope* scope)
+{
+    for (size_t i = 0; i < scope->capacity; ++i)
+        freeString(scope->symbols[i].name);
+    free(scope->symbols);
+    initScope(scope, scope->fnDepth);
+}
+
+static struct Symbol* findSymbol(const struct Scope* scope, const char* name)
+{
+    if (scope->capacity == 0)
+        return NULL;
+
+    size_t i = (size_t)hashChars(name, strlen(name)) & (scope->capacity - 1);
+    while (scope->symbols[i].name)
+    {
+        if (cmpStringStr(scope->symbols[i].name, name) == 0)
+            return &scope->symbols[i];
+        i = (i + 1) & (scope->capacity - 1);
+    }
+
+    return NULL;
+}
+
+// Bind name in scope to the next slot counted by slotCount, and return the
+// slot. A name already bound in the same scope keeps its slot.
+static int defineSymbol(struct Scope* scope, const String* name,
+                        int* slotCount)
+{
+    struct Symbol* symbol = findSymbol(scope, getStr(name));
+    if (symbol)
+        return symbol->slot;
+
+    if ((scope->len + 1) * 2 > scope->capacity)
+    {
+        size_t oldCapacity = scope->capacity;
+        struct Symbol* old = scope->symbols;
+
+        scope->capacity = oldCapacity ? oldCapacity << 1 : 8;
+        scope->symbols  = calloc(scope->capacity, sizeof(struct Symbol));
+
+        for (size_t i = 0; i < oldCapacity; ++i)
+        {
+            if (!old[i].name)
+                continue;
+
+            size_t j = (size_t)hashString(old[i].name) & (scope->capacity - 1);
+            while (scope->symbols[j].name)
+                j = (j + 1) & (scope->capacity - 1);
+            scope->symbols[j] = old[i];
+        }
+        free(old);
+    }
+
+    size_t i = (size_t)hashString(name) & (scope->capacity - 1);
+    while (scope->symbols[i].name)
+        i = (i + 1) & (scope->capacity - 1);
+
+    scope->symbols[i].name = mkString(getStr(name));
+    scope->symbols[i].slot = (*slotCount)++;
+    ++scope->len;
+
+    return scope->symbols[i].slot;
+}
+
+static void undefinedIdentError(Resolver* r, const char* name)
+{
+    if (r->errLen >= MAXIMUM_RESOLVE_ERR_MSGS)
+    {
+        fprintf(stderr, "too many resolve error occurs.");
+        return;
+    }
+
+    String* msg = mkString("identifier not found: ");
+    appendStr(msg, name);
+
+    if (!r->errors)
+        r->errors = malloc(sizeof(String*) * (MAXIMUM_RESOLVE_ERR_MSGS + 1));
+    r->errors[r->errLen++] = msg;
+    r->errors[r->errLen]   = NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef _MONKEY_LANG_SRC_RESOLVER_H_
+#define _MONKEY_LANG_SRC_RESOLVER_H_
+
+#include <stddef.h>
+
+#include "ast.h"
+
+#define MAXIMUM_RESOLVE_ERR_MSGS 20
+
+// The resolver maps every identifier to the slot that holds its value, so
+// that no name has to be looked up while the program runs.
+//
+// Scopes are lexical: a function literal opens a frame for its parameters
+// and bindings, and every block opens a scope whose bindings are only
+// visible inside it. Bindings of the top-level program, and of blocks
+// outside any function, live in the global table. A `let` is visible from
+// the next statement on; binding a name again in the same scope reuses its
+// slot. A function literal bound by `let` sees its own name, so it can
+// recurse. Function bodies may refer to top-level bindings defined later in
+// the same program, or never defined at all: until its `let` has run, a
+// global slot holds an undefined value, and every engine checks for it on
+// each read and raises "identifier not found" with getGlobalName.
+//
+// Resolver keeps the global scope between calls, so a REPL resolves every
+// line with the same Resolver.
+typedef struct Resolver Resolver;
+
+Resolver* mkResolver(void);
+void freeResolver(Resolver*);
+
+// Annotate the identifiers and function literals of the program. Names
+// that cannot be resolved are reported and left as RESOLVE_UNRESOLVED.
+// Returns the number of errors.
+int resolveProgram(Resolver*, Program*);
+
+String** getResolverErrors(Resolver*);
+int getResolverErrLen(Resolver*);
+
+// Number of slots the global table needs so far
+int getGlobalCount(const Resolver*);
+// Name bound to a global slot, or NULL
+const String* getGlobalName(const Resolver*, int slot);
+
+#endif //_MONKEY_LANG_SRC_RESOLVER_H_
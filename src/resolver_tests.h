@@ -0,0 +1,236 @@
+#define MAIN_TEST_NAME TestResolver
+
+#include "parser.h"
+#include "resolver.h"
+#include "testing.h"
+#include "walker.h"
+
+/* Function Signatures */
+WalkResult dumpIdent(AstNode, void*);
+String* dumpResolution(Program*);
+WalkResult dumpCall(AstNode, void*);
+
+// Uses as G<slot>, L<slot>, F<depth>:<slot> or U, and function literals as
+// fn<numLocals>
+WalkResult dumpIdent(AstNode node, void* ctx)
+{
+    char buffer[32];
+
+    if (node.kind != NODE_EXPR)
+        return WALK_CONTINUE;
+
+    if (node.as.expr->type == EXPR_FUNCTION)
+    {
+        sprintf(buffer, "fn%d ", node.as.expr->inner.fntExpr->numLocals);
+        appendStr(ctx, buffer);
+    }
+    if (node.as.expr->type != EXPR_IDENT)
+        return WALK_CONTINUE;
+
+    IdentExpr* ident = node.as.expr->inner.identExpr;
+    switch (ident->kind)
+    {
+    case RESOLVE_GLOBAL:
+        sprintf(buffer, "G%d ", ident->slot);
+        break;
+    case RESOLVE_LOCAL:
+        sprintf(buffer, "L%d ", ident->slot);
+        break;
+    case RESOLVE_FREE:
+        sprintf(buffer, "F%d:%d ", ident->depth, ident->slot);
+        break;
+    default:
+        sprintf(buffer, "U ");
+        break;
+    }
+    appendStr(ctx, buffer);
+
+    return WALK_CONTINUE;
+}
+
+String* dumpResolution(Program* program)
+{
+    // Function literals are dumped after their body, once numLocals is set
+    Visitor visitor = {NULL, NULL, dumpIdent};
+    String* output = mkString("");
+    walkProgram(program, &visitor, output);
+    return output;
+}
+
+// Calls, after their arguments, as T in tail position and C otherwise
+WalkResult dumpCall(AstNode node, void* ctx)
+{
+    if (node.kind == NODE_EXPR && node.as.expr->type == EXPR_CALL)
+        appendStr(ctx, node.as.expr->inner.callExpr->tail ? "T" : "C");
+    return WALK_CONTINUE;
+}
+
+TEST(ResolveIdentifiers)
+{
+    int testStatus = TEST_SUCESSED;
+    struct
+    {
+        const char* input;
+        const char* expected;
+        int expectedErrors;
+    } tests[] = {
+        {"let a = 1; let b = a; fn(x, y) { let z = x; y + z + a + b }",
+         "G0 L0 L1 L2 G0 G1 fn3 ", 0},
+        {"let f = fn(n) { f(n) }", "L0 L1 fn2 ", 0},
+        {"fn(a) { fn(b) { a + b } }", "F1:0 L0 fn1 fn1 ", 0},
+        {"fn() { let x = 1; if (x) { let x = 2; x }; x }", "L0 L1 L0 fn2 ", 0},
+        {"fn(x) { let x = x + 1; x }", "L0 L1 fn2 ", 0},
+        {"let f = fn() { g() }; let g = fn() { 1 }; f()",
+         "G0 fn1 fn1 G1 ", 0},
+        {"let f = fn(f) { f }", "L1 fn2 ", 0},
+        {"if (true) { let a = 1; a }; let b = 2; b", "G0 G1 ", 0},
+        {"x; let y = fn() { z };", "U U fn1 ", 2},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        Program* program = parseForTest(tests[i].input, NULL);
+        if (!program)
+            return TEST_FAILED;
+
+        Resolver* r = mkResolver();
+        int errLen = resolveProgram(r, program);
+        String* got = dumpResolution(program);
+
+        if (cmpStringStr(got, tests[i].expected) != 0)
+        {
+            PRINT_ERR("`%s`: expected `%s`, got = `%s`", tests[i].input,
+                      tests[i].expected, getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        if (errLen != tests[i].expectedErrors)
+        {
+            PRINT_ERR("`%s`: expected %d errors, got = %d", tests[i].input,
+                      tests[i].expectedErrors, errLen);
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeResolver(r);
+        freeProgram(program);
+    }
+
+    return testStatus;
+}
+
+TEST(ReportUndefinedNames)
+{
+    int testStatus = TEST_SUCESSED;
+    Program* program = parseForTest("let a = b; fn() { c };", NULL);
+    if (!program)
+        return TEST_FAILED;
+
+    Resolver* r = mkResolver();
+    resolveProgram(r, program);
+    String** errors = getResolverErrors(r);
+
+    if (!errors || cmpStringStr(errors[0], "identifier not found: b") != 0
+        || cmpStringStr(errors[1], "identifier not found: c") != 0
+        || errors[2])
+    {
+        PRINT_ERR("unexpected resolve errors%s", "");
+        testStatus = TEST_FAILED;
+    }
+
+    for (int i = 0; errors && errors[i]; ++i)
+        freeString(errors[i]);
+    free(errors);
+    freeResolver(r);
+    freeProgram(program);
+    return testStatus;
+}
+
+TEST(KeepGlobalsAcrossPrograms)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {"let a = 1; let b = 2;", "let c = b; a + c",
+                            "let a = 3; a"};
+    const char* expected[] = {"", "G1 G0 G2 ", "G0 "};
+
+    Resolver* r = mkResolver();
+    for (size_t i = 0; i < 3; ++i)
+    {
+        Program* program = parseForTest(inputs[i], NULL);
+        if (!program)
+        {
+            freeResolver(r);
+            return TEST_FAILED;
+        }
+
+        resolveProgram(r, program);
+        String* got = dumpResolution(program);
+        if (cmpStringStr(got, expected[i]) != 0)
+        {
+            PRINT_ERR("`%s`: expected `%s`, got = `%s`", inputs[i],
+                      expected[i], getStr(got));
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeProgram(program);
+    }
+
+    if (getGlobalCount(r) != 3)
+    {
+        PRINT_ERR("expected 3 globals, got = %d", getGlobalCount(r));
+        testStatus = TEST_FAILED;
+    }
+
+    freeResolver(r);
+    return testStatus;
+}
+
+TEST(MarkTailCalls)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let f = fn(n) { f(n) }; f(1)",
+        "fn(n) { if (n) { return f(n); }; g(n) + 1; h(g(n)) }",
+        "fn(n) { if (n) { f(n) } else { g(n) + 1 } }",
+        "fn(n) { let x = f(n); x }",
+        "fn(n) { if (n) { f(n) }; g(n) }",
+        "fn(n) { fn() { f(n) }; return if (n) { g(n) } else { h(n) }; }",
+    };
+    const char* expected[] = {"TC", "TCCT", "TC", "C", "CT", "TTT"};
+
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        Program* program = parseForTest(inputs[i], NULL);
+        if (!program)
+            return TEST_FAILED;
+
+        Resolver* r     = mkResolver();
+        Visitor visitor = {NULL, NULL, dumpCall};
+        String* got     = mkString("");
+        resolveProgram(r, program);
+        walkProgram(program, &visitor, got);
+
+        if (cmpStringStr(got, expected[i]) != 0)
+        {
+            PRINT_ERR("`%s`: expected `%s`, got = `%s`", inputs[i],
+                      expected[i], getStr(got));
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeResolver(r);
+        freeProgram(program);
+    }
+
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(ResolveIdentifiers);
+        RUN_TEST(ReportUndefinedNames);
+        RUN_TEST(KeepGlobalsAcrossPrograms);
+        RUN_TEST(MarkTailCalls);
+    })
+
+#undef MAIN_TEST_NAME // End TestResolver
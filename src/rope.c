@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rope.h"
+
+#define MIN_INTERN_SLOTS 64
+
+// Open addressing with linear probing, at most half full. Slots are
+// emptied by shifting the strings after them back, so there are no
+// tombstones.
+struct InternTable
+{
+    Rope** slots;
+    size_t slotMask;
+    size_t len;
+};
+
+/* Private Function Signatures */
+static Rope* allocRope(size_t len);
+static void growInternTable(InternTable*);
+
+Rope* mkRope(const char* chars, size_t len)
+{
+    Rope* output  = allocRope(len);
+    output->chars = malloc(len + 1);
+    output->leaf  = 1;
+    memcpy(output->chars, chars, len);
+    output->chars[len] = '\0';
+
+    return output;
+}
+
+Rope* mkConcat(Rope* left, Rope* right)
+{
+    Rope* output  = allocRope(left->len + right->len);
+    output->left  = left;
+    output->right = right;
+
+    return output;
+}
+
+Rope* charRope(char c)
+{
+    static Rope characters[256];
+    static char text[256][2];
+
+    Rope* output = &characters[(unsigned char)c];
+    if (!output->chars)
+    {
+        text[(unsigned char)c][0] = c;
+        output->object.type       = OBJECT_STRING;
+        output->len               = 1;
+        output->chars             = text[(unsigned char)c];
+        output->leaf              = 1;
+    }
+    return output;
+}
+
+const char* flattenRope(Rope* rope)
+{
+    if (rope->chars)
+        return rope->chars;
+
+    // Filled from the end, right halves first, so that the stack stays
+    // short for strings built by appending
+    char* chars    = malloc(rope->len + 1);
+    size_t end     = rope->len;
+    size_t len     = 0;
+    size_t cap     = 16;
+    Rope** pending = malloc(sizeof(Rope*) * cap);
+
+    chars[end]     = '\0';
+    pending[len++] = rope;
+    while (len > 0)
+    {
+        Rope* part = pending[--len];
+        if (part->chars)
+        {
+            end -= part->len;
+            memcpy(chars + end, part->chars, part->len);
+            continue;
+        }
+
+        if (len + 2 > cap)
+        {
+            cap <<= 1;
+            pending = realloc(pending, sizeof(Rope*) * cap);
+        }
+        pending[len++] = part->left;
+        pending[len++] = part->right;
+    }
+    free(pending);
+
+    rope->chars = chars;
+    rope->left  = NULL;
+    rope->right = NULL;
+    return chars;
+}
+
+uint64_t ropeHash(Rope* rope)
+{
+    if (!rope->hash)
+        rope->hash = hashChars(flattenRope(rope), rope->len);
+    return rope->hash;
+}
+
+int ropesEqual(Rope* lhs, Rope* rhs)
+{
+    if (lhs == rhs)
+        return 1;
+    if (lhs->len != rhs->len || (lhs->interned && rhs->interned))
+        return 0;
+    if (lhs->hash && rhs->hash && lhs->hash != rhs->hash)
+        return 0;
+    return memcmp(flattenRope(lhs), flattenRope(rhs), lhs->len) == 0;
+}
+
+Rope* ropeCharAt(Rope* rope, int64_t index)
+{
+    if (index < 0 || (uint64_t)index >= rope->len)
+        return NULL;
+    return charRope(flattenRope(rope)[index]);
+}
+
+InternTable* mkInternTable(void)
+{
+    InternTable* output = malloc(sizeof(InternTable));
+
+    output->slots    = calloc(MIN_INTERN_SLOTS, sizeof(Rope*));
+    output->slotMask = MIN_INTERN_SLOTS - 1;
+    output->len      = 0;
+
+    return output;
+}
+
+void freeInternTable(InternTable* table)
+{
+    if (!table)
+        return;
+
+    free(table->slots);
+    free(table);
+}
+
+Rope* findInterned(const InternTable* table, const char* chars, size_t len,
+                   uint64_t hash)
+{
+    for (size_t i = (size_t)hash & table->slotMask;;
+         i = (i + 1) & table->slotMask)
+    {
+        Rope* rope = table->slots[i];
+        if (!rope)
+            return NULL;
+        if (rope->hash == hash && rope->len == len
+            && memcmp(rope->chars, chars, len) == 0)
+            return rope;
+    }
+}
+
+void addInterned(InternTable* table, Rope* rope)
+{
+    if ((table->len + 1) * 2 > table->slotMask + 1)
+        growInternTable(table);
+
+    size_t i = (size_t)ropeHash(rope) & table->slotMask;
+    while (table->slots[i])
+        i = (i + 1) & table->slotMask;
+
+    table->slots[i] = rope;
+    rope->interned  = 1;
+    ++table->len;
+}
+
+void forgetInterned(InternTable* table, Rope* rope)
+{
+    if (!rope->interned)
+        return;
+
+    size_t i = (size_t)rope->hash & table->slotMask;
+    while (table->slots[i] != rope)
+        i = (i + 1) & table->slotMask;
+
+    // Move back the strings whose probe would otherwise pass the hole
+    for (size_t j = (i + 1) & table->slotMask; table->slots[j];
+         j = (j + 1) & table->slotMask)
+    {
+        size_t home = (size_t)table->slots[j]->hash & table->slotMask;
+        if (((j - home) & table->slotMask) >= ((j - i) & table->slotMask))
+        {
+            table->slots[i] = table->slots[j];
+            i               = j;
+        }
+    }
+
+    table->slots[i] = NULL;
+    rope->interned  = 0;
+    --table->len;
+}
+
+static Rope* allocRope(size_t len)
+{
+    Rope* output = malloc(sizeof(Rope));
+
+    output->object.type       = OBJECT_STRING;
+    output->object.marked     = 0;
+    output->object.remembered = 0;
+    output->object.forwarded  = 0;
+    output->object.next       = NULL;
+
+    output->len      = len;
+    output->chars    = NULL;
+    output->left     = NULL;
+    output->right    = NULL;
+    output->hash     = 0;
+    output->leaf     = 0;
+    output->interned = 0;
+
+    return output;
+}
+
+static void growInternTable(InternTable* table)
+{
+    Rope** slots    = table->slots;
+    size_t oldSlots = table->slotMask + 1;
+
+    table->slots    = calloc(oldSlots << 1, sizeof(Rope*));
+    table->slotMask = (oldSlots << 1) - 1;
+    table->len      = 0;
+    for (size_t i = 0; i < oldSlots; ++i)
+    {
+        if (slots[i])
+            addInterned(table, slots[i]);
+    }
+    free(slots);
+}
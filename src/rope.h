@@ -0,0 +1,45 @@
+#ifndef _MONKEY_LANG_SRC_ROPE_H_
+#define _MONKEY_LANG_SRC_ROPE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dynString.h"
+#include "object.h"
+
+// Strings this short are flat and interned: concatenating two of them
+// copies the characters, and an environment keeps one string per content.
+#define INTERN_MAX_LEN 32
+
+// Strings are ropes, so that appending to a long string in a loop takes
+// constant time instead of copying it. A string is flattened into one
+// buffer the first time its characters are needed, by indexing, hashing
+// or comparing it, and keeps them from then on.
+Rope* mkRope(const char* chars, size_t len);
+Rope* mkConcat(Rope* left, Rope* right);
+// The string of the single character c, made once for the whole process
+// and never freed. Collections mark it and leave it alone.
+Rope* charRope(char c);
+
+// The characters of a string, flattening it first if need be. A
+// concatenation is flattened without recursion, however deep it is.
+const char* flattenRope(Rope*);
+// hashChars of the characters, cached in the string
+uint64_t ropeHash(Rope*);
+int ropesEqual(Rope*, Rope*);
+// The character at index as a string, or NULL out of bounds
+Rope* ropeCharAt(Rope*, int64_t index);
+
+// Table of the short strings of an environment, by content. It holds them
+// weakly: the collector calls forgetInterned as it frees one.
+typedef struct InternTable InternTable;
+
+InternTable* mkInternTable(void);
+void freeInternTable(InternTable*);
+// The interned string of chars, whose hash is given, or NULL
+Rope* findInterned(const InternTable*, const char* chars, size_t len,
+                   uint64_t hash);
+void addInterned(InternTable*, Rope*);
+void forgetInterned(InternTable*, Rope*);
+
+#endif //_MONKEY_LANG_SRC_ROPE_H_
@@ -0,0 +1,182 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "stringBuilder.h"
+
+// Number of chunks handed to a single writev call
+#define BUILDER_IOV_BATCH 64
+
+struct Chunk
+{
+    struct Chunk* next;
+    size_t len;
+    char data[BUILDER_CHUNK_SIZE];
+};
+
+struct StringBuilder
+{
+    struct Chunk* head;
+    struct Chunk* tail;
+    size_t len;
+};
+
+static struct Chunk* mkChunk(void)
+{
+    struct Chunk* chunk = malloc(sizeof(struct Chunk));
+
+    chunk->next = NULL;
+    chunk->len  = 0;
+
+    return chunk;
+}
+
+StringBuilder* mkStringBuilder(void)
+{
+    StringBuilder* output = malloc(sizeof(StringBuilder));
+
+    output->head = mkChunk();
+    output->tail = output->head;
+    output->len  = 0;
+
+    return output;
+}
+
+void freeStringBuilder(StringBuilder* pBuilder)
+{
+    if (!pBuilder)
+        return;
+
+    struct Chunk* tmp  = pBuilder->head;
+    struct Chunk* next = NULL;
+    while (tmp)
+    {
+        next = tmp->next;
+        free(tmp);
+        tmp = next;
+    }
+
+    free(pBuilder);
+}
+
+void builderAppendChar(StringBuilder* pBuilder, char chr)
+{
+    if (pBuilder->tail->len == BUILDER_CHUNK_SIZE)
+    {
+        pBuilder->tail->next = mkChunk();
+        pBuilder->tail       = pBuilder->tail->next;
+    }
+
+    pBuilder->tail->data[pBuilder->tail->len++] = chr;
+    ++pBuilder->len;
+}
+
+void builderAppendStr(StringBuilder* pBuilder, const char* str)
+{
+    builderAppendNStr(pBuilder, str, strlen(str));
+}
+
+void builderAppendNStr(StringBuilder* pBuilder, const char* str,
+                       size_t strLen)
+{
+    size_t room = 0;
+
+    pBuilder->len += strLen;
+
+    while (strLen > 0)
+    {
+        if (pBuilder->tail->len == BUILDER_CHUNK_SIZE)
+        {
+            pBuilder->tail->next = mkChunk();
+            pBuilder->tail       = pBuilder->tail->next;
+        }
+
+        room = BUILDER_CHUNK_SIZE - pBuilder->tail->len;
+        if (room > strLen)
+            room = strLen;
+
+        memcpy(pBuilder->tail->data + pBuilder->tail->len, str, room);
+        pBuilder->tail->len += room;
+        str += room;
+        strLen -= room;
+    }
+}
+
+void builderAppendString(StringBuilder* pBuilder, const String* pString)
+{
+    if (!pString)
+        return;
+
+    builderAppendNStr(pBuilder, getStr(pString), getLen(pString));
+}
+
+void builderAppendFreeString(StringBuilder* pBuilder, String* pString)
+{
+    builderAppendString(pBuilder, pString);
+    freeString(pString);
+}
+
+size_t getBuilderLen(const StringBuilder* pBuilder)
+{
+    if (!pBuilder)
+        return 0;
+    return pBuilder->len;
+}
+
+String* buildString(const StringBuilder* pBuilder)
+{
+    if (!pBuilder)
+        return NULL;
+
+    String* output = mkStringWithCapacity(pBuilder->len);
+    for (struct Chunk* tmp = pBuilder->head; tmp; tmp = tmp->next)
+        appendNStr(output, tmp->data, tmp->len);
+
+    return output;
+}
+
+long writeBuilder(const StringBuilder* pBuilder, int fd)
+{
+    struct iovec iov[BUILDER_IOV_BATCH];
+    struct Chunk* chunk = pBuilder->head;
+    size_t skip         = 0; // bytes of `chunk` already written
+    long written        = 0;
+    ssize_t result      = 0;
+    int iovLen          = 0;
+
+    while (chunk)
+    {
+        iovLen = 0;
+        for (struct Chunk* tmp = chunk; tmp && iovLen < BUILDER_IOV_BATCH;
+             tmp               = tmp->next)
+        {
+            iov[iovLen].iov_base = tmp->data + (tmp == chunk ? skip : 0);
+            iov[iovLen].iov_len  = tmp->len - (tmp == chunk ? skip : 0);
+            ++iovLen;
+        }
+
+        result = writev(fd, iov, iovLen);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        written += result;
+
+        // Advance past everything writev accepted, which may end in the
+        // middle of a chunk when the write was partial.
+        result += (ssize_t)skip;
+        while (chunk && (size_t)result >= chunk->len)
+        {
+            result -= (ssize_t)chunk->len;
+            chunk = chunk->next;
+        }
+        skip = (size_t)result;
+    }
+
+    return written;
+}
@@ -0,0 +1,31 @@
+#ifndef _MONKEY_LANG_SRC_STRINGBUILDER_H_
+#define _MONKEY_LANG_SRC_STRINGBUILDER_H_
+
+#include <stddef.h>
+
+#include "dynString.h"
+
+// Size of the payload of each chunk. Appends never move bytes already
+// written: once a chunk is full, a new one is linked after it.
+#define BUILDER_CHUNK_SIZE 4096
+
+typedef struct StringBuilder StringBuilder;
+
+StringBuilder* mkStringBuilder(void);
+void freeStringBuilder(StringBuilder*);
+
+void builderAppendChar(StringBuilder*, char);
+void builderAppendStr(StringBuilder*, const char*);
+void builderAppendNStr(StringBuilder*, const char*, size_t);
+void builderAppendString(StringBuilder*, const String*);
+void builderAppendFreeString(StringBuilder*, String*);
+
+size_t getBuilderLen(const StringBuilder*);
+
+// Flatten every chunk into a single String. The builder stays usable.
+String* buildString(const StringBuilder*);
+// Write every chunk to fd with writev(2). Returns the number of bytes
+// written, or -1 if a write failed.
+long writeBuilder(const StringBuilder*, int fd);
+
+#endif //_MONKEY_LANG_SRC_STRINGBUILDER_H_
@@ -0,0 +1,141 @@
+#define MAIN_TEST_NAME TestStringBuilder
+
+#include <unistd.h>
+
+#include "stringBuilder.h"
+#include "testing.h"
+
+TEST(AppendAndBuild)
+{
+    const char* expected = "Hello World!*";
+    size_t strLen = strlen(expected);
+
+    StringBuilder* builder = mkStringBuilder();
+    builderAppendStr(builder, "Hello");
+    builderAppendNStr(builder, " World!!!", 7);
+    builderAppendChar(builder, '*');
+
+    String* string = buildString(builder);
+    freeStringBuilder(builder);
+
+    if (strLen != getLen(string))
+    {
+        PRINT_ERR("String Length are different. expected = %zu, got = %zu",
+                  strLen, getLen(string));
+        freeString(string);
+        return TEST_FAILED;
+    }
+
+    if (strcmp(getStr(string), expected) != 0)
+    {
+        PRINT_ERR("Strings are different. expected = %s, got = %s", expected,
+                  getStr(string));
+        freeString(string);
+        return TEST_FAILED;
+    }
+
+    freeString(string);
+    return TEST_SUCESSED;
+}
+
+TEST(AppendAcrossChunks)
+{
+    // Pieces of an odd length so that appends straddle chunk boundaries
+    const char* piece = "0123456789abc";
+    size_t pieceLen = strlen(piece);
+    size_t count = (BUILDER_CHUNK_SIZE * 3) / pieceLen + 1;
+
+    StringBuilder* builder = mkStringBuilder();
+    for (size_t i = 0; i < count; ++i)
+        builderAppendStr(builder, piece);
+
+    String* string = buildString(builder);
+    freeStringBuilder(builder);
+
+    if (getLen(string) != pieceLen * count)
+    {
+        PRINT_ERR("String Length are different. expected = %zu, got = %zu",
+                  pieceLen * count, getLen(string));
+        freeString(string);
+        return TEST_FAILED;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (strncmp(getStr(string) + i * pieceLen, piece, pieceLen) != 0)
+        {
+            PRINT_ERR("piece %zu is corrupted", i);
+            freeString(string);
+            return TEST_FAILED;
+        }
+    }
+
+    freeString(string);
+    return TEST_SUCESSED;
+}
+
+TEST(WriteToFd)
+{
+    int testStatus = TEST_SUCESSED;
+    int fds[2];
+    char buffer[BUILDER_CHUNK_SIZE * 2 + 16];
+    size_t total = BUILDER_CHUNK_SIZE + 100;
+
+    if (pipe(fds) != 0)
+    {
+        PRINT_ERR("cannot open a pipe%s", "");
+        return TEST_FAILED;
+    }
+
+    StringBuilder* builder = mkStringBuilder();
+    for (size_t i = 0; i < total; ++i)
+        builderAppendChar(builder, (char)('a' + i % 26));
+
+    long written = writeBuilder(builder, fds[1]);
+    close(fds[1]);
+
+    if (written != (long)total)
+    {
+        PRINT_ERR("written bytes are different. expected = %zu, got = %ld",
+                  total, written);
+        testStatus = TEST_FAILED;
+        goto EXIT_TEST;
+    }
+
+    size_t got = 0;
+    ssize_t readLen = 0;
+    while ((readLen = read(fds[0], buffer + got, sizeof(buffer) - got)) > 0)
+        got += (size_t)readLen;
+
+    if (got != total)
+    {
+        PRINT_ERR("read bytes are different. expected = %zu, got = %zu",
+                  total, got);
+        testStatus = TEST_FAILED;
+        goto EXIT_TEST;
+    }
+
+    for (size_t i = 0; i < total; ++i)
+    {
+        if (buffer[i] != (char)('a' + i % 26))
+        {
+            PRINT_ERR("byte %zu is corrupted", i);
+            testStatus = TEST_FAILED;
+            goto EXIT_TEST;
+        }
+    }
+
+EXIT_TEST:
+    close(fds[0]);
+    freeStringBuilder(builder);
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(AppendAndBuild);
+        RUN_TEST(AppendAcrossChunks);
+        RUN_TEST(WriteToFd);
+    })
+
+#undef MAIN_TEST_NAME // End TestStringBuilder
@@ -1,9 +1,22 @@
+// popen and mkstemp, to build the C printed by --emit-c
+#define _DEFAULT_SOURCE
+
 #include <stdlib.h>
 
 #include "ast_tests.h"
+#include "capture_tests.h"
+#include "collection_tests.h"
+#include "evaluator_tests.h"
+#include "gc_tests.h"
+#include "hash_cons_tests.h"
 #include "lexer_tests.h"
+#include "optimizer_tests.h"
 #include "parser_tests.h"
+#include "resolver_tests.h"
+#include "string_builder_tests.h"
 #include "string_tests.h"
+#include "vm_tests.h"
+#include "walker_tests.h"
 
 #define IS_MAIN_FILE
 #include "testing.h"
@@ -11,9 +24,19 @@
 int main(void)
 {
     RUN_MAIN_TEST(TestDynString);
+    RUN_MAIN_TEST(TestStringBuilder);
     RUN_MAIN_TEST(TestLexer);
     RUN_MAIN_TEST(TestAst);
     RUN_MAIN_TEST(TestParser);
+    RUN_MAIN_TEST(TestWalker);
+    RUN_MAIN_TEST(TestResolver);
+    RUN_MAIN_TEST(TestCapture);
+    RUN_MAIN_TEST(TestEvaluator);
+    RUN_MAIN_TEST(TestCollection);
+    RUN_MAIN_TEST(TestGC);
+    RUN_MAIN_TEST(TestVM);
+    RUN_MAIN_TEST(TestOptimizer);
+    RUN_MAIN_TEST(TestHashCons);
 
     return 0;
 }
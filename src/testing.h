@@ -6,6 +6,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "parser.h"
+#include "resolver.h"
+
 #define TEST_FAILED   0
 #define TEST_SUCESSED 1
 
@@ -75,4 +78,35 @@
 #define PRINT_NOTE(fmtString, ...) \
     printf(NOTE_COLOR "NOTE:  " fmtString "\n", __VA_ARGS__)
 
+// The program of input, or NULL after printing why it cannot be parsed.
+// Given a resolver, the program is resolved with it as well.
+static inline Program* parseForTest(const char* input, Resolver* resolver)
+{
+    Lexer* l = mkLexer(input);
+    Parser* p = mkParser(l);
+    Program* program = parseProgram(p);
+
+    if (getErrLen(p) != 0)
+    {
+        String** errors = getErrors(p);
+        for (int i = 0; errors[i]; ++i)
+        {
+            PRINT_ERR("%s", getStr(errors[i]));
+            freeString(errors[i]);
+        }
+        free(errors);
+        freeProgram(program);
+        program = NULL;
+    }
+    else if (resolver && resolveProgram(resolver, program) != 0)
+    {
+        PRINT_ERR("cannot resolve `%s`", input);
+        freeProgram(program);
+        program = NULL;
+    }
+
+    freeParser(p);
+    return program;
+}
+
 #endif // _MONKEY_LANG_TESTS_TEST_H_
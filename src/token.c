@@ -97,6 +97,14 @@ const char* printTokType(TokenType tokType)
         return "FALSE";
     case T_RETURN:
         return "RETURN";
+    case T_LBRACKET:
+        return "LBRACKET";
+    case T_RBRACKET:
+        return "RBRACKET";
+    case T_COLON:
+        return "COLON";
+    case T_STRING:
+        return "STRING";
     default:
         return "????";
     }
@@ -33,6 +33,10 @@ typedef enum
     T_TRUE,
     T_FALSE,
     T_RETURN,
+    T_LBRACKET,
+    T_RBRACKET,
+    T_COLON,
+    T_STRING,
 } TokenType;
 
 #define INIT_TOKEN \
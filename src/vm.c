@@ -0,0 +1,1093 @@
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __PRIVATE_ENVIRONMENT_OBJECTS__
+#include "code.h"
+#include "collection.h"
+#include "environment.h"
+#include "jit.h"
+#include "memo.h"
+#include "object.h"
+#include "stringBuilder.h"
+#include "vm.h"
+
+#define INITIAL_FRAME_CAPACITY 64
+// Native calls nest on the C stack; deeper calls stay in the interpreter,
+// whose frames are on the frame stack of the environment
+#define MAX_NATIVE_DEPTH 10000
+
+// Direct threading relies on computed goto, a GCC and Clang extension.
+// Build with -DMONKEY_SWITCH_DISPATCH to get the portable switch loop.
+#if defined(__GNUC__) && !defined(MONKEY_SWITCH_DISPATCH)
+#define THREADED_DISPATCH
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#ifdef THREADED_DISPATCH
+// An instruction translated to the address of its handler, so that each
+// handler jumps straight to the next one without going back to a switch
+typedef struct
+{
+    const void* handler;
+    uint32_t arg;
+} Instr;
+
+#define CODE_OF(fn)   threadCode((fn), handlers)
+#define TARGET(op)    L_##op:
+#define UNKNOWN       L_UNKNOWN:
+#define ARG_AT(i)     (ip[(i) - 1].arg)
+#define OPCODE        ((int)(ip[-1].arg >> 24)) // only for unknown opcodes
+#define NEXT()                 \
+    do                         \
+    {                          \
+        PROFILE();             \
+        goto *(ip++)->handler; \
+    } while (0)
+// The last part of a superinstruction is reached without a dispatch
+#define CONTINUE_WITH(op, n) \
+    ip += (n);               \
+    goto L_##op
+#else
+typedef uint32_t Instr;
+
+#define CODE_OF(fn)   ((const Instr*)(fn)->code)
+#define TARGET(op)    case op:
+#define UNKNOWN       default:
+#define ARG_AT(i)     INSTR_ARG(ip[(i) - 1])
+#define OPCODE        ((int)INSTR_OP(ip[-1]))
+#define NEXT()        break
+// The last part of a superinstruction is dispatched from where it stayed
+#define CONTINUE_WITH(op, n) \
+    ip += (n) - 1;           \
+    NEXT()
+#endif
+
+#define ARG ARG_AT(0)
+
+#ifdef MONKEY_PROFILE_DISPATCH
+#define PROFILE() \
+    countDispatch(env->profile, INSTR_OP(frame->fn->code[ip - code]))
+#else
+#define PROFILE() ((void)0)
+#endif
+
+struct CallFrame
+{
+    CompiledFunction* fn;
+    const Instr* ip;
+    size_t base; // index of the first slot in the stack, which may move
+};
+
+/* Private Function Signatures */
+#ifdef THREADED_DISPATCH
+static const Instr* threadCode(CompiledFunction*, const void* const*);
+#endif
+#ifdef MONKEY_PROFILE_DISPATCH
+static void countDispatch(DispatchProfile*, Opcode);
+#endif
+static Value execute(Environment*, CompiledFunction*, size_t);
+static Closure* checkCallee(Environment*, Value, uint32_t);
+static size_t enterFrame(Environment*, CompiledFunction*, size_t, Value**);
+static int callNative(Environment*, size_t);
+static inline int callNested(Environment*, size_t, uint32_t);
+static int callMemoized(Environment*, size_t, uint32_t);
+static void dumpFunctionCaches(StringBuilder*, const CompiledFunction*, int);
+static void binaryError(Environment*, Opcode, Value, Value);
+static int concatStrings(Environment*, Value*);
+static void growStack(Environment*, Value**, size_t);
+static void growFrames(Environment*);
+
+// The closure being run sits below its arguments for the whole call, and
+// is read from there since a collection may move it
+#define FRAME_CLOSURE ((Closure*)base[frame->fn->firstParam - 1].as.object)
+
+// Only false and null are falsy; see isTruthy
+#define IS_FALSY(v) \
+    ((v).type == VALUE_BOOL ? !(v).as.boolean : (v).type <= VALUE_NULL)
+
+// Bodies of the instructions that leave the flow of control alone, so that
+// a superinstruction can run several of them in a row
+#define EXEC_OP_CONSTANT(arg)  (*sp++ = constants[(arg)])
+#define EXEC_OP_TRUE(arg)      (*sp++ = BOOL_VALUE(1))
+#define EXEC_OP_FALSE(arg)     (*sp++ = BOOL_VALUE(0))
+#define EXEC_OP_NULL(arg)      (*sp++ = NULL_VALUE)
+#define EXEC_OP_UNDEFINED(arg) (*sp++ = UNDEFINED_VALUE)
+#define EXEC_OP_POP(arg)       (--sp)
+
+#define EXEC_INT_BINARY(op, expr)                              \
+    do                                                         \
+    {                                                          \
+        Value right = sp[-1];                                  \
+        Value left  = sp[-2];                                  \
+        if (left.type != VALUE_INT || right.type != VALUE_INT) \
+        {                                                      \
+            binaryError(env, op, left, right);                 \
+            goto fail;                                         \
+        }                                                      \
+        sp[-2] = expr;                                         \
+        --sp;                                                  \
+    } while (0)
+
+// Arithmetic wraps around on overflow, as in eval. Strings concatenate,
+// on a path of its own since allocating may collect.
+#define EXEC_OP_ADD(arg)                                                     \
+    do                                                                       \
+    {                                                                        \
+        Value right = sp[-1];                                                \
+        Value left  = sp[-2];                                                \
+        if (left.type == VALUE_INT && right.type == VALUE_INT)               \
+            sp[-2] = INT_VALUE((int64_t)((uint64_t)left.as.integer          \
+                                         + (uint64_t)right.as.integer));     \
+        else if (!concatStrings(env, sp))                                    \
+            goto fail;                                                       \
+        --sp;                                                                \
+    } while (0)
+#define EXEC_OP_SUB(arg)                                                     \
+    EXEC_INT_BINARY(OP_SUB, INT_VALUE((int64_t)((uint64_t)left.as.integer \
+                                                - (uint64_t)right.as.integer)))
+#define EXEC_OP_MUL(arg)                                                     \
+    EXEC_INT_BINARY(OP_MUL, INT_VALUE((int64_t)((uint64_t)left.as.integer \
+                                                * (uint64_t)right.as.integer)))
+#define EXEC_OP_LT(arg) \
+    EXEC_INT_BINARY(OP_LT, BOOL_VALUE(left.as.integer < right.as.integer))
+#define EXEC_OP_GT(arg) \
+    EXEC_INT_BINARY(OP_GT, BOOL_VALUE(left.as.integer > right.as.integer))
+
+#define EXEC_OP_DIV(arg)                                                 \
+    do                                                                   \
+    {                                                                    \
+        Value right = sp[-1];                                            \
+        Value left  = sp[-2];                                            \
+        if (left.type != VALUE_INT || right.type != VALUE_INT)           \
+        {                                                                \
+            binaryError(env, OP_DIV, left, right);                       \
+            goto fail;                                                   \
+        }                                                                \
+        if (right.as.integer == 0)                                       \
+        {                                                                \
+            setEnvError(env, "division by zero");                        \
+            goto fail;                                                   \
+        }                                                                \
+        sp[-2] = INT_VALUE(right.as.integer == -1                        \
+                               ? (int64_t)(0 - (uint64_t)left.as.integer) \
+                               : left.as.integer / right.as.integer);    \
+        --sp;                                                            \
+    } while (0)
+
+#define EXEC_OP_EQ(arg)                                     \
+    do                                                      \
+    {                                                       \
+        sp[-2] = BOOL_VALUE(valuesEqual(sp[-2], sp[-1]));   \
+        --sp;                                               \
+    } while (0)
+
+#define EXEC_OP_NE(arg)                                     \
+    do                                                      \
+    {                                                       \
+        sp[-2] = BOOL_VALUE(!valuesEqual(sp[-2], sp[-1]));  \
+        --sp;                                               \
+    } while (0)
+
+#define EXEC_OP_MINUS(arg)                                               \
+    do                                                                   \
+    {                                                                    \
+        if (sp[-1].type != VALUE_INT)                                    \
+        {                                                                \
+            setEnvError(env, "unknown operator: -%s",                    \
+                        valueTypeName(sp[-1].type));                     \
+            goto fail;                                                   \
+        }                                                                \
+        sp[-1].as.integer = (int64_t)(0 - (uint64_t)sp[-1].as.integer);  \
+    } while (0)
+
+#define EXEC_OP_BANG(arg) (sp[-1] = BOOL_VALUE(IS_FALSY(sp[-1])))
+
+#define EXEC_OP_GET_GLOBAL(arg)                                          \
+    do                                                                   \
+    {                                                                    \
+        Value value = globals[(arg)];                                    \
+        if (value.type == VALUE_UNDEFINED)                               \
+        {                                                                \
+            const String* name = getGlobalName(env->resolver, (int)(arg)); \
+            setEnvError(env, "identifier not found: %s",                 \
+                        name ? getStr(name) : "?");                      \
+            goto fail;                                                   \
+        }                                                                \
+        *sp++ = value;                                                   \
+    } while (0)
+
+// Binding a global again forgets the results of pure calls, see memo.h
+#define EXEC_OP_SET_GLOBAL(arg)                                          \
+    do                                                                   \
+    {                                                                    \
+        if (env->memo && globals[(arg)].type != VALUE_UNDEFINED)         \
+            forgetMemo(env);                                             \
+        globals[(arg)] = *--sp;                                          \
+    } while (0)
+#define EXEC_OP_GET_LOCAL(arg)   (*sp++ = base[(arg)])
+#define EXEC_OP_SET_LOCAL(arg)   (base[(arg)] = *--sp)
+#define EXEC_OP_GET_CAPTURE(arg) (*sp++ = FRAME_CLOSURE->captures[(arg)])
+
+// Set closure to the callee of the call instruction with operand arg, from
+// the cache of its call site if it was checked there before
+#define LOOK_UP_CALLEE(arg, closure)                                         \
+    do                                                                       \
+    {                                                                        \
+        Value callee     = sp[-(ptrdiff_t)CALL_ARGC(arg) - 1];               \
+        CallCache* cache = &frame->fn->callCaches[CALL_SITE(arg)];           \
+        closure          = callee.type == VALUE_CLOSURE                      \
+                             ? (Closure*)callee.as.object                    \
+                             : NULL;                                         \
+                                                                             \
+        int hit = closure && cache->closures[0] == closure;                  \
+        for (int i = 1; i < cache->len && !hit; ++i)                         \
+            hit = cache->closures[i] == closure;                             \
+                                                                             \
+        if (hit)                                                             \
+        {                                                                    \
+            ++cache->hits;                                                   \
+        }                                                                    \
+        else                                                                 \
+        {                                                                    \
+            ++cache->misses;                                                 \
+            if (!closure || !closure->compiled)                              \
+            {                                                                \
+                setEnvError(env, "not a function: %s",                       \
+                            valueTypeName(callee.type));                     \
+                goto fail;                                                   \
+            }                                                                \
+            if (CALL_ARGC(arg) != (uint32_t)closure->compiled->numParams)    \
+            {                                                                \
+                setEnvError(env,                                             \
+                            "wrong number of arguments: want=%d, got=%u",    \
+                            closure->compiled->numParams, CALL_ARGC(arg));   \
+                goto fail;                                                   \
+            }                                                                \
+                                                                             \
+            if (cache->len < CALL_CACHE_ENTRIES)                             \
+            {                                                                \
+                cache->closures[cache->len++] = closure;                     \
+                WRITE_BARRIER(env, &frame->fn->object, callee);              \
+            }                                                                \
+            else                                                             \
+            {                                                                \
+                cache->megamorphic = 1;                                      \
+            }                                                                \
+        }                                                                    \
+    } while (0)
+
+const char* getDispatchMode(void)
+{
+#ifdef THREADED_DISPATCH
+    return "threaded";
+#else
+    return "switch";
+#endif
+}
+
+Value runBytecode(CompiledFunction* program, Environment* env)
+{
+    freeString(env->error);
+    env->error       = NULL;
+    env->nativeDepth = 0;
+    reserveGlobals(env);
+
+    Value* sp = env->stack;
+    if ((size_t)program->maxStack > env->stackCapacity)
+        growStack(env, &sp, (size_t)program->maxStack);
+
+    // Roots pinned by frames that fail are dropped along with them
+    size_t rootLen = env->rootLen;
+    pushRoot(env, &program->object);
+    Value result = execute(env, program, 0);
+    env->rootLen  = rootLen;
+    env->stackLen = 0;
+
+    // The caller frees the program, which its call caches may have
+    // remembered
+    forgetObject(env, &program->object);
+    return result;
+}
+
+int callFromNative(Environment* env, size_t callee, uint32_t argc)
+{
+    if (!checkCallee(env, env->stack[callee], argc))
+        return 1;
+
+    if (env->memo)
+    {
+        int status = callMemoized(env, callee, argc);
+        if (status >= 0)
+            return status;
+    }
+    return callNested(env, callee, argc);
+}
+
+int tailCallFromNative(Environment* env, size_t callee, uint32_t argc,
+                       size_t frame)
+{
+    Closure* closure = checkCallee(env, env->stack[callee], argc);
+    if (!closure)
+        return 1;
+
+    memmove(env->stack + frame, env->stack + callee,
+            sizeof(Value) * (argc + 1));
+    ++env->tailCalls;
+
+    Value* sp = env->stack + frame + 1 + argc;
+    enterFrame(env, closure->compiled, frame, &sp);
+    return 0;
+}
+
+// Run the frame at stack[frameBase] of fn, whose arguments and locals are
+// in place, until it returns. Calls push frames of their own above it on
+// env->frames, or run natively; native code calling back into the
+// interpreter nests another execute on the same frames, so that calls
+// allocate nothing once the frame stack has grown deep enough.
+static Value execute(Environment* env, CompiledFunction* fn,
+                     size_t frameBase)
+{
+#ifdef THREADED_DISPATCH
+    // Handlers by opcode; the last entry catches unknown opcodes
+    static const void* const handlers[OPCODE_COUNT + 1] = {
+        [OP_CONSTANT] = &&L_OP_CONSTANT,
+        [OP_TRUE] = &&L_OP_TRUE,
+        [OP_FALSE] = &&L_OP_FALSE,
+        [OP_NULL] = &&L_OP_NULL,
+        [OP_UNDEFINED] = &&L_OP_UNDEFINED,
+        [OP_POP] = &&L_OP_POP,
+        [OP_ADD] = &&L_OP_ADD,
+        [OP_SUB] = &&L_OP_SUB,
+        [OP_MUL] = &&L_OP_MUL,
+        [OP_DIV] = &&L_OP_DIV,
+        [OP_EQ] = &&L_OP_EQ,
+        [OP_NE] = &&L_OP_NE,
+        [OP_LT] = &&L_OP_LT,
+        [OP_GT] = &&L_OP_GT,
+        [OP_MINUS] = &&L_OP_MINUS,
+        [OP_BANG] = &&L_OP_BANG,
+        [OP_JUMP] = &&L_OP_JUMP,
+        [OP_JUMP_FALSY] = &&L_OP_JUMP_FALSY,
+        [OP_GET_GLOBAL] = &&L_OP_GET_GLOBAL,
+        [OP_SET_GLOBAL] = &&L_OP_SET_GLOBAL,
+        [OP_GET_LOCAL] = &&L_OP_GET_LOCAL,
+        [OP_SET_LOCAL] = &&L_OP_SET_LOCAL,
+        [OP_GET_CAPTURE] = &&L_OP_GET_CAPTURE,
+        [OP_ARRAY] = &&L_OP_ARRAY,
+        [OP_HASH] = &&L_OP_HASH,
+        [OP_INDEX] = &&L_OP_INDEX,
+        [OP_CLOSURE] = &&L_OP_CLOSURE,
+        [OP_CALL] = &&L_OP_CALL,
+        [OP_TAIL_CALL] = &&L_OP_TAIL_CALL,
+        [OP_RETURN] = &&L_OP_RETURN,
+#define SUPER_PAIR(name, a, b)      [name] = &&L_##name,
+#define SUPER_TRIPLE(name, a, b, c) [name] = &&L_##name,
+#include "superinstructions.h"
+#undef SUPER_PAIR
+#undef SUPER_TRIPLE
+        [OPCODE_COUNT] = &&L_UNKNOWN,
+    };
+#endif
+
+    // Frames below floor belong to the interpreters this one is nested in
+    size_t floor = env->frameLen;
+    if (floor == env->frameCapacity)
+        growFrames(env);
+
+    struct CallFrame* frame = &env->frames[env->frameLen++];
+    frame->fn               = fn;
+    frame->base             = frameBase;
+
+    // The state of the running frame is kept in locals
+    const Instr* code  = CODE_OF(fn);
+    const Instr* ip    = code;
+    Value* base        = env->stack + frameBase;
+    Value* sp          = base + fn->frameSize;
+    Value* constants   = fn->constants;
+    Value* globals     = env->globals;
+    Value result       = UNDEFINED_VALUE;
+
+#ifdef THREADED_DISPATCH
+    NEXT();
+#else
+    for (;;)
+    {
+        PROFILE();
+        switch (INSTR_OP(*ip++))
+        {
+#endif
+        TARGET(OP_CONSTANT)
+            EXEC_OP_CONSTANT(ARG);
+            NEXT();
+
+        TARGET(OP_TRUE)
+            EXEC_OP_TRUE(ARG);
+            NEXT();
+
+        TARGET(OP_FALSE)
+            EXEC_OP_FALSE(ARG);
+            NEXT();
+
+        TARGET(OP_NULL)
+            EXEC_OP_NULL(ARG);
+            NEXT();
+
+        TARGET(OP_UNDEFINED)
+            EXEC_OP_UNDEFINED(ARG);
+            NEXT();
+
+        TARGET(OP_POP)
+            EXEC_OP_POP(ARG);
+            NEXT();
+
+        TARGET(OP_ADD)
+            EXEC_OP_ADD(ARG);
+            NEXT();
+
+        TARGET(OP_SUB)
+            EXEC_OP_SUB(ARG);
+            NEXT();
+
+        TARGET(OP_MUL)
+            EXEC_OP_MUL(ARG);
+            NEXT();
+
+        TARGET(OP_DIV)
+            EXEC_OP_DIV(ARG);
+            NEXT();
+
+        TARGET(OP_EQ)
+            EXEC_OP_EQ(ARG);
+            NEXT();
+
+        TARGET(OP_NE)
+            EXEC_OP_NE(ARG);
+            NEXT();
+
+        TARGET(OP_LT)
+            EXEC_OP_LT(ARG);
+            NEXT();
+
+        TARGET(OP_GT)
+            EXEC_OP_GT(ARG);
+            NEXT();
+
+        TARGET(OP_MINUS)
+            EXEC_OP_MINUS(ARG);
+            NEXT();
+
+        TARGET(OP_BANG)
+            EXEC_OP_BANG(ARG);
+            NEXT();
+
+        TARGET(OP_JUMP)
+            ip = code + ARG;
+            NEXT();
+
+        TARGET(OP_JUMP_FALSY)
+            --sp;
+            if (IS_FALSY(*sp))
+                ip = code + ARG;
+            NEXT();
+
+        TARGET(OP_GET_GLOBAL)
+            EXEC_OP_GET_GLOBAL(ARG);
+            NEXT();
+
+        TARGET(OP_SET_GLOBAL)
+            EXEC_OP_SET_GLOBAL(ARG);
+            NEXT();
+
+        TARGET(OP_GET_LOCAL)
+            EXEC_OP_GET_LOCAL(ARG);
+            NEXT();
+
+        TARGET(OP_SET_LOCAL)
+            EXEC_OP_SET_LOCAL(ARG);
+            NEXT();
+
+        TARGET(OP_GET_CAPTURE)
+            EXEC_OP_GET_CAPTURE(ARG);
+            NEXT();
+
+        TARGET(OP_ARRAY)
+        {
+            // The elements stay on the stack, where a collection finds
+            // them, until the array is made
+            env->stackLen = (size_t)(sp - env->stack);
+
+            Array* array = newArray(env, ARG);
+            sp -= ARG;
+            for (uint32_t i = 0; i < ARG; ++i)
+            {
+                arrayPush(array, sp[i]);
+                WRITE_BARRIER(env, &array->object, sp[i]);
+            }
+
+            *sp++ = OBJECT_VALUE(VALUE_ARRAY, array);
+            NEXT();
+        }
+
+        TARGET(OP_HASH)
+        {
+            env->stackLen = (size_t)(sp - env->stack);
+
+            Hash* hash = newHash(env, ARG);
+            sp -= 2 * (size_t)ARG;
+            for (uint32_t i = 0; i < 2 * ARG; i += 2)
+            {
+                if (!isHashable(sp[i]))
+                {
+                    setEnvError(env, UNUSABLE_HASH_KEY,
+                                valueTypeName(sp[i].type));
+                    goto fail;
+                }
+                hashPut(hash, sp[i], sp[i + 1]);
+                WRITE_BARRIER(env, &hash->object, sp[i]);
+                WRITE_BARRIER(env, &hash->object, sp[i + 1]);
+            }
+
+            *sp++ = OBJECT_VALUE(VALUE_HASH, hash);
+            NEXT();
+        }
+
+        TARGET(OP_INDEX)
+        {
+            ValueType culprit;
+            const char* error = indexValue(sp[-2], sp[-1], &sp[-2], &culprit);
+            if (error)
+            {
+                setEnvError(env, error, valueTypeName(culprit));
+                goto fail;
+            }
+            --sp;
+            NEXT();
+        }
+
+        TARGET(OP_CLOSURE)
+        {
+            // Frames, callees included, live on the stack below sp
+            env->stackLen = (size_t)(sp - env->stack);
+
+            CompiledFunction* fn = frame->fn->functions[ARG];
+            Closure* closure     = newClosure(env, fn->function);
+            Capture* capture     = fn->function->inner.fntExpr->captures;
+
+            closure->compiled = fn;
+            for (int i = 0; i < closure->numCaptures; ++i)
+            {
+                if (capture[i].source == CAPTURE_LOCAL)
+                    closure->captures[i] = base[capture[i].index];
+                else
+                    closure->captures[i] =
+                        FRAME_CLOSURE->captures[capture[i].index];
+                WRITE_BARRIER(env, &closure->object, closure->captures[i]);
+            }
+
+            *sp++ = OBJECT_VALUE(VALUE_CLOSURE, closure);
+            NEXT();
+        }
+
+        TARGET(OP_CALL)
+        {
+            uint32_t argc = CALL_ARGC(ARG);
+            Closure* closure;
+            LOOK_UP_CALLEE(ARG, closure);
+
+            CompiledFunction* fn = closure->compiled;
+            size_t callee        = (size_t)(sp - env->stack) - argc - 1;
+
+            if (env->memo)
+            {
+                // The stack and the frames may move in the nested call
+                int status = callMemoized(env, callee, argc);
+                if (status >= 0)
+                {
+                    frame = &env->frames[env->frameLen - 1];
+                    base  = env->stack + frame->base;
+                    sp    = env->stack + callee + 1;
+                    if (status)
+                        goto fail;
+                    NEXT();
+                }
+            }
+
+            size_t newBase = enterFrame(env, fn, callee, &sp);
+
+            if (env->jitThreshold)
+            {
+                // The stack and the frames may move in native code
+                int status = callNative(env, callee);
+                frame      = &env->frames[env->frameLen - 1];
+                if (status >= 0)
+                {
+                    // The result replaced the callee
+                    base = env->stack + frame->base;
+                    sp   = env->stack + callee + 1;
+                    if (status)
+                        goto fail;
+                    NEXT();
+                }
+
+                // Native tail calls may have left another closure to run
+                fn      = ((Closure*)env->stack[callee].as.object)->compiled;
+                newBase = callee + 1 - (size_t)fn->firstParam;
+                sp      = env->stack + newBase + fn->frameSize;
+            }
+
+            if (env->frameLen == env->frameCapacity)
+            {
+                growFrames(env);
+                frame = &env->frames[env->frameLen - 1];
+            }
+
+            frame->ip   = ip;
+            frame       = &env->frames[env->frameLen++];
+            frame->fn   = fn;
+            frame->base = newBase;
+
+            code      = CODE_OF(fn);
+            ip        = code;
+            base      = env->stack + newBase;
+            constants = fn->constants;
+            NEXT();
+        }
+
+        TARGET(OP_TAIL_CALL)
+        {
+            uint32_t argc = CALL_ARGC(ARG);
+            Closure* closure;
+            LOOK_UP_CALLEE(ARG, closure);
+
+            // A remembered result is returned at once
+            MemoKey key;
+            if (env->memo
+                && makeMemoKey(closure->function, sp - argc, argc, &key)
+                && lookUpMemo(env, &key, &sp[-(ptrdiff_t)argc - 1]))
+            {
+                sp -= argc;
+                goto returnTop;
+            }
+
+            // The callee and its arguments replace those of the running
+            // frame, whose slots hold nothing else still needed, and the
+            // callee runs in that frame
+            size_t callee = frame->base + (size_t)frame->fn->firstParam - 1;
+            memmove(env->stack + callee, sp - argc - 1,
+                    sizeof(Value) * (argc + 1));
+            sp = env->stack + callee + 1 + argc;
+            ++env->tailCalls;
+
+            CompiledFunction* fn = closure->compiled;
+            frame->fn            = fn;
+            frame->base          = enterFrame(env, fn, callee, &sp);
+
+            if (env->jitThreshold)
+            {
+                int status = callNative(env, callee);
+                frame      = &env->frames[env->frameLen - 1];
+                if (status >= 0)
+                {
+                    base = env->stack + frame->base;
+                    sp   = env->stack + callee + 1;
+                    if (status)
+                        goto fail;
+                    goto returnTop;
+                }
+
+                fn          = ((Closure*)env->stack[callee].as.object)->compiled;
+                frame->fn   = fn;
+                frame->base = callee + 1 - (size_t)fn->firstParam;
+                sp          = env->stack + frame->base + fn->frameSize;
+            }
+
+            code      = CODE_OF(fn);
+            ip        = code;
+            base      = env->stack + frame->base;
+            constants = fn->constants;
+            NEXT();
+        }
+
+        TARGET(OP_RETURN)
+        returnTop:
+        {
+            result = sp[-1];
+            if (--env->frameLen == floor)
+                goto done;
+
+            // The result replaces the callee below the arguments
+            sp    = base + frame->fn->firstParam - 1;
+            *sp++ = result;
+
+            frame     = &env->frames[env->frameLen - 1];
+            code      = CODE_OF(frame->fn);
+            ip        = frame->ip;
+            base      = env->stack + frame->base;
+            constants = frame->fn->constants;
+            NEXT();
+        }
+
+#define SUPER_PAIR(name, a, b) \
+    TARGET(name)               \
+    EXEC_##a(ARG_AT(0));       \
+    CONTINUE_WITH(b, 1);
+#define SUPER_TRIPLE(name, a, b, c) \
+    TARGET(name)                    \
+    EXEC_##a(ARG_AT(0));            \
+    EXEC_##b(ARG_AT(1));            \
+    CONTINUE_WITH(c, 2);
+#include "superinstructions.h"
+#undef SUPER_PAIR
+#undef SUPER_TRIPLE
+
+        UNKNOWN
+            setEnvError(env, "unknown opcode: %d", OPCODE);
+            goto fail;
+#ifndef THREADED_DISPATCH
+        }
+    }
+#endif
+
+fail:
+    result        = UNDEFINED_VALUE;
+    env->frameLen = floor;
+done:
+    return result;
+}
+
+// The closure value called with argc arguments, or NULL after setting the
+// error of env if it cannot be
+static Closure* checkCallee(Environment* env, Value value, uint32_t argc)
+{
+    if (value.type != VALUE_CLOSURE
+        || !((Closure*)value.as.object)->compiled)
+    {
+        setEnvError(env, "not a function: %s", valueTypeName(value.type));
+        return NULL;
+    }
+
+    Closure* closure = (Closure*)value.as.object;
+    if (argc != (uint32_t)closure->compiled->numParams)
+    {
+        setEnvError(env, "wrong number of arguments: want=%d, got=%u",
+                    closure->compiled->numParams, argc);
+        return NULL;
+    }
+
+    return closure;
+}
+
+// Make room for the frame of fn, whose callee is at stack[callee] with the
+// arguments above it up to sp, and start its other locals undefined.
+// Returns the base of the frame, with sp moved to its end.
+static size_t enterFrame(Environment* env, CompiledFunction* fn,
+                         size_t callee, Value** sp)
+{
+    size_t base   = callee + 1 - (size_t)fn->firstParam;
+    size_t needed = base + (size_t)(fn->frameSize + fn->maxStack);
+    if (needed > env->stackCapacity)
+        growStack(env, sp, needed);
+
+    Value* frameEnd = env->stack + base + fn->frameSize;
+    while (*sp < frameEnd)
+        *(*sp)++ = UNDEFINED_VALUE;
+
+    return base;
+}
+
+// Run the checked call of the closure at stack[callee] in an interpreter
+// nested on the C stack, or natively. Returns 0 with the result in place of
+// the callee, or 1 after setting the error.
+static inline int callNested(Environment* env, size_t callee,
+                             uint32_t argc)
+{
+    Closure* closure = (Closure*)env->stack[callee].as.object;
+    Value* sp        = env->stack + callee + 1 + argc;
+    enterFrame(env, closure->compiled, callee, &sp);
+
+    int status = callNative(env, callee);
+    if (status >= 0)
+        return status;
+
+    // Native tail calls may have left another closure to run
+    CompiledFunction* fn = ((Closure*)env->stack[callee].as.object)->compiled;
+    Value result = execute(env, fn, callee + 1 - (size_t)fn->firstParam);
+    if (env->error)
+        return 1;
+    env->stack[callee] = result;
+    return 0;
+}
+
+// Answer the checked call of the closure at stack[callee] from the memo
+// table, or run it as callNested does and remember its result. Returns -1
+// to leave a call that cannot be memoized to the caller, or as callNested.
+static int callMemoized(Environment* env, size_t callee, uint32_t argc)
+{
+    Closure* closure = (Closure*)env->stack[callee].as.object;
+    MemoKey key;
+    if (env->nativeDepth >= MAX_NATIVE_DEPTH
+        || !makeMemoKey(closure->function, env->stack + callee + 1, argc,
+                        &key))
+        return -1;
+    if (lookUpMemo(env, &key, &env->stack[callee]))
+        return 0;
+
+    // Memoized calls nest on the C stack as native ones do
+    ++env->nativeDepth;
+    int status = callNested(env, callee, argc);
+    --env->nativeDepth;
+    if (status == 0)
+        storeMemo(env, &key, env->stack[callee]);
+    return status;
+}
+
+// Run the closure at stack[callee], whose frame is set up, natively if the
+// JIT compiled it, or can now that it was called often enough. A native
+// tail call leaves the next closure in its place, which runs the same way.
+// Returns -1 to leave the closure then at stack[callee] to the interpreter,
+// or the status of the native code.
+static int callNative(Environment* env, size_t callee)
+{
+    if (!env->jitThreshold || env->nativeDepth >= MAX_NATIVE_DEPTH)
+        return -1;
+
+    int status = NATIVE_TAIL_CALL;
+    while (status == NATIVE_TAIL_CALL)
+    {
+        Closure* closure     = (Closure*)env->stack[callee].as.object;
+        CompiledFunction* fn = closure->compiled;
+        if (!fn->native)
+        {
+            if (fn->calls < 0 || ++fn->calls < env->jitThreshold)
+                return -1;
+            if (!compileNative(fn))
+            {
+                fn->calls = -1;
+                return -1;
+            }
+        }
+
+        union
+        {
+            void* address;
+            NativeCode run;
+        } native = {fn->native};
+
+        ++env->nativeDepth;
+        status = native.run(env, callee + 1 - (size_t)fn->firstParam,
+                            closure);
+        --env->nativeDepth;
+    }
+
+    return status;
+}
+
+String* dumpCallCaches(const CompiledFunction* program)
+{
+    StringBuilder* sb = mkStringBuilder();
+    if (program)
+        dumpFunctionCaches(sb, program, 0);
+
+    String* output = buildString(sb);
+    freeStringBuilder(sb);
+    return output;
+}
+
+static void dumpFunctionCaches(StringBuilder* sb, const CompiledFunction* fn,
+                               int depth)
+{
+    char buffer[128];
+
+    for (int i = 0; i < depth; ++i)
+        builderAppendStr(sb, "  ");
+
+    if (!fn->function)
+    {
+        builderAppendStr(sb, "program");
+    }
+    else
+    {
+        FntExpr* fntExpr = fn->function->inner.fntExpr;
+        builderAppendStr(sb, "fn(");
+        struct ParamNode* tmp = fntExpr->parameters->tail->before;
+        while (tmp != fntExpr->parameters->head)
+        {
+            builderAppendString(sb, tmp->value->value);
+            if (tmp->before != fntExpr->parameters->head)
+                builderAppendStr(sb, ", ");
+            tmp = tmp->before;
+        }
+        builderAppendChar(sb, ')');
+    }
+    builderAppendChar(sb, '\n');
+
+    for (size_t i = 0; i < fn->numCallSites; ++i)
+    {
+        const CallCache* cache = &fn->callCaches[i];
+        uint64_t calls         = cache->hits + cache->misses;
+
+        for (int j = 0; j <= depth; ++j)
+            builderAppendStr(sb, "  ");
+
+        snprintf(buffer, sizeof(buffer),
+                 "call %zu: %" PRIu64 " calls, %" PRIu64 " hits (%.1f%%), ", i,
+                 calls, cache->hits,
+                 calls ? 100.0 * (double)cache->hits / (double)calls : 0.0);
+        builderAppendStr(sb, buffer);
+
+        if (cache->megamorphic)
+            builderAppendStr(sb, "megamorphic\n");
+        else if (cache->len == 0)
+            builderAppendStr(sb, "unused\n");
+        else if (cache->len == 1)
+            builderAppendStr(sb, "monomorphic\n");
+        else
+        {
+            snprintf(buffer, sizeof(buffer), "polymorphic (%d)\n",
+                     cache->len);
+            builderAppendStr(sb, buffer);
+        }
+    }
+
+    for (size_t i = 0; i < fn->numFunctions; ++i)
+        dumpFunctionCaches(sb, fn->functions[i], depth + 1);
+}
+
+DispatchProfile* mkDispatchProfile(void)
+{
+    DispatchProfile* output = calloc(1, sizeof(DispatchProfile));
+    output->last[0]         = -1;
+    output->last[1]         = -1;
+    return output;
+}
+
+void freeDispatchProfile(DispatchProfile* profile)
+{
+    free(profile);
+}
+
+int isDispatchProfiled(void)
+{
+#ifdef MONKEY_PROFILE_DISPATCH
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void setDispatchProfile(Environment* env, DispatchProfile* profile)
+{
+    env->profile = profile;
+}
+
+#ifdef MONKEY_PROFILE_DISPATCH
+static void countDispatch(DispatchProfile* profile, Opcode op)
+{
+    if (!profile)
+        return;
+
+    ++profile->dispatches;
+    if (op >= BASE_OPCODE_COUNT)
+    {
+        profile->last[0] = profile->last[1] = -1;
+        return;
+    }
+
+    int first  = profile->last[0];
+    int second = profile->last[1];
+    if (second >= 0)
+        ++profile->pairs[second][op];
+    if (first >= 0 && second >= 0)
+        ++profile->triples[first][second][op];
+
+    profile->last[0] = second;
+    profile->last[1] = (int)op;
+}
+#endif
+
+#ifdef THREADED_DISPATCH
+// Translate the code of fn on its first run. Unknown opcodes keep their
+// number in the operand for the error message.
+static const Instr* threadCode(CompiledFunction* fn,
+                               const void* const* handlers)
+{
+    if (fn->threaded)
+        return fn->threaded;
+
+    Instr* threaded = malloc(sizeof(Instr) * (fn->codeLen ? fn->codeLen : 1));
+    for (size_t i = 0; i < fn->codeLen; ++i)
+    {
+        Opcode op = INSTR_OP(fn->code[i]);
+        if ((unsigned)op < OPCODE_COUNT && handlers[op])
+        {
+            threaded[i].handler = handlers[op];
+            threaded[i].arg     = INSTR_ARG(fn->code[i]);
+        }
+        else
+        {
+            threaded[i].handler = handlers[OPCODE_COUNT];
+            threaded[i].arg     = (uint32_t)op << 24;
+        }
+    }
+
+    fn->threaded = threaded;
+    return threaded;
+}
+#endif
+
+static void binaryError(Environment* env, Opcode op, Value left, Value right)
+{
+    static const char* const operators[OPCODE_COUNT] = {
+        [OP_ADD] = "+", [OP_SUB] = "-", [OP_MUL] = "*",
+        [OP_DIV] = "/", [OP_LT] = "<",  [OP_GT] = ">",
+    };
+
+    setEnvError(env, "%s: %s %s %s",
+                left.type != right.type ? "type mismatch" : "unknown operator",
+                valueTypeName(left.type), operators[op],
+                valueTypeName(right.type));
+}
+
+// Replace the two strings below sp with their concatenation, leaving sp
+// to the caller. Returns 0 after setting the error when they are not both
+// strings.
+static int concatStrings(Environment* env, Value* sp)
+{
+    Value right = sp[-1];
+    Value left  = sp[-2];
+    if (left.type != VALUE_STRING || right.type != VALUE_STRING)
+    {
+        binaryError(env, OP_ADD, left, right);
+        return 0;
+    }
+
+    env->stackLen = (size_t)(sp - env->stack);
+    sp[-2]        = OBJECT_VALUE(VALUE_STRING,
+                                 newConcat(env, (Rope*)left.as.object,
+                                           (Rope*)right.as.object));
+    return 1;
+}
+
+// Make room for needed slots, moving sp along with the stack. Frames refer
+// to the stack by index, so they stay valid.
+static void growStack(Environment* env, Value** sp, size_t needed)
+{
+    size_t spIndex = (size_t)(*sp - env->stack);
+
+    while (env->stackCapacity < needed)
+        env->stackCapacity <<= 1;
+    env->stack = realloc(env->stack, sizeof(Value) * env->stackCapacity);
+
+    *sp = env->stack + spIndex;
+}
+
+static void growFrames(Environment* env)
+{
+    env->frameCapacity = env->frameCapacity ? env->frameCapacity << 1
+                                            : INITIAL_FRAME_CAPACITY;
+    env->frames = realloc(env->frames,
+                          sizeof(struct CallFrame) * env->frameCapacity);
+}
@@ -0,0 +1,52 @@
+#ifndef _MONKEY_LANG_SRC_VM_H_
+#define _MONKEY_LANG_SRC_VM_H_
+
+#include <stdint.h>
+
+#include "code.h"
+#include "environment.h"
+#include "object.h"
+
+// Run a program made by compileProgram with the same env. Returns the same
+// value eval would, and on a runtime error leaves the same message for
+// getEvalError.
+//
+// Operands and frames share the frame stack of env: a call finds its
+// arguments where the caller pushed them, which become the first slots of
+// the callee's frame. Once a function was called as often as the JIT
+// threshold of env, its calls run native code instead; see jit.h.
+Value runBytecode(CompiledFunction*, Environment*);
+
+// Calls, cache hits and state of each call site of program and of the
+// functions it creates, indented by nesting:
+//
+//   program
+//     call 0: 1 calls, 0 hits (0.0%), monomorphic
+//     fn(n)
+//       call 0: 20 calls, 19 hits (95.0%), monomorphic
+String* dumpCallCaches(const CompiledFunction* program);
+
+// "threaded" when runBytecode dispatches through computed goto, "switch"
+// when built with MONKEY_SWITCH_DISPATCH or a compiler without it
+const char* getDispatchMode(void);
+
+// What runBytecode dispatched, in builds with MONKEY_PROFILE_DISPATCH:
+// every dispatch, and the sequences of two and three plain instructions
+// that ran in a row
+typedef struct DispatchProfile
+{
+    uint64_t dispatches;
+    uint64_t pairs[BASE_OPCODE_COUNT][BASE_OPCODE_COUNT];
+    uint64_t triples[BASE_OPCODE_COUNT][BASE_OPCODE_COUNT][BASE_OPCODE_COUNT];
+    int last[2]; // the two instructions dispatched last, or -1
+} DispatchProfile;
+
+DispatchProfile* mkDispatchProfile(void);
+void freeDispatchProfile(DispatchProfile*);
+// Whether runBytecode was built to count its dispatches
+int isDispatchProfiled(void);
+// Add the dispatches of the programs run in env to profile, or stop with
+// NULL. The profile is shared, not owned, by env.
+void setDispatchProfile(Environment*, DispatchProfile*);
+
+#endif //_MONKEY_LANG_SRC_VM_H_
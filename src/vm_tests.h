@@ -0,0 +1,1214 @@
+#define MAIN_TEST_NAME TestVM
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asmEmitter.h"
+#include "capture.h"
+#include "cEmitter.h"
+#include "closureCompiler.h"
+#include "code.h"
+#include "compiler.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "hashCons.h"
+#include "jit.h"
+#include "memo.h"
+#include "parser.h"
+#include "purity.h"
+#include "registerCode.h"
+#include "registerCompiler.h"
+#include "registerVM.h"
+#include "resolver.h"
+#include "testing.h"
+#include "vm.h"
+
+// Engines runForTest can run a program with
+enum
+{
+    RUN_EVAL = 0,
+    RUN_STACK_VM,
+    RUN_SUPER_VM, // stack VM with superinstructions
+    RUN_JIT_VM,   // stack VM compiling functions on their first call
+    RUN_REGISTER_VM,
+    RUN_CLOSURES,
+    RUN_EMITTED_C,   // printed by emitC, built with the system cc
+    RUN_EMITTED_ASM, // printed by emitAsm, assembled with the system cc
+};
+
+/* Function Signatures */
+Program* parseForVM(Environment*, const char*);
+String* runForTest(Environment*, const char*, int);
+String* runProgramForTest(Environment*, Program*, int);
+int hasCCompiler(void);
+String* runEmittedC(const String*, int);
+
+Program* parseForVM(Environment* env, const char* input)
+{
+    Program* program = parseForTest(input, getResolver(env));
+    if (program)
+    {
+        analyzeCaptures(program);
+        analyzePurity(program);
+    }
+    return program;
+}
+
+// The inspected value of the program run by the given engine, or
+// "ERROR: <message>"
+String* runForTest(Environment* env, const char* input, int engine)
+{
+    Program* program = parseForVM(env, input);
+    if (!program)
+        return mkString("PARSE ERROR");
+    return runProgramForTest(env, program, engine);
+}
+
+// runForTest of a program already analyzed, which it frees
+String* runProgramForTest(Environment* env, Program* program, int engine)
+{
+    Value result = UNDEFINED_VALUE;
+    if (engine == RUN_EVAL)
+    {
+        result = eval(program, env);
+    }
+    else if (engine == RUN_EMITTED_C || engine == RUN_EMITTED_ASM)
+    {
+        int isAsm      = engine == RUN_EMITTED_ASM;
+        String* source = isAsm ? emitAsm(program) : emitC(program);
+        String* output = runEmittedC(source, isAsm);
+        freeString(source);
+        freeProgram(program);
+        return output;
+    }
+    else if (engine == RUN_CLOSURES)
+    {
+        NodeTree* compiled = compileClosures(program, env);
+        result = runClosures(compiled, env);
+        freeObject(&compiled->object);
+    }
+    else if (engine != RUN_REGISTER_VM)
+    {
+        CompiledFunction* compiled = compileProgram(program, env);
+        if (compiled && engine != RUN_STACK_VM)
+            fuseInstructions(compiled);
+        if (compiled)
+        {
+            setJitThreshold(env, engine == RUN_JIT_VM);
+            result = runBytecode(compiled, env);
+            freeObject(&compiled->object);
+        }
+    }
+    else
+    {
+        CompiledFunction* compiled = compileRegisters(program, env);
+        if (compiled)
+        {
+            result = runRegisters(compiled, env);
+            freeObject(&compiled->object);
+        }
+    }
+    freeProgram(program);
+
+    String* error = getEvalError(env);
+    if (!error)
+        return inspectValue(result);
+
+    String* output = mkString("ERROR: ");
+    concatFreeString(output, error);
+    return output;
+}
+
+int hasCCompiler(void)
+{
+    static int found = -1;
+    if (found < 0)
+        found = system("cc --version > /dev/null 2>&1") == 0;
+    return found;
+}
+
+// Build source, C or assembly, against runtime/ and run it, giving its
+// output as runForTest does
+String* runEmittedC(const String* source, int isAsm)
+{
+    char path[] = "/tmp/monkeyXXXXXX";
+    int fd      = mkstemp(path);
+    if (fd < 0)
+        return mkString("CANNOT WRITE");
+
+    FILE* file = fdopen(fd, "w");
+    fputs(getStr(source), file);
+    fclose(file);
+
+    char command[256];
+    if (isAsm)
+        snprintf(command, sizeof(command),
+                 "cc -x assembler %s -x c -std=c11 runtime/asmRuntime.c "
+                 "-Iruntime -o %s.out",
+                 path, path);
+    else
+        snprintf(command, sizeof(command),
+                 "cc -std=c11 -O0 -Iruntime -x c %s -o %s.out", path, path);
+    String* output = NULL;
+    if (system(command) != 0)
+    {
+        output = mkString("CC ERROR");
+    }
+    else
+    {
+        snprintf(command, sizeof(command), "%s.out 2>&1", path);
+        FILE* run = popen(command, "r");
+        char buffer[256];
+        size_t len;
+
+        output = mkString("");
+        while ((len = fread(buffer, 1, sizeof(buffer), run)) > 0)
+            appendNStr(output, buffer, len);
+        pclose(run);
+    }
+
+    snprintf(command, sizeof(command), "%s.out", path);
+    remove(command);
+    remove(path);
+
+    // A value is printed on a line of its own, an error as the CLI does
+    const char* str = getStr(output);
+    size_t len      = getLen(output);
+    if (len > 0 && str[len - 1] == '\n')
+        --len;
+    size_t skip     = strncmp(str, "[ERROR]: ", 9) == 0 ? 9 : 0;
+    String* got     = mkString(skip ? "ERROR: " : "");
+    appendNStr(got, str + skip, len - skip);
+    freeString(output);
+    return got;
+}
+
+TEST(CompileToBytecode)
+{
+    int testStatus = TEST_SUCESSED;
+    struct
+    {
+        const char* input;
+        const char* expected;
+    } tests[] = {
+        {"1 + 2; 1",
+         "0000 OP_CONSTANT 0\n0001 OP_CONSTANT 1\n0002 OP_ADD\n0003 OP_POP\n"
+         "0004 OP_CONSTANT 0\n0005 OP_RETURN\n"},
+        {"let a = !true; -a",
+         "0000 OP_TRUE\n0001 OP_BANG\n0002 OP_SET_GLOBAL 0\n"
+         "0003 OP_GET_GLOBAL 0\n0004 OP_MINUS\n0005 OP_RETURN\n"},
+        {"if (true) { 10 }; let a = 1;",
+         "0000 OP_TRUE\n0001 OP_JUMP_FALSY 4\n0002 OP_CONSTANT 0\n"
+         "0003 OP_JUMP 5\n0004 OP_NULL\n0005 OP_POP\n0006 OP_CONSTANT 1\n"
+         "0007 OP_SET_GLOBAL 0\n0008 OP_UNDEFINED\n0009 OP_RETURN\n"},
+        {"let f = fn(a) { a }; f(1)",
+         "0000 OP_CLOSURE 0\n0001 OP_SET_GLOBAL 0\n0002 OP_GET_GLOBAL 0\n"
+         "0003 OP_CONSTANT 0\n0004 OP_CALL 1\n0005 OP_RETURN\n"},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        Environment* env = mkEnvironment();
+        Program* program = parseForVM(env, tests[i].input);
+        if (!program)
+        {
+            freeEnvironment(env);
+            return TEST_FAILED;
+        }
+
+        CompiledFunction* compiled = compileProgram(program, env);
+        String* got = disassemble(compiled);
+        if (cmpStringStr(got, tests[i].expected) != 0)
+        {
+            PRINT_ERR("`%s`: expected\n%s\ngot =\n%s", tests[i].input,
+                      tests[i].expected, getStr(got));
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeObject(&compiled->object);
+        freeProgram(program);
+        freeEnvironment(env);
+    }
+
+    return testStatus;
+}
+
+TEST(CompileFunctionBodies)
+{
+    int testStatus = TEST_SUCESSED;
+    Environment* env = mkEnvironment();
+    Program* program = parseForVM(
+        env, "fn(a) { let b = a * 2; fn() { a + b } }; fn(x, x) { x }");
+    if (!program)
+    {
+        freeEnvironment(env);
+        return TEST_FAILED;
+    }
+
+    CompiledFunction* compiled = compileProgram(program, env);
+    const char* expected[] = {
+        "0000 OP_GET_LOCAL 0\n0001 OP_CONSTANT 0\n0002 OP_MUL\n"
+        "0003 OP_SET_LOCAL 1\n0004 OP_CLOSURE 0\n0005 OP_RETURN\n",
+        // The second argument arrives in slot 1 and belongs in slot 0
+        "0000 OP_GET_LOCAL 1\n0001 OP_SET_LOCAL 0\n0002 OP_GET_LOCAL 0\n"
+        "0003 OP_RETURN\n",
+    };
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        String* got = disassemble(compiled->functions[i]);
+        if (cmpStringStr(got, expected[i]) != 0)
+        {
+            PRINT_ERR("function %zu: expected\n%s\ngot =\n%s", i,
+                      expected[i], getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        freeString(got);
+    }
+
+    freeObject(&compiled->object);
+    freeProgram(program);
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(CompileHotFunctions)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* input =
+        "let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) };"
+        "let mk = fn(n) { fn() { n } };"
+        "let sum = fn(n) { if (n == 0) { 0 } else { n + sum(n - 1) } };"
+        "fib(15) + mk(1)() + mk(2)() + mk(3)() + sum(20000)";
+
+    // Off, then compiling after three calls. Calls nested deeper than the
+    // C stack allows stay in the interpreter.
+    for (int threshold = 0; threshold <= 3; threshold += 3)
+    {
+        Environment* env = mkEnvironment();
+        Program* program = parseForVM(env, input);
+        if (!program)
+        {
+            freeEnvironment(env);
+            return TEST_FAILED;
+        }
+
+        CompiledFunction* compiled = compileProgram(program, env);
+        setJitThreshold(env, threshold);
+        Value result = runBytecode(compiled, env);
+
+        if (result.type != VALUE_INT || result.as.integer != 200010616)
+        {
+            String* got = inspectValue(result);
+            PRINT_ERR("threshold %d: expected 200010616, got = %s", threshold,
+                      getStr(got));
+            freeString(got);
+            testStatus = TEST_FAILED;
+        }
+
+        // Closures are created by the interpreter only
+        int native = threshold && isJitSupported();
+        if ((compiled->functions[0]->native != NULL) != native
+            || compiled->functions[1]->native
+            || (compiled->functions[2]->native != NULL) != native)
+        {
+            PRINT_ERR("threshold %d: wrong functions compiled", threshold);
+            testStatus = TEST_FAILED;
+        }
+
+        freeObject(&compiled->object);
+        freeProgram(program);
+        freeEnvironment(env);
+    }
+
+    return testStatus;
+}
+
+TEST(NestInterpreterInNativeCalls)
+{
+    int testStatus   = TEST_SUCESSED;
+    Environment* env = mkEnvironment();
+    const char* inputs[][2] = {
+        {"let f = fn(n) { if (n < 1) { 0 } else { g(n - 1) + 1 } };"
+         "let g = fn(n) { let h = fn() { n }; f(h()) }; f(5000)",
+         "5000"},
+        {"f(3000) + f(10)", "3010"},
+    };
+
+    // g makes a closure and stays in the interpreter, which native code of
+    // f enters once per call on the frames of the outer interpreter
+    for (size_t i = 0; i < 2; ++i)
+    {
+        String* got = runForTest(env, inputs[i][0], RUN_JIT_VM);
+        if (cmpStringStr(got, inputs[i][1]) != 0)
+        {
+            PRINT_ERR("`%s`: expected `%s`, got = `%s`", inputs[i][0],
+                      inputs[i][1], getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        freeString(got);
+    }
+
+    freeEnvironment(env);
+    return testStatus;
+}
+
+// Every program must give the same result in eval, in every VM, and
+// translated to C when there is a C compiler
+TEST(MatchEvaluator)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* corpus[] = {
+        "5 + 5 * 2 - 10 / 2",
+        "(5 + 10 * 2 + 15 / 3) * 2 + -10",
+        "9223372036854775807 + 1",
+        "let m = -9223372036854775807 - 1; m / -1",
+        "1 < 2 == true",
+        "!5",
+        "!!false",
+        "1 == true",
+        "if (1 > 2) { 10 }",
+        "if (1) { 10 } else { 20 }",
+        "if (false) { 10 } else { let a = 1; }",
+        "let a = 5; let b = a; let c = a + b + 5; c;",
+        "let a = 5;",
+        "9; return 2 * 5; 9;",
+        "if (10 > 1) { if (10 > 1) { return 10; } return 1; }",
+        "let f = fn(x) { if (x > 1) { return x; } 0 }; f(3) + f(1)",
+        "let f = fn() { let a = 1; }; f()",
+        "let f = fn(x) { let y = if (x) { return 1; } else { 2 }; y + 10 }; "
+        "f(true) * 100 + f(false)",
+        "5 + true; 5",
+        "-true",
+        "if (10 > 1) { true + false; 1 }",
+        "1 / 0",
+        "5()",
+        "let f = fn(x) { x }; f(1, 2)",
+        "let f = fn() { g }; f(); let g = 1;",
+        "fn(x) { x + 2 }",
+        "fn(x) { x; }(5)",
+        "let add = fn(a, b) { a + b }; add(5 + 5, add(5, 5));",
+        "let f = fn() { g() }; let g = fn() { 7 }; f()",
+        "let newAdder = fn(x) { fn(y) { x + y } }; newAdder(2)(3)",
+        "let f = fn(a) { fn(b) { fn(c) { a * 100 + b * 10 + c } } }; "
+        "f(1)(2)(3)",
+        "let f = fn(n) { let g = fn() { f(n - 1) }; if (n > 0) { g() } "
+        "else { 0 } }; f(3)",
+        "let a = 1; let f = fn() { a }; let a = 2; f()",
+        "let f = fn(x, x) { x }; f(1, 2)",
+        "let f = fn(a) { fn() { a } }; f(1) == f(1)",
+        "let f = fn() { 1 }; f == f",
+        "let sum = fn(n) { if (n == 0) { 0 } else { n + sum(n - 1) } }; "
+        "sum(1000)",
+        "let f = fn(a, b, c, d, e) { a - b * c + d / e }; f(1, 2, 3, 40, 5)",
+        "let f = fn(x) { let y = x; let x = y + 1; x * y }; f(4)",
+        "let f = fn(n) { if (n) { 1 } }; f(false)",
+        "let a = 1; if (a) { let a = 2; a } else { 3 }",
+        "let f = fn(x) { x + true }; f(1)",
+        "let f = fn(x) { -x }; f(true)",
+        "let f = fn(x, y) { x / y }; f(7, -2) * 10 + f(1, 0)",
+        "let f = fn(x) { x / -1 }; f(-9223372036854775807 - 1)",
+        "let f = fn(a, b) { if (a == b) { !a } else { a != b } }; "
+        "if (f(1, true)) { if (f(f, f)) { 1 } else { f(false, false) } } "
+        "else { 3 }",
+        "let f = fn(a) { if (!a) { 1 } else { if (a > 3) { 2 } } }; "
+        "f(0) + f(4) * 10",
+        "let f = fn(a) { if (!a) { 1 } else { if (a > 3) { 2 } } }; f(1)",
+        "[1, 2 * 2, [], fn(x) { x }]",
+        "let a = [1, [2, 3]]; a[1][0] + a[0] * 10",
+        "[1, 2, 3][3] == [1][-1]",
+        "{1: 2, true: 3, 1: 7}",
+        "let h = {5 - 4: fn(x) { x * 2 }, false: [1]}; h[1](h[false][0])",
+        "let f = fn(a, b) { let x = [a, b, a + b, {a: b, b: a}]; "
+        "x[3][a] + x[2] }; f(1, 2) * 100 + f(3, 4)",
+        "let f = fn(k) { {k: k * 2, true: !k}[k] }; f(21)",
+        "let a = [1]; [a == a, [1] == [1], {} == {}]",
+        "if ([]) { {} } else { 1 }",
+        "{[1]: 2}",
+        "{1: 2}[fn(x) { x }]",
+        "let f = fn(x) { x[0] }; f(1)",
+        "[1][true]",
+        "[1] + [2]",
+        "let s = \"ab\"; [s + \"c\", s[1], s[2], \"\" + s == s, \"a\" != s]",
+        "let f = fn(n, s) { if (n == 0) { s } else { f(n - 1, s + \"xy\") } }; "
+        "let s = f(100, \"\"); [s[0], s[199], s[200], s == f(100, \"\")]",
+        "let f = fn(a, b) { a + b }; [f(1, 2), f(\"1\", \"2\"), f(\"\", \"\")]",
+        "let h = {\"k\": 1, \"long key of more than 32 characters\": 2}; "
+        "h[\"k\"] + h[\"long key of more\" + \" than 32 characters\"]",
+        "if (\"\") { \"a\" } else { \"b\" }",
+        "\"a\" * \"b\"",
+        "let f = fn(x) { x + \"s\" }; f(1)",
+        "\"abc\"[true]",
+    };
+
+    int lastEngine = hasCCompiler() ? RUN_EMITTED_C : RUN_CLOSURES;
+#if defined(__x86_64__) && defined(__linux__)
+    if (hasCCompiler())
+        lastEngine = RUN_EMITTED_ASM;
+#endif
+    for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); ++i)
+    {
+        Environment* evalEnv = mkEnvironment();
+        String* expected = runForTest(evalEnv, corpus[i], RUN_EVAL);
+
+        for (int engine = RUN_STACK_VM; engine <= lastEngine; ++engine)
+        {
+            Environment* vmEnv = mkEnvironment();
+            String* got = runForTest(vmEnv, corpus[i], engine);
+
+            if (cmpString(got, expected) != 0)
+            {
+                PRINT_ERR("`%s`: eval gives `%s`, engine %d = `%s`",
+                          corpus[i], getStr(expected), engine, getStr(got));
+                testStatus = TEST_FAILED;
+            }
+
+            freeString(got);
+            freeEnvironment(vmEnv);
+        }
+
+        freeString(expected);
+        freeEnvironment(evalEnv);
+    }
+
+    return testStatus;
+}
+
+// A superinstruction replaces only the opcode of the first instruction of
+// its sequence
+TEST(FuseInstructions)
+{
+    int testStatus = TEST_SUCESSED;
+    Environment* env = mkEnvironment();
+    Program* program = parseForVM(
+        env, "let fib = fn(n) { if (n < 2) { return n; } "
+             "fib(n - 1) + fib(n - 2) }; fib(10) * 2 + 1");
+    if (!program)
+    {
+        freeEnvironment(env);
+        return TEST_FAILED;
+    }
+
+    CompiledFunction* compiled = compileProgram(program, env);
+    CompiledFunction* fns[] = {compiled, compiled->functions[0]};
+    uint32_t* original[2];
+    size_t fused = 0;
+
+    for (size_t f = 0; f < 2; ++f)
+    {
+        original[f] = malloc(sizeof(uint32_t) * fns[f]->codeLen);
+        memcpy(original[f], fns[f]->code, sizeof(uint32_t) * fns[f]->codeLen);
+    }
+    fuseInstructions(compiled);
+
+    for (size_t f = 0; f < 2; ++f)
+    {
+        CompiledFunction* fn = fns[f];
+        for (size_t i = 0; i < fn->codeLen; ++i)
+        {
+            Opcode parts[MAX_SUPER_LENGTH];
+            int len = getSuperinstruction(INSTR_OP(fn->code[i]), parts);
+            int matches = INSTR_ARG(fn->code[i]) == INSTR_ARG(original[f][i])
+                       && (len > 0 || fn->code[i] == original[f][i]);
+
+            for (int j = 0; j < len && matches; ++j)
+                matches = i + (size_t)j < fn->codeLen
+                       && INSTR_OP(original[f][i + (size_t)j]) == parts[j];
+
+            if (!matches)
+            {
+                PRINT_ERR("function %zu: %s at %zu does not stand for the "
+                          "code behind it", f,
+                          opcodeName(INSTR_OP(fn->code[i])), i);
+                testStatus = TEST_FAILED;
+            }
+            fused += len > 0;
+        }
+        free(original[f]);
+    }
+
+    // Only the training profile decides which sequences are fused
+    if (OPCODE_COUNT > BASE_OPCODE_COUNT && fused == 0)
+    {
+        PRINT_ERR("expected fib to use superinstructions, got = %zu", fused);
+        testStatus = TEST_FAILED;
+    }
+
+    freeObject(&compiled->object);
+    freeProgram(program);
+    freeEnvironment(env);
+    return testStatus;
+}
+
+// Sites calling one closure stay monomorphic, and those calling a fresh
+// closure each time give up after CALL_CACHE_ENTRIES
+TEST(CacheCallSites)
+{
+    int testStatus = TEST_SUCESSED;
+    Environment* env = mkEnvironment();
+    Program* program = parseForVM(
+        env, "let inc = fn(x) { x + 1 }; let dec = fn(x) { x - 1 };"
+             "let apply = fn(h, x) { h(x) };"
+             "apply(inc, apply(dec, apply(inc, 1)));"
+             "let mk = fn(n) { fn() { n } };"
+             "let each = fn(n) { if (n > 0) { mk(n)(); each(n - 1) } };"
+             "each(6)");
+    if (!program)
+    {
+        freeEnvironment(env);
+        return TEST_FAILED;
+    }
+
+    CompiledFunction* compiled = compileProgram(program, env);
+    runBytecode(compiled, env);
+
+    const char* expected =
+        "program\n"
+        "  call 0: 1 calls, 0 hits (0.0%), monomorphic\n"
+        "  call 1: 1 calls, 0 hits (0.0%), monomorphic\n"
+        "  call 2: 1 calls, 0 hits (0.0%), monomorphic\n"
+        "  call 3: 1 calls, 0 hits (0.0%), monomorphic\n"
+        "  fn(x)\n"
+        "  fn(x)\n"
+        "  fn(h, x)\n"
+        "    call 0: 3 calls, 1 hits (33.3%), polymorphic (2)\n"
+        "  fn(n)\n"
+        "    fn()\n"
+        "  fn(n)\n"
+        "    call 0: 6 calls, 5 hits (83.3%), monomorphic\n"
+        "    call 1: 6 calls, 0 hits (0.0%), megamorphic\n"
+        "    call 2: 6 calls, 5 hits (83.3%), monomorphic\n";
+
+    String* got = dumpCallCaches(compiled);
+    if (cmpStringStr(got, expected) != 0)
+    {
+        PRINT_ERR("expected\n%s\ngot =\n%s", expected, getStr(got));
+        testStatus = TEST_FAILED;
+    }
+
+    freeString(got);
+    freeObject(&compiled->object);
+    freeProgram(program);
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(CompileToRegisters)
+{
+    int testStatus = TEST_SUCESSED;
+    struct
+    {
+        const char* input;
+        const char* expected;
+    } tests[] = {
+        {"let a = 1 + 2; -a",
+         "0000 R_ADD r0 k0 k1\n0002 R_SET_GLOBAL r0 0\n0004 R_GET_GLOBAL r0 0\n"
+         "0006 R_MINUS r0 r0\n0008 R_RETURN r0\n"},
+        {"let f = fn(a, b) { a }; f(1, 2)",
+         "0000 R_CLOSURE r0 0\n0002 R_SET_GLOBAL r0 0\n"
+         "0004 R_GET_GLOBAL r0 0\n0006 R_CALL r0 r0 2\n0008 R_ARGS k0 k1\n"
+         "0010 R_RETURN r0\n"},
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        Environment* env = mkEnvironment();
+        Program* program = parseForVM(env, tests[i].input);
+        if (!program)
+        {
+            freeEnvironment(env);
+            return TEST_FAILED;
+        }
+
+        CompiledFunction* compiled = compileRegisters(program, env);
+        String* got = disassembleRegisters(compiled);
+        if (cmpStringStr(got, tests[i].expected) != 0)
+        {
+            PRINT_ERR("`%s`: expected\n%s\ngot =\n%s", tests[i].input,
+                      tests[i].expected, getStr(got));
+            testStatus = TEST_FAILED;
+        }
+
+        freeString(got);
+        freeObject(&compiled->object);
+        freeProgram(program);
+        freeEnvironment(env);
+    }
+
+    return testStatus;
+}
+
+// Temporaries whose lives do not overlap share a register
+TEST(AllocateRegisters)
+{
+    int testStatus = TEST_SUCESSED;
+    Environment* env = mkEnvironment();
+    Program* program = parseForVM(
+        env, "let fib = fn(n) { if (n < 2) { return n; } "
+             "fib(n - 1) + fib(n - 2) };");
+    if (!program)
+    {
+        freeEnvironment(env);
+        return TEST_FAILED;
+    }
+
+    CompiledFunction* compiled = compileRegisters(program, env);
+    CompiledFunction* fib = compiled->functions[0];
+    const char* expected =
+        "0000 R_LT r2 r1 k0\n0002 R_JUMP_FALSY r2 6\n0004 R_RETURN r1\n"
+        "0006 R_SUB r2 r1 k1\n0008 R_CALL r2 r0 1\n0010 R_ARGS r2\n"
+        "0012 R_SUB r3 r1 k0\n0014 R_CALL r3 r0 1\n0016 R_ARGS r3\n"
+        "0018 R_ADD r2 r2 r3\n0020 R_RETURN r2\n";
+
+    String* got = disassembleRegisters(fib);
+    if (cmpStringStr(got, expected) != 0)
+    {
+        PRINT_ERR("expected\n%s\ngot =\n%s", expected, getStr(got));
+        testStatus = TEST_FAILED;
+    }
+    if (fib->frameSize != 4)
+    {
+        PRINT_ERR("expected a frame of 4 registers, got = %d", fib->frameSize);
+        testStatus = TEST_FAILED;
+    }
+
+    freeString(got);
+    freeObject(&compiled->object);
+    freeProgram(program);
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(SpecializeHandlers)
+{
+    int testStatus = TEST_SUCESSED;
+    Environment* env = mkEnvironment();
+    Program* program = parseForVM(
+        env, "let fib = fn(n) { if (n < 2) { return n; } "
+             "fib(n - 1) + fib(n - 2) }; if (fib(10) == 55) { -fib(3) }");
+    if (!program)
+    {
+        freeEnvironment(env);
+        return TEST_FAILED;
+    }
+
+    NodeTree* compiled = compileClosures(program, env);
+    const char* expected =
+        "block\n  let-global 0\n    function\n      block\n        if\n"
+        "          less-local-constant 1 2\n          return\n"
+        "            local 1\n        add\n          call\n"
+        "            local 0\n            sub-local-constant 1 1\n"
+        "          call\n            local 0\n"
+        "            sub-local-constant 1 2\n  if\n    equal-constant 55\n"
+        "      call\n        global 0\n        constant 10\n    negate\n"
+        "      call\n        global 0\n        constant 3\n";
+
+    String* got = dumpNodes(compiled);
+    if (cmpStringStr(got, expected) != 0)
+    {
+        PRINT_ERR("expected\n%s\ngot =\n%s", expected, getStr(got));
+        testStatus = TEST_FAILED;
+    }
+    freeString(got);
+
+    got = inspectValue(runClosures(compiled, env));
+    if (cmpStringStr(got, "-2") != 0)
+    {
+        PRINT_ERR("expected `-2`, got = `%s`", getStr(got));
+        testStatus = TEST_FAILED;
+    }
+
+    freeString(got);
+    freeObject(&compiled->object);
+    freeProgram(program);
+    freeEnvironment(env);
+    return testStatus;
+}
+
+TEST(RunAcrossPrograms)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let a = 2; let f = fn(x) { x * a };", "f(21)", "let a = 3; f(2)",
+        "let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) };",
+        "fib(25)"};
+    const char* expected[] = {"", "42", "6", "", "75025"};
+
+    for (int engine = RUN_STACK_VM; engine <= RUN_CLOSURES; ++engine)
+    {
+        Environment* env = mkEnvironment();
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            String* got = runForTest(env, inputs[i], engine);
+            if (cmpStringStr(got, expected[i]) != 0)
+            {
+                PRINT_ERR("`%s`: expected `%s`, got = `%s`", inputs[i],
+                          expected[i], getStr(got));
+                testStatus = TEST_FAILED;
+            }
+            freeString(got);
+        }
+        freeEnvironment(env);
+    }
+    return testStatus;
+}
+
+// Collecting on every closure leaves no value an engine holds unrooted:
+// results match eval, across programs run in the same environment
+TEST(CollectOnEveryClosure)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let adder = fn(x) { fn(y) { fn(z) { x + y + z } } };",
+        "adder(1)(2)(3) + adder(4)(5)(6)",
+        "adder(1) == adder(1)",
+        "let twice = fn(f) { fn(x) { f(f(x)) } }; twice(adder(1)(1))(5)",
+        "let count = fn(n) { if (n < 1) { adder } else { adder(n)(n); "
+        "count(n - 1) } }; count(200)(1)(1)(1)",
+        "let pick = fn(a, b) { if (a(0)(0) > b(0)(0)) { a } else { b } }; "
+        "pick(adder(2), adder(3))(1)(1)",
+        "let keep = adder(10)(20); keep(30) + twice(fn(x) { x * 2 })(3)",
+        "let late = fn(x) { fn(y) { let g = fn() { y }; x + g() } }; "
+        "late(1)(2)",
+    };
+    const char* expected[] = {"", "21", "false", "9", "3", "5", "72", "3"};
+
+    for (int engine = RUN_EVAL; engine <= RUN_CLOSURES; ++engine)
+    {
+        Environment* env = mkEnvironment();
+        setHeapGrowth(env, 0);
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            String* got = runForTest(env, inputs[i], engine);
+            if (cmpStringStr(got, expected[i]) != 0)
+            {
+                PRINT_ERR("`%s`: expected `%s`, engine %d = `%s`", inputs[i],
+                          expected[i], engine, getStr(got));
+                testStatus = TEST_FAILED;
+            }
+            freeString(got);
+        }
+        if (getGCStats(env).collections == 0)
+        {
+            PRINT_ERR("engine %d never collected", engine);
+            testStatus = TEST_FAILED;
+        }
+        freeEnvironment(env);
+    }
+    return testStatus;
+}
+
+TEST(MoveClosuresOutOfTheNursery)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let add = fn(a) { fn(b) { a + b } }; let f = add(10);",
+        "let sum = fn(n, acc) { if (n > 0) { let g = add(n); "
+        "sum(n - 1, acc + g(1) + f(0)) } else { acc } }; sum(500, 0)",
+        "let loop = fn(n) { if (n > 0) { add(n); f(n); loop(n - 1) } "
+        "else { f(0) } }; loop(300)",
+        "let pair = fn(x) { fn(y, z) { x + y + z } }; "
+        "let mix = fn(n) { if (n > 0) { add(n)(1); pair(n)(1, 1); mix(n - 1) }"
+        " else { 0 } }; mix(400)",
+    };
+    const char* expected[] = {"", "130750", "10", "0"};
+
+    // Call sites keep seeing young closures, moved or dead, whose addresses
+    // the nursery hands out again
+    for (int engine = RUN_EVAL; engine <= RUN_CLOSURES; ++engine)
+    {
+        Environment* env = mkEnvironment();
+        setNurserySize(env, 1024);
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            String* got = runForTest(env, inputs[i], engine);
+            if (cmpStringStr(got, expected[i]) != 0)
+            {
+                PRINT_ERR("`%s`: expected `%s`, engine %d = `%s`", inputs[i],
+                          expected[i], engine, getStr(got));
+                testStatus = TEST_FAILED;
+            }
+            freeString(got);
+        }
+        // Dead young closures are counted without being looked at
+        GCStats stats = getGCStats(env);
+        if (stats.minorCollections == 0)
+        {
+            PRINT_ERR("engine %d never emptied the nursery", engine);
+            testStatus = TEST_FAILED;
+        }
+        else if (stats.freed == 0)
+        {
+            PRINT_ERR("engine %d freed no young closure", engine);
+            testStatus = TEST_FAILED;
+        }
+        freeEnvironment(env);
+    }
+    return testStatus;
+}
+
+TEST(MarkIncrementally)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let make = fn(x) { fn() { x } }; "
+        "let tree = fn(d) { if (d > 0) { let l = tree(d - 1); "
+        "let r = tree(d - 1); make(d); fn(f) { f(l, r, d) } } "
+        "else { make(1) } };",
+        "let total = fn(t, d) { if (d > 0) { t(fn(l, r, x) { "
+        "total(l, d - 1) + total(r, d - 1) + x }) } else { t() } };",
+        "let big = tree(14); let spin = fn(n) { if (n > 0) { make(n); "
+        "spin(n - 1); spin(n - 1) } else { 0 } }; spin(14); total(big, 14)",
+    };
+    const char* expected[] = {"", "", "49136"};
+
+    // The tree is built, and read, while its older parts are being marked,
+    // with young closures and without
+    for (int engine = RUN_EVAL; engine <= RUN_CLOSURES; ++engine)
+    {
+        for (size_t nursery = 0; nursery <= 4096; nursery += 4096)
+        {
+            Environment* env = mkEnvironment();
+            setNurserySize(env, nursery);
+            setMarkBudget(env, 4);
+            for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+            {
+                String* got = runForTest(env, inputs[i], engine);
+                if (cmpStringStr(got, expected[i]) != 0)
+                {
+                    PRINT_ERR("`%s`: expected `%s`, engine %d = `%s`",
+                              inputs[i], expected[i], engine, getStr(got));
+                    testStatus = TEST_FAILED;
+                }
+                freeString(got);
+            }
+
+            GCStats stats = getGCStats(env);
+            if (stats.collections == 0 || stats.markSlices == 0)
+            {
+                PRINT_ERR("engine %d with a nursery of %zu bytes never "
+                          "marked incrementally",
+                          engine, nursery);
+                testStatus = TEST_FAILED;
+            }
+            freeEnvironment(env);
+        }
+    }
+    return testStatus;
+}
+
+TEST(CollectArraysAndHashes)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let add = fn(a) { fn(b) { a + b } }; let keep = [add(1), {1: add(2)}];",
+        "let build = fn(n, acc) { if (n > 0) { "
+        "build(n - 1, [add(n), {n: add(n), true: acc}, acc][1]) } "
+        "else { acc } };",
+        "let walk = fn(h, n, sum) { if (n < 301) { "
+        "walk(h[true], n + 1, sum + h[n](1)) } else { sum } }; "
+        "walk(build(300, {}), 1, 0)",
+        "keep[0](1) + keep[1][1](1)",
+    };
+    const char* expected[] = {"", "", "45450", "5"};
+
+    // Arrays and hashes start out old and hold young closures, which a
+    // minor collection must find through them
+    for (int engine = RUN_EVAL; engine <= RUN_CLOSURES; ++engine)
+    {
+        Environment* env = mkEnvironment();
+        setHeapGrowth(env, 0);
+        setNurserySize(env, 1024);
+        setMarkBudget(env, 4);
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            String* got = runForTest(env, inputs[i], engine);
+            if (cmpStringStr(got, expected[i]) != 0)
+            {
+                PRINT_ERR("`%s`: expected `%s`, engine %d = `%s`", inputs[i],
+                          expected[i], engine, getStr(got));
+                testStatus = TEST_FAILED;
+            }
+            freeString(got);
+        }
+
+        GCStats stats = getGCStats(env);
+        if (stats.collections == 0 || stats.minorCollections == 0)
+        {
+            PRINT_ERR("engine %d never collected", engine);
+            testStatus = TEST_FAILED;
+        }
+        freeEnvironment(env);
+    }
+    return testStatus;
+}
+
+TEST(CollectStrings)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let mk = fn(n, s) { if (n == 0) { s } else { "
+        "mk(n - 1, s + \"ab\") } }; "
+        "let keep = {mk(3, \"\"): 1, mk(40, \"\"): 2};",
+        "let churn = fn(n, last) { if (n > 0) { churn(n - 1, "
+        "{mk(n / 20 + 1, \"c\"): mk(20, \"c\")}) } else { last } }; "
+        "churn(300, {})[\"cab\"][40]",
+        "keep[\"ab\" + \"ab\" + \"ab\"] + keep[mk(40, \"\")]",
+    };
+    const char* expected[] = {"", "b", "3"};
+
+    // Short strings outlive their entry in the intern table only if they
+    // are reachable, and ropes keep their halves until flattened
+    for (int engine = RUN_EVAL; engine <= RUN_CLOSURES; ++engine)
+    {
+        Environment* env = mkEnvironment();
+        setHeapGrowth(env, 0);
+        setMarkBudget(env, 4);
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            String* got = runForTest(env, inputs[i], engine);
+            if (cmpStringStr(got, expected[i]) != 0)
+            {
+                PRINT_ERR("`%s`: expected `%s`, engine %d = `%s`", inputs[i],
+                          expected[i], engine, getStr(got));
+                testStatus = TEST_FAILED;
+            }
+            freeString(got);
+        }
+
+        if (getGCStats(env).collections == 0)
+        {
+            PRINT_ERR("engine %d never collected", engine);
+            testStatus = TEST_FAILED;
+        }
+        freeEnvironment(env);
+    }
+    return testStatus;
+}
+
+// Engines only read the AST, so they run a program whose equal subtrees
+// share nodes as they run the program itself
+TEST(RunHashConsedPrograms)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let f = fn(n) { if (n < 2) { n } else { f(n - 1) + f(n - 2) } }; "
+        "let g = fn(n) { if (n < 2) { n } else { g(n - 1) + g(n - 2) } }; "
+        "[f(15), g(15), f(15) == g(15)]",
+        "let a = fn(x) { fn(y) { x + y } }; let b = fn(x) { fn(y) { x + y } }; "
+        "a(1)(2) + b(1)(2) + a(1)(2)",
+        "let h = {\"k\" + \"1\": [1, 2][1], \"k\" + \"1\": [1, 2][1]}; "
+        "[h, h[\"k1\"] + [1, 2][1]]",
+        "let f = fn(n, s) { if (n == 0) { s } else { f(n - 1, s + 1) } }; "
+        "f(1000, 0) + f(1000, 0)",
+    };
+
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        for (int engine = RUN_EVAL; engine <= RUN_CLOSURES; ++engine)
+        {
+            Environment* env       = mkEnvironment();
+            Environment* sharedEnv = mkEnvironment();
+            String* expected       = runForTest(env, inputs[i], engine);
+            Program* program       = parseForVM(sharedEnv, inputs[i]);
+            HashConsStats stats    = hashConsProgram(program);
+            String* got = runProgramForTest(sharedEnv, program, engine);
+
+            if (cmpString(got, expected) != 0
+                || stats.uniqueNodes >= stats.exprNodes)
+            {
+                PRINT_ERR("`%s`: engine %d gives `%s` unshared, `%s` with "
+                          "%zu of %zu nodes",
+                          inputs[i], engine, getStr(expected), getStr(got),
+                          stats.uniqueNodes, stats.exprNodes);
+                testStatus = TEST_FAILED;
+            }
+
+            freeString(expected);
+            freeString(got);
+            freeEnvironment(env);
+            freeEnvironment(sharedEnv);
+        }
+    }
+    return testStatus;
+}
+
+TEST(EliminateTailCalls)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let count = fn(n) { if (n == 0) { 0 } else { count(n - 1) } }; "
+        "count(100000)",
+        "let even = fn(n) { if (n == 0) { true } else { odd(n - 1) } }; "
+        "let odd = fn(n) { if (n == 0) { false } else { even(n - 1) } }; "
+        "even(100001)",
+        "let sum = fn(n, acc) { if (n > 0) { return sum(n - 1, acc + n); } "
+        "acc }; sum(100000, 0)",
+        "let add = fn(a) { fn(b, n) { if (n > 0) { add(a + b)(b, n - 1) } "
+        "else { a } } }; add(0)(2, 50000)",
+        "let deep = fn(n) { if (n == 0) { 0 } else { deep(n - 1) + 1 } }; "
+        "deep(1000)",
+    };
+    const char* expected[] = {"0", "false", "5000050000", "100000", "1000"};
+    size_t tailCalls[]     = {100000, 100001, 100000, 50000, 0};
+
+    // Each call in tail position, and none other, takes over the frame of
+    // its caller
+    for (int engine = RUN_EVAL; engine <= RUN_CLOSURES; ++engine)
+    {
+        Environment* env = mkEnvironment();
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            size_t before = getTailCallCount(env);
+            String* got   = runForTest(env, inputs[i], engine);
+            if (cmpStringStr(got, expected[i]) != 0)
+            {
+                PRINT_ERR("`%s`: expected `%s`, engine %d = `%s`", inputs[i],
+                          expected[i], engine, getStr(got));
+                testStatus = TEST_FAILED;
+            }
+            else if (getTailCallCount(env) - before != tailCalls[i])
+            {
+                PRINT_ERR("`%s`: expected %zu tail calls, engine %d = %zu",
+                          inputs[i], tailCalls[i], engine,
+                          getTailCallCount(env) - before);
+                testStatus = TEST_FAILED;
+            }
+            freeString(got);
+        }
+        freeEnvironment(env);
+    }
+
+    // Emitted code, built unoptimized, jumps back to the entry of a
+    // function calling itself
+    const char* deep = "let count = fn(n, acc) { if (n == 0) { acc } "
+                       "else { count(n - 1, acc + 1) } }; count(1000000, 0)";
+    int lastEngine = hasCCompiler() ? RUN_EMITTED_C : RUN_CLOSURES;
+#if defined(__x86_64__) && defined(__linux__)
+    if (hasCCompiler())
+        lastEngine = RUN_EMITTED_ASM;
+#endif
+    for (int engine = RUN_EMITTED_C; engine <= lastEngine; ++engine)
+    {
+        Environment* env = mkEnvironment();
+        String* got      = runForTest(env, deep, engine);
+        if (cmpStringStr(got, "1000000") != 0)
+        {
+            PRINT_ERR("`%s`: expected `1000000`, engine %d = `%s`", deep,
+                      engine, getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        freeString(got);
+        freeEnvironment(env);
+    }
+    return testStatus;
+}
+
+TEST(BoundRecursionOnTheCStack)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* input = "let w = fn(n) { if (n == 0) { 0 } "
+                        "else { 1 + w(n - 1) } }; w(100000)";
+
+    // eval and the closure compiler nest calls on the C stack, the VMs
+    // on a frame stack of their own
+    for (int engine = RUN_EVAL; engine <= RUN_CLOSURES; ++engine)
+    {
+        const char* expected =
+            engine == RUN_EVAL || engine == RUN_CLOSURES
+                ? "ERROR: stack overflow"
+                : "100000";
+        Environment* env = mkEnvironment();
+        String* got      = runForTest(env, input, engine);
+        if (cmpStringStr(got, expected) != 0)
+        {
+            PRINT_ERR("expected `%s`, engine %d = `%s`", expected, engine,
+                      getStr(got));
+            testStatus = TEST_FAILED;
+        }
+        freeString(got);
+        freeEnvironment(env);
+    }
+    return testStatus;
+}
+
+TEST(MemoizePureCalls)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* inputs[] = {
+        "let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) };"
+        "fib(60)",
+        "let choose = fn(n, k) { if (k == 0) { return 1; } if (k == n) "
+        "{ return 1; } choose(n - 1, k - 1) + choose(n - 1, k) }; "
+        "choose(40, 20)",
+        "let even = fn(n) { if (n == 0) { true } else { odd(n - 1) } }; "
+        "let odd = fn(n) { if (n == 0) { false } else { even(n - 1) } }; "
+        "even(301) == odd(301)",
+        "let f = fn(x) { g(x) * 2 }; let g = fn(x) { x + 1 }; f(1)",
+        "let g = fn(x) { x + 2 }; f(1)",
+        "let mk = fn(n) { fn() { n } }; mk(1) == mk(1)",
+    };
+    const char* expected[] = {"1548008755920", "137846528820", "false", "4",
+                              "6",             "false"};
+
+    // Small enough a table to evict, with every engine answering from it
+    for (int engine = RUN_EVAL; engine <= RUN_CLOSURES; ++engine)
+    {
+        Environment* env = mkEnvironment();
+        setMemoCapacity(env, 64);
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            String* got = runForTest(env, inputs[i], engine);
+            if (cmpStringStr(got, expected[i]) != 0)
+            {
+                PRINT_ERR("`%s`: expected `%s`, engine %d = `%s`", inputs[i],
+                          expected[i], engine, getStr(got));
+                testStatus = TEST_FAILED;
+            }
+            freeString(got);
+        }
+
+        MemoStats stats = getMemoStats(env);
+        if (stats.hits == 0 || stats.evictions == 0 || stats.flushes != 1
+            || stats.entries > 64)
+        {
+            PRINT_ERR("engine %d: %" PRIu64 " hits, %" PRIu64 " evicted, "
+                      "%" PRIu64 " flushes, %zu entries",
+                      engine, stats.hits, stats.evictions, stats.flushes,
+                      stats.entries);
+            testStatus = TEST_FAILED;
+        }
+        freeEnvironment(env);
+    }
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(CompileToBytecode);
+        RUN_TEST(CompileFunctionBodies);
+        RUN_TEST(FuseInstructions);
+        RUN_TEST(CacheCallSites);
+        RUN_TEST(CompileHotFunctions);
+        RUN_TEST(NestInterpreterInNativeCalls);
+        RUN_TEST(CompileToRegisters);
+        RUN_TEST(AllocateRegisters);
+        RUN_TEST(SpecializeHandlers);
+        RUN_TEST(MatchEvaluator);
+        RUN_TEST(RunAcrossPrograms);
+        RUN_TEST(CollectOnEveryClosure);
+        RUN_TEST(MoveClosuresOutOfTheNursery);
+        RUN_TEST(MarkIncrementally);
+        RUN_TEST(CollectArraysAndHashes);
+        RUN_TEST(CollectStrings);
+        RUN_TEST(RunHashConsedPrograms);
+        RUN_TEST(EliminateTailCalls);
+        RUN_TEST(BoundRecursionOnTheCStack);
+        RUN_TEST(MemoizePureCalls);
+    })
+
+#undef MAIN_TEST_NAME // End TestVM
@@ -0,0 +1,344 @@
+#include <stdlib.h>
+
+#include "walker.h"
+
+typedef enum
+{
+    FRAME_ENTER = 0,
+    FRAME_BETWEEN,
+    FRAME_LEAVE,
+} FrameState;
+
+struct WalkFrame
+{
+    AstNode node;
+    FrameState state;
+    size_t child; // index of the next child for FRAME_BETWEEN
+};
+
+struct WalkStack
+{
+    struct WalkFrame* frames;
+    size_t capacity;
+    size_t len;
+    AstNode* children; // scratch space for the children of one node
+    size_t childCapacity;
+};
+
+/* Private Function Signatures */
+static void pushFrame(struct WalkStack*, AstNode, FrameState, size_t);
+static void pushChildren(struct WalkStack*, AstNode, int);
+static size_t collectArguments(Arguments*, AstNode*);
+
+#define BLOCK_NODE(value) ((AstNode){NODE_BLOCK, {.block = (value)}})
+#define STMT_NODE(value)  ((AstNode){NODE_STMT, {.stmt = (value)}})
+#define EXPR_NODE(value)  ((AstNode){NODE_EXPR, {.expr = (value)}})
+
+WalkResult walkProgram(Program* pProg, const Visitor* visitor, void* ctx)
+{
+    if (!pProg)
+        return WALK_CONTINUE;
+    return walkNode(BLOCK_NODE((BlockStmt*)pProg), visitor, ctx);
+}
+
+WalkResult walkStmt(Stmt* pStmt, const Visitor* visitor, void* ctx)
+{
+    if (!pStmt)
+        return WALK_CONTINUE;
+    return walkNode(STMT_NODE(pStmt), visitor, ctx);
+}
+
+WalkResult walkExpr(Expr* pExpr, const Visitor* visitor, void* ctx)
+{
+    if (!pExpr)
+        return WALK_CONTINUE;
+    return walkNode(EXPR_NODE(pExpr), visitor, ctx);
+}
+
+WalkResult walkNode(AstNode root, const Visitor* visitor, void* ctx)
+{
+    struct WalkStack stack = {NULL, 0, 0, NULL, 0};
+    struct WalkFrame frame;
+    WalkResult result = WALK_CONTINUE;
+
+    pushFrame(&stack, root, FRAME_ENTER, 0);
+
+    while (stack.len > 0)
+    {
+        frame = stack.frames[--stack.len];
+
+        switch (frame.state)
+        {
+        case FRAME_ENTER:
+            if (visitor->pre)
+                result = visitor->pre(frame.node, ctx);
+            break;
+
+        case FRAME_BETWEEN:
+            result = visitor->between(frame.node, frame.child, ctx);
+            break;
+
+        case FRAME_LEAVE:
+            if (visitor->post)
+                result = visitor->post(frame.node, ctx);
+            break;
+        }
+
+        if (result == WALK_STOP)
+            break;
+
+        if (frame.state == FRAME_ENTER && result != WALK_SKIP)
+        {
+            pushFrame(&stack, frame.node, FRAME_LEAVE, 0);
+            pushChildren(&stack, frame.node, visitor->between != NULL);
+        }
+        result = WALK_CONTINUE;
+    }
+
+    free(stack.frames);
+    free(stack.children);
+    return result;
+}
+
+size_t countChildren(AstNode node)
+{
+    switch (node.kind)
+    {
+    case NODE_BLOCK:
+        return node.as.block->len;
+
+    case NODE_STMT:
+        // A statement left without its inner node has nothing below it
+        if (!node.as.stmt->inner.checkIsNull)
+            return 0;
+
+        switch (node.as.stmt->type)
+        {
+        case STMT_LET:
+            return node.as.stmt->inner.letStmt->value != NULL;
+        case STMT_RETURN:
+            return node.as.stmt->inner.returnStmt->returnValue != NULL;
+        case STMT_EXPRESSION:
+            return node.as.stmt->inner.exprStmt->expression != NULL;
+        case STMT_BLOCK:
+            return node.as.stmt->inner.blockStmt != NULL;
+        default:
+            return 0;
+        }
+
+    case NODE_EXPR:
+    {
+        Expr* expr = node.as.expr;
+        if (!expr->inner.checkIsNull)
+            return 0;
+
+        switch (expr->type)
+        {
+        case EXPR_PREFIX:
+            return expr->inner.prefixExpr->right != NULL;
+        case EXPR_INFIX:
+            return (size_t)(expr->inner.infixExpr->left != NULL)
+                 + (size_t)(expr->inner.infixExpr->right != NULL);
+        case EXPR_IF:
+            return (size_t)(expr->inner.ifExpr->condition != NULL)
+                 + (size_t)(expr->inner.ifExpr->consequence != NULL)
+                 + (size_t)(expr->inner.ifExpr->alternative != NULL);
+        case EXPR_FUNCTION:
+            return expr->inner.fntExpr->body != NULL;
+        case EXPR_CALL:
+            return (size_t)(expr->inner.callExpr->function != NULL)
+                 + (expr->inner.callExpr->arguments
+                        ? expr->inner.callExpr->arguments->len
+                        : 0);
+        case EXPR_ARRAY:
+            return expr->inner.arrayExpr->elements
+                       ? expr->inner.arrayExpr->elements->len
+                       : 0;
+        case EXPR_HASH:
+            return expr->inner.hashExpr->pairs
+                       ? expr->inner.hashExpr->pairs->len
+                       : 0;
+        case EXPR_INDEX:
+            return (size_t)(expr->inner.indexExpr->left != NULL)
+                 + (size_t)(expr->inner.indexExpr->index != NULL);
+        default:
+            return 0;
+        }
+    }
+
+    default:
+        return 0;
+    }
+}
+
+static void pushFrame(struct WalkStack* stack, AstNode node,
+                      FrameState state, size_t child)
+{
+    if (stack->len == stack->capacity)
+    {
+        stack->capacity = stack->capacity ? stack->capacity << 1 : 64;
+        stack->frames   = realloc(stack->frames,
+                                  stack->capacity * sizeof(struct WalkFrame));
+    }
+
+    stack->frames[stack->len++] = (struct WalkFrame){node, state, child};
+}
+
+// The list runs from the first expression at tail to the last at head
+static size_t collectArguments(Arguments* args, AstNode* children)
+{
+    size_t len = 0;
+    if (!args)
+        return 0;
+
+    struct ArgNode* tmp = args->tail->before;
+    while (tmp != args->head)
+    {
+        if (tmp->value)
+            children[len++] = EXPR_NODE(tmp->value);
+        tmp = tmp->before;
+    }
+    return len;
+}
+
+// Collect the children of a node, first to last
+static size_t collectChildren(AstNode node, AstNode* children)
+{
+    size_t len = 0;
+
+#define PUSH_CHILD(kind, field, value)                       \
+    if (value)                                               \
+        children[len++] = (AstNode){kind, {.field = (value)}};
+
+    switch (node.kind)
+    {
+    case NODE_BLOCK:
+    {
+        // The list runs from the first statement at tail to the last at head
+        struct ProgNode* tmp = node.as.block->tail->before;
+        while (tmp != node.as.block->head)
+        {
+            PUSH_CHILD(NODE_STMT, stmt, tmp->value);
+            tmp = tmp->before;
+        }
+        break;
+    }
+
+    case NODE_STMT:
+    {
+        Stmt* stmt = node.as.stmt;
+        if (!stmt->inner.checkIsNull)
+            break;
+
+        switch (stmt->type)
+        {
+        case STMT_LET:
+            PUSH_CHILD(NODE_EXPR, expr, stmt->inner.letStmt->value);
+            break;
+
+        case STMT_RETURN:
+            PUSH_CHILD(NODE_EXPR, expr, stmt->inner.returnStmt->returnValue);
+            break;
+
+        case STMT_EXPRESSION:
+            PUSH_CHILD(NODE_EXPR, expr, stmt->inner.exprStmt->expression);
+            break;
+
+        case STMT_BLOCK:
+            PUSH_CHILD(NODE_BLOCK, block, stmt->inner.blockStmt);
+            break;
+
+        default:
+            break;
+        }
+        break;
+    }
+
+    case NODE_EXPR:
+    {
+        Expr* expr = node.as.expr;
+        if (!expr->inner.checkIsNull)
+            break;
+
+        switch (expr->type)
+        {
+        case EXPR_PREFIX:
+            PUSH_CHILD(NODE_EXPR, expr, expr->inner.prefixExpr->right);
+            break;
+
+        case EXPR_INFIX:
+            PUSH_CHILD(NODE_EXPR, expr, expr->inner.infixExpr->left);
+            PUSH_CHILD(NODE_EXPR, expr, expr->inner.infixExpr->right);
+            break;
+
+        case EXPR_IF:
+            PUSH_CHILD(NODE_EXPR, expr, expr->inner.ifExpr->condition);
+            PUSH_CHILD(NODE_BLOCK, block, expr->inner.ifExpr->consequence);
+            PUSH_CHILD(NODE_BLOCK, block, expr->inner.ifExpr->alternative);
+            break;
+
+        case EXPR_FUNCTION:
+            PUSH_CHILD(NODE_BLOCK, block, expr->inner.fntExpr->body);
+            break;
+
+        case EXPR_CALL:
+            PUSH_CHILD(NODE_EXPR, expr, expr->inner.callExpr->function);
+            len += collectArguments(expr->inner.callExpr->arguments,
+                                    children + len);
+            break;
+
+        case EXPR_ARRAY:
+            len += collectArguments(expr->inner.arrayExpr->elements,
+                                    children + len);
+            break;
+
+        case EXPR_HASH:
+            len += collectArguments(expr->inner.hashExpr->pairs,
+                                    children + len);
+            break;
+
+        case EXPR_INDEX:
+            PUSH_CHILD(NODE_EXPR, expr, expr->inner.indexExpr->left);
+            PUSH_CHILD(NODE_EXPR, expr, expr->inner.indexExpr->index);
+            break;
+
+        default:
+            break;
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+#undef PUSH_CHILD
+
+    return len;
+}
+
+// Children are pushed last to first so that they are popped in source
+// order, each but the first preceded by its between frame.
+static void pushChildren(struct WalkStack* stack, AstNode node,
+                         int withBetween)
+{
+    size_t len = countChildren(node);
+    if (len == 0)
+        return;
+
+    if (len > stack->childCapacity)
+    {
+        stack->childCapacity = len;
+        stack->children      = realloc(stack->children,
+                                       stack->childCapacity * sizeof(AstNode));
+    }
+
+    len = collectChildren(node, stack->children);
+
+    for (size_t i = len; i-- > 0;)
+    {
+        pushFrame(stack, stack->children[i], FRAME_ENTER, 0);
+        if (withBetween && i > 0)
+            pushFrame(stack, node, FRAME_BETWEEN, i);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef _MONKEY_LANG_SRC_WALKER_H_
+#define _MONKEY_LANG_SRC_WALKER_H_
+
+#include "ast.h"
+
+typedef enum
+{
+    NODE_BLOCK = 0, // Program or BlockStmt
+    NODE_STMT,
+    NODE_EXPR,
+} NodeKind;
+
+typedef struct
+{
+    NodeKind kind;
+    union
+    {
+        BlockStmt* block;
+        Stmt* stmt;
+        Expr* expr;
+    } as;
+} AstNode;
+
+typedef enum
+{
+    WALK_CONTINUE = 0,
+    WALK_SKIP, // Returned by pre: skip the children and post of this node
+    WALK_STOP, // Abort the whole walk
+} WalkResult;
+
+typedef WalkResult (*WalkFn)(AstNode, void* ctx);
+typedef WalkResult (*WalkBetweenFn)(AstNode, size_t child, void* ctx);
+
+// Any callback may be NULL. pre runs before the children of a node and
+// post after all of them; between runs before every child but the first,
+// with the index of that child. Children are visited in source order:
+// statements of a block, then the operands of an expression from left to
+// right.
+typedef struct
+{
+    WalkFn pre;
+    WalkBetweenFn between;
+    WalkFn post;
+} Visitor;
+
+// Walk the tree below a node without recursion: pending nodes are kept on
+// a heap-allocated stack, so the depth of the tree is only bounded by
+// memory. The children of a node are collected when it is entered, so post
+// may free the node it is given. Returns WALK_STOP if a callback stopped
+// the walk, WALK_CONTINUE otherwise.
+WalkResult walkNode(AstNode, const Visitor*, void* ctx);
+WalkResult walkProgram(Program*, const Visitor*, void* ctx);
+WalkResult walkStmt(Stmt*, const Visitor*, void* ctx);
+WalkResult walkExpr(Expr*, const Visitor*, void* ctx);
+
+// Number of children walkNode visits below a node
+size_t countChildren(AstNode);
+
+#endif //_MONKEY_LANG_SRC_WALKER_H_
@@ -0,0 +1,188 @@
+#define MAIN_TEST_NAME TestWalker
+
+#include "parser.h"
+#include "testing.h"
+#include "walker.h"
+
+#define WALK_LOG_SIZE 64
+
+struct WalkLog
+{
+    char entries[WALK_LOG_SIZE];
+    size_t len;
+    size_t stopAfter;
+};
+
+/* Function Signatures */
+char walkLogCode(AstNode);
+WalkResult logPre(AstNode, void*);
+WalkResult logPost(AstNode, void*);
+WalkResult skipFunctions(AstNode, void*);
+
+// One letter per node: uppercase on entry, lowercase on exit
+char walkLogCode(AstNode node)
+{
+    switch (node.kind)
+    {
+    case NODE_BLOCK:
+        return 'B';
+    case NODE_STMT:
+        return "ELRXK"[node.as.stmt->type];
+    default:
+        return "EINTPQYFC"[node.as.expr->type];
+    }
+}
+
+WalkResult logPre(AstNode node, void* ctx)
+{
+    struct WalkLog* log = ctx;
+    log->entries[log->len++] = walkLogCode(node);
+    if (log->stopAfter && log->len >= log->stopAfter)
+        return WALK_STOP;
+    return WALK_CONTINUE;
+}
+
+WalkResult logPost(AstNode node, void* ctx)
+{
+    struct WalkLog* log = ctx;
+    log->entries[log->len++] = (char)(walkLogCode(node) - 'A' + 'a');
+    return WALK_CONTINUE;
+}
+
+WalkResult skipFunctions(AstNode node, void* ctx)
+{
+    if (node.kind == NODE_EXPR && node.as.expr->type == EXPR_FUNCTION)
+        return WALK_SKIP;
+    return logPre(node, ctx);
+}
+
+TEST(VisitOrder)
+{
+    int testStatus = TEST_SUCESSED;
+    struct
+    {
+        WalkFn pre;
+        size_t stopAfter;
+        const char* expected;
+        WalkResult expectedResult;
+    } tests[] = {
+        {logPre, 0, "BLCIiNnPIipclXYIiBXIixbyxb", WALK_CONTINUE},
+        {logPre, 4, "BLCI", WALK_STOP},
+        {skipFunctions, 0, "BLCIiNnPIipclXYIiBXIixbyxb", WALK_CONTINUE},
+    };
+    const char* input = "let a = f(1, -x); if (y) { z }";
+
+    Lexer* l = mkLexer(input);
+    Parser* p = mkParser(l);
+    Program* program = parseProgram(p);
+    freeParser(p);
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+        struct WalkLog log = {{0}, 0, tests[i].stopAfter};
+        Visitor visitor = {tests[i].pre, NULL, logPost};
+
+        WalkResult result = walkProgram(program, &visitor, &log);
+        log.entries[log.len] = '\0';
+
+        if (strcmp(log.entries, tests[i].expected) != 0)
+        {
+            PRINT_ERR("expected `%s`, got = `%s`", tests[i].expected,
+                      log.entries);
+            testStatus = TEST_FAILED;
+        }
+        if (result != tests[i].expectedResult)
+        {
+            PRINT_ERR("expected result %d, got = %d",
+                      tests[i].expectedResult, result);
+            testStatus = TEST_FAILED;
+        }
+    }
+
+    freeProgram(program);
+    return testStatus;
+}
+
+TEST(SkipChildren)
+{
+    int testStatus = TEST_SUCESSED;
+    const char* input = "fn(x) { x + 1 }(2)";
+    const char* expected = "BXCNncxb";
+
+    Lexer* l = mkLexer(input);
+    Parser* p = mkParser(l);
+    Program* program = parseProgram(p);
+    freeParser(p);
+
+    struct WalkLog log = {{0}, 0, 0};
+    Visitor visitor = {skipFunctions, NULL, logPost};
+    walkProgram(program, &visitor, &log);
+    log.entries[log.len] = '\0';
+
+    // The function literal is neither entered nor left
+    if (strcmp(log.entries, expected) != 0)
+    {
+        PRINT_ERR("expected `%s`, got = `%s`", expected, log.entries);
+        testStatus = TEST_FAILED;
+    }
+
+    freeProgram(program);
+    return testStatus;
+}
+
+TEST(DeepTree)
+{
+    int testStatus = TEST_SUCESSED;
+    // Deep enough to overflow the C stack if freeing were recursive
+    size_t depth = 1000000;
+
+    Expr* root = mkExpr();
+    root->type = EXPR_INTEGER;
+    root->inner.intExpr = mkIntExpr();
+    root->inner.intExpr->value = 1;
+
+    for (size_t i = 0; i < depth; ++i)
+    {
+        Expr* prefix = mkExpr();
+        prefix->type = EXPR_PREFIX;
+        prefix->inner.prefixExpr = mkPrefixExpr();
+        prefix->inner.prefixExpr->opt = mkString("-");
+        freeExpr(prefix->inner.prefixExpr->right);
+        prefix->inner.prefixExpr->right = root;
+        root = prefix;
+    }
+
+    size_t count = 0;
+    Expr* tmp = root;
+    while (tmp->type == EXPR_PREFIX)
+    {
+        tmp = tmp->inner.prefixExpr->right;
+        ++count;
+    }
+    if (count != depth)
+    {
+        PRINT_ERR("expected depth %zu, got = %zu", depth, count);
+        testStatus = TEST_FAILED;
+    }
+
+    String* string = stringifyExpr(root);
+    if (getLen(string) != depth * 3 + 1)
+    {
+        PRINT_ERR("expected %zu characters, got = %zu", depth * 3 + 1,
+                  getLen(string));
+        testStatus = TEST_FAILED;
+    }
+
+    freeString(string);
+    freeExpr(root);
+    return testStatus;
+}
+
+MAIN_TEST(
+    {
+        RUN_TEST(VisitOrder);
+        RUN_TEST(SkipChildren);
+        RUN_TEST(DeepTree);
+    })
+
+#undef MAIN_TEST_NAME // End TestWalker
@@ -0,0 +1,116 @@
+// Pick the superinstructions of the bytecode VM from a dispatch profile,
+// and print them as the X-macro list included by code.h, code.c and vm.c.
+//
+// usage: superGen <profile> > src/superinstructions.h
+//
+// Each line of the profile is a count followed by two or three opcode
+// names, the times that sequence ran in a row in the training run, as
+// printed by `monkey_bench --profile`. Lines starting with '#' are
+// comments. A missing profile gives no superinstructions.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SUPERINSTRUCTIONS 32
+#define MAX_SEQUENCES         4096
+#define MAX_PARTS             3
+#define MAX_NAME              32
+
+struct Sequence
+{
+    unsigned long long count;
+    char parts[MAX_PARTS][MAX_NAME];
+    int len;
+};
+
+// Only these may end a superinstruction: they change the flow of control,
+// or are too large to be worth copying into another handler
+static const char* const lastOnly[] = {
+    "OP_JUMP", "OP_JUMP_FALSY", "OP_ARRAY", "OP_HASH", "OP_INDEX",
+    "OP_CLOSURE", "OP_CALL", "OP_TAIL_CALL", "OP_RETURN",
+};
+
+static int isLastOnly(const char* name)
+{
+    for (size_t i = 0; i < sizeof(lastOnly) / sizeof(lastOnly[0]); ++i)
+    {
+        if (strcmp(name, lastOnly[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Dispatches saved by fusing the sequence every time it ran
+static unsigned long long saved(const struct Sequence* sequence)
+{
+    return sequence->count * (unsigned long long)(sequence->len - 1);
+}
+
+static int bySavings(const void* lhs, const void* rhs)
+{
+    unsigned long long l = saved(lhs);
+    unsigned long long r = saved(rhs);
+    return l < r ? 1 : l > r ? -1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <profile>\n", argv[0]);
+        return 1;
+    }
+
+    static struct Sequence sequences[MAX_SEQUENCES];
+    size_t len = 0;
+    char line[256];
+
+    FILE* profile = fopen(argv[1], "r");
+    while (profile && len < MAX_SEQUENCES && fgets(line, sizeof(line), profile))
+    {
+        struct Sequence* sequence = &sequences[len];
+        if (line[0] == '#')
+            continue;
+
+        int fields = sscanf(line, "%llu %31s %31s %31s", &sequence->count,
+                            sequence->parts[0], sequence->parts[1],
+                            sequence->parts[2]);
+        if (fields < 3)
+            continue;
+        sequence->len = fields - 1;
+
+        int valid = 1;
+        for (int i = 0; i < sequence->len; ++i)
+            valid = valid && strncmp(sequence->parts[i], "OP_", 3) == 0;
+        for (int i = 0; i + 1 < sequence->len; ++i)
+            valid = valid && !isLastOnly(sequence->parts[i]);
+        if (valid)
+            ++len;
+    }
+    if (profile)
+        fclose(profile);
+
+    qsort(sequences, len, sizeof(struct Sequence), bySavings);
+    if (len > MAX_SUPERINSTRUCTIONS)
+        len = MAX_SUPERINSTRUCTIONS;
+
+    printf("// Generated by tools/superGen.c from %s; do not edit.\n"
+           "// The most rewarding sequences of the training run, with the "
+           "dispatches\n// they saved. Included by code.h, code.c and "
+           "vm.c, which define\n// SUPER_PAIR and SUPER_TRIPLE.\n",
+           argv[1]);
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        const struct Sequence* sequence = &sequences[i];
+
+        printf("%s(OP", sequence->len == 2 ? "SUPER_PAIR" : "SUPER_TRIPLE");
+        for (int j = 0; j < sequence->len; ++j)
+            printf("_%s", sequence->parts[j] + strlen("OP_"));
+        for (int j = 0; j < sequence->len; ++j)
+            printf(", %s", sequence->parts[j]);
+        printf(") // %llu\n", saved(sequence));
+    }
+
+    return 0;
+}